@@ -29,34 +29,154 @@
 #include "util/hash_table.h"
 #include "util/macros.h"
 #include "util/ralloc.h"
+#include "util/u_atomic.h"
 #include "util/u_math.h"
 #include "util/u_string.h"
 #include "util/simple_mtx.h"
 
+/* Interning table for one kind of derived type.
+ *
+ * Lookups take no lock: they walk an open-addressed array of immutable
+ * entries that writers publish with release stores.  Insertions are
+ * serialized by the table's own lock and allocate from the table's own
+ * arena, so lookups of different kinds of types never contend.  When the
+ * array grows, the old one is left alive until the cache is destroyed since
+ * readers may still be walking it.
+ */
+struct glsl_type_table_entry {
+   uint32_t hash;
+   const void *key;
+   const glsl_type *type;
+};
+
+struct glsl_type_table_slots {
+   uint32_t size_mask;
+   struct glsl_type_table_entry *entries[];
+};
+
+struct glsl_type_table {
+   simple_mtx_t lock;
+   linear_ctx *lin_ctx;
+   struct glsl_type_table_slots *slots;
+   uint32_t count;
+};
+
+typedef bool (*glsl_type_key_equal_func)(const void *a, const void *b);
+
+/* Protects the users count, and the creation and destruction of the cache. */
 static simple_mtx_t glsl_type_cache_mutex = SIMPLE_MTX_INITIALIZER;
 
 static struct {
    void *mem_ctx;
 
-   /* Use a linear (arena) allocator for all the new types, since
-    * they are not meant to be deallocated individually.
-    */
-   linear_ctx *lin_ctx;
-
    /* There might be multiple users for types (e.g. application using OpenGL
     * and Vulkan simultaneously or app using multiple Vulkan instances). Counter
     * is used to make sure we don't release the types if a user is still present.
     */
    uint32_t users;
 
-   struct hash_table *explicit_matrix_types;
-   struct hash_table *array_types;
-   struct hash_table *cmat_types;
-   struct hash_table *struct_types;
-   struct hash_table *interface_types;
-   struct hash_table *subroutine_types;
+   struct glsl_type_table explicit_matrix_types;
+   struct glsl_type_table array_types;
+   struct glsl_type_table cmat_types;
+   struct glsl_type_table struct_types;
+   struct glsl_type_table interface_types;
+   struct glsl_type_table subroutine_types;
 } glsl_type_cache;
 
+#define GLSL_TYPE_TABLE_INITIAL_SIZE 64
+
+static void
+glsl_type_table_init(struct glsl_type_table *table, void *mem_ctx)
+{
+   simple_mtx_init(&table->lock, mtx_plain);
+
+   /* Use a linear (arena) allocator for all the new types, since
+    * they are not meant to be deallocated individually.
+    */
+   table->lin_ctx = linear_context(mem_ctx);
+   table->slots = NULL;
+   table->count = 0;
+}
+
+static void
+glsl_type_table_fini(struct glsl_type_table *table)
+{
+   simple_mtx_destroy(&table->lock);
+}
+
+static const glsl_type *
+glsl_type_table_search(struct glsl_type_table *table, uint32_t hash,
+                       const void *key, glsl_type_key_equal_func key_equal)
+{
+   assert(p_atomic_read(&glsl_type_cache.users) > 0);
+
+   const struct glsl_type_table_slots *slots = p_atomic_read(&table->slots);
+   if (slots == NULL)
+      return NULL;
+
+   /* The table is never more than half full, so the probe always ends on an
+    * empty slot.
+    */
+   for (uint32_t i = hash & slots->size_mask;; i = (i + 1) & slots->size_mask) {
+      const struct glsl_type_table_entry *entry =
+         p_atomic_read(&slots->entries[i]);
+      if (entry == NULL)
+         return NULL;
+      if (entry->hash == hash && key_equal(key, entry->key))
+         return entry->type;
+   }
+}
+
+static void
+glsl_type_table_place(struct glsl_type_table_slots *slots,
+                      struct glsl_type_table_entry *entry)
+{
+   uint32_t i = entry->hash & slots->size_mask;
+   while (slots->entries[i] != NULL)
+      i = (i + 1) & slots->size_mask;
+
+   p_atomic_set(&slots->entries[i], entry);
+}
+
+/**
+ * Add a type to the table.  Must be called with the table's lock held, after
+ * checking that the key is not already present.
+ */
+static void
+glsl_type_table_insert(struct glsl_type_table *table, uint32_t hash,
+                       const void *key, const glsl_type *type)
+{
+   simple_mtx_assert_locked(&table->lock);
+
+   struct glsl_type_table_slots *slots = table->slots;
+   const uint32_t size = slots ? slots->size_mask + 1 : 0;
+
+   if ((table->count + 1) * 2 > size) {
+      const uint32_t new_size = MAX2(size * 2, GLSL_TYPE_TABLE_INITIAL_SIZE);
+      struct glsl_type_table_slots *new_slots =
+         linear_zalloc_child(table->lin_ctx, sizeof(*new_slots) +
+                                             new_size * sizeof(new_slots->entries[0]));
+      new_slots->size_mask = new_size - 1;
+
+      for (uint32_t i = 0; i < size; i++) {
+         if (slots->entries[i] != NULL)
+            glsl_type_table_place(new_slots, slots->entries[i]);
+      }
+
+      p_atomic_set(&table->slots, new_slots);
+      slots = new_slots;
+   }
+
+   struct glsl_type_table_entry *entry =
+      linear_alloc(table->lin_ctx, struct glsl_type_table_entry);
+   entry->hash = hash;
+   entry->key = key;
+   entry->type = type;
+
+   glsl_type_table_place(slots, entry);
+   table->count++;
+}
+
 static const glsl_type *
 make_vector_matrix_type(linear_ctx *lin_ctx, uint32_t gl_type,
                         enum glsl_base_type base_type, unsigned vector_elements,
@@ -473,8 +593,14 @@ glsl_type_singleton_init_or_ref()
 
    simple_mtx_lock(&glsl_type_cache_mutex);
    if (glsl_type_cache.users == 0) {
-      glsl_type_cache.mem_ctx = ralloc_context(NULL);
-      glsl_type_cache.lin_ctx = linear_context(glsl_type_cache.mem_ctx);
+      void *mem_ctx = ralloc_context(NULL);
+      glsl_type_cache.mem_ctx = mem_ctx;
+      glsl_type_table_init(&glsl_type_cache.explicit_matrix_types, mem_ctx);
+      glsl_type_table_init(&glsl_type_cache.array_types, mem_ctx);
+      glsl_type_table_init(&glsl_type_cache.cmat_types, mem_ctx);
+      glsl_type_table_init(&glsl_type_cache.struct_types, mem_ctx);
+      glsl_type_table_init(&glsl_type_cache.interface_types, mem_ctx);
+      glsl_type_table_init(&glsl_type_cache.subroutine_types, mem_ctx);
    }
    glsl_type_cache.users++;
    simple_mtx_unlock(&glsl_type_cache_mutex);
@@ -492,6 +618,13 @@ glsl_type_singleton_decref()
       return;
    }
 
+   glsl_type_table_fini(&glsl_type_cache.explicit_matrix_types);
+   glsl_type_table_fini(&glsl_type_cache.array_types);
+   glsl_type_table_fini(&glsl_type_cache.cmat_types);
+   glsl_type_table_fini(&glsl_type_cache.struct_types);
+   glsl_type_table_fini(&glsl_type_cache.interface_types);
+   glsl_type_table_fini(&glsl_type_cache.subroutine_types);
+
    ralloc_free(glsl_type_cache.mem_ctx);
    memset(&glsl_type_cache, 0, sizeof(glsl_type_cache));
 
@@ -736,7 +869,17 @@ struct PACKED explicit_matrix_key {
    uintptr_t row_major;
 };
 
-DERIVE_HASH_TABLE(explicit_matrix_key);
+static uint32_t
+explicit_matrix_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct explicit_matrix_key));
+}
+
+static bool
+explicit_matrix_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct explicit_matrix_key)) == 0;
+}
 
 static const glsl_type *
 get_explicit_matrix_instance(unsigned int base_type, unsigned int rows, unsigned int columns,
@@ -765,42 +908,35 @@ get_explicit_matrix_instance(unsigned int base_type, unsigned int rows, unsigned
 
    const uint32_t key_hash = explicit_matrix_key_hash(&key);
 
-   simple_mtx_lock(&glsl_type_cache_mutex);
-   assert(glsl_type_cache.users > 0);
-   void *mem_ctx = glsl_type_cache.mem_ctx;
-
-   if (glsl_type_cache.explicit_matrix_types == NULL) {
-      glsl_type_cache.explicit_matrix_types =
-         explicit_matrix_key_table_create(mem_ctx);
-   }
-   struct hash_table *explicit_matrix_types = glsl_type_cache.explicit_matrix_types;
+   struct glsl_type_table *table = &glsl_type_cache.explicit_matrix_types;
+   const glsl_type *t =
+      glsl_type_table_search(table, key_hash, &key, explicit_matrix_key_equal);
+   if (t == NULL) {
+      simple_mtx_lock(&table->lock);
 
-   const struct hash_entry *entry =
-      _mesa_hash_table_search_pre_hashed(explicit_matrix_types, key_hash, &key);
-   if (entry == NULL) {
+      /* Another thread may have added it while we were waiting for the lock. */
+      t = glsl_type_table_search(table, key_hash, &key, explicit_matrix_key_equal);
+      if (t == NULL) {
+         char name[128];
+         snprintf(name, sizeof(name), "%sx%ua%uB%s", glsl_get_type_name(bare_type),
+                  explicit_stride, explicit_alignment, row_major ? "RM" : "");
 
-      char name[128];
-      snprintf(name, sizeof(name), "%sx%ua%uB%s", glsl_get_type_name(bare_type),
-               explicit_stride, explicit_alignment, row_major ? "RM" : "");
+         linear_ctx *lin_ctx = table->lin_ctx;
+         t = make_vector_matrix_type(lin_ctx, bare_type->gl_type,
+                                     (enum glsl_base_type)base_type,
+                                     rows, columns, name,
+                                     explicit_stride, row_major,
+                                     explicit_alignment);
 
-      linear_ctx *lin_ctx = glsl_type_cache.lin_ctx;
-      const glsl_type *t =
-         make_vector_matrix_type(lin_ctx, bare_type->gl_type,
-                                 (enum glsl_base_type)base_type,
-                                 rows, columns, name,
-                                 explicit_stride, row_major,
-                                 explicit_alignment);
+         struct explicit_matrix_key *stored_key = linear_zalloc(lin_ctx, struct explicit_matrix_key);
+         memcpy(stored_key, &key, sizeof(key));
 
-      struct explicit_matrix_key *stored_key = linear_zalloc(lin_ctx, struct explicit_matrix_key);
-      memcpy(stored_key, &key, sizeof(key));
+         glsl_type_table_insert(table, key_hash, stored_key, t);
+      }
 
-      entry = _mesa_hash_table_insert_pre_hashed(explicit_matrix_types,
-                                                 key_hash, stored_key, (void *)t);
+      simple_mtx_unlock(&table->lock);
    }
 
-   const glsl_type *t = (const glsl_type *) entry->data;
-   simple_mtx_unlock(&glsl_type_cache_mutex);
-
    assert(t->base_type == base_type);
    assert(t->vector_elements == rows);
    assert(t->matrix_columns == columns);
@@ -1243,7 +1379,17 @@ struct PACKED array_key {
    uintptr_t explicit_stride;
 };
 
-DERIVE_HASH_TABLE(array_key);
+static uint32_t
+array_key_hash(const void *key)
+{
+   return _mesa_hash_data(key, sizeof(struct array_key));
+}
+
+static bool
+array_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct array_key)) == 0;
+}
 
 const glsl_type *
 glsl_array_type(const glsl_type *element,
@@ -1260,30 +1406,25 @@ glsl_array_type(const glsl_type *element,
 
    const uint32_t key_hash = array_key_hash(&key);
 
-   simple_mtx_lock(&glsl_type_cache_mutex);
-   assert(glsl_type_cache.users > 0);
-   void *mem_ctx = glsl_type_cache.mem_ctx;
+   struct glsl_type_table *table = &glsl_type_cache.array_types;
+   const glsl_type *t = glsl_type_table_search(table, key_hash, &key, array_key_equal);
+   if (t == NULL) {
+      simple_mtx_lock(&table->lock);
 
-   if (glsl_type_cache.array_types == NULL) {
-      glsl_type_cache.array_types = array_key_table_create(mem_ctx);
-   }
-   struct hash_table *array_types = glsl_type_cache.array_types;
+      /* Another thread may have added it while we were waiting for the lock. */
+      t = glsl_type_table_search(table, key_hash, &key, array_key_equal);
+      if (t == NULL) {
+         linear_ctx *lin_ctx = table->lin_ctx;
+         t = make_array_type(lin_ctx, element, array_size, explicit_stride);
+         struct array_key *stored_key = linear_zalloc(lin_ctx, struct array_key);
+         memcpy(stored_key, &key, sizeof(key));
 
-   const struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(array_types, key_hash, &key);
-   if (entry == NULL) {
-      linear_ctx *lin_ctx = glsl_type_cache.lin_ctx;
-      const glsl_type *t = make_array_type(lin_ctx, element, array_size, explicit_stride);
-      struct array_key *stored_key = linear_zalloc(lin_ctx, struct array_key);
-      memcpy(stored_key, &key, sizeof(key));
+         glsl_type_table_insert(table, key_hash, stored_key, t);
+      }
 
-      entry = _mesa_hash_table_insert_pre_hashed(array_types, key_hash,
-                                                 stored_key,
-                                                 (void *) t);
+      simple_mtx_unlock(&table->lock);
    }
 
-   const glsl_type *t = (const glsl_type *) entry->data;
-   simple_mtx_unlock(&glsl_type_cache_mutex);
-
    assert(t->base_type == GLSL_TYPE_ARRAY);
    assert(t->length == array_size);
    assert(t->fields.array == element);
@@ -1312,6 +1453,12 @@ make_cmat_type(linear_ctx *lin_ctx, const struct glsl_cmat_description desc)
    return t;
 }
 
+static bool
+cmat_key_equal(const void *a, const void *b)
+{
+   return memcmp(a, b, sizeof(struct glsl_cmat_description)) == 0;
+}
+
 const glsl_type *
 glsl_cmat_type(const struct glsl_cmat_description *desc)
 {
@@ -1322,26 +1469,22 @@ glsl_cmat_type(const struct glsl_cmat_description *desc)
                         desc->use << 24;
    const uint32_t key_hash = _mesa_hash_uint(&key);
 
-   simple_mtx_lock(&glsl_type_cache_mutex);
-   assert(glsl_type_cache.users > 0);
-   void *mem_ctx = glsl_type_cache.mem_ctx;
+   struct glsl_type_table *table = &glsl_type_cache.cmat_types;
+   const glsl_type *t = glsl_type_table_search(table, key_hash, desc, cmat_key_equal);
+   if (t == NULL) {
+      simple_mtx_lock(&table->lock);
 
-   if (glsl_type_cache.cmat_types == NULL) {
-      glsl_type_cache.cmat_types =
-         _mesa_hash_table_create_u32_keys(mem_ctx);
-   }
-   struct hash_table *cmat_types = glsl_type_cache.cmat_types;
+      /* Another thread may have added it while we were waiting for the lock. */
+      t = glsl_type_table_search(table, key_hash, desc, cmat_key_equal);
+      if (t == NULL) {
+         t = make_cmat_type(table->lin_ctx, *desc);
 
-   const struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(
-      cmat_types, key_hash, (void *) (uintptr_t) key);
-   if (entry == NULL) {
-      const glsl_type *t = make_cmat_type(glsl_type_cache.lin_ctx, *desc);
-      entry = _mesa_hash_table_insert_pre_hashed(cmat_types, key_hash,
-                                                 (void *) (uintptr_t) key, (void *) t);
-   }
+         /* The key is stored in the type itself. */
+         glsl_type_table_insert(table, key_hash, &t->cmat_desc, t);
+      }
 
-   const glsl_type *t = (const glsl_type *)entry->data;
-   simple_mtx_unlock(&glsl_type_cache_mutex);
+      simple_mtx_unlock(&table->lock);
+   }
 
    assert(t->base_type == GLSL_TYPE_COOPERATIVE_MATRIX);
    assert(t->cmat_desc.element_type == desc->element_type);
@@ -1538,28 +1681,23 @@ glsl_struct_type_with_explicit_alignment(const glsl_struct_field *fields,
    fill_struct_type(&key, fields, num_fields, name, packed, explicit_alignment);
    const uint32_t key_hash = record_key_hash(&key);
 
-   simple_mtx_lock(&glsl_type_cache_mutex);
-   assert(glsl_type_cache.users > 0);
-   void *mem_ctx = glsl_type_cache.mem_ctx;
+   struct glsl_type_table *table = &glsl_type_cache.struct_types;
+   const glsl_type *t = glsl_type_table_search(table, key_hash, &key, record_key_compare);
+   if (t == NULL) {
+      simple_mtx_lock(&table->lock);
 
-   if (glsl_type_cache.struct_types == NULL) {
-      glsl_type_cache.struct_types =
-         _mesa_hash_table_create(mem_ctx, record_key_hash, record_key_compare);
-   }
-   struct hash_table *struct_types = glsl_type_cache.struct_types;
+      /* Another thread may have added it while we were waiting for the lock. */
+      t = glsl_type_table_search(table, key_hash, &key, record_key_compare);
+      if (t == NULL) {
+         t = make_struct_type(table->lin_ctx, fields, num_fields,
+                              name, packed, explicit_alignment);
 
-   const struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(struct_types,
-                                                                       key_hash, &key);
-   if (entry == NULL) {
-      const glsl_type *t = make_struct_type(glsl_type_cache.lin_ctx, fields, num_fields,
-                                            name, packed, explicit_alignment);
+         glsl_type_table_insert(table, key_hash, t, t);
+      }
 
-      entry = _mesa_hash_table_insert_pre_hashed(struct_types, key_hash, t, (void *) t);
+      simple_mtx_unlock(&table->lock);
    }
 
-   const glsl_type *t = (const glsl_type *) entry->data;
-   simple_mtx_unlock(&glsl_type_cache_mutex);
-
    assert(t->base_type == GLSL_TYPE_STRUCT);
    assert(t->length == num_fields);
    assert(strcmp(glsl_get_type_name(t), name) == 0);
@@ -1581,28 +1719,23 @@ glsl_interface_type(const glsl_struct_field *fields,
    fill_interface_type(&key, fields, num_fields, packing, row_major, block_name);
    const uint32_t key_hash = record_key_hash(&key);
 
-   simple_mtx_lock(&glsl_type_cache_mutex);
-   assert(glsl_type_cache.users > 0);
-   void *mem_ctx = glsl_type_cache.mem_ctx;
+   struct glsl_type_table *table = &glsl_type_cache.interface_types;
+   const glsl_type *t = glsl_type_table_search(table, key_hash, &key, record_key_compare);
+   if (t == NULL) {
+      simple_mtx_lock(&table->lock);
 
-   if (glsl_type_cache.interface_types == NULL) {
-      glsl_type_cache.interface_types =
-         _mesa_hash_table_create(mem_ctx, record_key_hash, record_key_compare);
-   }
-   struct hash_table *interface_types = glsl_type_cache.interface_types;
+      /* Another thread may have added it while we were waiting for the lock. */
+      t = glsl_type_table_search(table, key_hash, &key, record_key_compare);
+      if (t == NULL) {
+         t = make_interface_type(table->lin_ctx, fields, num_fields,
+                                 packing, row_major, block_name);
 
-   const struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(interface_types,
-                                                                       key_hash, &key);
-   if (entry == NULL) {
-      const glsl_type *t = make_interface_type(glsl_type_cache.lin_ctx, fields, num_fields,
-                                               packing, row_major, block_name);
+         glsl_type_table_insert(table, key_hash, t, t);
+      }
 
-      entry = _mesa_hash_table_insert_pre_hashed(interface_types, key_hash, t, (void *) t);
+      simple_mtx_unlock(&table->lock);
    }
 
-   const glsl_type *t = (const glsl_type *) entry->data;
-   simple_mtx_unlock(&glsl_type_cache_mutex);
-
    assert(t->base_type == GLSL_TYPE_INTERFACE);
    assert(t->length == num_fields);
    assert(strcmp(glsl_get_type_name(t), block_name) == 0);
@@ -1615,27 +1748,23 @@ glsl_subroutine_type(const char *subroutine_name)
 {
    const uint32_t key_hash = _mesa_hash_string(subroutine_name);
 
-   simple_mtx_lock(&glsl_type_cache_mutex);
-   assert(glsl_type_cache.users > 0);
-   void *mem_ctx = glsl_type_cache.mem_ctx;
-
-   if (glsl_type_cache.subroutine_types == NULL) {
-      glsl_type_cache.subroutine_types =
-         _mesa_hash_table_create(mem_ctx, _mesa_hash_string, _mesa_key_string_equal);
-   }
-   struct hash_table *subroutine_types = glsl_type_cache.subroutine_types;
+   struct glsl_type_table *table = &glsl_type_cache.subroutine_types;
+   const glsl_type *t = glsl_type_table_search(table, key_hash, subroutine_name,
+                                               _mesa_key_string_equal);
+   if (t == NULL) {
+      simple_mtx_lock(&table->lock);
 
-   const struct hash_entry *entry = _mesa_hash_table_search_pre_hashed(subroutine_types,
-                                                                       key_hash, subroutine_name);
-   if (entry == NULL) {
-      const glsl_type *t = make_subroutine_type(glsl_type_cache.lin_ctx, subroutine_name);
+      /* Another thread may have added it while we were waiting for the lock. */
+      t = glsl_type_table_search(table, key_hash, subroutine_name,
+                                 _mesa_key_string_equal);
+      if (t == NULL) {
+         t = make_subroutine_type(table->lin_ctx, subroutine_name);
+         glsl_type_table_insert(table, key_hash, glsl_get_type_name(t), t);
+      }
 
-      entry = _mesa_hash_table_insert_pre_hashed(subroutine_types, key_hash, glsl_get_type_name(t), (void *) t);
+      simple_mtx_unlock(&table->lock);
    }
 
-   const glsl_type *t = (const glsl_type *) entry->data;
-   simple_mtx_unlock(&glsl_type_cache_mutex);
-
    assert(t->base_type == GLSL_TYPE_SUBROUTINE);
    assert(strcmp(glsl_get_type_name(t), subroutine_name) == 0);
 
@@ -90,6 +90,8 @@ static const struct debug_named_value nir_debug_control[] = {
      "Print shaders even if they are marked as internal" },
    { "print_pass_flags", NIR_DEBUG_PRINT_PASS_FLAGS,
      "Print pass_flags for every instruction when pass_flags are non-zero" },
+   { "pass_stats", NIR_DEBUG_PASS_STATS,
+     "Collect time, progress and instruction count changes of every pass, and print them at exit" },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -91,6 +91,7 @@ extern bool nir_debug_print_shader[MESA_SHADER_KERNEL + 1];
 #define NIR_DEBUG_PRINT_NO_INLINE_CONSTS (1u << 20)
 #define NIR_DEBUG_PRINT_INTERNAL         (1u << 21)
 #define NIR_DEBUG_PRINT_PASS_FLAGS       (1u << 22)
+#define NIR_DEBUG_PASS_STATS             (1u << 23)
 
 #define NIR_DEBUG_PRINT (NIR_DEBUG_PRINT_VS |  \
                          NIR_DEBUG_PRINT_TCS | \
@@ -5259,6 +5260,24 @@ should_print_nir(UNUSED nir_shader *shader)
 }
 #endif /* NDEBUG */
 
+/* Per-pass statistics collected by NIR_PASS and NIR_PASS_V with
+ * NIR_DEBUG=pass_stats, aggregated over the whole process by pass, shader
+ * stage and the directory of the caller (i.e. the driver).
+ */
+typedef struct nir_pass_stats_sample {
+   int64_t start_ns;
+   unsigned num_instrs;
+   unsigned num_defs;
+} nir_pass_stats_sample;
+
+void nir_pass_stats_begin(nir_shader *shader, nir_pass_stats_sample *sample);
+void nir_pass_stats_end(nir_shader *shader, const nir_pass_stats_sample *sample,
+                        const char *pass, const char *file, bool progress);
+
+/* Print the statistics collected so far, sorted by total time. */
+void nir_pass_stats_print(FILE *fp);
+void nir_pass_stats_reset(void);
+
 #define _PASS(pass, nir, do_pass)                                       \
    do {                                                                 \
       if (should_skip_nir(#pass)) {                                     \
@@ -5275,27 +5294,42 @@ should_print_nir(UNUSED nir_shader *shader)
       }                                                                 \
    } while (0)
 
-#define NIR_PASS(progress, nir, pass, ...) _PASS(pass, nir, {   \
-   nir_metadata_set_validation_flag(nir);                       \
-   if (should_print_nir(nir))                                   \
-      printf("%s\n", #pass);                                    \
-   if (pass(nir, ##__VA_ARGS__)) {                              \
-      nir_validate_shader(nir, "after " #pass " in " __FILE__); \
-      UNUSED bool _;                                            \
-      progress = true;                                          \
-      if (should_print_nir(nir))                                \
-         nir_print_shader(nir, stdout);                         \
-      nir_metadata_check_validation_flag(nir);                  \
-   }                                                            \
+#define NIR_PASS(progress, nir, pass, ...) _PASS(pass, nir, {    \
+   nir_metadata_set_validation_flag(nir);                        \
+   if (should_print_nir(nir))                                    \
+      printf("%s\n", #pass);                                     \
+   nir_pass_stats_sample _stats = { 0 };                         \
+   if (NIR_DEBUG(PASS_STATS))                                    \
+      nir_pass_stats_begin(nir, &_stats);                        \
+   bool _pass_progress = pass(nir, ##__VA_ARGS__);               \
+   if (NIR_DEBUG(PASS_STATS))                                    \
+      nir_pass_stats_end(nir, &_stats, #pass, __FILE__,          \
+                         _pass_progress);                        \
+   if (_pass_progress) {                                         \
+      nir_validate_shader(nir, "after " #pass " in " __FILE__);  \
+      UNUSED bool _;                                             \
+      progress = true;                                           \
+      if (should_print_nir(nir))                                 \
+         nir_print_shader(nir, stdout);                          \
+      nir_metadata_check_validation_flag(nir);                   \
+   }                                                             \
 })
 
-#define NIR_PASS_V(nir, pass, ...) _PASS(pass, nir, {        \
-   if (should_print_nir(nir))                                \
-      printf("%s\n", #pass);                                 \
-   pass(nir, ##__VA_ARGS__);                                 \
-   nir_validate_shader(nir, "after " #pass " in " __FILE__); \
-   if (should_print_nir(nir))                                \
-      nir_print_shader(nir, stdout);                         \
+/* Passes run with NIR_PASS_V don't report progress, so their statistics
+ * only count calls, time and instruction deltas.
+ */
+#define NIR_PASS_V(nir, pass, ...) _PASS(pass, nir, {               \
+   if (should_print_nir(nir))                                       \
+      printf("%s\n", #pass);                                        \
+   nir_pass_stats_sample _stats = { 0 };                            \
+   if (NIR_DEBUG(PASS_STATS))                                       \
+      nir_pass_stats_begin(nir, &_stats);                           \
+   pass(nir, ##__VA_ARGS__);                                        \
+   if (NIR_DEBUG(PASS_STATS))                                       \
+      nir_pass_stats_end(nir, &_stats, #pass, __FILE__, false);     \
+   nir_validate_shader(nir, "after " #pass " in " __FILE__);        \
+   if (should_print_nir(nir))                                       \
+      nir_print_shader(nir, stdout);                                \
 })
 
 #define _NIR_LOOP_PASS(progress, idempotent, skip, nir, pass, ...)   \
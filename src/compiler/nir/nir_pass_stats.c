@@ -0,0 +1,241 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Per-pass statistics for NIR_DEBUG=pass_stats.
+ *
+ * NIR_PASS and NIR_PASS_V time every pass they run and count the
+ * instructions and SSA defs of the shader before and after it.  The samples
+ * are aggregated for the whole process by pass name, shader stage and the
+ * directory of the file calling the pass, which tells drivers and common
+ * code apart.  The table is printed at exit, sorted by total time, or on
+ * demand with nir_pass_stats_print().
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+#include "util/os_time.h"
+#include "util/simple_mtx.h"
+#include "nir.h"
+
+struct pass_stats_key {
+   const char *pass;
+   const char *dir;
+   unsigned dir_len;
+   gl_shader_stage stage;
+};
+
+struct pass_stats {
+   struct pass_stats_key key;
+
+   uint64_t calls;
+   uint64_t progress;
+   uint64_t time_ns;
+
+   /* Sum of the changes in instruction and SSA def counts. */
+   int64_t instr_delta;
+   int64_t def_delta;
+};
+
+static simple_mtx_t pass_stats_mutex = SIMPLE_MTX_INITIALIZER;
+static void *pass_stats_mem_ctx;
+static struct hash_table *pass_stats_table;
+
+static uint32_t
+pass_stats_key_hash(const void *data)
+{
+   const struct pass_stats_key *key = data;
+
+   uint32_t hash = _mesa_hash_string(key->pass);
+   hash = XXH32(key->dir, key->dir_len, hash);
+   return XXH32(&key->stage, sizeof(key->stage), hash);
+}
+
+static bool
+pass_stats_key_equal(const void *a, const void *b)
+{
+   const struct pass_stats_key *ka = a, *kb = b;
+
+   return ka->stage == kb->stage &&
+          ka->dir_len == kb->dir_len &&
+          memcmp(ka->dir, kb->dir, ka->dir_len) == 0 &&
+          strcmp(ka->pass, kb->pass) == 0;
+}
+
+static void
+count_instrs(nir_shader *shader, unsigned *num_instrs, unsigned *num_defs)
+{
+   unsigned instrs = 0, defs = 0;
+
+   nir_foreach_function_impl(impl, shader) {
+      nir_foreach_block(block, impl) {
+         nir_foreach_instr(instr, block) {
+            instrs++;
+            if (instr->type != nir_instr_type_parallel_copy &&
+                nir_instr_def(instr) != NULL)
+               defs++;
+         }
+      }
+   }
+
+   *num_instrs = instrs;
+   *num_defs = defs;
+}
+
+void
+nir_pass_stats_begin(nir_shader *shader, nir_pass_stats_sample *sample)
+{
+   count_instrs(shader, &sample->num_instrs, &sample->num_defs);
+
+   /* Start the clock last so that counting isn't accounted to the pass. */
+   sample->start_ns = os_time_get_nano();
+}
+
+static void
+pass_stats_print_at_exit(void)
+{
+   nir_pass_stats_print(stderr);
+}
+
+void
+nir_pass_stats_end(nir_shader *shader, const nir_pass_stats_sample *sample,
+                   const char *pass, const char *file, bool progress)
+{
+   const int64_t time_ns = os_time_get_nano() - sample->start_ns;
+
+   unsigned num_instrs, num_defs;
+   count_instrs(shader, &num_instrs, &num_defs);
+
+   /* Only keep the directory of the caller. */
+   const char *slash = strrchr(file, '/');
+   const unsigned dir_len = slash ? slash - file : 0;
+
+   struct pass_stats_key key = {
+      .pass = pass,
+      .dir = file,
+      .dir_len = dir_len,
+      .stage = shader->info.stage,
+   };
+   const uint32_t hash = pass_stats_key_hash(&key);
+
+   simple_mtx_lock(&pass_stats_mutex);
+
+   if (pass_stats_table == NULL) {
+      pass_stats_mem_ctx = ralloc_context(NULL);
+      pass_stats_table = _mesa_hash_table_create(pass_stats_mem_ctx,
+                                                 pass_stats_key_hash,
+                                                 pass_stats_key_equal);
+
+      static bool registered = false;
+      if (!registered) {
+         atexit(pass_stats_print_at_exit);
+         registered = true;
+      }
+   }
+
+   struct hash_entry *entry =
+      _mesa_hash_table_search_pre_hashed(pass_stats_table, hash, &key);
+
+   struct pass_stats *stats;
+   if (entry) {
+      stats = entry->data;
+   } else {
+      /* The strings may belong to a driver that gets unloaded before exit. */
+      stats = rzalloc(pass_stats_mem_ctx, struct pass_stats);
+      stats->key = key;
+      stats->key.pass = ralloc_strdup(pass_stats_mem_ctx, pass);
+      stats->key.dir = ralloc_strndup(pass_stats_mem_ctx, file, dir_len);
+      _mesa_hash_table_insert_pre_hashed(pass_stats_table, hash,
+                                         &stats->key, stats);
+   }
+
+   stats->calls++;
+   stats->progress += progress;
+   stats->time_ns += time_ns;
+   stats->instr_delta += (int64_t)num_instrs - sample->num_instrs;
+   stats->def_delta += (int64_t)num_defs - sample->num_defs;
+
+   simple_mtx_unlock(&pass_stats_mutex);
+}
+
+static int
+pass_stats_compare(const void *a, const void *b)
+{
+   const struct pass_stats *sa = *(const struct pass_stats **)a;
+   const struct pass_stats *sb = *(const struct pass_stats **)b;
+
+   if (sa->time_ns != sb->time_ns)
+      return sa->time_ns < sb->time_ns ? 1 : -1;
+
+   return strcmp(sa->key.pass, sb->key.pass);
+}
+
+/* Show the caller relative to the source tree, however the build spells it. */
+static const char *
+display_dir(const char *dir)
+{
+   if (strncmp(dir, "src/", 4) == 0)
+      return dir + 4;
+
+   const char *src = strstr(dir, "/src/");
+   return src ? src + 5 : dir;
+}
+
+void
+nir_pass_stats_print(FILE *fp)
+{
+   simple_mtx_lock(&pass_stats_mutex);
+
+   if (pass_stats_table == NULL || pass_stats_table->entries == 0) {
+      simple_mtx_unlock(&pass_stats_mutex);
+      return;
+   }
+
+   const unsigned count = pass_stats_table->entries;
+   struct pass_stats **sorted = malloc(count * sizeof(*sorted));
+   if (sorted == NULL) {
+      simple_mtx_unlock(&pass_stats_mutex);
+      return;
+   }
+
+   unsigned i = 0;
+   uint64_t total_ns = 0;
+   hash_table_foreach(pass_stats_table, entry) {
+      sorted[i++] = entry->data;
+      total_ns += ((struct pass_stats *)entry->data)->time_ns;
+   }
+
+   qsort(sorted, count, sizeof(*sorted), pass_stats_compare);
+
+   fprintf(fp, "NIR pass statistics (%.3f ms total):\n", total_ns / 1e6);
+   fprintf(fp, "%10s %6s %8s %8s %10s %10s %5s  %-40s %s\n",
+           "time (ms)", "%", "calls", "progress", "instrs", "defs",
+           "stage", "pass", "caller");
+
+   for (i = 0; i < count; i++) {
+      const struct pass_stats *stats = sorted[i];
+      fprintf(fp, "%10.3f %6.2f %8" PRIu64 " %8" PRIu64 " %+10" PRId64
+                  " %+10" PRId64 " %5s  %-40s %s\n",
+              stats->time_ns / 1e6,
+              total_ns ? stats->time_ns * 100.0 / total_ns : 0.0,
+              stats->calls, stats->progress,
+              stats->instr_delta, stats->def_delta,
+              _mesa_shader_stage_to_abbrev(stats->key.stage),
+              stats->key.pass, display_dir(stats->key.dir));
+   }
+
+   free(sorted);
+   simple_mtx_unlock(&pass_stats_mutex);
+}
+
+void
+nir_pass_stats_reset(void)
+{
+   simple_mtx_lock(&pass_stats_mutex);
+   ralloc_free(pass_stats_mem_ctx);
+   pass_stats_mem_ctx = NULL;
+   pass_stats_table = NULL;
+   simple_mtx_unlock(&pass_stats_mutex);
+}
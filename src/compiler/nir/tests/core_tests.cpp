@@ -117,4 +117,53 @@ TEST_F(nir_core_test, nir_instr_free_and_dce_multiple_src_test)
    nir_validate_shader(b->shader, "after remove_and_dce");
 }
 
+#ifndef NDEBUG
+TEST_F(nir_core_test, pass_stats)
+{
+   nir_def *one = nir_imm_int(b, 1);
+   nir_iadd(b, one, one);
+
+   const uint32_t old_debug = nir_debug;
+   nir_debug |= NIR_DEBUG_PASS_STATS;
+   nir_pass_stats_reset();
+
+   bool progress = false;
+   NIR_PASS(progress, b->shader, nir_opt_dce);
+   NIR_PASS(progress, b->shader, nir_opt_dce);
+   ASSERT_TRUE(progress);
+
+   FILE *fp = tmpfile();
+   ASSERT_NE(fp, nullptr);
+   nir_pass_stats_print(fp);
+   rewind(fp);
+
+   /* Two calls, one with progress, removing both instructions. */
+   char line[256];
+   bool found = false;
+   while (fgets(line, sizeof(line), fp)) {
+      if (strstr(line, "nir_opt_dce") == NULL)
+         continue;
+
+      double time_ms, percent;
+      unsigned calls, made_progress;
+      int instrs, defs;
+      char stage[8];
+      ASSERT_EQ(sscanf(line, "%lf %lf %u %u %d %d %7s", &time_ms, &percent,
+                       &calls, &made_progress, &instrs, &defs, stage), 7);
+      EXPECT_EQ(calls, 2);
+      EXPECT_EQ(made_progress, 1);
+      EXPECT_EQ(instrs, -2);
+      EXPECT_EQ(defs, -2);
+      EXPECT_STREQ(stage, "CS");
+      EXPECT_NE(strstr(line, "compiler/nir/tests"), nullptr);
+      found = true;
+   }
+   EXPECT_TRUE(found);
+
+   fclose(fp);
+   nir_pass_stats_reset();
+   nir_debug = old_debug;
+}
+#endif
+
 }
@@ -0,0 +1,137 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#include <gtest/gtest.h>
+
+#include "nir.h"
+#include "nir_builder.h"
+
+#include "c11/threads.h"
+
+/* Builds and optimizes many small shaders on several threads at once, all of
+ * them interning the same derived types, to check that every thread gets the
+ * same type pointers.
+ */
+
+#define NUM_THREADS 8
+#define SHADERS_PER_THREAD 64
+#define VARS_PER_SHADER 16
+
+struct compile_thread {
+   const nir_shader_compiler_options *options;
+
+   /* Types seen by the thread, compared across threads afterwards. */
+   const glsl_type *array_types[VARS_PER_SHADER];
+   const glsl_type *struct_types[VARS_PER_SHADER];
+   const glsl_type *block_types[VARS_PER_SHADER];
+   const glsl_type *matrix_types[VARS_PER_SHADER];
+};
+
+static const glsl_type *
+field_struct_type(unsigned i)
+{
+   char name[16];
+   snprintf(name, sizeof(name), "S%u", i);
+
+   glsl_struct_field fields[2];
+   fields[0] = glsl_struct_field(glsl_array_type(glsl_vec4_type(), i + 1, 0), "v");
+   fields[1] = glsl_struct_field(glsl_float_type(), "f");
+
+   return glsl_struct_type(fields, ARRAY_SIZE(fields), name, false);
+}
+
+static void
+compile_shader(struct compile_thread *thread, unsigned index)
+{
+   nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_COMPUTE,
+                                                  thread->options,
+                                                  "type_cache_%u", index);
+
+   nir_variable *out = nir_variable_create(b.shader, nir_var_mem_shared,
+                                           glsl_vec4_type(), "out");
+   nir_def *sum = nir_imm_vec4(&b, 0.0, 0.0, 0.0, 0.0);
+
+   for (unsigned i = 0; i < VARS_PER_SHADER; i++) {
+      const glsl_type *s = field_struct_type(i);
+      const glsl_type *type = glsl_array_type(s, 4, 0);
+
+      nir_variable *var = nir_local_variable_create(b.impl, type, "var");
+      nir_deref_instr *elem =
+         nir_build_deref_array_imm(&b, nir_build_deref_var(&b, var), i % 4);
+      nir_deref_instr *v =
+         nir_build_deref_array_imm(&b, nir_build_deref_struct(&b, elem, 0), i);
+
+      nir_store_deref(&b, v, nir_imm_vec4(&b, i, i, i, i), 0xf);
+      sum = nir_fadd(&b, sum, nir_load_deref(&b, v));
+
+      thread->array_types[i] = type;
+      thread->struct_types[i] = s;
+   }
+
+   nir_store_var(&b, out, sum, 0xf);
+
+   /* Splitting creates new array and struct types of its own. */
+   NIR_PASS_V(b.shader, nir_split_array_vars, nir_var_function_temp);
+   NIR_PASS_V(b.shader, nir_split_struct_vars, nir_var_function_temp);
+   NIR_PASS_V(b.shader, nir_lower_vars_to_ssa);
+   NIR_PASS_V(b.shader, nir_opt_dce);
+
+   for (unsigned i = 0; i < VARS_PER_SHADER; i++) {
+      glsl_struct_field field(glsl_array_type(glsl_vec4_type(), i + 1, 0), "v");
+      thread->block_types[i] =
+         glsl_interface_type(&field, 1, GLSL_INTERFACE_PACKING_STD430,
+                             false, "Block");
+      thread->matrix_types[i] =
+         glsl_simple_explicit_type(GLSL_TYPE_FLOAT, 4, 4, 16 * (i + 1),
+                                   i & 1, 0);
+   }
+
+   ralloc_free(b.shader);
+}
+
+static int
+compile_thread_func(void *data)
+{
+   struct compile_thread *thread = (struct compile_thread *)data;
+
+   for (unsigned i = 0; i < SHADERS_PER_THREAD; i++)
+      compile_shader(thread, i);
+
+   return 0;
+}
+
+TEST(type_cache_test, parallel_compiles)
+{
+   glsl_type_singleton_init_or_ref();
+
+   const nir_shader_compiler_options options = {};
+   struct compile_thread threads[NUM_THREADS];
+   thrd_t handles[NUM_THREADS];
+
+   for (unsigned i = 0; i < NUM_THREADS; i++) {
+      threads[i] = {};
+      threads[i].options = &options;
+      ASSERT_EQ(thrd_create(&handles[i], compile_thread_func, &threads[i]),
+                thrd_success);
+   }
+
+   for (unsigned i = 0; i < NUM_THREADS; i++)
+      ASSERT_EQ(thrd_join(handles[i], NULL), thrd_success);
+
+   for (unsigned i = 0; i < VARS_PER_SHADER; i++) {
+      EXPECT_EQ(threads[0].struct_types[i], field_struct_type(i));
+      EXPECT_EQ(threads[0].array_types[i],
+                glsl_array_type(field_struct_type(i), 4, 0));
+
+      for (unsigned t = 1; t < NUM_THREADS; t++) {
+         EXPECT_EQ(threads[t].array_types[i], threads[0].array_types[i]);
+         EXPECT_EQ(threads[t].struct_types[i], threads[0].struct_types[i]);
+         EXPECT_EQ(threads[t].block_types[i], threads[0].block_types[i]);
+         EXPECT_EQ(threads[t].matrix_types[i], threads[0].matrix_types[i]);
+      }
+   }
+
+   glsl_type_singleton_decref();
+}
@@ -542,6 +542,19 @@ draw_enable_point_sprites(struct draw_context *draw, bool enable)
 }
 
 
+/**
+ * Let the LLVM middle end shade the vertices of large draws on up to
+ * \p num_threads worker threads.  Primitives are still assembled, clipped
+ * and emitted on the calling thread, in order.
+ */
+void
+draw_set_vertex_threads(struct draw_context *draw, unsigned num_threads)
+{
+   draw_do_flush(draw, DRAW_FLUSH_STATE_CHANGE);
+   draw->num_vertex_threads = num_threads;
+}
+
+
 /**
  * Allocate an extra vertex/geometry shader vertex attribute, if it doesn't
  * exist already.
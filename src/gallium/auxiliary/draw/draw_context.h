@@ -146,6 +146,8 @@ void draw_enable_point_sprites(struct draw_context *draw, bool enable);
 
 void draw_set_zs_format(struct draw_context *draw, enum pipe_format format);
 
+void draw_set_vertex_threads(struct draw_context *draw, unsigned num_threads);
+
 /* for TGSI constants are 4 * sizeof(float), but for NIR they need to be sizeof(float); */
 void draw_set_constant_buffer_stride(struct draw_context *draw, unsigned num_bytes);
 
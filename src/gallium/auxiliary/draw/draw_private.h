@@ -223,6 +223,7 @@ struct draw_context
          unsigned eltSize;
          unsigned eltMax;
          int eltBias;
+         unsigned count;   /**< vertices in the draw being split */
          unsigned min_index;
          unsigned max_index;
          unsigned drawid;
@@ -370,6 +371,9 @@ struct draw_context
    unsigned constant_buffer_stride;
    struct draw_llvm *llvm;
 
+   /** Threads to run vertex shaders on, 0 to shade on the calling thread */
+   unsigned num_vertex_threads;
+
    /** Texture sampler and sampler view state.
     * Note that we have arrays indexed by shader type.  At this time
     * we only handle vertex and geometry shaders in the draw module, but
@@ -156,6 +156,7 @@ draw_pt_arrays(struct draw_context *draw,
       }
 
       draw->start_index = draw_info[i].start;
+      draw->pt.user.count = count;
 
       if (count >= first)
          frontend->run(frontend, draw_info[i].start, count);
@@ -628,6 +629,12 @@ draw_vbo(struct draw_context *draw,
       draw_instances(draw, drawid_offset, use_info, use_draws, num_draws);
    }
 
+   /* The vertex buffers may be unmapped once we return, so wait for any
+    * vertices still being shaded on the vertex threads.
+    */
+   if (draw->pt.middle.llvm && draw->pt.middle.llvm->flush)
+      draw->pt.middle.llvm->flush(draw->pt.middle.llvm);
+
    /* If requested emit the pipeline statistics for this run */
    if (draw->collect_statistics) {
       draw->render->pipeline_statistics(draw->render, &draw->statistics);
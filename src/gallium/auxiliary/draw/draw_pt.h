@@ -124,6 +124,12 @@ struct draw_pt_middle_end {
 
    int (*get_max_vertex_count)(struct draw_pt_middle_end *);
 
+   /**
+    * Wait for any work deferred by the run functions and pass it down
+    * the pipeline.  May be NULL if the middle end never defers work.
+    */
+   void (*flush)(struct draw_pt_middle_end *);
+
    void (*finish)(struct draw_pt_middle_end *);
    void (*destroy)(struct draw_pt_middle_end *);
 };
@@ -28,6 +28,8 @@
 #include "util/u_math.h"
 #include "util/u_memory.h"
 #include "util/u_prim.h"
+#include "util/u_queue.h"
+#include "util/u_thread.h"
 #include "draw/draw_context.h"
 #include "draw/draw_gs.h"
 #include "draw/draw_tess.h"
@@ -41,6 +43,48 @@
 #include "gallivm/lp_bld_debug.h"
 
 
+/* Upper bound on the segments in flight on the vertex threads */
+#define LLVM_MAX_QUEUED_SEGMENTS 64
+
+/* Smaller draws don't span enough vsplit segments for the vertex threads to
+ * overlap with the rest of the pipeline, so shade them on the calling thread.
+ */
+#define LLVM_MIN_QUEUED_DRAW_VERTICES 2048
+
+struct llvm_middle_end;
+
+/**
+ * A vsplit segment whose vertices are shaded on the vertex threads.
+ * Everything after the vertex shader runs on the application thread, in
+ * submission order, when the segment is drained.
+ */
+struct llvm_vs_segment {
+   struct util_queue_fence fence;
+   struct llvm_middle_end *fpme;
+   bool shaded;
+   bool clipped;
+
+   /* Vertex shader inputs, captured at submission since vsplit reuses its
+    * element buffers and draw_vbo() moves on to the next draw/instance.
+    */
+   unsigned count;
+   unsigned start;
+   unsigned vertex_id_offset;
+   unsigned instance_id;
+   unsigned draw_id;
+   unsigned view_id;
+   const unsigned *elts;
+   unsigned *fetch_elts;
+   unsigned fetch_elts_size;
+
+   struct draw_prim_info prim_info;
+   uint16_t *draw_elts;
+   unsigned draw_elts_size;
+   unsigned draw_count;
+
+   struct vertex_header *verts;
+};
+
 struct llvm_middle_end {
    struct draw_pt_middle_end base;
    struct draw_context *draw;
@@ -58,9 +102,22 @@ struct llvm_middle_end {
 
    struct draw_llvm *llvm;
    struct draw_llvm_variant *current_variant;
+
+   /* Ring of segments queued on vs_queue, oldest first */
+   struct util_queue vs_queue;
+   unsigned num_vs_threads;
+   struct llvm_vs_segment segments[LLVM_MAX_QUEUED_SEGMENTS];
+   unsigned max_segments;
+   unsigned first_segment;
+   unsigned num_segments;
+   bool draining;
 };
 
 
+static void
+llvm_middle_end_drain(struct llvm_middle_end *fpme);
+
+
 /** cast wrapper */
 static inline struct llvm_middle_end *
 llvm_middle_end(struct draw_pt_middle_end *middle)
@@ -268,6 +325,42 @@ llvm_middle_end_prepare_tes(struct llvm_middle_end *fpme)
 }
 
 
+/**
+ * (Re)create the vertex shading threads if their number changed.
+ */
+static void
+llvm_middle_end_init_threads(struct llvm_middle_end *fpme)
+{
+   unsigned num_threads = fpme->draw->num_vertex_threads;
+
+   if (num_threads == fpme->num_vs_threads)
+      return;
+
+   /* The ring is indexed modulo max_segments, so it must be empty before
+    * that changes.  If we're nested in a drain, pick the change up next time.
+    */
+   llvm_middle_end_drain(fpme);
+   if (fpme->num_segments)
+      return;
+
+   if (fpme->max_segments)
+      util_queue_destroy(&fpme->vs_queue);
+
+   fpme->num_vs_threads = num_threads;
+   fpme->max_segments = 0;
+   fpme->first_segment = 0;
+   fpme->num_segments = 0;
+
+   /* Keep every thread busy while the application thread drains the
+    * oldest segment, without holding too many vertices in flight.
+    */
+   if (num_threads &&
+       util_queue_init(&fpme->vs_queue, "drawvs", LLVM_MAX_QUEUED_SEGMENTS,
+                       num_threads, 0, NULL))
+      fpme->max_segments = MIN2(num_threads * 2, LLVM_MAX_QUEUED_SEGMENTS);
+}
+
+
 /**
  * Prepare/validate middle part of the vertex pipeline.
  * NOTE: if you change this function, also look at the non-LLVM
@@ -294,6 +387,10 @@ llvm_middle_end_prepare(struct draw_pt_middle_end *middle,
                               out_prim == MESA_PRIM_POINTS ||
                               u_reduced_prim(out_prim) == MESA_PRIM_LINES;
 
+   /* Queued segments depend on the state we're about to replace */
+   llvm_middle_end_drain(fpme);
+   llvm_middle_end_init_threads(fpme);
+
    fpme->input_prim = in_prim;
    fpme->opt = opt;
 
@@ -431,6 +528,8 @@ llvm_middle_end_bind_parameters(struct draw_pt_middle_end *middle)
    struct draw_llvm *llvm = fpme->llvm;
    unsigned i;
 
+   llvm_middle_end_drain(fpme);
+
    for (enum pipe_shader_type shader_type = PIPE_SHADER_VERTEX; shader_type <= PIPE_SHADER_GEOMETRY; shader_type++) {
       for (i = 0; i < ARRAY_SIZE(llvm->jit_resources[shader_type].constants); ++i) {
          /*
@@ -491,12 +590,17 @@ emit(struct pt_emit *emit,
 }
 
 
+/**
+ * Everything that follows the vertex shader: tessellation, geometry shader,
+ * primitive assembly, stream output, clipping and emit.  Takes ownership
+ * of \p llvm_vert_info's vertices.
+ */
 static void
-llvm_pipeline_generic(struct draw_pt_middle_end *middle,
-                      const struct draw_fetch_info *fetch_info,
-                      const struct draw_prim_info *in_prim_info)
+llvm_pipeline_post_vs(struct llvm_middle_end *fpme,
+                      struct draw_vertex_info *llvm_vert_info,
+                      const struct draw_prim_info *in_prim_info,
+                      bool clipped)
 {
-   struct llvm_middle_end *fpme = llvm_middle_end(middle);
    struct draw_context *draw = fpme->draw;
    struct draw_geometry_shader *gshader = draw->gs.geometry_shader;
    struct draw_tess_ctrl_shader *tcs_shader = draw->tcs.tess_ctrl_shader;
@@ -504,77 +608,16 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
    struct draw_prim_info tcs_prim_info;
    struct draw_prim_info tes_prim_info;
    struct draw_prim_info gs_prim_info[TGSI_MAX_VERTEX_STREAMS];
-   struct draw_vertex_info llvm_vert_info;
    struct draw_vertex_info tcs_vert_info;
    struct draw_vertex_info tes_vert_info;
-   struct draw_vertex_info *vert_info;
+   struct draw_vertex_info *vert_info = llvm_vert_info;
    struct draw_prim_info ia_prim_info;
    struct draw_vertex_info ia_vert_info;
    const struct draw_prim_info *prim_info = in_prim_info;
    bool free_prim_info = false;
    unsigned opt = fpme->opt;
-   bool clipped = 0;
    uint16_t *tes_elts_out = NULL;
 
-   assert(fetch_info->count > 0);
-
-   llvm_vert_info.count = fetch_info->count;
-   llvm_vert_info.vertex_size = fpme->vertex_size;
-   llvm_vert_info.stride = fpme->vertex_size;
-   llvm_vert_info.verts = (struct vertex_header *)
-      MALLOC(fpme->vertex_size *
-             align(fetch_info->count, lp_native_vector_width / 32) +
-             DRAW_EXTRA_VERTICES_PADDING);
-   if (!llvm_vert_info.verts) {
-      assert(0);
-      return;
-   }
-
-   if (draw->collect_statistics) {
-      draw->statistics.ia_vertices += prim_info->count;
-      if (prim_info->prim == MESA_PRIM_PATCHES)
-         draw->statistics.ia_primitives +=
-            prim_info->count / draw->pt.vertices_per_patch;
-      else
-         draw->statistics.ia_primitives +=
-            u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
-      draw->statistics.vs_invocations += fetch_info->count;
-   }
-
-   {
-      unsigned start, vertex_id_offset;
-      const unsigned *elts;
-
-      if (fetch_info->linear) {
-         start = fetch_info->start;
-         vertex_id_offset = draw->start_index;
-         elts = NULL;
-      } else {
-         start = draw->pt.user.eltMax;
-         vertex_id_offset = draw->pt.user.eltBias;
-         elts = fetch_info->elts;
-      }
-      /* Run vertex fetch shader */
-      clipped = fpme->current_variant->jit_func(&fpme->llvm->vs_jit_context,
-                                                &fpme->llvm->jit_resources[PIPE_SHADER_VERTEX],
-                                                llvm_vert_info.verts,
-                                                draw->pt.user.vbuffer,
-                                                fetch_info->count,
-                                                start,
-                                                fpme->vertex_size,
-                                                draw->pt.vertex_buffer,
-                                                draw->instance_id,
-                                                vertex_id_offset,
-                                                draw->start_instance,
-                                                elts,
-                                                draw->pt.user.drawid,
-                                                draw->pt.user.viewid);
-
-      /* Finished with fetch and vs */
-      fetch_info = NULL;
-      vert_info = &llvm_vert_info;
-   }
-
    if (opt & PT_SHADE) {
       struct draw_vertex_shader *vshader = draw->vs.vertex_shader;
       if (tcs_shader) {
@@ -717,6 +760,267 @@ llvm_pipeline_generic(struct draw_pt_middle_end *middle,
 }
 
 
+static bool
+llvm_middle_end_queue(struct llvm_middle_end *fpme,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info,
+                      struct vertex_header *verts,
+                      unsigned start, unsigned vertex_id_offset);
+
+
+static void
+llvm_pipeline_generic(struct draw_pt_middle_end *middle,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info)
+{
+   struct llvm_middle_end *fpme = llvm_middle_end(middle);
+   struct draw_context *draw = fpme->draw;
+   struct draw_vertex_info llvm_vert_info;
+   bool clipped = 0;
+
+   assert(fetch_info->count > 0);
+
+   llvm_vert_info.count = fetch_info->count;
+   llvm_vert_info.vertex_size = fpme->vertex_size;
+   llvm_vert_info.stride = fpme->vertex_size;
+   llvm_vert_info.verts = (struct vertex_header *)
+      MALLOC(fpme->vertex_size *
+             align(fetch_info->count, lp_native_vector_width / 32) +
+             DRAW_EXTRA_VERTICES_PADDING);
+   if (!llvm_vert_info.verts) {
+      assert(0);
+      return;
+   }
+
+   if (draw->collect_statistics) {
+      draw->statistics.ia_vertices += prim_info->count;
+      if (prim_info->prim == MESA_PRIM_PATCHES)
+         draw->statistics.ia_primitives +=
+            prim_info->count / draw->pt.vertices_per_patch;
+      else
+         draw->statistics.ia_primitives +=
+            u_decomposed_prims_for_vertices(prim_info->prim, prim_info->count);
+      draw->statistics.vs_invocations += fetch_info->count;
+   }
+
+   {
+      unsigned start, vertex_id_offset;
+      const unsigned *elts;
+
+      if (fetch_info->linear) {
+         start = fetch_info->start;
+         vertex_id_offset = draw->start_index;
+         elts = NULL;
+      } else {
+         start = draw->pt.user.eltMax;
+         vertex_id_offset = draw->pt.user.eltBias;
+         elts = fetch_info->elts;
+      }
+
+      /* Segments of small draws still queue behind pending ones to keep
+       * them in order.
+       */
+      if (fpme->max_segments &&
+          (draw->pt.user.count >= LLVM_MIN_QUEUED_DRAW_VERTICES ||
+           fpme->num_segments)) {
+         if (llvm_middle_end_queue(fpme, fetch_info, prim_info,
+                                   llvm_vert_info.verts,
+                                   start, vertex_id_offset))
+            return;
+
+         /* Couldn't queue it, shade it here after the pending ones. */
+         llvm_middle_end_drain(fpme);
+      }
+
+      /* Run vertex fetch shader */
+      clipped = fpme->current_variant->jit_func(&fpme->llvm->vs_jit_context,
+                                                &fpme->llvm->jit_resources[PIPE_SHADER_VERTEX],
+                                                llvm_vert_info.verts,
+                                                draw->pt.user.vbuffer,
+                                                fetch_info->count,
+                                                start,
+                                                fpme->vertex_size,
+                                                draw->pt.vertex_buffer,
+                                                draw->instance_id,
+                                                vertex_id_offset,
+                                                draw->start_instance,
+                                                elts,
+                                                draw->pt.user.drawid,
+                                                draw->pt.user.viewid);
+   }
+
+   llvm_pipeline_post_vs(fpme, &llvm_vert_info, prim_info, clipped);
+}
+
+
+static void
+llvm_segment_shade(struct llvm_vs_segment *seg)
+{
+   struct llvm_middle_end *fpme = seg->fpme;
+   struct draw_context *draw = fpme->draw;
+
+   seg->clipped = fpme->current_variant->jit_func(&fpme->llvm->vs_jit_context,
+                                                  &fpme->llvm->jit_resources[PIPE_SHADER_VERTEX],
+                                                  seg->verts,
+                                                  draw->pt.user.vbuffer,
+                                                  seg->count,
+                                                  seg->start,
+                                                  fpme->vertex_size,
+                                                  draw->pt.vertex_buffer,
+                                                  seg->instance_id,
+                                                  seg->vertex_id_offset,
+                                                  draw->start_instance,
+                                                  seg->elts,
+                                                  seg->draw_id,
+                                                  seg->view_id);
+   seg->shaded = true;
+}
+
+
+static void
+llvm_segment_execute(void *data, void *gdata, int thread_index)
+{
+   /* Match the denorm handling draw_vbo() sets up on the calling thread */
+   util_fpstate_set_denorms_to_zero(util_fpstate_get());
+
+   llvm_segment_shade(data);
+}
+
+
+/**
+ * Wait for the oldest queued segment and pass it down the pipeline.
+ */
+static void
+llvm_middle_end_drain_one(struct llvm_middle_end *fpme)
+{
+   struct llvm_vs_segment *seg = &fpme->segments[fpme->first_segment];
+   struct draw_context *draw = fpme->draw;
+   unsigned instance_id = draw->instance_id;
+   unsigned draw_id = draw->pt.user.drawid;
+   unsigned view_id = draw->pt.user.viewid;
+   struct draw_vertex_info vert_info;
+
+   assert(fpme->num_segments);
+
+   /* Shade it ourselves rather than wait if no thread picked it up yet */
+   util_queue_drop_job(&fpme->vs_queue, &seg->fence);
+   if (!seg->shaded)
+      llvm_segment_shade(seg);
+
+   fpme->first_segment = (fpme->first_segment + 1) % fpme->max_segments;
+   fpme->num_segments--;
+
+   vert_info.count = seg->count;
+   vert_info.vertex_size = fpme->vertex_size;
+   vert_info.stride = fpme->vertex_size;
+   vert_info.verts = seg->verts;
+   seg->verts = NULL;
+
+   /* The geometry shader and emit look at these too, and the application
+    * thread may have moved on to another instance or view since.
+    */
+   draw->instance_id = seg->instance_id;
+   draw->pt.user.drawid = seg->draw_id;
+   draw->pt.user.viewid = seg->view_id;
+
+   llvm_pipeline_post_vs(fpme, &vert_info, &seg->prim_info, seg->clipped);
+
+   draw->instance_id = instance_id;
+   draw->pt.user.drawid = draw_id;
+   draw->pt.user.viewid = view_id;
+}
+
+
+static void
+llvm_middle_end_drain(struct llvm_middle_end *fpme)
+{
+   /* The pipeline may flush us again while emitting a segment.  Leave the
+    * remaining segments to the outer loop so they stay in order.
+    */
+   if (fpme->draining)
+      return;
+
+   fpme->draining = true;
+   while (fpme->num_segments)
+      llvm_middle_end_drain_one(fpme);
+   fpme->draining = false;
+}
+
+
+static bool
+llvm_segment_copy_elts(void **dst, unsigned *dst_size,
+                       const void *src, unsigned size)
+{
+   if (*dst_size < size) {
+      void *elts = REALLOC(*dst, *dst_size, size);
+      if (!elts)
+         return false;
+      *dst = elts;
+      *dst_size = size;
+   }
+
+   memcpy(*dst, src, size);
+
+   return true;
+}
+
+
+static bool
+llvm_middle_end_queue(struct llvm_middle_end *fpme,
+                      const struct draw_fetch_info *fetch_info,
+                      const struct draw_prim_info *prim_info,
+                      struct vertex_header *verts,
+                      unsigned start, unsigned vertex_id_offset)
+{
+   struct draw_context *draw = fpme->draw;
+   struct llvm_vs_segment *seg;
+
+   if (fpme->num_segments == fpme->max_segments)
+      llvm_middle_end_drain_one(fpme);
+
+   seg = &fpme->segments[(fpme->first_segment + fpme->num_segments) %
+                         fpme->max_segments];
+
+   seg->fpme = fpme;
+   seg->shaded = false;
+   seg->clipped = false;
+   seg->count = fetch_info->count;
+   seg->start = start;
+   seg->vertex_id_offset = vertex_id_offset;
+   seg->instance_id = draw->instance_id;
+   seg->draw_id = draw->pt.user.drawid;
+   seg->view_id = draw->pt.user.viewid;
+   seg->verts = verts;
+
+   seg->prim_info = *prim_info;
+   seg->draw_count = prim_info->count;
+   seg->prim_info.primitive_lengths = &seg->draw_count;
+   assert(prim_info->primitive_count == 1);
+
+   if ((!fetch_info->linear &&
+        !llvm_segment_copy_elts((void **)&seg->fetch_elts,
+                                &seg->fetch_elts_size, fetch_info->elts,
+                                fetch_info->count * sizeof(unsigned))) ||
+       (!prim_info->linear &&
+        !llvm_segment_copy_elts((void **)&seg->draw_elts,
+                                &seg->draw_elts_size, prim_info->elts,
+                                prim_info->count * sizeof(uint16_t)))) {
+      seg->verts = NULL;
+      return false;
+   }
+
+   seg->elts = fetch_info->linear ? NULL : seg->fetch_elts;
+   seg->prim_info.elts = prim_info->linear ? NULL : seg->draw_elts;
+
+   fpme->num_segments++;
+
+   util_queue_add_job(&fpme->vs_queue, seg, &seg->fence,
+                      llvm_segment_execute, NULL, 0);
+
+   return true;
+}
+
+
 static inline enum mesa_prim
 prim_type(enum mesa_prim prim, unsigned flags)
 {
@@ -817,10 +1121,17 @@ llvm_middle_end_linear_run_elts(struct draw_pt_middle_end *middle,
 }
 
 
+static void
+llvm_middle_end_flush(struct draw_pt_middle_end *middle)
+{
+   llvm_middle_end_drain(llvm_middle_end(middle));
+}
+
+
 static void
 llvm_middle_end_finish(struct draw_pt_middle_end *middle)
 {
-   /* nothing to do */
+   llvm_middle_end_drain(llvm_middle_end(middle));
 }
 
 
@@ -829,6 +1140,17 @@ llvm_middle_end_destroy(struct draw_pt_middle_end *middle)
 {
    struct llvm_middle_end *fpme = llvm_middle_end(middle);
 
+   llvm_middle_end_drain(fpme);
+
+   if (fpme->max_segments)
+      util_queue_destroy(&fpme->vs_queue);
+
+   for (unsigned i = 0; i < LLVM_MAX_QUEUED_SEGMENTS; i++) {
+      util_queue_fence_destroy(&fpme->segments[i].fence);
+      FREE(fpme->segments[i].fetch_elts);
+      FREE(fpme->segments[i].draw_elts);
+   }
+
    if (fpme->fetch)
       draw_pt_fetch_destroy(fpme->fetch);
 
@@ -862,11 +1184,15 @@ draw_pt_fetch_pipeline_or_emit_llvm(struct draw_context *draw)
    fpme->base.run             = llvm_middle_end_run;
    fpme->base.run_linear      = llvm_middle_end_linear_run;
    fpme->base.run_linear_elts = llvm_middle_end_linear_run_elts;
+   fpme->base.flush           = llvm_middle_end_flush;
    fpme->base.finish          = llvm_middle_end_finish;
    fpme->base.destroy         = llvm_middle_end_destroy;
 
    fpme->draw = draw;
 
+   for (unsigned i = 0; i < LLVM_MAX_QUEUED_SEGMENTS; i++)
+      util_queue_fence_init(&fpme->segments[i].fence);
+
    fpme->fetch = draw_pt_fetch_create(draw);
    if (!fpme->fetch)
       goto fail;
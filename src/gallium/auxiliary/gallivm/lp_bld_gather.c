@@ -341,6 +341,27 @@ lp_build_gather_avx2(struct gallivm_state *gallivm,
       unsigned l_idx = 0;
 
       assert(src_width == 32 || src_width == 64);
+      if (src_width == 32 && length == 16) {
+         /*
+          * AVX-512 gathers use a mask register (vector of i1) rather than
+          * a vector mask, and an i32 scale.
+          */
+         LLVMTypeRef i1_type = LLVMInt1TypeInContext(gallivm->context);
+         LLVMTypeRef i32_type = LLVMInt32TypeInContext(gallivm->context);
+
+         intrinsic = dst_type.floating ? "llvm.x86.avx512.mask.gather.dps.512" :
+                                         "llvm.x86.avx512.mask.gather.dpi.512";
+
+         LLVMValueRef passthru = LLVMGetUndef(src_vec_type);
+         LLVMValueRef mask = LLVMConstAllOnes(LLVMVectorType(i1_type, length));
+         LLVMValueRef scale = LLVMConstInt(i32_type, 1, 0);
+
+         LLVMValueRef args[] = { passthru, base_ptr, offsets, mask, scale };
+
+         res = lp_build_intrinsic(builder, intrinsic, src_vec_type, args, 5, 0);
+         return LLVMBuildBitCast(builder, res,
+                                 lp_build_vec_type(gallivm, res_type), "");
+      }
       if (src_width == 32) {
          assert(length == 4 || length == 8);
       } else {
@@ -491,6 +512,10 @@ lp_build_gather(struct gallivm_state *gallivm,
               src_width == 32 && (length == 4 || length == 8)) {
       return lp_build_gather_avx2(gallivm, length, src_width, dst_type,
                                   base_ptr, offsets);
+   } else if (util_get_cpu_caps()->has_avx512f && !need_expansion &&
+              src_width == 32 && length == 16) {
+      return lp_build_gather_avx2(gallivm, length, src_width, dst_type,
+                                  base_ptr, offsets);
    /*
     * This looks bad on paper wrt throughtput/latency on Haswell.
     * Even on Broadwell it doesn't look stellar.
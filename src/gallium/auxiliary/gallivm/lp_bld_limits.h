@@ -83,6 +83,13 @@
  */
 #define LP_MAX_TGSI_LOOP_ITERATIONS 65535
 
+/**
+ * Edge length, in texels, of the square tiles of micro-tiled textures
+ * (lp_static_texture_state::microtiled).  Tiles are stored row by row,
+ * and so are the texels within each tile.
+ */
+#define LP_MICROTILE_SIZE 4
+
 static inline bool
 lp_has_fp16(void)
 {
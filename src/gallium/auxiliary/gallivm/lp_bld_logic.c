@@ -420,6 +420,18 @@ lp_build_select(struct lp_build_context *bld,
          res = LLVMBuildBitCast(builder, res, bld->vec_type, "");
       }
    }
+   else if (util_get_cpu_caps()->has_avx512f &&
+            type.width * type.length == 512 &&
+            (type.width >= 32 || util_get_cpu_caps()->has_avx512bw)) {
+      /* There's no 512-bit blendv, but AVX-512 has mask registers: turn the
+       * mask into a vector of booleans with a compare (vptestm) so LLVM can
+       * keep it in a k register and emit a masked move / vblendm.
+       */
+      LLVMTypeRef mask_type = LLVMTypeOf(mask);
+      mask = LLVMBuildICmp(builder, LLVMIntNE, mask,
+                           LLVMConstNull(mask_type), "");
+      res = LLVMBuildSelect(builder, mask, a, b, "");
+   }
    else {
       res = lp_build_select_bitwise(bld, mask, a, b);
    }
@@ -2339,6 +2339,69 @@ lp_build_tiled_sample_offset(struct lp_build_context *bld,
 }
 
 
+/**
+ * Compute the offset of a texel in a micro-tiled texture.
+ *
+ * Like lp_build_sample_offset(), but texels are grouped into
+ * LP_MICROTILE_SIZE x LP_MICROTILE_SIZE tiles.  y_stride is still the
+ * stride of a single row of texels, so a row of tiles spans
+ * LP_MICROTILE_SIZE * y_stride bytes.  With T = LP_MICROTILE_SIZE the
+ * offset remains separable in x and y:
+ *
+ *    x_offset = ((x & ~(T-1)) * T + (x & (T-1))) * texel_size
+ *    y_offset = (y & ~(T-1)) * y_stride + (y & (T-1)) * T * texel_size
+ *
+ * Only formats with 1x1 blocks are micro-tiled, so i and j are zero.
+ */
+void
+lp_build_microtiled_sample_offset(struct lp_build_context *bld,
+                                  const struct util_format_description *format_desc,
+                                  LLVMValueRef x,
+                                  LLVMValueRef y,
+                                  LLVMValueRef z,
+                                  LLVMValueRef y_stride,
+                                  LLVMValueRef z_stride,
+                                  LLVMValueRef *out_offset,
+                                  LLVMValueRef *out_i,
+                                  LLVMValueRef *out_j)
+{
+   struct gallivm_state *gallivm = bld->gallivm;
+   LLVMBuilderRef builder = gallivm->builder;
+   const unsigned texel_size = format_desc->block.bits / 8;
+   LLVMValueRef tile_mask =
+      lp_build_const_int_vec(gallivm, bld->type, LP_MICROTILE_SIZE - 1);
+   LLVMValueRef tile_shift =
+      lp_build_const_int_vec(gallivm, bld->type,
+                             util_logbase2(LP_MICROTILE_SIZE));
+
+   assert(format_desc->block.width == 1 && format_desc->block.height == 1);
+
+   LLVMValueRef x_in_tile = LLVMBuildAnd(builder, x, tile_mask, "");
+   LLVMValueRef x_tile = LLVMBuildSub(builder, x, x_in_tile, "");
+   x_tile = LLVMBuildShl(builder, x_tile, tile_shift, "");
+   LLVMValueRef offset = lp_build_add(bld, x_tile, x_in_tile);
+
+   if (y && y_stride) {
+      LLVMValueRef y_in_tile = LLVMBuildAnd(builder, y, tile_mask, "");
+      LLVMValueRef y_tile = LLVMBuildSub(builder, y, y_in_tile, "");
+      y_in_tile = LLVMBuildShl(builder, y_in_tile, tile_shift, "");
+      offset = lp_build_add(bld, offset, y_in_tile);
+      offset = lp_build_mul_imm(bld, offset, texel_size);
+      offset = lp_build_add(bld, offset, lp_build_mul(bld, y_tile, y_stride));
+   } else {
+      offset = lp_build_mul_imm(bld, offset, texel_size);
+   }
+
+   if (z && z_stride) {
+      offset = lp_build_add(bld, offset, lp_build_mul(bld, z, z_stride));
+   }
+
+   *out_offset = offset;
+   *out_i = bld->zero;
+   *out_j = bld->zero;
+}
+
+
 static LLVMValueRef
 lp_build_sample_min(struct lp_build_context *bld,
                     LLVMValueRef x,
@@ -192,6 +192,11 @@ lp_build_sample_texel_soa(struct lp_build_sample_context *bld,
                                    bld->static_texture_state,
                                    x, y, z, width, height, z_stride,
                                    &offset, &i, &j);
+   } else if (bld->static_texture_state->microtiled) {
+      lp_build_microtiled_sample_offset(&bld->int_coord_bld,
+                                        bld->format_desc,
+                                        x, y, z, y_stride, z_stride,
+                                        &offset, &i, &j);
    } else {
       lp_build_sample_offset(&bld->int_coord_bld,
                              bld->format_desc,
@@ -3329,6 +3334,11 @@ lp_build_fetch_texel(struct lp_build_sample_context *bld,
                                    bld->static_texture_state,
                                    x, y, z, width, height, img_stride_vec,
                                    &offset, &i, &j);
+   } else if (bld->static_texture_state->microtiled) {
+      lp_build_microtiled_sample_offset(int_coord_bld,
+                                        bld->format_desc,
+                                        x, y, z, row_stride_vec, img_stride_vec,
+                                        &offset, &i, &j);
    } else {
       lp_build_sample_offset(int_coord_bld,
                              bld->format_desc,
@@ -3860,6 +3870,7 @@ lp_build_sample_soa_code(struct gallivm_state *gallivm,
                     derived_sampler_state.mag_img_filter;
 
       use_aos &= !static_texture_state->tiled;
+      use_aos &= !static_texture_state->microtiled;
 
       if (gallivm_perf & GALLIVM_PERF_NO_AOS_SAMPLING) {
          use_aos = 0;
@@ -3920,9 +3931,11 @@ lp_build_sample_soa_code(struct gallivm_state *gallivm,
       /*
        * we only try 8-wide sampling with soa or if we have AVX2
        * as it appears to be a loss with just AVX)
+       * 16-wide (AVX-512) vectors always use soa as a whole or aos per quad,
+       * the fixed point aos code is only tuned for up to 256 bits.
        */
       if (num_quads == 1 || !use_aos ||
-          (util_get_cpu_caps()->has_avx2 &&
+          (util_get_cpu_caps()->has_avx2 && num_quads <= 2 &&
            (bld.num_lods == 1 ||
             derived_sampler_state.min_img_filter == derived_sampler_state.mag_img_filter))) {
          if (use_aos) {
@@ -5061,6 +5074,11 @@ lp_build_img_op_soa(const struct lp_static_texture_state *static_texture_state,
                                    static_texture_state,
                                    x, y, z, width, height, img_stride_vec,
                                    &offset, &i, &j);
+   } else if (static_texture_state->microtiled) {
+      lp_build_microtiled_sample_offset(&int_coord_bld,
+                                        format_desc,
+                                        x, y, z, row_stride_vec, img_stride_vec,
+                                        &offset, &i, &j);
    } else {
       lp_build_sample_offset(&int_coord_bld,
                              format_desc,
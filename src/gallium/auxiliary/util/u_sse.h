@@ -584,6 +584,190 @@ util_sse2_stretch_row_8unorm(__m128i * restrict dst,
 }
 
 
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+/*
+ * AVX2 versions of the helpers above, for translation units built with
+ * -mavx2.  They process eight pixels at a time, and give the same results
+ * as the SSE2 versions.
+ *
+ * Note that AVX2 unpacks and packs operate within each 128-bit lane, so
+ * the "lo" 16-bit vectors hold pixels 0, 1, 4 and 5, and the "hi" vectors
+ * pixels 2, 3, 6 and 7.
+ */
+
+static ALWAYS_INLINE __m256i
+util_avx2_lerp_epi16(__m256i w, __m256i a, __m256i b)
+{
+   __m256i res;
+
+   res = _mm256_sub_epi16(b, a);
+   res = _mm256_mullo_epi16(res, w);
+   res = _mm256_srli_epi16(res, 8);
+   /* use add_epi8 instead of add_epi16 so no need to mask off upper bits */
+   res = _mm256_add_epi8(res, a);
+
+   return res;
+}
+
+
+static ALWAYS_INLINE __m256i
+util_avx2_lerp_epi8_fixed88(__m256i src0, __m256i src1,
+                            const __m256i * restrict weight_lo,
+                            const __m256i * restrict weight_hi)
+{
+   const __m256i zero = _mm256_setzero_si256();
+
+   __m256i src0_lo = _mm256_unpacklo_epi8(src0, zero);
+   __m256i src0_hi = _mm256_unpackhi_epi8(src0, zero);
+
+   __m256i src1_lo = _mm256_unpacklo_epi8(src1, zero);
+   __m256i src1_hi = _mm256_unpackhi_epi8(src1, zero);
+
+   __m256i dst_lo;
+   __m256i dst_hi;
+
+   dst_lo = util_avx2_lerp_epi16(*weight_lo, src0_lo, src1_lo);
+   dst_hi = util_avx2_lerp_epi16(*weight_hi, src0_hi, src1_hi);
+
+   return _mm256_packus_epi16(dst_lo, dst_hi);
+}
+
+
+static ALWAYS_INLINE __m256i
+util_avx2_lerp_2d_epi8_fixed88(__m256i src0, __m256i src1,
+                               const __m256i * restrict src2,
+                               const __m256i * restrict src3,
+                               const __m256i * restrict ws_lo,
+                               const __m256i * restrict ws_hi,
+                               const __m256i * restrict wt_lo,
+                               const __m256i * restrict wt_hi)
+{
+   const __m256i zero = _mm256_setzero_si256();
+
+   __m256i src0_lo = _mm256_unpacklo_epi8(src0, zero);
+   __m256i src0_hi = _mm256_unpackhi_epi8(src0, zero);
+
+   __m256i src1_lo = _mm256_unpacklo_epi8(src1, zero);
+   __m256i src1_hi = _mm256_unpackhi_epi8(src1, zero);
+
+   __m256i src2_lo = _mm256_unpacklo_epi8(*src2, zero);
+   __m256i src2_hi = _mm256_unpackhi_epi8(*src2, zero);
+
+   __m256i src3_lo = _mm256_unpacklo_epi8(*src3, zero);
+   __m256i src3_hi = _mm256_unpackhi_epi8(*src3, zero);
+
+   __m256i dst_lo, dst01_lo, dst23_lo;
+   __m256i dst_hi, dst01_hi, dst23_hi;
+
+   dst01_lo = util_avx2_lerp_epi16(*ws_lo, src0_lo, src1_lo);
+   dst01_hi = util_avx2_lerp_epi16(*ws_hi, src0_hi, src1_hi);
+   dst23_lo = util_avx2_lerp_epi16(*ws_lo, src2_lo, src3_lo);
+   dst23_hi = util_avx2_lerp_epi16(*ws_hi, src2_hi, src3_hi);
+
+   dst_lo = util_avx2_lerp_epi16(*wt_lo, dst01_lo, dst23_lo);
+   dst_hi = util_avx2_lerp_epi16(*wt_hi, dst01_hi, dst23_hi);
+
+   return _mm256_packus_epi16(dst_lo, dst_hi);
+}
+
+
+/**
+ * AVX2 version of util_sse2_stretch_row_8unorm().
+ *
+ * dst only needs to be 16 byte aligned.
+ */
+static ALWAYS_INLINE int32_t
+util_avx2_stretch_row_8unorm(uint32_t * restrict dst,
+                             int32_t dst_width,
+                             const uint32_t * restrict src,
+                             int32_t src_x,
+                             int32_t src_xstep)
+{
+   int16_t error[8];
+   __m256i error_lo, error_hi, error_step;
+
+   assert(dst_width >= 0);
+   assert(dst_width % 4 == 0);
+
+   error[0] = src_x;
+   for (unsigned i = 1; i < 8; i++)
+      error[i] = error[i - 1] + src_xstep;
+
+   error_lo   = _mm256_setr_epi16(error[0], error[0], error[0], error[0],
+                                  error[1], error[1], error[1], error[1],
+                                  error[4], error[4], error[4], error[4],
+                                  error[5], error[5], error[5], error[5]);
+   error_hi   = _mm256_setr_epi16(error[2], error[2], error[2], error[2],
+                                  error[3], error[3], error[3], error[3],
+                                  error[6], error[6], error[6], error[6],
+                                  error[7], error[7], error[7], error[7]);
+   error_step = _mm256_set1_epi16(src_xstep << 3);
+
+   while (dst_width >= 8) {
+      __m128i src0_lo, src0_hi, src1_lo, src1_hi;
+      __m256i src0, src1;
+      __m256i weight_lo, weight_hi;
+
+      /* Fetch pairs of pixels 64bit at a time, four pixels per lane. */
+      for (unsigned lane = 0; lane < 2; lane++) {
+         uint16_t src_x0 = src_x >> 16;
+         src_x += src_xstep;
+         uint16_t src_x1 = src_x >> 16;
+         src_x += src_xstep;
+         uint16_t src_x2 = src_x >> 16;
+         src_x += src_xstep;
+         uint16_t src_x3 = src_x >> 16;
+         src_x += src_xstep;
+
+         __m128i src_00_10 = _mm_loadl_epi64((const __m128i *)&src[src_x0]);
+         __m128i src_01_11 = _mm_loadl_epi64((const __m128i *)&src[src_x1]);
+         __m128i src_02_12 = _mm_loadl_epi64((const __m128i *)&src[src_x2]);
+         __m128i src_03_13 = _mm_loadl_epi64((const __m128i *)&src[src_x3]);
+
+         __m128i src_00_01_10_11 = _mm_unpacklo_epi32(src_00_10, src_01_11);
+         __m128i src_02_03_12_13 = _mm_unpacklo_epi32(src_02_12, src_03_13);
+
+         if (lane == 0) {
+            src0_lo = _mm_unpacklo_epi64(src_00_01_10_11, src_02_03_12_13);
+            src1_lo = _mm_unpackhi_epi64(src_00_01_10_11, src_02_03_12_13);
+         } else {
+            src0_hi = _mm_unpacklo_epi64(src_00_01_10_11, src_02_03_12_13);
+            src1_hi = _mm_unpackhi_epi64(src_00_01_10_11, src_02_03_12_13);
+         }
+      }
+
+      src0 = _mm256_inserti128_si256(_mm256_castsi128_si256(src0_lo),
+                                     src0_hi, 1);
+      src1 = _mm256_inserti128_si256(_mm256_castsi128_si256(src1_lo),
+                                     src1_hi, 1);
+
+      weight_lo = _mm256_srli_epi16(error_lo, 8);
+      weight_hi = _mm256_srli_epi16(error_hi, 8);
+
+      _mm256_storeu_si256((__m256i *)dst,
+                          util_avx2_lerp_epi8_fixed88(src0, src1,
+                                                      &weight_lo, &weight_hi));
+
+      error_lo = _mm256_add_epi16(error_lo, error_step);
+      error_hi = _mm256_add_epi16(error_hi, error_step);
+
+      dst += 8;
+      dst_width -= 8;
+   }
+
+   if (dst_width)
+      src_x = util_sse2_stretch_row_8unorm((__m128i *)dst, dst_width,
+                                           src, src_x, src_xstep);
+
+   return src_x;
+}
+
+#endif /* __AVX2__ */
+
+
 
 #endif /* DETECT_ARCH_SSE */
 
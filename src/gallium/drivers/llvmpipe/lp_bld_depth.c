@@ -544,6 +544,40 @@ lp_build_depth_stencil_load_swizzled(struct gallivm_state *gallivm,
    const unsigned depth_bytes = format_desc->block.bits / 8;
    struct lp_type zs_type = lp_depth_type(format_desc, z_src_type.length);
 
+   if (z_src_type.length == 16) {
+      /*
+       * A 16-wide vector covers the whole 4x4 block, which is just the two
+       * 8-wide halves (rows 0-1 and rows 2-3) back to back.
+       */
+      struct lp_type half_type = z_src_type;
+      LLVMValueRef z_half[2], s_half[2];
+      LLVMValueRef loop_half =
+         LLVMBuildShl(builder, loop_counter, lp_build_const_int32(gallivm, 1), "");
+
+      half_type.length = 8;
+      lp_build_depth_stencil_load_swizzled(gallivm, half_type, format_desc,
+                                           is_1d, depth_ptr, depth_stride,
+                                           &z_half[0], &s_half[0], loop_half);
+      if (is_1d) {
+         z_half[1] = LLVMGetUndef(LLVMTypeOf(z_half[0]));
+         s_half[1] = LLVMGetUndef(LLVMTypeOf(s_half[0]));
+      } else {
+         loop_half = LLVMBuildAdd(builder, loop_half,
+                                  lp_build_const_int32(gallivm, 1), "");
+         lp_build_depth_stencil_load_swizzled(gallivm, half_type, format_desc,
+                                              is_1d, depth_ptr, depth_stride,
+                                              &z_half[1], &s_half[1], loop_half);
+      }
+      for (unsigned i = 0; i < 16; i++) {
+         shuffles[i] = lp_build_const_int32(gallivm, i);
+      }
+      *z_fb = LLVMBuildShuffleVector(builder, z_half[0], z_half[1],
+                                     LLVMConstVector(shuffles, 16), "");
+      *s_fb = LLVMBuildShuffleVector(builder, s_half[0], s_half[1],
+                                     LLVMConstVector(shuffles, 16), "");
+      return;
+   }
+
    struct lp_type zs_load_type = zs_type;
    zs_load_type.length = zs_load_type.length / 2;
 
@@ -691,6 +725,27 @@ lp_build_depth_stencil_write_swizzled(struct gallivm_state *gallivm,
    struct lp_type z_type = zs_type;
    struct lp_type zs_load_type = zs_type;
 
+   if (z_src_type.length == 16) {
+      /* Store as two 8-wide halves, see lp_build_depth_stencil_load_swizzled */
+      struct lp_type half_type = z_src_type;
+      LLVMValueRef loop_half =
+         LLVMBuildShl(builder, loop_counter, lp_build_const_int32(gallivm, 1), "");
+
+      half_type.length = 8;
+      for (unsigned h = 0; h < (is_1d ? 1 : 2); h++) {
+         lp_build_depth_stencil_write_swizzled(
+            gallivm, half_type, format_desc, is_1d,
+            mask_value ? lp_build_extract_range(gallivm, mask_value, h * 8, 8) : NULL,
+            z_fb ? lp_build_extract_range(gallivm, z_fb, h * 8, 8) : NULL,
+            s_fb ? lp_build_extract_range(gallivm, s_fb, h * 8, 8) : NULL,
+            LLVMBuildAdd(builder, loop_half, lp_build_const_int32(gallivm, h), ""),
+            depth_ptr, depth_stride,
+            lp_build_extract_range(gallivm, z_value, h * 8, 8),
+            s_value ? lp_build_extract_range(gallivm, s_value, h * 8, 8) : NULL);
+      }
+      return;
+   }
+
    zs_load_type.length = zs_load_type.length / 2;
    load_ptr_type = LLVMPointerType(lp_build_vec_type(gallivm, zs_load_type), 0);
 
@@ -48,6 +48,7 @@
 #include "lp_setup.h"
 #include "lp_screen.h"
 #include "lp_fence.h"
+#include "lp_ml.h"
 
 static void
 llvmpipe_destroy(struct pipe_context *pipe)
@@ -61,6 +62,13 @@ llvmpipe_destroy(struct pipe_context *pipe)
    mtx_unlock(&lp_screen->ctx_mutex);
    lp_print_counters();
 
+   /* The screen's compile queue may still be working on our variants. */
+   struct lp_fs_variant_list_item *li;
+   LIST_FOR_EACH_ENTRY(li, &llvmpipe->fs_variants_list.list, list)
+      lp_fs_variant_wait(li->base);
+
+   llvmpipe_cs_finish_pending(llvmpipe);
+
    if (llvmpipe->csctx) {
       lp_csctx_destroy(llvmpipe->csctx);
    }
@@ -247,6 +255,7 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    llvmpipe_init_tess_funcs(llvmpipe);
    llvmpipe_init_task_funcs(llvmpipe);
    llvmpipe_init_mesh_funcs(llvmpipe);
+   llvmpipe_init_ml_funcs(llvmpipe);
    llvmpipe_init_rasterizer_funcs(llvmpipe);
    llvmpipe_init_context_resource_funcs(&llvmpipe->pipe);
    llvmpipe_init_surface_functions(llvmpipe);
@@ -336,6 +345,9 @@ llvmpipe_create_context(struct pipe_screen *screen, void *priv,
    /* initial state for clipping - enabled, with no guardband */
    draw_set_driver_clipping(llvmpipe->draw, false, false, false, true);
 
+   /* shade large draws on as many threads as the rasterizer uses */
+   draw_set_vertex_threads(llvmpipe->draw, lp_screen->num_threads);
+
    lp_reset_counters();
 
    /* If llvmpipe_set_scissor_states() is never called, we still need to
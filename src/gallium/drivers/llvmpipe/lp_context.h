@@ -38,11 +38,13 @@
 
 #include "lp_tex_sample.h"
 #include "lp_jit.h"
+#include "lp_limits.h"
 #include "lp_texture_handle.h"
 #include "lp_setup.h"
 #include "lp_state_fs.h"
 #include "lp_state_cs.h"
 #include "lp_state_setup.h"
+#include "lp_perf.h"
 
 
 struct llvmpipe_vbuf_render;
@@ -51,6 +53,7 @@ struct draw_stage;
 struct draw_vertex_shader;
 struct lp_fragment_shader;
 struct lp_compute_shader;
+struct lp_cs_job;
 struct lp_blend_state;
 struct lp_setup_context;
 struct lp_setup_variant;
@@ -159,11 +162,15 @@ struct llvmpipe_context {
    struct blitter_context *blitter;
 
    unsigned tex_timestamp;
+   unsigned tex_layout_timestamp;
 
    /** List of all fragment shader variants */
    struct lp_fs_variant_list_item fs_variants_list;
    unsigned nr_fs_variants;
-   unsigned nr_fs_instrs;
+   unsigned nr_fs_instrs;   /**< updated atomically by the compile queue */
+
+   /** Shader compile counters, updated from the compile queue too */
+   struct lp_perf_counters perf;
 
    bool permit_linear_rasterizer;
    bool single_vp;
@@ -177,6 +184,10 @@ struct llvmpipe_context {
    unsigned nr_cs_instrs;
    struct lp_cs_context *csctx;
 
+   /** Dispatches still running on the compute thread pool, oldest first */
+   struct lp_cs_job *cs_pending[LP_MAX_CS_PENDING];
+   unsigned num_cs_pending;
+
    struct lp_cs_context *task_ctx;
    struct lp_cs_context *mesh_ctx;
 
@@ -28,9 +28,12 @@
  * based on threadpool.c but modified heavily to be compute shader tuned.
  */
 
+#include "util/u_atomic.h"
+#include "util/u_math.h"
 #include "util/u_thread.h"
 #include "util/u_memory.h"
 #include "lp_cs_tpool.h"
+#include "lp_screen.h"
 
 static int
 lp_cs_tpool_worker(void *data)
@@ -43,7 +46,6 @@ lp_cs_tpool_worker(void *data)
 
    while (!pool->shutdown) {
       struct lp_cs_tpool_task *task;
-      unsigned iter_per_thread;
 
       while (list_is_empty(&pool->workqueue) && !pool->shutdown)
          cnd_wait(&pool->new_work, &pool->m);
@@ -54,28 +56,38 @@ lp_cs_tpool_worker(void *data)
       task = list_first_entry(&pool->workqueue, struct lp_cs_tpool_task,
                               list);
 
-      unsigned this_iter = task->iter_start;
-
-      iter_per_thread = task->iter_per_thread;
-
-      if (task->iter_remainder &&
-          task->iter_start + task->iter_remainder == task->iter_total) {
-         task->iter_remainder--;
-         iter_per_thread = 1;
+      /* Every iteration has been handed out already, nobody else needs to
+       * find this task.
+       */
+      if (p_atomic_read(&task->iter_start) >= task->iter_total) {
+         list_delinit(&task->list);
+         continue;
       }
 
-      task->iter_start += iter_per_thread;
+      /* Hold a reference so the task can't complete (and be freed by the
+       * waiter) while we're still claiming iterations from it.
+       */
+      p_atomic_inc(&task->pending);
+      mtx_unlock(&pool->m);
 
-      if (task->iter_start == task->iter_total)
-         list_del(&task->list);
+      while (true) {
+         unsigned this_iter = p_atomic_add_return(&task->iter_start,
+                                                  task->iter_per_claim) -
+                              task->iter_per_claim;
+         if (this_iter >= task->iter_total)
+            break;
 
-      mtx_unlock(&pool->m);
-      for (unsigned i = 0; i < iter_per_thread; i++)
-         task->work(task->data, this_iter + i, &lmem);
+         unsigned count = MIN2(task->iter_per_claim,
+                               task->iter_total - this_iter);
+         for (unsigned i = 0; i < count; i++)
+            task->work(task->data, this_iter + i, &lmem);
+
+         /* Can't drop to zero, we still hold our reference. */
+         p_atomic_add(&task->pending, -(int)count);
+      }
 
       mtx_lock(&pool->m);
-      task->iter_finished += iter_per_thread;
-      if (task->iter_finished == task->iter_total)
+      if (p_atomic_dec_zero(&task->pending))
          cnd_broadcast(&task->finish);
    }
    mtx_unlock(&pool->m);
@@ -84,7 +96,7 @@ lp_cs_tpool_worker(void *data)
 }
 
 struct lp_cs_tpool *
-lp_cs_tpool_create(unsigned num_threads)
+lp_cs_tpool_create(unsigned num_threads, unsigned num_domains)
 {
    struct lp_cs_tpool *pool = CALLOC_STRUCT(lp_cs_tpool);
 
@@ -101,6 +113,10 @@ lp_cs_tpool_create(unsigned num_threads)
          num_threads = i;  /* previous thread is max */
          break;
       }
+
+      if (num_domains > 1)
+         lp_thread_set_domain(pool->threads[i],
+                              lp_thread_domain(i, num_threads, num_domains));
    }
    pool->num_threads = num_threads;
    return pool;
@@ -150,9 +166,12 @@ lp_cs_tpool_queue_task(struct lp_cs_tpool *pool,
    task->work = work;
    task->data = data;
    task->iter_total = num_iters;
+   task->pending = num_iters;
 
-   task->iter_per_thread = num_iters / pool->num_threads;
-   task->iter_remainder = num_iters % pool->num_threads;
+   /* Claims are cheap, so hand out a few chunks per thread to even out
+    * workgroups of differing cost.
+    */
+   task->iter_per_claim = MAX2(num_iters / (pool->num_threads * 4), 1);
 
    cnd_init(&task->finish);
 
@@ -175,8 +194,12 @@ lp_cs_tpool_wait_for_task(struct lp_cs_tpool *pool,
       return;
 
    mtx_lock(&pool->m);
-   while (task->iter_finished < task->iter_total)
+   while (p_atomic_read(&task->pending))
       cnd_wait(&task->finish, &pool->m);
+
+   /* Workers only unlink the task lazily, when they next look at it. */
+   if (!list_is_empty(&task->list))
+      list_del(&task->list);
    mtx_unlock(&pool->m);
 
    cnd_destroy(&task->finish);
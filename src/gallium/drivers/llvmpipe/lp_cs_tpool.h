@@ -64,13 +64,22 @@ struct lp_cs_tpool_task {
    struct list_head list;
    cnd_t finish;
    unsigned iter_total;
+   unsigned iter_per_claim;
+
+   /* Next iteration to hand out, claimed by workers with atomic adds
+    * without holding the pool mutex.
+    */
    unsigned iter_start;
-   unsigned iter_finished;
-   unsigned iter_per_thread;
-   unsigned iter_remainder;
+
+   /* Unfinished iterations plus the number of workers still holding a
+    * pointer to the task.  The task is complete when this drops to zero;
+    * the final decrement is done with the pool mutex held.
+    */
+   unsigned pending;
 };
 
-struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads);
+struct lp_cs_tpool *lp_cs_tpool_create(unsigned num_threads,
+                                       unsigned num_domains);
 void lp_cs_tpool_destroy(struct lp_cs_tpool *);
 
 struct lp_cs_tpool_task *lp_cs_tpool_queue_task(struct lp_cs_tpool *,
@@ -45,7 +45,7 @@
 #define DEBUG_MEM           0x4000
 #define DEBUG_FS            0x8000
 #define DEBUG_CS            0x10000
-// unused                   0x40000
+#define DEBUG_CACHE         0x40000
 #define DEBUG_NO_FASTPATH   0x80000
 #define DEBUG_LINEAR        0x100000
 #define DEBUG_LINEAR2       0x200000
@@ -65,6 +65,11 @@
 #define PERF_NO_ALPHATEST   0x80  	/* disable alpha testing */
 #define PERF_NO_RAST_LINEAR 0x100  	/* disable linear rast */
 #define PERF_NO_SHADE       0x200  	/* disable fragment shaders */
+#define PERF_NO_ASYNC_COMPILE 0x400	/* compile fs variants at draw time */
+#define PERF_MICROTILE      0x800	/* micro-tiled layout for textures */
+#define PERF_NO_PARALLEL_BIN 0x1000	/* bin triangles on the draw thread only */
+#define PERF_NO_STREAM      0x2000	/* rasterize scenes only when full/flushed */
+#define PERF_CACHE_STATS    0x4000	/* print shader disk cache hits at exit */
 
 
 extern int LP_PERF;
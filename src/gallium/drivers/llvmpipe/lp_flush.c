@@ -41,6 +41,7 @@
 #include "lp_fence.h"
 #include "lp_screen.h"
 #include "lp_rast.h"
+#include "lp_state.h"
 
 
 /**
@@ -54,6 +55,9 @@ llvmpipe_flush(struct pipe_context *pipe,
    struct llvmpipe_context *llvmpipe = llvmpipe_context(pipe);
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
 
+   /* The fence covers compute dispatches too. */
+   llvmpipe_cs_finish_pending(llvmpipe);
+
    draw_flush(llvmpipe->draw);
 
    /* ask the setup module to flush */
@@ -131,6 +135,9 @@ llvmpipe_flush_resource(struct pipe_context *pipe,
    }
    mtx_unlock(&lp_screen->ctx_mutex);
 
+   referenced |= llvmpipe_cs_is_resource_referenced(llvmpipe_context(pipe),
+                                                    resource);
+
    if ((referenced & LP_REFERENCED_FOR_WRITE) ||
        ((referenced & LP_REFERENCED_FOR_READ) && !read_only)) {
 
@@ -147,3 +154,35 @@ llvmpipe_flush_resource(struct pipe_context *pipe,
 
    return true;
 }
+
+
+/**
+ * Wait for all flushed work which may use the resource, e.g. before changing
+ * its layout.  The rasterizer is shared by all contexts of the screen and
+ * retires scenes in order, so its last fence covers the scenes the other
+ * contexts flushed without touching those contexts.  Their unflushed work is
+ * theirs to flush first, as for any resource shared between contexts.
+ *
+ * \param pipe  the calling context, flushed first, or NULL
+ */
+void
+llvmpipe_finish_resource(struct pipe_screen *screen,
+                         struct pipe_context *pipe,
+                         struct pipe_resource *resource,
+                         const char *reason)
+{
+   struct llvmpipe_screen *lp_screen = llvmpipe_screen(screen);
+   struct lp_fence *fence = NULL;
+
+   if (pipe)
+      llvmpipe_flush(pipe, NULL, reason);
+
+   mtx_lock(&lp_screen->rast_mutex);
+   lp_rast_fence(lp_screen->rast, &fence);
+   mtx_unlock(&lp_screen->rast_mutex);
+
+   if (fence) {
+      lp_fence_wait(fence);
+      lp_fence_reference(&fence, NULL);
+   }
+}
@@ -91,6 +91,12 @@
  */
 #define LP_MAX_SETUP_VARIANTS 64
 
+/**
+ * Max number of compute dispatches a context can have in flight on the
+ * compute thread pool.  Launching one more waits for the oldest.
+ */
+#define LP_MAX_CS_PENDING 8
+
 /*
  * Max point size reported. Cap vertex shader point sizes to this.
  */
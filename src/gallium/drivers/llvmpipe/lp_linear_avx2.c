@@ -0,0 +1,266 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * AVX2 versions of the linear path interpolation and sampling kernels.
+ *
+ * This file is built with -mavx2, and its functions must only be called
+ * after checking util_get_cpu_caps()->has_avx2.  They produce exactly the
+ * same rows as the SSE2 kernels they replace, eight pixels at a time.
+ */
+
+
+#include "util/detect.h"
+
+#include "util/u_math.h"
+#include "util/u_sse.h"
+
+#include "lp_jit.h"
+#include "lp_debug.h"
+#include "lp_state_fs.h"
+#include "lp_linear_priv.h"
+
+#if defined(__AVX2__)
+
+#define FIXED16_SHIFT  16
+
+
+/* Interpolate in 1.15 space, but produce a packed row of 0.8 values.
+ */
+const uint32_t *
+lp_linear_interp_0_8_avx2(struct lp_linear_elem *elem)
+{
+   struct lp_linear_interp *interp = (struct lp_linear_interp *)elem;
+   uint32_t *row = interp->row;
+   const __m128i dadx = interp->dadx;
+   const int width = (interp->width + 3) & ~3;
+   int i;
+
+   /* interp->a0 holds pixels 0 and 1, and dadx steps by two pixels.
+    * Keep pixels 0, 1, 4, 5 in a0 and 2, 3, 6, 7 in a1, which is the
+    * order _mm256_packus_epi16() interleaves its 128-bit lanes in.
+    */
+   __m256i a0 = _mm256_inserti128_si256(
+      _mm256_castsi128_si256(interp->a0),
+      _mm_add_epi16(interp->a0, _mm_add_epi16(dadx, dadx)), 1);
+   __m256i dadx8 = _mm256_broadcastsi128_si256(dadx);
+   __m256i a1 = _mm256_add_epi16(a0, dadx8);
+   dadx8 = _mm256_add_epi16(dadx8, dadx8);
+   dadx8 = _mm256_add_epi16(dadx8, dadx8);
+
+   for (i = 0; i + 8 <= width; i += 8) {
+      __m256i l = _mm256_srai_epi16(a0, 7);
+      __m256i h = _mm256_srai_epi16(a1, 7);
+
+      _mm256_storeu_si256((__m256i *)&row[i], _mm256_packus_epi16(l, h));
+
+      a0 = _mm256_add_epi16(a0, dadx8);
+      a1 = _mm256_add_epi16(a1, dadx8);
+   }
+
+   if (i < width) {
+      __m128i a = _mm256_castsi256_si128(a0);
+      __m128i l = _mm_srai_epi16(a, 7);
+      __m128i h = _mm_srai_epi16(_mm_add_epi16(a, dadx), 7);
+
+      *(__m128i *)&row[i] = _mm_packus_epi16(l, h);
+   }
+
+   // advance to next row
+   interp->a0 = _mm_add_epi16(interp->a0, interp->dady);
+   return interp->row;
+}
+
+
+int32_t
+lp_linear_stretch_row_avx2(uint32_t *dst, int width,
+                           const uint32_t *src, int s, int dsdx)
+{
+   return util_avx2_stretch_row_8unorm(dst, width, src, s, dsdx);
+}
+
+
+/* Combine two rows using a constant weight.
+ */
+void
+lp_linear_lerp_rows_avx2(uint32_t *dst, int width,
+                         const uint32_t *src0, const uint32_t *src1, int w)
+{
+   const __m256i wt = _mm256_set1_epi16(w);
+   int i;
+
+   for (i = 0; i + 8 <= width; i += 8) {
+      __m256i srca = _mm256_loadu_si256((const __m256i *)&src0[i]);
+      __m256i srcb = _mm256_loadu_si256((const __m256i *)&src1[i]);
+
+      _mm256_storeu_si256((__m256i *)&dst[i],
+                          util_avx2_lerp_epi8_fixed88(srca, srcb, &wt, &wt));
+   }
+
+   if (i < width) {
+      const __m128i wt4 = _mm256_castsi256_si128(wt);
+      __m128i srca = _mm_load_si128((const __m128i *)&src0[i]);
+      __m128i srcb = _mm_load_si128((const __m128i *)&src1[i]);
+
+      *(__m128i *)&dst[i] = util_sse2_lerp_epi8_fixed88(srca, srcb,
+                                                        &wt4, &wt4);
+   }
+}
+
+
+/* Bilinear filtering of eight pixels, given their four texels and their
+ * 16.16 texture coordinates.
+ */
+static inline __m256i
+lerp_2d_bgra(const __m256i *texels, __m256i s8, __m256i t8)
+{
+   const __m256i mask = _mm256_set1_epi32(0xff);
+   __m256i ws, wt, wsl, wsh, wtl, wth;
+
+   ws = _mm256_and_si256(_mm256_srli_epi32(s8, 8), mask);
+   ws = _mm256_or_si256(ws, _mm256_slli_epi32(ws, 16));
+   wsl = _mm256_shuffle_epi32(ws, _MM_SHUFFLE(1,1,0,0));
+   wsh = _mm256_shuffle_epi32(ws, _MM_SHUFFLE(3,3,2,2));
+
+   wt = _mm256_and_si256(_mm256_srli_epi32(t8, 8), mask);
+   wt = _mm256_or_si256(wt, _mm256_slli_epi32(wt, 16));
+   wtl = _mm256_shuffle_epi32(wt, _MM_SHUFFLE(1,1,0,0));
+   wth = _mm256_shuffle_epi32(wt, _MM_SHUFFLE(3,3,2,2));
+
+   return util_avx2_lerp_2d_epi8_fixed88(texels[0], texels[2],
+                                         &texels[1], &texels[3],
+                                         &wtl, &wth,
+                                         &wsl, &wsh);
+}
+
+
+/* Non-axis-aligned linear fetch, without clamping.
+ */
+const uint32_t *
+lp_linear_fetch_linear_bgra_avx2(struct lp_linear_elem *elem)
+{
+   struct lp_linear_sampler *samp = (struct lp_linear_sampler *)elem;
+   const struct lp_jit_texture *texture = samp->texture;
+   const int stride     = texture->row_stride[0] / sizeof(uint32_t);
+   const int *data      = (const int *)texture->base;
+   const int dsdx  = samp->dsdx;
+   const int dtdx  = samp->dtdx;
+   const int width = align(samp->width, 4);
+   uint32_t *row   = samp->row;
+
+   const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+   const __m256i stride8 = _mm256_set1_epi32(stride);
+   const __m256i one = _mm256_set1_epi32(1);
+   __m256i s8 = _mm256_add_epi32(_mm256_set1_epi32(samp->s),
+                                 _mm256_mullo_epi32(lane,
+                                                    _mm256_set1_epi32(dsdx)));
+   __m256i t8 = _mm256_add_epi32(_mm256_set1_epi32(samp->t),
+                                 _mm256_mullo_epi32(lane,
+                                                    _mm256_set1_epi32(dtdx)));
+   const __m256i dsdx8 = _mm256_set1_epi32(8 * dsdx);
+   const __m256i dtdx8 = _mm256_set1_epi32(8 * dtdx);
+
+   for (int i = 0; i < width; i += 8) {
+      /* Only the texels of the first width pixels are known to be within
+       * the texture, so mask off the loads of the ones past it.
+       */
+      const __m256i valid =
+         _mm256_cmpgt_epi32(_mm256_set1_epi32(width - i), lane);
+      __m256i addr, texels[4];
+
+      addr = _mm256_mullo_epi32(_mm256_srai_epi32(t8, FIXED16_SHIFT),
+                                stride8);
+      addr = _mm256_add_epi32(addr, _mm256_srai_epi32(s8, FIXED16_SHIFT));
+
+      texels[0] = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), data,
+                                              addr, valid, 4);
+      texels[1] = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), data,
+                                              _mm256_add_epi32(addr, one),
+                                              valid, 4);
+      addr = _mm256_add_epi32(addr, stride8);
+      texels[2] = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), data,
+                                              addr, valid, 4);
+      texels[3] = _mm256_mask_i32gather_epi32(_mm256_setzero_si256(), data,
+                                              _mm256_add_epi32(addr, one),
+                                              valid, 4);
+
+      _mm256_storeu_si256((__m256i *)&row[i], lerp_2d_bgra(texels, s8, t8));
+
+      s8 = _mm256_add_epi32(s8, dsdx8);
+      t8 = _mm256_add_epi32(t8, dtdx8);
+   }
+
+   samp->s += samp->dsdy;
+   samp->t += samp->dtdy;
+   return row;
+}
+
+
+/* Clamped, non-axis-aligned linear fetch.
+ */
+const uint32_t *
+lp_linear_fetch_clamp_linear_bgra_avx2(struct lp_linear_elem *elem)
+{
+   struct lp_linear_sampler *samp = (struct lp_linear_sampler *)elem;
+   const struct lp_jit_texture *texture = samp->texture;
+   const int *data      = (const int *)texture->base;
+   const int stride     = texture->row_stride[0] / sizeof(uint32_t);
+   const int dsdx  = samp->dsdx;
+   const int dtdx  = samp->dtdx;
+   const int width = samp->width;
+   uint32_t *row   = samp->row;
+
+   /* width, height, stride (in pixels) must be smaller than 32768 */
+   const __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+   const __m256i stride8 = _mm256_set1_epi32(stride);
+   const __m256i w8 = _mm256_set1_epi32(texture->width - 1);
+   const __m256i h8 = _mm256_set1_epi32(texture->height - 1);
+   const __m256i zero = _mm256_setzero_si256();
+   const __m256i one = _mm256_set1_epi32(1);
+   __m256i s8 = _mm256_add_epi32(_mm256_set1_epi32(samp->s),
+                                 _mm256_mullo_epi32(lane,
+                                                    _mm256_set1_epi32(dsdx)));
+   __m256i t8 = _mm256_add_epi32(_mm256_set1_epi32(samp->t),
+                                 _mm256_mullo_epi32(lane,
+                                                    _mm256_set1_epi32(dtdx)));
+   const __m256i dsdx8 = _mm256_set1_epi32(8 * dsdx);
+   const __m256i dtdx8 = _mm256_set1_epi32(8 * dtdx);
+
+   /* All addresses are clamped, so it is fine to fetch up to eight pixels
+    * past the row width (row[] has room for them).
+    */
+   for (int i = 0; i < width; i += 8) {
+      __m256i s8s, t8s, cs0, cs1, ct0, ct1, tmp, texels[4];
+
+      s8s = _mm256_srli_epi32(s8, FIXED16_SHIFT);
+      t8s = _mm256_srli_epi32(t8, FIXED16_SHIFT);
+      cs0 = _mm256_min_epi16(_mm256_max_epi16(s8s, zero), w8);
+      cs1 = _mm256_add_epi16(s8s, one);
+      cs1 = _mm256_min_epi16(_mm256_max_epi16(cs1, zero), w8);
+      ct0 = _mm256_min_epi16(_mm256_max_epi16(t8s, zero), h8);
+      ct1 = _mm256_add_epi16(t8s, one);
+      ct1 = _mm256_min_epi16(_mm256_max_epi16(ct1, zero), h8);
+
+      tmp = _mm256_madd_epi16(ct0, stride8);
+      texels[0] = _mm256_i32gather_epi32(data, _mm256_add_epi32(tmp, cs0), 4);
+      texels[1] = _mm256_i32gather_epi32(data, _mm256_add_epi32(tmp, cs1), 4);
+      tmp = _mm256_madd_epi16(ct1, stride8);
+      texels[2] = _mm256_i32gather_epi32(data, _mm256_add_epi32(tmp, cs0), 4);
+      texels[3] = _mm256_i32gather_epi32(data, _mm256_add_epi32(tmp, cs1), 4);
+
+      _mm256_storeu_si256((__m256i *)&row[i], lerp_2d_bgra(texels, s8, t8));
+
+      s8 = _mm256_add_epi32(s8, dsdx8);
+      t8 = _mm256_add_epi32(t8, dtdx8);
+   }
+
+   samp->s += samp->dsdy;
+   samp->t += samp->dtdy;
+
+   return row;
+}
+
+#endif /* __AVX2__ */
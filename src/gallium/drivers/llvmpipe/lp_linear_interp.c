@@ -212,6 +212,12 @@ lp_linear_init_interp(struct lp_linear_interp *interp,
    interp->dady  = _mm_setr_epi16(dsdy_fp[2], dsdy_fp[1], dsdy_fp[0], dsdy_fp[3],
                                   dsdy_fp[2], dsdy_fp[1], dsdy_fp[0], dsdy_fp[3]);
 
+   interp->base.fetch = interp_0_8;
+#ifdef HAVE_LP_LINEAR_AVX2
+   if (util_get_cpu_caps()->has_avx2)
+      interp->base.fetch = lp_linear_interp_0_8_avx2;
+#endif
+
    /* If the value is y-invariant, eagerly calculate it here and then
     * always return the precalculated value.
     */
@@ -219,10 +225,8 @@ lp_linear_init_interp(struct lp_linear_interp *interp,
        dsdy[1] == 0 &&
        dsdy[2] == 0 &&
        dsdy[3] == 0) {
-      interp_0_8(&interp->base);
+      interp->base.fetch(&interp->base);
       interp->base.fetch = interp_noop;
-   } else {
-      interp->base.fetch = interp_0_8;
    }
 
    return true;
@@ -162,6 +162,29 @@ void
 lp_linear_init_noop_sampler(struct lp_linear_sampler *samp);
 
 
+#ifdef HAVE_LP_LINEAR_AVX2
+/* AVX2 kernels, see lp_linear_avx2.c.  Only to be used when
+ * util_get_cpu_caps()->has_avx2 is set.
+ */
+const uint32_t *
+lp_linear_interp_0_8_avx2(struct lp_linear_elem *elem);
+
+const uint32_t *
+lp_linear_fetch_linear_bgra_avx2(struct lp_linear_elem *elem);
+
+const uint32_t *
+lp_linear_fetch_clamp_linear_bgra_avx2(struct lp_linear_elem *elem);
+
+int32_t
+lp_linear_stretch_row_avx2(uint32_t *dst, int width,
+                           const uint32_t *src, int s, int dsdx);
+
+void
+lp_linear_lerp_rows_avx2(uint32_t *dst, int width,
+                         const uint32_t *src0, const uint32_t *src1, int w);
+#endif
+
+
 #define FAIL(s) do {                                    \
       if (LP_DEBUG & DEBUG_LINEAR)                      \
          debug_printf("%s: %s\n", __func__, s);         \
@@ -235,6 +235,12 @@ fetch_and_stretch_bgra_row(struct lp_linear_sampler *samp,
          *(__m128i *)&dst_row[i] = src;
       }
    } else {
+#ifdef HAVE_LP_LINEAR_AVX2
+      if (util_get_cpu_caps()->has_avx2)
+         lp_linear_stretch_row_avx2(dst_row, align(width, 4),
+                                    src_row, samp->s, samp->dsdx);
+      else
+#endif
       util_sse2_stretch_row_8unorm((__m128i *)dst_row,
                                    align(width, 4),
                                    src_row, samp->s, samp->dsdx);
@@ -270,6 +276,13 @@ fetch_axis_aligned_linear_bgra(struct lp_linear_elem *elem)
 
    const uint32_t * restrict src_row1 = fetch_and_stretch_bgra_row(samp, y + 1);
 
+#ifdef HAVE_LP_LINEAR_AVX2
+   if (util_get_cpu_caps()->has_avx2) {
+      lp_linear_lerp_rows_avx2(row, align(width, 4), src_row0, src_row1, w);
+      return row;
+   }
+#endif
+
    __m128i wt = _mm_set1_epi16(w);
 
    /* Combine the two rows using a constant weight.
@@ -302,6 +315,11 @@ fetch_linear_bgra(struct lp_linear_elem *elem)
    int s = samp->s;
    int t = samp->t;
 
+#ifdef HAVE_LP_LINEAR_AVX2
+   if (util_get_cpu_caps()->has_avx2)
+      return lp_linear_fetch_linear_bgra_avx2(elem);
+#endif
+
    for (int i = 0; i < width; i += 4) {
       union m128i si0, si1, si2, si3, ws, wt;
       __m128i si02, si13;
@@ -358,6 +376,11 @@ fetch_clamp_linear_bgra(struct lp_linear_elem *elem)
    int s = samp->s;
    int t = samp->t;
 
+#ifdef HAVE_LP_LINEAR_AVX2
+   if (util_get_cpu_caps()->has_avx2)
+      return lp_linear_fetch_clamp_linear_bgra_avx2(elem);
+#endif
+
    /* width, height, stride (in pixels) must be smaller than 32768 */
    __m128i dsdx4, dtdx4, s4, t4, stride4, w4, h4, zero, one;
    s4 = _mm_set1_epi32(s);
@@ -0,0 +1,901 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * CPU implementation of the pipe_ml_subgraph interface used by Teflon.
+ *
+ * Tensors are 8-bit quantized NHWC, with a batch size of one, and live in
+ * plain host memory owned by the subgraph.  The operations are run in order
+ * on the compute thread pool, each split into rows of its output tensor.
+ * The arithmetic follows the TensorFlow Lite reference kernels, including
+ * their fixed-point requantization, so results match TFLite's.
+ *
+ * Convolutions gather the input patch of a few output pixels into a buffer
+ * of 16-bit values with the zero point subtracted, and take its dot product
+ * with blocks of four output channels' weights, which are repacked the same
+ * way when the subgraph is created.  A block of weights is then reused by
+ * every pixel of the tile while it is in cache.  Depthwise convolutions
+ * accumulate eight channels at a time instead.
+ */
+
+#include <math.h>
+
+#include "pipe/p_state.h"
+#include "util/detect.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "util/u_sse.h"
+
+#include "lp_context.h"
+#include "lp_cs_tpool.h"
+#include "lp_ml.h"
+#include "lp_screen.h"
+
+/* Output pixels whose patches are multiplied by each block of weights. */
+#define LP_ML_TILE_PIXELS 8
+
+/* Output channels handed to one iteration of a convolution task. */
+#define LP_ML_CHANNEL_CHUNK 64
+
+/* Elements handed to one iteration of an elementwise task. */
+#define LP_ML_ELEMENT_CHUNK 4096
+
+/* The vector loops read up to this much past the end of a tensor. */
+#define LP_ML_TENSOR_PADDING 16
+
+struct lp_ml_shape {
+   unsigned height;
+   unsigned width;
+   unsigned channels;
+};
+
+struct lp_ml_tensor {
+   uint8_t *data;
+   unsigned size;
+};
+
+struct lp_ml_operation {
+   enum pipe_ml_operation_type type;
+
+   unsigned input_tensor;
+   unsigned input2_tensor;
+   unsigned output_tensor;
+
+   const uint8_t *input;
+   const uint8_t *input2;
+   uint8_t *output;
+
+   struct lp_ml_shape in;
+   struct lp_ml_shape out;
+
+   bool input_signed;
+   bool output_signed;
+   int input_zero_point;
+   int input2_zero_point;
+   int output_zero_point;
+
+   /* Convolutions and pooling */
+   unsigned kernel_width;
+   unsigned kernel_height;
+   unsigned stride_x;
+   unsigned stride_y;
+   unsigned pad_left;
+   unsigned pad_top;
+
+   /* Convolutions */
+   bool depthwise;
+   unsigned depth_multiplier;
+   unsigned patch_size;        /**< kernel_width * kernel_height * in.channels */
+   unsigned patch_stride;      /**< patch_size padded to 8 elements */
+   unsigned channel_stride;    /**< depthwise: out.channels padded to 8 */
+   int16_t *weights;           /**< zero point subtracted, see pack_weights() */
+   int32_t *biases;            /**< padded like the weights */
+   int32_t multiplier;
+   int shift;
+
+   /* Additions */
+   int32_t input_multiplier;
+   int input_shift;
+   int32_t input2_multiplier;
+   int input2_shift;
+};
+
+struct lp_ml_subgraph {
+   struct pipe_ml_subgraph base;
+
+   struct lp_ml_operation *operations;
+   unsigned operation_count;
+
+   /* Indexed by tensor index */
+   struct lp_ml_tensor *tensors;
+   unsigned tensor_count;
+};
+
+
+/*
+ * Fixed-point requantization, as done by TensorFlow Lite (and gemmlowp).
+ */
+
+static void
+quantize_multiplier(double real, int32_t *multiplier, int *shift)
+{
+   if (real == 0.0) {
+      *multiplier = 0;
+      *shift = 0;
+      return;
+   }
+
+   int64_t q = llround(frexp(real, shift) * (double)(1ll << 31));
+   if (q == (1ll << 31)) {
+      q /= 2;
+      (*shift)++;
+   }
+   if (*shift < -31) {
+      *shift = 0;
+      q = 0;
+   }
+   *multiplier = q;
+}
+
+static inline int32_t
+saturating_rounding_doubling_high_mul(int32_t a, int32_t b)
+{
+   if (a == INT32_MIN && b == INT32_MIN)
+      return INT32_MAX;
+
+   int64_t ab = (int64_t)a * b;
+   int32_t nudge = ab >= 0 ? (1 << 30) : (1 - (1 << 30));
+   return (int32_t)((ab + nudge) / (1ll << 31));
+}
+
+static inline int32_t
+rounding_divide_by_pot(int32_t x, int exponent)
+{
+   const int32_t mask = (int32_t)((1ll << exponent) - 1);
+   const int32_t remainder = x & mask;
+   const int32_t threshold = (mask >> 1) + (x < 0);
+   return (x >> exponent) + (remainder > threshold);
+}
+
+static inline int32_t
+multiply_by_quantized_multiplier(int32_t x, int32_t multiplier, int shift)
+{
+   const int left_shift = shift > 0 ? shift : 0;
+   const int right_shift = shift > 0 ? 0 : -shift;
+
+   return rounding_divide_by_pot(
+      saturating_rounding_doubling_high_mul(x * (1 << left_shift), multiplier),
+      right_shift);
+}
+
+static inline uint8_t
+clamp_output(int32_t value, bool is_signed)
+{
+   if (is_signed)
+      return (uint8_t)(int8_t)CLAMP(value, INT8_MIN, INT8_MAX);
+   else
+      return (uint8_t)CLAMP(value, 0, UINT8_MAX);
+}
+
+static inline int
+load_value(const uint8_t *data, bool is_signed)
+{
+   return is_signed ? (int8_t)*data : *data;
+}
+
+static inline uint8_t
+requantize(const struct lp_ml_operation *op, int32_t acc)
+{
+   acc = multiply_by_quantized_multiplier(acc, op->multiplier, op->shift);
+   return clamp_output(acc + op->output_zero_point, op->output_signed);
+}
+
+
+/*
+ * SIMD building blocks, with scalar fallbacks.
+ */
+
+#if DETECT_ARCH_SSE
+
+/* Load 8 values and subtract their zero point, as 16-bit integers. */
+static inline __m128i
+load8_i16(const uint8_t *src, bool is_signed, __m128i zero_point)
+{
+   __m128i v = _mm_loadl_epi64((const __m128i *)src);
+
+   if (is_signed)
+      v = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+   else
+      v = _mm_unpacklo_epi8(v, _mm_setzero_si128());
+
+   return _mm_sub_epi16(v, zero_point);
+}
+
+#endif
+
+/**
+ * Store count input values minus their zero point to dst.  Up to 7 values
+ * past count may be written too.
+ */
+static inline void
+convert_to_i16(int16_t *dst, const uint8_t *src, unsigned count,
+               bool is_signed, int zero_point)
+{
+#if DETECT_ARCH_SSE
+   const __m128i zp = _mm_set1_epi16(zero_point);
+
+   for (unsigned i = 0; i < count; i += 8)
+      _mm_storeu_si128((__m128i *)&dst[i], load8_i16(&src[i], is_signed, zp));
+#else
+   for (unsigned i = 0; i < count; i++)
+      dst[i] = load_value(&src[i], is_signed) - zero_point;
+#endif
+}
+
+/**
+ * Dot products of x with the four rows of w starting at w, stride elements
+ * apart.  count is a multiple of 8 and w is 16-byte aligned.
+ */
+static inline void
+dot4_i16(const int16_t *x, const int16_t *w, unsigned stride, unsigned count,
+         int32_t acc[4])
+{
+#if DETECT_ARCH_SSE
+   __m128i a0 = _mm_setzero_si128();
+   __m128i a1 = _mm_setzero_si128();
+   __m128i a2 = _mm_setzero_si128();
+   __m128i a3 = _mm_setzero_si128();
+
+   for (unsigned i = 0; i < count; i += 8) {
+      const __m128i v = _mm_loadu_si128((const __m128i *)&x[i]);
+
+      a0 = _mm_add_epi32(a0, _mm_madd_epi16(v, _mm_load_si128((const __m128i *)&w[i])));
+      a1 = _mm_add_epi32(a1, _mm_madd_epi16(v, _mm_load_si128((const __m128i *)&w[stride + i])));
+      a2 = _mm_add_epi32(a2, _mm_madd_epi16(v, _mm_load_si128((const __m128i *)&w[2 * stride + i])));
+      a3 = _mm_add_epi32(a3, _mm_madd_epi16(v, _mm_load_si128((const __m128i *)&w[3 * stride + i])));
+   }
+
+   /* Sum the lanes of each accumulator into one lane of the result. */
+   __m128i s01 = _mm_add_epi32(_mm_unpacklo_epi32(a0, a1),
+                               _mm_unpackhi_epi32(a0, a1));
+   __m128i s23 = _mm_add_epi32(_mm_unpacklo_epi32(a2, a3),
+                               _mm_unpackhi_epi32(a2, a3));
+   _mm_storeu_si128((__m128i *)acc,
+                    _mm_add_epi32(_mm_unpacklo_epi64(s01, s23),
+                                  _mm_unpackhi_epi64(s01, s23)));
+#else
+   for (unsigned j = 0; j < 4; j++) {
+      int32_t sum = 0;
+      for (unsigned i = 0; i < count; i++)
+         sum += x[i] * w[j * stride + i];
+      acc[j] = sum;
+   }
+#endif
+}
+
+/**
+ * acc[c] += (x[c] - zero_point) * w[c] for count channels, a multiple of 8.
+ * Reads up to 7 values past the end of x.
+ */
+static inline void
+madd_channels(int32_t *acc, const uint8_t *x, const int16_t *w,
+              unsigned count, bool is_signed, int zero_point)
+{
+#if DETECT_ARCH_SSE
+   const __m128i zp = _mm_set1_epi16(zero_point);
+
+   for (unsigned c = 0; c < count; c += 8) {
+      const __m128i v = load8_i16(&x[c], is_signed, zp);
+      const __m128i k = _mm_load_si128((const __m128i *)&w[c]);
+      const __m128i lo = _mm_mullo_epi16(v, k);
+      const __m128i hi = _mm_mulhi_epi16(v, k);
+      __m128i *a = (__m128i *)&acc[c];
+
+      _mm_storeu_si128(&a[0], _mm_add_epi32(_mm_loadu_si128(&a[0]),
+                                            _mm_unpacklo_epi16(lo, hi)));
+      _mm_storeu_si128(&a[1], _mm_add_epi32(_mm_loadu_si128(&a[1]),
+                                            _mm_unpackhi_epi16(lo, hi)));
+   }
+#else
+   for (unsigned c = 0; c < count; c++)
+      acc[c] += (load_value(&x[c], is_signed) - zero_point) * w[c];
+#endif
+}
+
+
+static void *
+scratch(struct lp_cs_local_mem *lmem, unsigned size)
+{
+   if (lmem->local_size < size) {
+      lmem->local_mem_ptr = REALLOC(lmem->local_mem_ptr, lmem->local_size,
+                                    size);
+      lmem->local_size = size;
+   }
+   return lmem->local_mem_ptr;
+}
+
+
+/*
+ * Kernels, run once per iteration of a compute pool task.
+ */
+
+/**
+ * Gather the patches of count output pixels starting at (ox, oy), one
+ * every patch_stride elements, with padding reading as the zero point.
+ */
+static void
+gather_patches(const struct lp_ml_operation *op, int16_t *patches,
+               unsigned ox, unsigned oy, unsigned count)
+{
+   const unsigned channels = op->in.channels;
+
+   for (unsigned p = 0; p < count; p++) {
+      int16_t *patch = &patches[p * op->patch_stride];
+      const int x0 = (int)((ox + p) * op->stride_x) - (int)op->pad_left;
+      const int y0 = (int)(oy * op->stride_y) - (int)op->pad_top;
+
+      for (unsigned ky = 0; ky < op->kernel_height; ky++) {
+         const int iy = y0 + ky;
+
+         for (unsigned kx = 0; kx < op->kernel_width; kx++) {
+            const int ix = x0 + kx;
+
+            if (iy < 0 || iy >= (int)op->in.height ||
+                ix < 0 || ix >= (int)op->in.width) {
+               memset(patch, 0, channels * sizeof(*patch));
+            } else {
+               const uint8_t *src =
+                  &op->input[((unsigned)iy * op->in.width + ix) * channels];
+               convert_to_i16(patch, src, channels, op->input_signed,
+                              op->input_zero_point);
+            }
+            patch += channels;
+         }
+      }
+
+      /* The vector loads may have overrun into the padding. */
+      memset(patch, 0, (op->patch_stride - op->patch_size) * sizeof(*patch));
+   }
+}
+
+static void
+convolution_task(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   const struct lp_ml_operation *op = data;
+   const unsigned chunks = DIV_ROUND_UP(op->out.channels, LP_ML_CHANNEL_CHUNK);
+   const unsigned oy = iter_idx / chunks;
+   const unsigned oc_start = (iter_idx % chunks) * LP_ML_CHANNEL_CHUNK;
+   const unsigned oc_end = MIN2(oc_start + LP_ML_CHANNEL_CHUNK,
+                                op->out.channels);
+
+   /* Room for the vector loads to overrun the last patch. */
+   int16_t *patches =
+      scratch(lmem, (LP_ML_TILE_PIXELS * op->patch_stride + 8) *
+                    sizeof(int16_t));
+
+   for (unsigned ox = 0; ox < op->out.width; ox += LP_ML_TILE_PIXELS) {
+      const unsigned count = MIN2(LP_ML_TILE_PIXELS, op->out.width - ox);
+      uint8_t *out = &op->output[(oy * op->out.width + ox) * op->out.channels];
+
+      gather_patches(op, patches, ox, oy, count);
+
+      for (unsigned oc = oc_start; oc < oc_end; oc += 4) {
+         const int16_t *w = &op->weights[oc * op->patch_stride];
+         const unsigned n = MIN2(4, oc_end - oc);
+
+         for (unsigned p = 0; p < count; p++) {
+            int32_t acc[4];
+
+            dot4_i16(&patches[p * op->patch_stride], w, op->patch_stride,
+                     op->patch_stride, acc);
+
+            for (unsigned j = 0; j < n; j++)
+               out[p * op->out.channels + oc + j] =
+                  requantize(op, acc[j] + op->biases[oc + j]);
+         }
+      }
+   }
+}
+
+static void
+depthwise_convolution_task(void *data, int iter_idx,
+                           struct lp_cs_local_mem *lmem)
+{
+   const struct lp_ml_operation *op = data;
+   const unsigned oy = iter_idx;
+   const unsigned channels = op->out.channels;
+   int32_t *acc = scratch(lmem, op->channel_stride * sizeof(int32_t));
+
+   for (unsigned ox = 0; ox < op->out.width; ox++) {
+      const int x0 = (int)(ox * op->stride_x) - (int)op->pad_left;
+      const int y0 = (int)(oy * op->stride_y) - (int)op->pad_top;
+
+      memcpy(acc, op->biases, op->channel_stride * sizeof(int32_t));
+
+      for (unsigned ky = 0; ky < op->kernel_height; ky++) {
+         const int iy = y0 + ky;
+         if (iy < 0 || iy >= (int)op->in.height)
+            continue;
+
+         for (unsigned kx = 0; kx < op->kernel_width; kx++) {
+            const int ix = x0 + kx;
+            if (ix < 0 || ix >= (int)op->in.width)
+               continue;
+
+            const uint8_t *x =
+               &op->input[((unsigned)iy * op->in.width + ix) * op->in.channels];
+            const int16_t *w =
+               &op->weights[(ky * op->kernel_width + kx) * op->channel_stride];
+
+            if (op->depth_multiplier == 1) {
+               madd_channels(acc, x, w, op->channel_stride,
+                             op->input_signed, op->input_zero_point);
+            } else {
+               for (unsigned c = 0; c < channels; c++) {
+                  const unsigned ic = c / op->depth_multiplier;
+                  acc[c] += (load_value(&x[ic], op->input_signed) -
+                             op->input_zero_point) * w[c];
+               }
+            }
+         }
+      }
+
+      uint8_t *out = &op->output[(oy * op->out.width + ox) * channels];
+      for (unsigned c = 0; c < channels; c++)
+         out[c] = requantize(op, acc[c]);
+   }
+}
+
+static void
+add_task(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   const struct lp_ml_operation *op = data;
+   const unsigned size = op->out.height * op->out.width * op->out.channels;
+   const unsigned start = iter_idx * LP_ML_ELEMENT_CHUNK;
+   const unsigned end = MIN2(start + LP_ML_ELEMENT_CHUNK, size);
+   const int left_shift = 20;
+
+   for (unsigned i = start; i < end; i++) {
+      const int32_t a = (load_value(&op->input[i], op->input_signed) -
+                         op->input_zero_point) * (1 << left_shift);
+      const int32_t b = (load_value(&op->input2[i], op->input_signed) -
+                         op->input2_zero_point) * (1 << left_shift);
+      const int32_t sum =
+         multiply_by_quantized_multiplier(a, op->input_multiplier,
+                                          op->input_shift) +
+         multiply_by_quantized_multiplier(b, op->input2_multiplier,
+                                          op->input2_shift);
+
+      op->output[i] = requantize(op, sum);
+   }
+}
+
+static void
+average_pool_task(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   const struct lp_ml_operation *op = data;
+   const unsigned oy = iter_idx;
+   const unsigned channels = op->out.channels;
+   int32_t *acc = scratch(lmem, channels * sizeof(int32_t));
+
+   for (unsigned ox = 0; ox < op->out.width; ox++) {
+      const int x0 = (int)(ox * op->stride_x) - (int)op->pad_left;
+      const int y0 = (int)(oy * op->stride_y) - (int)op->pad_top;
+      int count = 0;
+
+      memset(acc, 0, channels * sizeof(int32_t));
+
+      for (unsigned ky = 0; ky < op->kernel_height; ky++) {
+         const int iy = y0 + ky;
+         if (iy < 0 || iy >= (int)op->in.height)
+            continue;
+
+         for (unsigned kx = 0; kx < op->kernel_width; kx++) {
+            const int ix = x0 + kx;
+            if (ix < 0 || ix >= (int)op->in.width)
+               continue;
+
+            const uint8_t *x =
+               &op->input[((unsigned)iy * op->in.width + ix) * channels];
+            for (unsigned c = 0; c < channels; c++)
+               acc[c] += load_value(&x[c], op->input_signed);
+            count++;
+         }
+      }
+
+      uint8_t *out = &op->output[(oy * op->out.width + ox) * channels];
+      for (unsigned c = 0; c < channels; c++) {
+         int32_t avg = 0;
+         if (count)
+            avg = (acc[c] + (acc[c] > 0 ? count / 2 : -count / 2)) / count;
+         out[c] = clamp_output(avg, op->output_signed);
+      }
+   }
+}
+
+
+/*
+ * Subgraph creation
+ */
+
+static void
+tensor_shape(const struct pipe_tensor *tensor, struct lp_ml_shape *shape)
+{
+   /* NHWC, with a batch of one */
+   assert(tensor->dims[0] <= 1);
+   shape->height = MAX2(tensor->dims[1], 1);
+   shape->width = MAX2(tensor->dims[2], 1);
+   shape->channels = MAX2(tensor->dims[3], 1);
+}
+
+static unsigned
+tensor_size(const struct pipe_tensor *tensor)
+{
+   unsigned size = 1;
+   for (unsigned i = 0; i < ARRAY_SIZE(tensor->dims); i++)
+      size *= MAX2(tensor->dims[i], 1);
+   return size;
+}
+
+static const void *
+map_tensor(struct pipe_context *pipe, const struct pipe_tensor *tensor,
+           struct pipe_transfer **transfer)
+{
+   if (!tensor->resource)
+      return NULL;
+
+   return pipe_buffer_map(pipe, tensor->resource, PIPE_MAP_READ, transfer);
+}
+
+/** Allocate the backing of a tensor, initialized with its data if any. */
+static bool
+create_tensor(struct lp_ml_subgraph *subgraph, const struct pipe_tensor *tensor)
+{
+   struct lp_ml_tensor *t = &subgraph->tensors[tensor->index];
+   struct pipe_context *pipe = subgraph->base.context;
+
+   if (t->data)
+      return true;
+
+   t->size = tensor_size(tensor);
+   t->data = align_malloc(t->size + LP_ML_TENSOR_PADDING, 64);
+   if (!t->data)
+      return false;
+
+   memset(t->data, 0, t->size + LP_ML_TENSOR_PADDING);
+
+   struct pipe_transfer *transfer;
+   const void *data = map_tensor(pipe, tensor, &transfer);
+   if (data) {
+      memcpy(t->data, data, MIN2(t->size, tensor->resource->width0));
+      pipe_buffer_unmap(pipe, transfer);
+   }
+
+   return true;
+}
+
+static void
+compute_padding(struct lp_ml_operation *op, bool padding_same)
+{
+   if (!padding_same) {
+      op->pad_left = 0;
+      op->pad_top = 0;
+      return;
+   }
+
+   const int pad_x = (int)((op->out.width - 1) * op->stride_x +
+                           op->kernel_width) - (int)op->in.width;
+   const int pad_y = (int)((op->out.height - 1) * op->stride_y +
+                           op->kernel_height) - (int)op->in.height;
+
+   op->pad_left = MAX2(pad_x, 0) / 2;
+   op->pad_top = MAX2(pad_y, 0) / 2;
+}
+
+/**
+ * Repack the weights and biases of a convolution: weights are stored as
+ * 16-bit values with their zero point subtracted, in rows of patch_stride
+ * elements per output channel, padded to blocks of four channels, or for
+ * depthwise convolutions in rows of channel_stride channels per kernel
+ * element.
+ */
+static bool
+pack_weights(struct pipe_context *pipe, struct lp_ml_operation *op,
+             const struct pipe_ml_operation *poperation)
+{
+   const struct pipe_tensor *weight_tensor = poperation->conv.weight_tensor;
+   const struct pipe_tensor *bias_tensor = poperation->conv.bias_tensor;
+   const bool weight_signed = weight_tensor->is_signed;
+   const int weight_zero_point = weight_tensor->zero_point;
+   const unsigned channels = op->out.channels;
+   unsigned weight_count, bias_count;
+
+   if (op->depthwise) {
+      op->channel_stride = align(channels, 8);
+      weight_count = op->kernel_width * op->kernel_height * op->channel_stride;
+      bias_count = op->channel_stride;
+   } else {
+      op->patch_size = op->kernel_width * op->kernel_height * op->in.channels;
+      op->patch_stride = align(op->patch_size, 8);
+      weight_count = align(channels, 4) * op->patch_stride;
+      bias_count = channels;
+   }
+
+   op->weights = align_malloc(weight_count * sizeof(*op->weights), 64);
+   op->biases = CALLOC(bias_count, sizeof(*op->biases));
+   if (!op->weights || !op->biases)
+      return false;
+
+   memset(op->weights, 0, weight_count * sizeof(*op->weights));
+
+   struct pipe_transfer *transfer;
+   const uint8_t *weights = map_tensor(pipe, weight_tensor, &transfer);
+   if (!weights)
+      return false;
+
+   if (op->depthwise) {
+      /* [1][kernel_height][kernel_width][channels] */
+      for (unsigned k = 0; k < op->kernel_width * op->kernel_height; k++) {
+         for (unsigned c = 0; c < channels; c++) {
+            op->weights[k * op->channel_stride + c] =
+               load_value(&weights[k * channels + c], weight_signed) -
+               weight_zero_point;
+         }
+      }
+   } else {
+      /* [channels][kernel_height][kernel_width][input channels], which is
+       * the order the patches are gathered in.
+       */
+      for (unsigned oc = 0; oc < channels; oc++) {
+         for (unsigned i = 0; i < op->patch_size; i++) {
+            op->weights[oc * op->patch_stride + i] =
+               load_value(&weights[oc * op->patch_size + i], weight_signed) -
+               weight_zero_point;
+         }
+      }
+   }
+   pipe_buffer_unmap(pipe, transfer);
+
+   const int32_t *biases = map_tensor(pipe, bias_tensor, &transfer);
+   if (biases) {
+      memcpy(op->biases, biases,
+             MIN2(channels * sizeof(*biases), bias_tensor->resource->width0));
+      pipe_buffer_unmap(pipe, transfer);
+   }
+
+   return true;
+}
+
+static bool
+lower_operation(struct lp_ml_subgraph *subgraph, struct lp_ml_operation *op,
+                const struct pipe_ml_operation *poperation)
+{
+   struct pipe_context *pipe = subgraph->base.context;
+   const struct pipe_tensor *input = poperation->input_tensor;
+   const struct pipe_tensor *output = poperation->output_tensor;
+
+   op->type = poperation->type;
+   op->input_tensor = input->index;
+   op->output_tensor = output->index;
+   tensor_shape(input, &op->in);
+   tensor_shape(output, &op->out);
+   op->input_signed = input->is_signed;
+   op->output_signed = output->is_signed;
+   op->input_zero_point = input->zero_point;
+   op->output_zero_point = output->zero_point;
+
+   if (!create_tensor(subgraph, input) || !create_tensor(subgraph, output))
+      return false;
+
+   switch (poperation->type) {
+   case PIPE_ML_OPERATION_TYPE_CONVOLUTION: {
+      const struct pipe_tensor *weights = poperation->conv.weight_tensor;
+
+      op->depthwise = poperation->conv.depthwise;
+      op->depth_multiplier = op->depthwise ?
+         MAX2(op->out.channels / op->in.channels, 1) : 1;
+      op->kernel_height = weights->dims[1];
+      op->kernel_width = weights->dims[2];
+      op->stride_x = poperation->conv.stride_x;
+      op->stride_y = poperation->conv.stride_y;
+      compute_padding(op, poperation->conv.padding_same);
+
+      quantize_multiplier((double)input->scale * weights->scale / output->scale,
+                          &op->multiplier, &op->shift);
+
+      return pack_weights(pipe, op, poperation);
+   }
+   case PIPE_ML_OPERATION_TYPE_ADD: {
+      const struct pipe_tensor *input2 = poperation->add.input_tensor;
+      const double twice_max_scale = 2.0 * MAX2(input->scale, input2->scale);
+
+      if (!create_tensor(subgraph, input2))
+         return false;
+
+      assert(tensor_size(input2) == tensor_size(input));
+      op->input2_tensor = input2->index;
+      op->input2_zero_point = input2->zero_point;
+
+      quantize_multiplier(input->scale / twice_max_scale,
+                          &op->input_multiplier, &op->input_shift);
+      quantize_multiplier(input2->scale / twice_max_scale,
+                          &op->input2_multiplier, &op->input2_shift);
+      quantize_multiplier(twice_max_scale / ((1 << 20) * (double)output->scale),
+                          &op->multiplier, &op->shift);
+      return true;
+   }
+   case PIPE_ML_OPERATION_TYPE_POOLING:
+      op->kernel_width = poperation->pooling.filter_width;
+      op->kernel_height = poperation->pooling.filter_height;
+      op->stride_x = MAX2(poperation->pooling.stride_x, 1);
+      op->stride_y = MAX2(poperation->pooling.stride_y, 1);
+      compute_padding(op, poperation->pooling.padding_same);
+      return true;
+   default:
+      unreachable("Unsupported ML operation type");
+   }
+}
+
+static void
+llvmpipe_ml_subgraph_destroy(struct pipe_context *pipe,
+                             struct pipe_ml_subgraph *psubgraph)
+{
+   struct lp_ml_subgraph *subgraph = (struct lp_ml_subgraph *)psubgraph;
+
+   for (unsigned i = 0; i < subgraph->operation_count; i++) {
+      align_free(subgraph->operations[i].weights);
+      FREE(subgraph->operations[i].biases);
+   }
+   FREE(subgraph->operations);
+
+   for (unsigned i = 0; i < subgraph->tensor_count; i++)
+      align_free(subgraph->tensors[i].data);
+   FREE(subgraph->tensors);
+
+   FREE(subgraph);
+}
+
+static unsigned
+count_tensors(const struct pipe_ml_operation *poperations, unsigned count)
+{
+   unsigned tensor_count = 0;
+
+   for (unsigned i = 0; i < count; i++) {
+      const struct pipe_ml_operation *poperation = &poperations[i];
+
+      tensor_count = MAX2(tensor_count, poperation->input_tensor->index);
+      tensor_count = MAX2(tensor_count, poperation->output_tensor->index);
+      if (poperation->type == PIPE_ML_OPERATION_TYPE_ADD)
+         tensor_count = MAX2(tensor_count, poperation->add.input_tensor->index);
+   }
+
+   return tensor_count + 1;
+}
+
+static struct pipe_ml_subgraph *
+llvmpipe_ml_subgraph_create(struct pipe_context *pipe,
+                            const struct pipe_ml_operation *poperations,
+                            unsigned count)
+{
+   struct lp_ml_subgraph *subgraph = CALLOC_STRUCT(lp_ml_subgraph);
+   if (!subgraph)
+      return NULL;
+
+   subgraph->base.context = pipe;
+   subgraph->tensor_count = count_tensors(poperations, count);
+   subgraph->tensors = CALLOC(subgraph->tensor_count, sizeof(*subgraph->tensors));
+   subgraph->operations = CALLOC(count, sizeof(*subgraph->operations));
+   subgraph->operation_count = count;
+   if (!subgraph->tensors || !subgraph->operations)
+      goto fail;
+
+   for (unsigned i = 0; i < count; i++) {
+      if (!lower_operation(subgraph, &subgraph->operations[i], &poperations[i]))
+         goto fail;
+   }
+
+   /* The tensors don't move from now on. */
+   for (unsigned i = 0; i < count; i++) {
+      struct lp_ml_operation *op = &subgraph->operations[i];
+
+      op->input = subgraph->tensors[op->input_tensor].data;
+      op->output = subgraph->tensors[op->output_tensor].data;
+      if (op->type == PIPE_ML_OPERATION_TYPE_ADD)
+         op->input2 = subgraph->tensors[op->input2_tensor].data;
+   }
+
+   return &subgraph->base;
+
+fail:
+   llvmpipe_ml_subgraph_destroy(pipe, &subgraph->base);
+   return NULL;
+}
+
+
+/*
+ * Execution
+ */
+
+static void
+run_operation(struct llvmpipe_screen *screen, struct lp_ml_operation *op)
+{
+   lp_cs_tpool_task_func func;
+   unsigned iterations;
+
+   switch (op->type) {
+   case PIPE_ML_OPERATION_TYPE_CONVOLUTION:
+      if (op->depthwise) {
+         func = depthwise_convolution_task;
+         iterations = op->out.height;
+      } else {
+         func = convolution_task;
+         iterations = op->out.height *
+                      DIV_ROUND_UP(op->out.channels, LP_ML_CHANNEL_CHUNK);
+      }
+      break;
+   case PIPE_ML_OPERATION_TYPE_ADD:
+      func = add_task;
+      iterations = DIV_ROUND_UP(op->out.height * op->out.width *
+                                op->out.channels, LP_ML_ELEMENT_CHUNK);
+      break;
+   case PIPE_ML_OPERATION_TYPE_POOLING:
+      func = average_pool_task;
+      iterations = op->out.height;
+      break;
+   default:
+      unreachable("Unsupported ML operation type");
+   }
+
+   struct lp_cs_tpool_task *task =
+      lp_cs_tpool_queue_task(screen->cs_tpool, func, op, iterations);
+   lp_cs_tpool_wait_for_task(screen->cs_tpool, &task);
+}
+
+static void
+llvmpipe_ml_subgraph_invoke(struct pipe_context *pipe,
+                            struct pipe_ml_subgraph *psubgraph,
+                            struct pipe_tensor *input)
+{
+   struct lp_ml_subgraph *subgraph = (struct lp_ml_subgraph *)psubgraph;
+   struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
+   struct lp_ml_tensor *t = &subgraph->tensors[input->index];
+   struct pipe_transfer *transfer;
+
+   const void *data = map_tensor(pipe, input, &transfer);
+   if (data) {
+      memcpy(t->data, data, MIN2(t->size, input->resource->width0));
+      pipe_buffer_unmap(pipe, transfer);
+   }
+
+   for (unsigned i = 0; i < subgraph->operation_count; i++)
+      run_operation(screen, &subgraph->operations[i]);
+}
+
+static void
+llvmpipe_ml_subgraph_read_output(struct pipe_context *pipe,
+                                 struct pipe_ml_subgraph *psubgraph,
+                                 unsigned outputs_count,
+                                 unsigned output_idxs[], void *outputs[])
+{
+   struct lp_ml_subgraph *subgraph = (struct lp_ml_subgraph *)psubgraph;
+
+   /* invoke() ran the whole subgraph to completion. */
+   for (unsigned i = 0; i < outputs_count; i++) {
+      const struct lp_ml_tensor *t = &subgraph->tensors[output_idxs[i]];
+      memcpy(outputs[i], t->data, t->size);
+   }
+}
+
+
+void
+llvmpipe_init_ml_funcs(struct llvmpipe_context *llvmpipe)
+{
+   llvmpipe->pipe.ml_subgraph_create = llvmpipe_ml_subgraph_create;
+   llvmpipe->pipe.ml_subgraph_invoke = llvmpipe_ml_subgraph_invoke;
+   llvmpipe->pipe.ml_subgraph_read_output = llvmpipe_ml_subgraph_read_output;
+   llvmpipe->pipe.ml_subgraph_destroy = llvmpipe_ml_subgraph_destroy;
+}
@@ -0,0 +1,14 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+#ifndef LP_ML_H
+#define LP_ML_H
+
+struct llvmpipe_context;
+
+void
+llvmpipe_init_ml_funcs(struct llvmpipe_context *llvmpipe);
+
+#endif /* LP_ML_H */
@@ -34,6 +34,7 @@
 #define LP_PERF_H
 
 #include "util/compiler.h"
+#include "util/u_atomic.h"
 
 /**
  * Various counters
@@ -86,6 +87,64 @@ extern struct lp_counters lp_count;
 #endif
 
 
+/**
+ * Always-on counters, cheap enough to keep in release builds and exposed
+ * as driver queries (see lp_query.c).  Unlike lp_counters above they are
+ * per context, and each lp_perf_counters instance is only ever updated by
+ * one thread at a time, so no atomic read-modify-writes are needed; other
+ * threads may read them at any time.  Per-primitive counts are gathered in
+ * the scene and only added to the context's counters once per scene.
+ */
+enum lp_perf_counter
+{
+   LP_PERF_SCENES,               /**< scenes rasterized */
+   LP_PERF_TRIANGLES,            /**< triangles binned */
+   LP_PERF_CULLED_TRIANGLES,
+   LP_PERF_FULLY_COVERED_64,     /**< 64x64 tiles fully covered by a tri */
+   LP_PERF_PARTIALLY_COVERED_64, /**< 64x64 tiles partially covered */
+   LP_PERF_BIN_TIME,             /**< nanoseconds spent binning draws */
+   LP_PERF_QUEUE_DEPTH,          /**< sum of scene queue depths at flush */
+   LP_PERF_RAST_TIME,            /**< nanoseconds spent rasterizing */
+   LP_PERF_IDLE_TIME,            /**< nanoseconds waiting for other threads */
+   LP_PERF_COMPILES,             /**< shader variants compiled */
+   LP_PERF_COMPILE_TIME,         /**< microseconds spent compiling them */
+   LP_PERF_COUNTERS
+};
+
+
+struct lp_perf_counters
+{
+   uint64_t value[LP_PERF_COUNTERS];
+};
+
+
+/** Add to a counter owned by the calling thread */
+static inline void
+lp_perf_add(struct lp_perf_counters *perf, enum lp_perf_counter counter,
+            uint64_t incr)
+{
+   p_atomic_set(&perf->value[counter], perf->value[counter] + incr);
+}
+
+
+/** Add to a counter that several threads may update concurrently */
+static inline void
+lp_perf_add_shared(struct lp_perf_counters *perf, enum lp_perf_counter counter,
+                   uint64_t incr)
+{
+   p_atomic_add(&perf->value[counter], incr);
+}
+
+
+/** Accumulate all counters of \p src into \p dst */
+static inline void
+lp_perf_sum(uint64_t dst[LP_PERF_COUNTERS], const struct lp_perf_counters *src)
+{
+   for (unsigned i = 0; i < LP_PERF_COUNTERS; i++)
+      dst[i] += p_atomic_read_relaxed(&src->value[i]);
+}
+
+
 extern void
 lp_reset_counters(void);
 
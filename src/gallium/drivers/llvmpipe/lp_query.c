@@ -41,6 +41,8 @@
 #include "lp_screen.h"
 #include "lp_state.h"
 #include "lp_rast.h"
+#include "lp_perf.h"
+#include "lp_setup.h"
 
 
 static struct llvmpipe_query *
@@ -50,17 +52,199 @@ llvmpipe_query(struct pipe_query *p)
 }
 
 
+/**
+ * Driver-specific queries.  The first LP_PERF_COUNTERS of them read the
+ * context's lp_perf_counters, and are followed by a rasterization and an
+ * idle time query for each rasterizer thread.
+ */
+static const struct {
+   const char *name;
+   enum pipe_driver_query_type type;
+   enum pipe_driver_query_result_type result_type;
+} lp_perf_queries[LP_PERF_COUNTERS] = {
+#define QUERY(counter, name, type, result_type) \
+   [LP_PERF_##counter] = { name, PIPE_DRIVER_QUERY_TYPE_##type, \
+                           PIPE_DRIVER_QUERY_RESULT_TYPE_##result_type }
+   QUERY(SCENES,               "scenes",               UINT64, CUMULATIVE),
+   QUERY(TRIANGLES,            "binned-triangles",     UINT64, CUMULATIVE),
+   QUERY(CULLED_TRIANGLES,     "culled-triangles",     UINT64, CUMULATIVE),
+   QUERY(FULLY_COVERED_64,     "fully-covered-64x64",  UINT64, CUMULATIVE),
+   QUERY(PARTIALLY_COVERED_64, "partially-covered-64x64", UINT64, CUMULATIVE),
+   QUERY(BIN_TIME,             "bin-time",             MICROSECONDS, CUMULATIVE),
+   QUERY(QUEUE_DEPTH,          "scene-queue-depth",    FLOAT, AVERAGE),
+   QUERY(RAST_TIME,            "rast-time",            MICROSECONDS, CUMULATIVE),
+   QUERY(IDLE_TIME,            "rast-idle-time",       MICROSECONDS, CUMULATIVE),
+   QUERY(COMPILES,             "shader-compiles",      UINT64, CUMULATIVE),
+   QUERY(COMPILE_TIME,         "shader-compile-time",  MICROSECONDS, CUMULATIVE),
+#undef QUERY
+};
+
+/* The counters are snapshotted into llvmpipe_query::start/end */
+static_assert(LP_PERF_COUNTERS <= LP_MAX_THREADS, "too many perf counters");
+
+
+static unsigned
+num_perf_queries(const struct llvmpipe_screen *screen)
+{
+   return LP_PERF_COUNTERS + 2 * MAX2(screen->num_threads, 1);
+}
+
+
+static bool
+is_perf_query(unsigned type)
+{
+   return type >= PIPE_QUERY_DRIVER_SPECIFIC;
+}
+
+
+/**
+ * Read the binning and compile counters of a driver-specific query.  The
+ * rasterizer times are read by the rasterizer itself, when it starts the
+ * scene the query begins in and once it is done with the one it ends in
+ * (see lp_setup_read_perf_queries()).
+ */
+static void
+read_perf_counters(struct llvmpipe_context *llvmpipe,
+                   const struct llvmpipe_query *pq,
+                   uint64_t *dst)
+{
+   uint64_t value[LP_PERF_COUNTERS] = { 0 };
+
+   if (pq->perf_thread >= 0)
+      return;
+
+   lp_perf_sum(value, &llvmpipe->perf);
+   lp_setup_get_perf_counters(llvmpipe->setup, value);
+
+   for (unsigned i = 0; i < LP_PERF_COUNTERS; i++) {
+      if (i != LP_PERF_RAST_TIME && i != LP_PERF_IDLE_TIME)
+         dst[i] = value[i];
+   }
+}
+
+
+/** The result of a driver-specific query, once its fence has signalled */
+static union pipe_query_result
+perf_query_result(const struct llvmpipe_query *pq)
+{
+   const unsigned index = pq->type - PIPE_QUERY_DRIVER_SPECIFIC;
+   union pipe_query_result result = { 0 };
+   unsigned counter;
+
+   if (index < LP_PERF_COUNTERS)
+      counter = index;
+   else if ((index - LP_PERF_COUNTERS) % 2 == 0)
+      counter = LP_PERF_RAST_TIME;
+   else
+      counter = LP_PERF_IDLE_TIME;
+
+   /* the end is missing if the query couldn't be binned */
+   const uint64_t value = pq->end[counter] >= pq->start[counter] ?
+                          pq->end[counter] - pq->start[counter] : 0;
+
+   switch (counter) {
+   case LP_PERF_QUEUE_DEPTH: {
+      const uint64_t scenes = pq->end[LP_PERF_SCENES] -
+                              pq->start[LP_PERF_SCENES];
+      result.f = scenes ? (float)value / scenes : 0.0f;
+      break;
+   }
+   case LP_PERF_BIN_TIME:
+   case LP_PERF_RAST_TIME:
+   case LP_PERF_IDLE_TIME:
+      /* nanoseconds to microseconds */
+      result.u64 = value / 1000;
+      break;
+   default:
+      result.u64 = value;
+      break;
+   }
+
+   return result;
+}
+
+
+static int
+llvmpipe_get_driver_query_info(struct pipe_screen *_screen,
+                               unsigned index,
+                               struct pipe_driver_query_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   if (!info)
+      return num_perf_queries(screen);
+
+   if (index >= num_perf_queries(screen))
+      return 0;
+
+   memset(info, 0, sizeof(*info));
+   info->query_type = PIPE_QUERY_DRIVER_SPECIFIC + index;
+
+   if (index < LP_PERF_COUNTERS) {
+      info->name = lp_perf_queries[index].name;
+      info->type = lp_perf_queries[index].type;
+      info->result_type = lp_perf_queries[index].result_type;
+      info->group_id = 0;
+   } else {
+      const unsigned thread = (index - LP_PERF_COUNTERS) / 2;
+      info->name =
+         screen->thread_query_names[thread][(index - LP_PERF_COUNTERS) % 2];
+      info->type = PIPE_DRIVER_QUERY_TYPE_MICROSECONDS;
+      info->result_type = PIPE_DRIVER_QUERY_RESULT_TYPE_CUMULATIVE;
+      info->group_id = 1;
+   }
+
+   return 1;
+}
+
+
+static int
+llvmpipe_get_driver_query_group_info(struct pipe_screen *_screen,
+                                     unsigned index,
+                                     struct pipe_driver_query_group_info *info)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   if (!info)
+      return 2;
+
+   switch (index) {
+   case 0:
+      info->name = "llvmpipe";
+      info->num_queries = LP_PERF_COUNTERS;
+      break;
+   case 1:
+      info->name = "llvmpipe threads";
+      info->num_queries = num_perf_queries(screen) - LP_PERF_COUNTERS;
+      break;
+   default:
+      return 0;
+   }
+
+   /* they're all read off the same counters, so there's no limit */
+   info->max_active_queries = info->num_queries;
+   return 1;
+}
+
+
 static struct pipe_query *
 llvmpipe_create_query(struct pipe_context *pipe,
                       unsigned type,
                       unsigned index)
 {
-   assert(type < PIPE_QUERY_TYPES);
+   assert(type < PIPE_QUERY_TYPES ||
+          (is_perf_query(type) &&
+           type - PIPE_QUERY_DRIVER_SPECIFIC <
+              num_perf_queries(llvmpipe_screen(pipe->screen))));
 
    struct llvmpipe_query *pq = CALLOC_STRUCT(llvmpipe_query);
    if (pq) {
       pq->type = type;
       pq->index = index;
+
+      const unsigned perf_index = type - PIPE_QUERY_DRIVER_SPECIFIC;
+      pq->perf_thread = is_perf_query(type) && perf_index >= LP_PERF_COUNTERS ?
+                        (perf_index - LP_PERF_COUNTERS) / 2 : -1;
    }
 
    return (struct pipe_query *) pq;
@@ -118,6 +302,11 @@ llvmpipe_get_query_result(struct pipe_context *pipe,
     */
    result->u64 = 0;
 
+   if (is_perf_query(pq->type)) {
+      *result = perf_query_result(pq);
+      return true;
+   }
+
    /* Combine the per-thread results */
    switch (pq->type) {
    case PIPE_QUERY_OCCLUSION_COUNTER:
@@ -348,6 +537,18 @@ llvmpipe_get_query_result_resource(struct pipe_context *pipe,
          }
          break;
       default:
+         if (is_perf_query(pq->type)) {
+            /* the rasterizer times are only there once the fence signalled */
+            if (!ready)
+               break;
+
+            union pipe_query_result result = perf_query_result(pq);
+            if (pq->type - PIPE_QUERY_DRIVER_SPECIFIC == LP_PERF_QUEUE_DEPTH)
+               value = (uint64_t)result.f;
+            else
+               value = result.u64;
+            break;
+         }
          fprintf(stderr, "Unknown query type %d\n", pq->type);
          break;
       }
@@ -403,10 +604,19 @@ llvmpipe_begin_query(struct pipe_context *pipe, struct pipe_query *q)
       llvmpipe_finish(pipe, __func__);
    }
 
+   /* The rasterizer writes the end of driver-specific queries. */
+   if (is_perf_query(pq->type) && pq->fence &&
+       !lp_fence_signalled(pq->fence)) {
+      lp_fence_wait(pq->fence);
+   }
+
    memset(pq->start, 0, sizeof(pq->start));
    memset(pq->end, 0, sizeof(pq->end));
    lp_setup_begin_query(llvmpipe->setup, pq);
 
+   if (is_perf_query(pq->type))
+      read_perf_counters(llvmpipe, pq, pq->start);
+
    switch (pq->type) {
    case PIPE_QUERY_PRIMITIVES_EMITTED:
       pq->num_primitives_written[0] = llvmpipe->so_stats[pq->index].num_primitives_written;
@@ -459,6 +669,9 @@ llvmpipe_end_query(struct pipe_context *pipe, struct pipe_query *q)
 
    lp_setup_end_query(llvmpipe->setup, pq);
 
+   if (is_perf_query(pq->type))
+      read_perf_counters(llvmpipe, pq, pq->end);
+
    switch (pq->type) {
 
    case PIPE_QUERY_PRIMITIVES_EMITTED:
@@ -572,6 +785,24 @@ llvmpipe_set_active_query_state(struct pipe_context *pipe, bool enable)
 }
 
 
+void
+llvmpipe_init_screen_query_funcs(struct llvmpipe_screen *screen)
+{
+   for (unsigned i = 0; i < MAX2(screen->num_threads, 1); i++) {
+      snprintf(screen->thread_query_names[i][0],
+               sizeof(screen->thread_query_names[i][0]),
+               "rast-time-thread%u", i);
+      snprintf(screen->thread_query_names[i][1],
+               sizeof(screen->thread_query_names[i][1]),
+               "rast-idle-time-thread%u", i);
+   }
+
+   screen->base.get_driver_query_info = llvmpipe_get_driver_query_info;
+   screen->base.get_driver_query_group_info =
+      llvmpipe_get_driver_query_group_info;
+}
+
+
 void
 llvmpipe_init_query_funcs(struct llvmpipe_context *llvmpipe)
 {
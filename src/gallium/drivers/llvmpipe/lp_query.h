@@ -51,11 +51,17 @@ struct llvmpipe_query {
    unsigned num_primitives_written[PIPE_MAX_VERTEX_STREAMS];
 
    struct pipe_query_data_pipeline_statistics stats;
+
+   int perf_thread;                 /* rasterizer thread, or -1 for all */
 };
 
 
+struct llvmpipe_screen;
+
 extern void llvmpipe_init_query_funcs(struct llvmpipe_context * );
 
+extern void llvmpipe_init_screen_query_funcs(struct llvmpipe_screen *);
+
 extern bool llvmpipe_check_render_cond(struct llvmpipe_context *);
 
 #endif /* LP_QUERY_H */
@@ -48,6 +48,7 @@
 #include "gallivm/lp_bld_debug.h"
 #include "lp_scene.h"
 #include "lp_screen.h"
+#include "lp_setup_context.h"
 #include "lp_tex_sample.h"
 
 #ifdef _WIN32
@@ -78,7 +79,8 @@ lp_rast_begin(struct lp_rasterizer *rast,
    LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
    lp_scene_begin_rasterization(scene);
-   lp_scene_bin_iter_begin(scene);
+   lp_setup_read_perf_queries(scene, false);
+   lp_scene_bin_iter_begin(scene, MAX2(rast->num_threads, 1));
 }
 
 
@@ -1034,6 +1036,37 @@ is_empty_bin(const struct cmd_bin *bin)
 }
 
 
+/**
+ * Credit a thread's time on a scene to the context that binned it.  The
+ * last thread to finish also charges every thread the time it then spent
+ * waiting at the end of the scene, and then reads the counters of the
+ * queries ending in the scene.  This must be done before the thread
+ * signals the scene's fence, after which the context may go away.
+ */
+static void
+account_scene(struct lp_rasterizer_task *task,
+              struct lp_scene *scene,
+              int64_t start)
+{
+   struct lp_rast_perf_counters *perf = scene->setup->rast_perf;
+   const unsigned num_threads = MAX2(task->rast->num_threads, 1);
+   const int64_t end = os_time_get_nano();
+
+   lp_perf_add(&perf[task->thread_index].perf, LP_PERF_RAST_TIME, end - start);
+   scene->rast_end[task->thread_index] = end;
+
+   /* Scenes are rasterized one at a time, so only this thread touches the
+    * others' idle time until the next scene.
+    */
+   if (p_atomic_inc_return(&scene->rast_done) == num_threads) {
+      for (unsigned i = 0; i < num_threads; i++)
+         lp_perf_add(&perf[i].perf, LP_PERF_IDLE_TIME, end - scene->rast_end[i]);
+
+      lp_setup_read_perf_queries(scene, true);
+   }
+}
+
+
 /**
  * Rasterize/execute all bins within a scene.
  * Called per thread.
@@ -1042,6 +1075,8 @@ static void
 rasterize_scene(struct lp_rasterizer_task *task,
                 struct lp_scene *scene)
 {
+   const int64_t start = os_time_get_nano();
+
    task->scene = scene;
 
    /* Clear the cache tags. This should not always be necessary but
@@ -1059,10 +1094,14 @@ rasterize_scene(struct lp_rasterizer_task *task,
    if (!task->rast->no_rast) {
       /* loop over scene bins, rasterize each */
       struct cmd_bin *bin;
+      unsigned steal = 0;
       int i, j;
 
       assert(scene);
-      while ((bin = lp_scene_bin_iter_next(scene, &i, &j))) {
+      while ((bin = lp_scene_bin_iter_next(scene, task->thread_index,
+                                           task->domain_start,
+                                           task->domain_size,
+                                           &steal, &i, &j))) {
          if (!is_empty_bin(bin))
             rasterize_bin(task, bin, i, j);
       }
@@ -1082,6 +1121,8 @@ rasterize_scene(struct lp_rasterizer_task *task,
    }
 #endif
 
+   account_scene(task, scene, start);
+
    if (scene->fence) {
       lp_fence_signal(scene->fence);
    }
@@ -1092,11 +1133,14 @@ rasterize_scene(struct lp_rasterizer_task *task,
 
 /**
  * Called by setup module when it has something for us to render.
+ * \return the number of scenes waiting to be rasterized, including this one
  */
-void
+unsigned
 lp_rast_queue_scene(struct lp_rasterizer *rast,
                     struct lp_scene *scene)
 {
+   unsigned depth = 0;
+
    LP_DBG(DEBUG_SETUP, "%s\n", __func__);
 
    lp_fence_reference(&rast->last_fence, scene->fence);
@@ -1123,7 +1167,7 @@ lp_rast_queue_scene(struct lp_rasterizer *rast,
       rast->curr_scene = NULL;
    } else {
       /* threaded rendering! */
-      lp_scene_enqueue(rast->full_scenes, scene);
+      depth = lp_scene_enqueue(rast->full_scenes, scene);
 
       /* signal the threads that there's work to do */
       for (unsigned i = 0; i < rast->num_threads; i++) {
@@ -1132,6 +1176,8 @@ lp_rast_queue_scene(struct lp_rasterizer *rast,
    }
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __func__);
+
+   return depth;
 }
 
 
@@ -1241,8 +1287,17 @@ create_rast_threads(struct lp_rasterizer *rast)
       if (thrd_success != u_thread_create(rast->threads + i, thread_function,
                                             (void *) &rast->tasks[i])) {
          rast->num_threads = i; /* previous thread is max */
+
+         /* the domains were laid out for more threads, drop them */
+         for (unsigned j = 0; j < MAX2(i, 1); j++) {
+            rast->tasks[j].domain_start = 0;
+            rast->tasks[j].domain_size = MAX2(i, 1);
+         }
          break;
       }
+
+      if (rast->num_domains > 1)
+         lp_thread_set_domain(rast->threads[i], rast->tasks[i].domain);
    }
 }
 
@@ -1251,9 +1306,10 @@ create_rast_threads(struct lp_rasterizer *rast)
  * Create new lp_rasterizer.  If num_threads is zero, don't create any
  * new threads, do rendering synchronously.
  * \param num_threads  number of rasterizer threads to create
+ * \param num_domains  number of L3 caches to pin the threads to, or 1
  */
 struct lp_rasterizer *
-lp_rast_create(unsigned num_threads)
+lp_rast_create(unsigned num_threads, unsigned num_domains)
 {
    struct lp_rasterizer *rast = CALLOC_STRUCT(lp_rasterizer);
    if (!rast) {
@@ -1265,10 +1321,19 @@ lp_rast_create(unsigned num_threads)
       goto no_full_scenes;
    }
 
-   for (unsigned i = 0; i < MAX2(1, num_threads); i++) {
+   /* Consecutive threads share a domain.  Since every thread gets a
+    * contiguous run of bins in Morton order, each domain ends up with a
+    * compact region of the framebuffer.
+    */
+   const unsigned n = MAX2(1, num_threads);
+   for (unsigned i = 0; i < n; i++) {
       struct lp_rasterizer_task *task = &rast->tasks[i];
       task->rast = rast;
       task->thread_index = i;
+      task->domain = lp_thread_domain(i, n, num_domains);
+      task->domain_start = DIV_ROUND_UP(task->domain * n, num_domains);
+      task->domain_size = DIV_ROUND_UP((task->domain + 1) * n, num_domains) -
+                          task->domain_start;
       task->thread_data.cache =
          align_malloc(sizeof(struct lp_build_format_cache), 16);
       if (!task->thread_data.cache) {
@@ -1277,6 +1342,7 @@ lp_rast_create(unsigned num_threads)
    }
 
    rast->num_threads = num_threads;
+   rast->num_domains = num_domains;
 
    rast->no_rast = debug_get_bool_option("LP_NO_RAST", false);
 
@@ -231,14 +231,14 @@ GET_PLANES(const struct lp_rast_triangle *tri)
 
 
 struct lp_rasterizer *
-lp_rast_create(unsigned num_threads);
+lp_rast_create(unsigned num_threads, unsigned num_domains);
 
 void
 lp_rast_destroy(struct lp_rasterizer *);
 
-void
+unsigned
 lp_rast_queue_scene(struct lp_rasterizer *rast,
-                     struct lp_scene *scene);
+                    struct lp_scene *scene);
 
 void
 lp_rast_finish(struct lp_rasterizer *rast);
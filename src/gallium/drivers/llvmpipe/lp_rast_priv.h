@@ -97,6 +97,11 @@ struct lp_rasterizer_task
    /** "my" index */
    unsigned thread_index;
 
+   /** The threads sharing this one's L3 cache, bins are stolen from
+    * them first.
+    */
+   unsigned domain, domain_start, domain_size;
+
    /** Non-interpolated passthru state and occlude counter for visible pixels */
    struct lp_jit_thread_data thread_data;
 
@@ -128,6 +133,7 @@ struct lp_rasterizer
    struct lp_rasterizer_task tasks[LP_MAX_THREADS];
 
    unsigned num_threads;
+   unsigned num_domains;
    thrd_t threads[LP_MAX_THREADS];
 
    /** For synchronizing the rasterization threads */
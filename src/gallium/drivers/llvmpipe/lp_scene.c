@@ -25,6 +25,7 @@
  *
  **************************************************************************/
 
+#include "util/u_atomic.h"
 #include "util/u_framebuffer.h"
 #include "util/u_math.h"
 #include "util/u_memory.h"
@@ -103,6 +104,8 @@ lp_scene_destroy(struct lp_scene *scene)
    lp_scene_end_rasterization(scene);
    mtx_destroy(&scene->mutex);
    free(scene->tiles);
+   free(scene->bin_order);
+   free(scene->shard_bins);
    assert(scene->data.head == &scene->data.first);
    slab_free_st(&scene->setup->scene_slab, scene);
 }
@@ -201,6 +204,8 @@ lp_scene_begin_rasterization(struct lp_scene *scene)
 
    //LP_DBG(DEBUG_RAST, "%s\n", __func__);
 
+   scene->rast_done = 0;
+
    for (unsigned i = 0; i < scene->fb.nr_cbufs; i++) {
       struct pipe_surface *cbuf = scene->fb.cbufs[i];
       init_scene_texture(&scene->cbufs[i], cbuf);
@@ -343,6 +348,8 @@ lp_scene_new_cmd_block(struct lp_scene *scene,
       } else {
          bin->head = block;
          bin->tail = block;
+         if (scene->is_shard)
+            scene->shard_bins[scene->num_shard_bins++] = bin - scene->tiles;
       }
       //memset(block, 0, sizeof *block);
       block->next = NULL;
@@ -547,60 +554,136 @@ lp_scene_is_resource_referenced(const struct lp_scene *scene,
 }
 
 
-/** advance curr_x,y to the next bin */
-static bool
-next_bin(struct lp_scene *scene)
+/**
+ * Compact the even bits of a Morton code into the low bits.
+ */
+static inline unsigned
+morton_compact(unsigned v)
 {
-   scene->curr_x++;
-   if (scene->curr_x >= scene->tiles_x) {
-      scene->curr_x = 0;
-      scene->curr_y++;
-   }
-   if (scene->curr_y >= scene->tiles_y) {
-      /* no more bins */
-      return false;
+   v &= 0x55555555;
+   v = (v | (v >> 1)) & 0x33333333;
+   v = (v | (v >> 2)) & 0x0f0f0f0f;
+   v = (v | (v >> 4)) & 0x00ff00ff;
+   v = (v | (v >> 8)) & 0x0000ffff;
+   return v;
+}
+
+
+/**
+ * Approximate cost of rasterizing a bin: the number of commands in it, as
+ * reported by lp_characterize_bin(), but computed from the block list
+ * without walking every command.
+ */
+static inline unsigned
+bin_cost(const struct cmd_bin *bin)
+{
+   unsigned cost = bin->tail->count;
+   for (const struct cmd_block *block = bin->head; block != bin->tail;
+        block = block->next) {
+      cost += block->count;
    }
-   return true;
+   /* even an empty-ish bin costs a tile load/store */
+   return cost + 1;
 }
 
 
+/**
+ * Prepare to hand out the scene's bins to the rasterizer threads.
+ * Called once per scene, before any thread calls lp_scene_bin_iter_next().
+ *
+ * Non-empty bins are listed in Morton (Z) order so that consecutive bins
+ * are spatial neighbours, then the list is split into one contiguous
+ * range per thread, balanced by the bins' command counts.  Empty bins
+ * aren't listed at all.
+ */
 void
-lp_scene_bin_iter_begin(struct lp_scene *scene)
+lp_scene_bin_iter_begin(struct lp_scene *scene, unsigned num_threads)
 {
-   scene->curr_x = scene->curr_y = -1;
+   const unsigned dim = util_next_power_of_two(MAX2(scene->tiles_x,
+                                                    scene->tiles_y));
+   unsigned num_bins = 0;
+   uint64_t total_cost = 0;
+
+   assert(num_threads > 0 && num_threads <= LP_MAX_THREADS);
+
+   for (unsigned m = 0; m < dim * dim; m++) {
+      const unsigned x = morton_compact(m);
+      const unsigned y = morton_compact(m >> 1);
+
+      if (x >= scene->tiles_x || y >= scene->tiles_y)
+         continue;
+
+      const struct cmd_bin *bin = lp_scene_get_bin(scene, x, y);
+      if (bin->head == NULL)
+         continue;
+
+      scene->bin_order[num_bins++] = (y << 16) | x;
+      total_cost += bin_cost(bin);
+   }
+
+   /* Split the list so that every range carries about the same amount of
+    * work.  Ranges may end up empty if there are fewer bins than threads.
+    */
+   unsigned start = 0;
+   uint64_t cost = 0;
+   for (unsigned t = 0; t < num_threads; t++) {
+      const uint64_t target = total_cost * (t + 1) / num_threads;
+      unsigned end = start;
+
+      if (t == num_threads - 1) {
+         end = num_bins;
+      } else {
+         while (end < num_bins && cost < target) {
+            const uint32_t pos = scene->bin_order[end++];
+            cost += bin_cost(lp_scene_get_bin(scene, pos & 0xffff, pos >> 16));
+         }
+      }
+
+      scene->bin_ranges[t].next = start;
+      scene->bin_ranges[t].end = end;
+      start = end;
+   }
+
+   scene->num_bin_ranges = num_threads;
 }
 
 
 /**
  * Return pointer to next bin to be rendered.
- * The lp_scene::curr_x and ::curr_y fields will be advanced.
  * Multiple rendering threads will call this function to get a chunk
- * of work (a bin) to work on.
+ * of work (a bin) to work on.  Bins are claimed with atomic increments,
+ * first from the calling thread's own range, then from the ranges of the
+ * other threads in its group and then from everybody else's.
+ * \param group_start  first thread of the calling thread's group
+ * \param group_size  number of threads in the group
+ * \param steal  per-thread iteration state, must be zero initially
  */
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene , int *x, int *y)
+lp_scene_bin_iter_next(struct lp_scene *scene, unsigned thread_index,
+                       unsigned group_start, unsigned group_size,
+                       unsigned *steal, int *x, int *y)
 {
-   struct cmd_bin *bin = NULL;
-
-   mtx_lock(&scene->mutex);
+   while (*steal < scene->num_bin_ranges) {
+      const unsigned r = *steal < group_size ?
+         group_start + (thread_index - group_start + *steal) % group_size :
+         (group_start + *steal) % scene->num_bin_ranges;
+      struct lp_scene_bin_range *range = &scene->bin_ranges[r];
+
+      if (p_atomic_read(&range->next) < range->end) {
+         const int i = p_atomic_inc_return(&range->next) - 1;
+         if (i < range->end) {
+            const uint32_t pos = scene->bin_order[i];
+            *x = pos & 0xffff;
+            *y = pos >> 16;
+            return lp_scene_get_bin(scene, *x, *y);
+         }
+      }
 
-   if (scene->curr_x < 0) {
-      /* first bin */
-      scene->curr_x = 0;
-      scene->curr_y = 0;
-   } else if (!next_bin(scene)) {
-      /* no more bins left */
-      goto end;
+      /* this range is drained, move on to the next one */
+      (*steal)++;
    }
 
-   bin = lp_scene_get_bin(scene, scene->curr_x, scene->curr_y);
-   *x = scene->curr_x;
-   *y = scene->curr_y;
-
-end:
-   /*printf("return bin %p at %d, %d\n", (void *) bin, *bin_x, *bin_y);*/
-   mtx_unlock(&scene->mutex);
-   return bin;
+   return NULL;
 }
 
 
@@ -611,6 +694,8 @@ lp_scene_begin_binning(struct lp_scene *scene,
    assert(lp_scene_is_empty(scene));
 
    util_copy_framebuffer_state(&scene->fb, fb);
+   memset(&scene->perf, 0, sizeof(scene->perf));
+   scene->perf_queries = NULL;
 
    scene->tiles_x = align(fb->width, TILE_SIZE) / TILE_SIZE;
    scene->tiles_y = align(fb->height, TILE_SIZE) / TILE_SIZE;
@@ -621,7 +706,9 @@ lp_scene_begin_binning(struct lp_scene *scene,
    if (scene->num_alloced_tiles < num_required_tiles) {
       scene->tiles = reallocarray(scene->tiles, num_required_tiles,
                                   sizeof(struct cmd_bin));
-      if (!scene->tiles)
+      scene->bin_order = reallocarray(scene->bin_order, num_required_tiles,
+                                      sizeof(uint32_t));
+      if (!scene->tiles || !scene->bin_order)
          return;
       memset(scene->tiles, 0, sizeof(struct cmd_bin) * num_required_tiles);
       scene->num_alloced_tiles = num_required_tiles;
@@ -665,6 +752,17 @@ lp_scene_begin_binning(struct lp_scene *scene,
 void
 lp_scene_end_binning(struct lp_scene *scene)
 {
+   /* Binning only needed the variants' key-derived state, but the
+    * rasterizer runs their code, which may still be compiling.
+    */
+   for (struct shader_ref *ref = scene->frag_shaders; ref; ref = ref->next) {
+      for (int i = 0; i < ref->count; i++) {
+         /* no variant if the state was set up without a fragment shader */
+         if (ref->variant[i])
+            lp_fs_variant_wait(ref->variant[i]);
+      }
+   }
+
    if (LP_DEBUG & DEBUG_SCENE) {
       debug_printf("rasterize scene:\n");
       debug_printf("  scene_size: %u\n",
@@ -676,3 +774,154 @@ lp_scene_end_binning(struct lp_scene *scene)
          lp_debug_bins(scene);
    }
 }
+
+
+/**
+ * Prepare \p shard for binning part of the primitives of \p scene.
+ * Each of \p num_shards shards gets an equal part of the memory left in
+ * the scene, and fails allocations once that is used up.
+ */
+bool
+lp_scene_shard_begin(struct lp_scene *shard,
+                     const struct lp_scene *scene,
+                     unsigned num_shards)
+{
+   unsigned num_required_tiles = scene->tiles_x * scene->tiles_y;
+
+   assert(shard->num_shard_bins == 0);
+
+   if (shard->num_alloced_tiles < num_required_tiles) {
+      free(shard->tiles);
+      free(shard->shard_bins);
+      shard->tiles = calloc(num_required_tiles, sizeof(struct cmd_bin));
+      shard->shard_bins = malloc(num_required_tiles * sizeof(uint32_t));
+      if (!shard->tiles || !shard->shard_bins) {
+         shard->num_alloced_tiles = 0;
+         return false;
+      }
+      shard->num_alloced_tiles = num_required_tiles;
+   }
+
+   shard->is_shard = true;
+   shard->tiles_x = scene->tiles_x;
+   shard->tiles_y = scene->tiles_y;
+   shard->fb_max_layer = scene->fb_max_layer;
+   shard->had_queries = scene->had_queries;
+   shard->alloc_failed = false;
+
+   shard->scene_size = LP_SCENE_MAX_SIZE -
+      (LP_SCENE_MAX_SIZE - MIN2(scene->scene_size, LP_SCENE_MAX_SIZE)) /
+      num_shards;
+   shard->shard_base_size = shard->scene_size;
+
+   /* The embedded first block can't be handed over to the scene, so mark
+    * it full to make every allocation come from a block of its own.
+    */
+   shard->data.first.used = DATA_BLOCK_SIZE;
+   shard->data.first.next = NULL;
+   if (!shard->shard_carry)
+      shard->data.head = &shard->data.first;
+
+   return true;
+}
+
+
+/* The blocks from data.head up to this one belong to the shard */
+static struct data_block *
+lp_scene_shard_owned_end(struct lp_scene *shard)
+{
+   return shard->shard_carry ? shard->shard_carry : &shard->data.first;
+}
+
+
+static void
+lp_scene_shard_reset(struct lp_scene *shard)
+{
+   for (unsigned i = 0; i < shard->num_shard_bins; i++)
+      memset(&shard->tiles[shard->shard_bins[i]], 0, sizeof(struct cmd_bin));
+
+   shard->num_shard_bins = 0;
+   shard->data.head = lp_scene_shard_owned_end(shard);
+   memset(&shard->perf, 0, sizeof(shard->perf));
+}
+
+
+/**
+ * Append the commands binned into \p shard to the bins of \p scene, and
+ * hand over the memory they live in.
+ */
+void
+lp_scene_shard_merge(struct lp_scene *scene, struct lp_scene *shard)
+{
+   for (unsigned i = 0; i < shard->num_shard_bins; i++) {
+      struct cmd_bin *src = &shard->tiles[shard->shard_bins[i]];
+      struct cmd_bin *dst = &scene->tiles[shard->shard_bins[i]];
+
+      if (dst->tail)
+         dst->tail->next = src->head;
+      else
+         dst->head = src->head;
+      dst->tail = src->tail;
+      dst->last_state = src->last_state;
+   }
+
+   /* Blocks are pushed at the head, so the shard's own blocks come first.
+    * Link them in behind the block the scene is currently allocating
+    * from.
+    */
+   struct data_block *end = lp_scene_shard_owned_end(shard);
+   struct data_block *last = NULL;
+   for (struct data_block *block = shard->data.head; block != end;
+        block = block->next)
+      last = block;
+
+   if (last) {
+      last->next = scene->data.head->next;
+      scene->data.head->next = shard->data.head;
+
+      /* Keep filling the last one with the next triangles binned for this
+       * scene, rather than starting a new block for every shard every
+       * time.
+       */
+      shard->shard_carry = shard->data.head;
+   }
+
+   scene->scene_size += shard->scene_size - shard->shard_base_size;
+
+   for (unsigned i = 0; i < LP_PERF_COUNTERS; i++)
+      scene->perf.value[i] += shard->perf.value[i];
+
+   lp_scene_shard_reset(shard);
+}
+
+
+/**
+ * Throw away everything binned into \p shard.
+ */
+void
+lp_scene_shard_discard(struct lp_scene *shard)
+{
+   struct data_block *end = lp_scene_shard_owned_end(shard);
+   struct data_block *block, *next;
+
+   for (block = shard->data.head; block != end; block = next) {
+      next = block->next;
+      FREE(block);
+   }
+
+   lp_scene_shard_reset(shard);
+}
+
+
+/**
+ * Stop filling the block merged into a scene, because that scene is done
+ * binning.  The scene frees it.
+ */
+void
+lp_scene_shard_detach(struct lp_scene *shard)
+{
+   assert(shard->num_shard_bins == 0);
+
+   shard->shard_carry = NULL;
+   shard->data.head = &shard->data.first;
+}
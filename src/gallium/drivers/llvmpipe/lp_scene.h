@@ -35,9 +35,12 @@
 #ifndef LP_SCENE_H
 #define LP_SCENE_H
 
+#include "util/u_memory.h"
 #include "util/u_thread.h"
 #include "lp_rast.h"
 #include "lp_debug.h"
+#include "lp_limits.h"
+#include "lp_perf.h"
 
 struct lp_scene_queue;
 struct lp_rast_state;
@@ -63,6 +66,11 @@ struct lp_rast_state;
  */
 #define LP_SCENE_MAX_SIZE (36*1024*1024)
 
+/* Smallest scene handed to the rasterizer before the frame is flushed, so
+ * that binning and rasterization overlap:
+ */
+#define LP_SCENE_MIN_STREAM_SIZE (1024*1024)
+
 /* The maximum amount of texture storage referenced by a scene is
  * clamped to this size:
  */
@@ -120,6 +128,18 @@ struct resource_ref;
 
 struct shader_ref;
 
+/**
+ * A contiguous run of entries in lp_scene::bin_order, handed out to
+ * rasterizer threads with atomic increments.  Each thread starts on its
+ * own range and then steals from the others once that is drained.
+ */
+struct lp_scene_bin_range {
+   EXCLUSIVE_CACHELINE(struct {
+      int next;     /**< next entry to hand out (atomic) */
+      int end;      /**< one past the last entry of the range */
+   });
+};
+
 struct lp_scene_surface {
    uint8_t *map;
    unsigned stride;
@@ -195,16 +215,57 @@ struct lp_scene {
     */
    unsigned tiles_x, tiles_y;
 
-   int curr_x, curr_y;  /**< for iterating over bins */
    mtx_t mutex;
 
    unsigned num_alloced_tiles;
    struct cmd_bin *tiles;
+
+   /**
+    * Non-empty bins in rasterization order, packed as (y << 16) | x, and
+    * the per-thread ranges of that list.  Filled in by
+    * lp_scene_bin_iter_begin().
+    */
+   uint32_t *bin_order;
+   unsigned num_bin_ranges;
+   struct lp_scene_bin_range bin_ranges[LP_MAX_THREADS];
+
+   /**
+    * Shards are private scenes that setup threads bin a range of
+    * primitives into.  Their commands are spliced onto the end of the
+    * real scene's bins in primitive order by lp_scene_shard_merge().
+    */
+   bool is_shard;
+   unsigned shard_base_size;    /**< scene_size when the shard began */
+   unsigned num_shard_bins;
+   uint32_t *shard_bins;        /**< indices of the bins used, unordered */
+   struct data_block *shard_carry; /**< merged block still being filled */
+
    struct data_block_list data;
+
+   /** Binning counters, folded into the context's when it is queued */
+   struct lp_perf_counters perf;
+
+   /** Driver-specific queries beginning or ending in the scene */
+   struct lp_scene_perf_query *perf_queries;
+
+   /** Rasterizer threads done with the scene, and when each finished */
+   unsigned rast_done;
+   int64_t rast_end[LP_MAX_THREADS];
 };
 
 
 
+/**
+ * A driver-specific query whose rasterizer counters are read when the
+ * rasterizer starts (for its beginning) or finishes (for its end) the scene.
+ */
+struct lp_scene_perf_query {
+   struct llvmpipe_query *query;
+   bool end;
+   struct lp_scene_perf_query *next;
+};
+
+
 struct lp_scene *lp_scene_create(struct lp_setup_context *setup);
 
 void lp_scene_destroy(struct lp_scene *scene);
@@ -396,10 +457,12 @@ lp_scene_get_num_bins(const struct lp_scene *scene)
 
 
 void
-lp_scene_bin_iter_begin(struct lp_scene *scene);
+lp_scene_bin_iter_begin(struct lp_scene *scene, unsigned num_threads);
 
 struct cmd_bin *
-lp_scene_bin_iter_next(struct lp_scene *scene, int *x, int *y);
+lp_scene_bin_iter_next(struct lp_scene *scene, unsigned thread_index,
+                       unsigned group_start, unsigned group_size,
+                       unsigned *steal, int *x, int *y);
 
 
 
@@ -413,6 +476,23 @@ void
 lp_scene_end_binning(struct lp_scene *scene);
 
 
+/* Binning a range of primitives into a shard of a scene
+ */
+bool
+lp_scene_shard_begin(struct lp_scene *shard,
+                     const struct lp_scene *scene,
+                     unsigned num_shards);
+
+void
+lp_scene_shard_merge(struct lp_scene *scene, struct lp_scene *shard);
+
+void
+lp_scene_shard_discard(struct lp_scene *shard);
+
+void
+lp_scene_shard_detach(struct lp_scene *shard);
+
+
 /* Begin/end rasterization of a scene
  */
 void
@@ -119,8 +119,11 @@ lp_scene_dequeue(struct lp_scene_queue *queue, bool wait)
 }
 
 
-/** Add an lp_scene to tail of queue */
-void
+/**
+ * Add an lp_scene to tail of queue.
+ * \return the number of scenes in the queue, including this one
+ */
+unsigned
 lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene)
 {
    mtx_lock(&queue->mutex);
@@ -130,7 +133,10 @@ lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene)
       cnd_wait(&queue->change, &queue->mutex);
 
    queue->scenes[queue->tail++ % SCENE_QUEUE_SIZE] = scene;
+   unsigned depth = queue->tail - queue->head;
 
    cnd_signal(&queue->change);
    mtx_unlock(&queue->mutex);
+
+   return depth;
 }
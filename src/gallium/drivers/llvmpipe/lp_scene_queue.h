@@ -44,7 +44,7 @@ lp_scene_queue_destroy(struct lp_scene_queue *queue);
 struct lp_scene *
 lp_scene_dequeue(struct lp_scene_queue *queue, bool wait);
 
-void
+unsigned
 lp_scene_enqueue(struct lp_scene_queue *queue, struct lp_scene *scene);
 
 
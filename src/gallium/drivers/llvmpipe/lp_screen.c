@@ -42,6 +42,7 @@
 #include "util/hex.h"
 #include "util/os_misc.h"
 #include "util/os_time.h"
+#include "util/u_atomic.h"
 #include "util/u_helpers.h"
 #include "util/anon_file.h"
 #include "lp_texture.h"
@@ -55,6 +56,8 @@
 #include "lp_rast.h"
 #include "lp_cs_tpool.h"
 #include "lp_flush.h"
+#include "lp_query.h"
+#include "lp_state.h"
 
 #include "frontend/sw_winsys.h"
 
@@ -84,6 +87,7 @@ static const struct debug_named_value lp_debug_flags[] = {
    { "mem", DEBUG_MEM, NULL },
    { "fs", DEBUG_FS, NULL },
    { "cs", DEBUG_CS, NULL },
+   { "cache", DEBUG_CACHE, NULL },
    { "accurate_a0", DEBUG_ACCURATE_A0 },
    { "mesh", DEBUG_MESH },
    DEBUG_NAMED_VALUE_END
@@ -101,6 +105,11 @@ static const struct debug_named_value lp_perf_flags[] = {
    { "no_alphatest",   PERF_NO_ALPHATEST, NULL },
    { "no_rast_linear", PERF_NO_RAST_LINEAR, NULL },
    { "no_shade",       PERF_NO_SHADE, NULL },
+   { "no_async_compile", PERF_NO_ASYNC_COMPILE, NULL },
+   { "microtile",      PERF_MICROTILE, NULL },
+   { "no_parallel_bin", PERF_NO_PARALLEL_BIN, NULL },
+   { "no_stream",      PERF_NO_STREAM, NULL },
+   { "cache_stats",    PERF_CACHE_STATS, NULL },
    DEBUG_NAMED_VALUE_END
 };
 
@@ -924,6 +933,9 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
 {
    struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
 
+   if (util_queue_is_initialized(&screen->compile_queue))
+      util_queue_destroy(&screen->compile_queue);
+
    if (screen->cs_tpool)
       lp_cs_tpool_destroy(screen->cs_tpool);
 
@@ -932,6 +944,11 @@ llvmpipe_destroy_screen(struct pipe_screen *_screen)
 
    lp_jit_screen_cleanup(screen);
 
+   /* Not LP_DBG, which is compiled out of release builds. */
+   if (screen->disk_shader_cache &&
+       ((LP_PERF & PERF_CACHE_STATS) || (LP_DEBUG & DEBUG_CACHE)))
+      fprintf(stderr, "llvmpipe: shader cache hits %u misses %u\n",
+              screen->disk_cache_hits, screen->disk_cache_misses);
    disk_cache_destroy(screen->disk_shader_cache);
 
    glsl_type_singleton_decref();
@@ -1065,8 +1082,10 @@ lp_disk_cache_find_shader(struct llvmpipe_screen *screen,
                                     sha1, &binary_size);
    if (!buffer) {
       cache->data_size = 0;
+      p_atomic_inc(&screen->disk_cache_misses);
       return;
    }
+   p_atomic_inc(&screen->disk_cache_hits);
    cache->data_size = binary_size;
    cache->data = buffer;
 }
@@ -1088,6 +1107,20 @@ lp_disk_cache_insert_shader(struct llvmpipe_screen *screen,
 }
 
 
+/**
+ * Pin a rasterizer or compute thread to the CPUs of one L3 cache.
+ */
+void
+lp_thread_set_domain(thrd_t thread, unsigned domain)
+{
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+
+   assert(domain < caps->num_L3_caches);
+   util_set_thread_affinity(thread, caps->L3_affinity_mask[domain], NULL,
+                            caps->num_cpu_mask_bits);
+}
+
+
 bool
 llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
 {
@@ -1097,13 +1130,15 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
    if (screen->late_init_done)
       goto out;
 
-   screen->rast = lp_rast_create(screen->num_threads);
+   screen->rast = lp_rast_create(screen->num_threads,
+                                 screen->num_thread_domains);
    if (!screen->rast) {
       ret = false;
       goto out;
    }
 
-   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads);
+   screen->cs_tpool = lp_cs_tpool_create(screen->num_threads,
+                                         screen->num_thread_domains);
    if (!screen->cs_tpool) {
       lp_rast_destroy(screen->rast);
       ret = false;
@@ -1117,6 +1152,19 @@ llvmpipe_screen_late_init(struct llvmpipe_screen *screen)
 
    lp_build_init(); /* get lp_native_vector_width initialised */
 
+#ifndef USE_GLOBAL_LLVM_CONTEXT
+   /* Variants compiled in the background each get an LLVM context of their
+    * own, so this is not an option with the global one.  Without the queue
+    * they are compiled at draw time.
+    */
+   if (!(LP_PERF & PERF_NO_ASYNC_COMPILE)) {
+      const unsigned nr_cpus = util_get_cpu_caps()->nr_cpus;
+      util_queue_init(&screen->compile_queue, "lpcomp", 64,
+                      MAX2(nr_cpus - 1, 1), UTIL_QUEUE_INIT_RESIZE_IF_FULL,
+                      NULL);
+   }
+#endif
+
    lp_disk_cache_create(screen);
    screen->late_init_done = true;
 out:
@@ -1175,6 +1223,7 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
 
    screen->base.get_disk_shader_cache = lp_get_disk_shader_cache;
    llvmpipe_init_screen_resource_funcs(&screen->base);
+   llvmpipe_init_screen_fs_funcs(&screen->base);
 
    screen->allow_cl = !!getenv("LP_CL");
    screen->num_threads = util_get_cpu_caps()->nr_cpus > 1
@@ -1183,6 +1232,17 @@ llvmpipe_create_screen(struct sw_winsys *winsys)
                                               screen->num_threads);
    screen->num_threads = MIN2(screen->num_threads, LP_MAX_THREADS);
 
+   /* LP_THREAD_AFFINITY=l3 spreads the rasterizer and compute threads over
+    * the L3 caches (CCXs, sockets) of the machine, each run of consecutive
+    * threads pinned to one of them.
+    */
+   screen->num_thread_domains = 1;
+   if (screen->num_threads &&
+       !strcmp(debug_get_option("LP_THREAD_AFFINITY", "none"), "l3"))
+      screen->num_thread_domains = MAX2(util_get_cpu_caps()->num_L3_caches, 1);
+
+   llvmpipe_init_screen_query_funcs(screen);
+
 #if defined(HAVE_LIBDRM) && defined(HAVE_LINUX_UDMABUF_H)
    screen->udmabuf_fd = open("/dev/udmabuf", O_RDWR);
    llvmpipe_init_screen_fence_funcs(&screen->base);
@@ -37,10 +37,12 @@
 #include "pipe/p_screen.h"
 #include "pipe/p_defines.h"
 #include "util/u_thread.h"
+#include "util/u_queue.h"
 #include "util/list.h"
 #include "util/vma.h"
 #include "gallivm/lp_bld.h"
 #include "gallivm/lp_bld_misc.h"
+#include "lp_limits.h"
 
 struct sw_winsys;
 struct lp_cs_tpool;
@@ -52,17 +54,28 @@ struct llvmpipe_screen
    struct sw_winsys *winsys;
 
    unsigned num_threads;
+   /** L3 cache domains the threads are pinned to, 1 if they aren't */
+   unsigned num_thread_domains;
+
+   /** Names of the per-thread driver queries, see lp_query.c */
+   char thread_query_names[LP_MAX_THREADS][2][32];
 
    /* Increments whenever textures are modified.  Contexts can track this.
     */
    unsigned timestamp;
 
+   /* Increments whenever a texture switches from micro-tiled to linear. */
+   unsigned layout_timestamp;
+
    struct lp_rasterizer *rast;
    mtx_t rast_mutex;
 
    struct lp_cs_tpool *cs_tpool;
    mtx_t cs_mutex;
 
+   /** Compiles shader variants off the draw path, shared by all contexts */
+   struct util_queue compile_queue;
+
    bool allow_cl;
 
    mtx_t late_mutex;
@@ -74,6 +87,9 @@ struct llvmpipe_screen
    char renderer_string[100];
 
    struct disk_cache *disk_shader_cache;
+   /* Shader variants whose machine code was / wasn't found in the disk cache. */
+   unsigned disk_cache_hits;
+   unsigned disk_cache_misses;
 
 #ifdef HAVE_LIBDRM
    int udmabuf_fd;
@@ -106,6 +122,18 @@ bool
 llvmpipe_screen_late_init(struct llvmpipe_screen *screen);
 
 
+void
+lp_thread_set_domain(thrd_t thread, unsigned domain);
+
+
+static inline unsigned
+lp_thread_domain(unsigned thread_index, unsigned num_threads,
+                 unsigned num_domains)
+{
+   return thread_index * num_domains / num_threads;
+}
+
+
 static inline struct llvmpipe_screen *
 llvmpipe_screen(struct pipe_screen *pipe)
 {
@@ -182,6 +182,11 @@ lp_setup_reset(struct lp_setup_context *setup)
    /* no current bin */
    setup->scene = NULL;
 
+   for (unsigned i = 0; i < ARRAY_SIZE(setup->bin_shards); i++) {
+      if (setup->bin_shards[i].scene)
+         lp_scene_shard_detach(setup->bin_shards[i].scene);
+   }
+
    /* Reset some state:
     */
    memset(&setup->clear, 0, sizeof(setup->clear));
@@ -209,16 +214,51 @@ lp_setup_rasterize_scene(struct lp_setup_context *setup)
 
    lp_scene_end_binning(scene);
 
+   lp_fence_reference(&setup->last_fence, scene->fence);
+
+   for (unsigned i = 0; i < LP_PERF_COUNTERS; i++)
+      lp_perf_add(&setup->perf, i, scene->perf.value[i]);
+   lp_perf_add(&setup->perf, LP_PERF_SCENES, 1);
+
    mtx_lock(&screen->rast_mutex);
-   lp_rast_queue_scene(screen->rast, scene);
+   unsigned depth = lp_rast_queue_scene(screen->rast, scene);
    mtx_unlock(&screen->rast_mutex);
 
+   lp_perf_add(&setup->perf, LP_PERF_QUEUE_DEPTH, depth);
+
    lp_setup_reset(setup);
 
    LP_DBG(DEBUG_SETUP, "%s done \n", __func__);
 }
 
 
+/**
+ * Whether to rasterize the current scene before it is full or flushed, so
+ * the rasterizer threads don't sit idle while the rest of the frame is
+ * binned.  Scenes are only streamed when the rasterizer has caught up
+ * with the previous one.  The size at which that is checked adapts: it
+ * grows while the rasterizer is still busy, so that fast binning makes
+ * few large scenes, and shrinks while it's idle, so that the first
+ * pixels of a frame get rasterized early.
+ */
+static bool
+lp_setup_stream_scene(struct lp_setup_context *setup)
+{
+   if (!setup->stream_size ||
+       setup->scene->scene_size < setup->stream_size)
+      return false;
+
+   if (setup->last_fence && !lp_fence_signalled(setup->last_fence)) {
+      setup->stream_size = MIN2(setup->stream_size * 2, LP_SCENE_MAX_SIZE);
+      return false;
+   }
+
+   setup->stream_size = MAX2(setup->stream_size / 2,
+                             LP_SCENE_MIN_STREAM_SIZE);
+   return true;
+}
+
+
 static bool
 begin_binning(struct lp_setup_context *setup)
 {
@@ -1250,6 +1290,14 @@ lp_setup_update_state(struct lp_setup_context *setup,
    if (update_scene && setup->scene) {
       assert(setup->state == SETUP_ACTIVE);
 
+      if (lp_setup_stream_scene(setup)) {
+         if (!set_scene_state(setup, SETUP_FLUSHED, "stream"))
+            return false;
+
+         if (!set_scene_state(setup, SETUP_ACTIVE, __func__))
+            return false;
+      }
+
       if (try_update_scene_state(setup))
          return true;
 
@@ -1314,9 +1362,21 @@ lp_setup_destroy(struct lp_setup_context *setup)
    }
 
    LP_DBG(DEBUG_SETUP, "number of scenes used: %d\n", setup->num_active_scenes);
+
+   lp_fence_reference(&setup->last_fence, NULL);
+
+   if (setup->num_bin_shards)
+      util_queue_destroy(&setup->bin_queue);
+
+   for (unsigned i = 0; i < ARRAY_SIZE(setup->bin_shards); i++) {
+      if (setup->bin_shards[i].scene)
+         lp_scene_destroy(setup->bin_shards[i].scene);
+      util_queue_fence_destroy(&setup->bin_shards[i].fence);
+   }
+
    slab_destroy(&setup->scene_slab);
 
-   FREE(setup);
+   FREE_CL(setup);
 }
 
 
@@ -1330,7 +1390,7 @@ lp_setup_create(struct pipe_context *pipe,
                 struct draw_context *draw)
 {
    struct llvmpipe_screen *screen = llvmpipe_screen(pipe->screen);
-   struct lp_setup_context *setup = CALLOC_STRUCT(lp_setup_context);
+   struct lp_setup_context *setup = CALLOC_STRUCT_CL(lp_setup_context);
    if (!setup) {
       goto no_setup;
    }
@@ -1365,6 +1425,25 @@ lp_setup_create(struct pipe_context *pipe,
    }
    setup->num_active_scenes++;
 
+   /* Bin large triangle lists on as many threads as we rasterize with,
+    * the draw thread included.
+    */
+   for (unsigned i = 0; i < ARRAY_SIZE(setup->bin_shards); i++)
+      util_queue_fence_init(&setup->bin_shards[i].fence);
+
+   if (setup->num_threads > 1 && !(LP_PERF & PERF_NO_PARALLEL_BIN)) {
+      setup->num_bin_shards = MIN2(setup->num_threads, LP_MAX_BIN_SHARDS);
+      if (!util_queue_init(&setup->bin_queue, "lpbin", LP_MAX_BIN_SHARDS,
+                           setup->num_bin_shards - 1, 0, NULL))
+         setup->num_bin_shards = 0;
+   }
+
+   /* With no rasterizer threads scenes get rasterized on this one, so
+    * there is nothing to overlap.
+    */
+   if (setup->num_threads && !(LP_PERF & PERF_NO_STREAM))
+      setup->stream_size = LP_SCENE_MIN_STREAM_SIZE;
+
    setup->triangle = first_triangle;
    setup->line     = first_line;
    setup->point    = first_point;
@@ -1386,12 +1465,44 @@ no_scenes:
 
    setup->vbuf->destroy(setup->vbuf);
 no_vbuf:
-   FREE(setup);
+   FREE_CL(setup);
 no_setup:
    return NULL;
 }
 
 
+/**
+ * Have the rasterizer read the counters of a driver-specific query when it
+ * starts or finishes the current scene.
+ */
+static bool
+bin_perf_query(struct lp_setup_context *setup,
+               struct llvmpipe_query *pq,
+               bool end)
+{
+   assert(setup->scene);
+   if (!setup->scene)
+      return false;
+
+   struct lp_scene_perf_query *ref =
+      lp_scene_alloc(setup->scene, sizeof(*ref));
+   if (!ref) {
+      if (!lp_setup_flush_and_restart(setup))
+         return false;
+
+      ref = lp_scene_alloc(setup->scene, sizeof(*ref));
+      if (!ref)
+         return false;
+   }
+
+   ref->query = pq;
+   ref->end = end;
+   ref->next = setup->scene->perf_queries;
+   setup->scene->perf_queries = ref;
+   return true;
+}
+
+
 /**
  * Put a BeginQuery command into all bins.
  */
@@ -1401,6 +1512,11 @@ lp_setup_begin_query(struct lp_setup_context *setup,
 {
    set_scene_state(setup, SETUP_ACTIVE, "begin_query");
 
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC) {
+      bin_perf_query(setup, pq, false);
+      return;
+   }
+
    if (!(pq->type == PIPE_QUERY_OCCLUSION_COUNTER ||
          pq->type == PIPE_QUERY_OCCLUSION_PREDICATE ||
          pq->type == PIPE_QUERY_OCCLUSION_PREDICATE_CONSERVATIVE ||
@@ -1438,6 +1554,65 @@ lp_setup_begin_query(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Accumulate the binning side of the context's lp_perf_counters into
+ * \p value, including the scene being binned.
+ */
+void
+lp_setup_get_perf_counters(struct lp_setup_context *setup,
+                           uint64_t *value)
+{
+   lp_perf_sum(value, &setup->perf);
+   if (setup->scene)
+      lp_perf_sum(value, &setup->scene->perf);
+}
+
+
+/**
+ * Accumulate the rasterizer threads' lp_perf_counters into \p value, or
+ * only those of thread \p thread if it isn't negative.
+ */
+void
+lp_setup_get_rast_perf_counters(struct lp_setup_context *setup,
+                                int thread,
+                                uint64_t *value)
+{
+   if (thread >= 0) {
+      lp_perf_sum(value, &setup->rast_perf[thread].perf);
+      return;
+   }
+
+   for (unsigned i = 0; i < MAX2(setup->num_threads, 1); i++)
+      lp_perf_sum(value, &setup->rast_perf[i].perf);
+}
+
+
+/**
+ * Read the rasterizer counters of the driver-specific queries beginning
+ * (\p end false) or ending in a scene.  Called by the rasterizer before it
+ * starts the scene, or once all threads are done with it.  Scenes of a
+ * context are rasterized one at a time, so this captures exactly the
+ * scenes the query spans.
+ */
+void
+lp_setup_read_perf_queries(struct lp_scene *scene, bool end)
+{
+   for (struct lp_scene_perf_query *ref = scene->perf_queries;
+        ref; ref = ref->next) {
+      if (ref->end != end)
+         continue;
+
+      struct llvmpipe_query *pq = ref->query;
+      uint64_t value[LP_PERF_COUNTERS] = { 0 };
+      uint64_t *dst = end ? pq->end : pq->start;
+
+      lp_setup_get_rast_perf_counters(scene->setup, pq->perf_thread, value);
+      dst[LP_PERF_RAST_TIME] = value[LP_PERF_RAST_TIME];
+      dst[LP_PERF_IDLE_TIME] = value[LP_PERF_IDLE_TIME];
+   }
+}
+
+
 /**
  * Put an EndQuery command into all bins.
  */
@@ -1446,6 +1621,10 @@ lp_setup_end_query(struct lp_setup_context *setup, struct llvmpipe_query *pq)
 {
    set_scene_state(setup, SETUP_ACTIVE, "end_query");
 
+   /* may have to start a new scene */
+   if (pq->type >= PIPE_QUERY_DRIVER_SPECIFIC)
+      bin_perf_query(setup, pq, true);
+
    assert(setup->scene);
    if (setup->scene) {
       /* pq->fence should be the fence of the *last* scene which
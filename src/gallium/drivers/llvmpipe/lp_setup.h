@@ -44,6 +44,7 @@ struct llvmpipe_query;
 struct pipe_fence_handle;
 struct lp_setup_variant;
 struct lp_setup_context;
+struct lp_scene;
 
 void
 lp_setup_reset(struct lp_setup_context *setup);
@@ -154,6 +155,18 @@ void
 lp_setup_end_query(struct lp_setup_context *setup,
                    struct llvmpipe_query *pq);
 
+void
+lp_setup_get_perf_counters(struct lp_setup_context *setup,
+                           uint64_t *value);
+
+void
+lp_setup_get_rast_perf_counters(struct lp_setup_context *setup,
+                                int thread,
+                                uint64_t *value);
+
+void
+lp_setup_read_perf_queries(struct lp_scene *scene, bool end);
+
 static inline unsigned
 lp_clamp_viewport_idx(int idx)
 {
@@ -44,6 +44,8 @@
 #include "util/u_rect.h"
 #include "util/u_pack_color.h"
 #include "util/slab.h"
+#include "util/u_queue.h"
+#include "util/u_memory.h"
 
 #define LP_SETUP_NEW_FS          0x01
 #define LP_SETUP_NEW_CONSTANTS   0x02
@@ -59,6 +61,35 @@ struct lp_setup_variant;
 #define INITIAL_SCENES 4
 #define MAX_SCENES 64
 
+/** Max number of threads binning one triangle list */
+#define LP_MAX_BIN_SHARDS 16
+
+/** Fewest triangles worth binning on a thread of their own */
+#define LP_MIN_BIN_SHARD_TRIS 64
+
+
+/**
+ * A range of a triangle list, binned into a scene shard by one of the
+ * setup threads.
+ */
+struct lp_setup_bin_shard
+{
+   struct util_queue_fence fence;
+   struct lp_setup_context *setup;
+   struct lp_scene *scene;
+
+   const void *vertex_buffer;
+   unsigned stride;
+   const uint16_t *indices;   /**< NULL for non-indexed lists */
+   unsigned start, end;       /**< range of triangles to bin */
+   unsigned failed;           /**< first triangle that didn't fit, or end */
+};
+
+
+/** Counters of one rasterizer thread, on cache lines of their own */
+struct lp_rast_perf_counters {
+   alignas(CACHE_LINE_SIZE) struct lp_perf_counters perf;
+};
 
 
 /**
@@ -96,9 +127,23 @@ struct lp_setup_context
    struct lp_scene *scenes[MAX_SCENES];  /**< all the scenes */
    struct lp_scene *scene;               /**< current scene being built */
 
+   /** Scene size at which to start rasterizing early, 0 if never */
+   unsigned stream_size;
+   struct lp_fence *last_fence;          /**< of the last queued scene */
+
+   /** Setup threads for binning large triangle lists in parallel */
+   struct util_queue bin_queue;
+   unsigned num_bin_shards;
+   struct lp_setup_bin_shard bin_shards[LP_MAX_BIN_SHARDS];
+
    struct llvmpipe_query *active_queries[LP_MAX_ACTIVE_BINNED_QUERIES];
    unsigned active_binned_queries;
 
+   /** Counters updated by the thread driving this context */
+   struct lp_perf_counters perf;
+   /** Counters updated by each rasterizer thread for this context's scenes */
+   struct lp_rast_perf_counters rast_perf[LP_MAX_THREADS];
+
    unsigned flatshade_first:1;
    unsigned ccw_is_frontface:1;
    unsigned scissor_test:1;
@@ -244,6 +289,7 @@ lp_setup_flush_and_restart(struct lp_setup_context *setup);
 
 bool
 lp_setup_whole_tile(struct lp_setup_context *setup,
+                    struct lp_scene *scene,
                     const struct lp_rast_shader_inputs *inputs,
                     int tx, int ty, bool opaque);
 
@@ -293,6 +339,7 @@ lp_setup_analyse_triangles(struct lp_setup_context *setup,
 
 bool
 lp_setup_bin_triangle(struct lp_setup_context *setup,
+                      struct lp_scene *scene,
                       struct lp_rast_triangle *tri,
                       bool use_32bits,
                       bool opaque,
@@ -300,6 +347,13 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                       int nr_planes,
                       unsigned scissor_index);
 
+bool
+lp_setup_bin_triangles(struct lp_setup_context *setup,
+                       const void *vertex_buffer,
+                       unsigned stride,
+                       const uint16_t *indices,
+                       unsigned nr);
+
 bool
 lp_setup_bin_rectangle(struct lp_setup_context *setup,
                        struct lp_rast_rectangle *rect,
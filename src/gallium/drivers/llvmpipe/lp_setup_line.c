@@ -718,7 +718,7 @@ try_setup_line(struct lp_setup_context *setup,
                                   setup->multisample);
    }
 
-   return lp_setup_bin_triangle(setup, line, use_32bits, false,
+   return lp_setup_bin_triangle(setup, scene, line, use_32bits, false,
                                 &bboxpos, nr_planes, viewport_index);
 }
 
@@ -545,7 +545,7 @@ try_setup_point(struct lp_setup_context *setup,
                         (bbox.y1 - (bbox.y0 & ~3)));
       bool use_32bits = max_szorig <= MAX_FIXED_LENGTH32;
 
-      return lp_setup_bin_triangle(setup, point, use_32bits,
+      return lp_setup_bin_triangle(setup, scene, point, use_32bits,
                                    setup->fs.current.variant->opaque,
                                    &bbox, nr_planes, viewport_index);
 
@@ -273,14 +273,13 @@ check_opaque(const struct lp_setup_context *setup,
  */
 static bool
 do_triangle_ccw(struct lp_setup_context *setup,
+                struct lp_scene *scene,
                 struct fixed_position *position,
                 const float (*v0)[4],
                 const float (*v1)[4],
                 const float (*v2)[4],
                 bool frontfacing)
 {
-   struct lp_scene *scene = setup->scene;
-
    const float (*pv)[4];
    if (setup->flatshade_first) {
       pv = v0;
@@ -326,6 +325,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
    if (!u_rect_test_intersection(&setup->draw_regions[viewport_index], &bbox)) {
       if (0) debug_printf("no intersection\n");
       LP_COUNT(nr_culled_tris);
+      scene->perf.value[LP_PERF_CULLED_TRIANGLES]++;
       return true;
    }
 
@@ -371,6 +371,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
 #endif
 
    LP_COUNT(nr_tris);
+   scene->perf.value[LP_PERF_TRIANGLES]++;
 
    /*
     * Rotate the tri such that v0 is closest to the fb origin.
@@ -744,7 +745,7 @@ do_triangle_ccw(struct lp_setup_context *setup,
                                   s_planes, setup->multisample);
    }
 
-   return lp_setup_bin_triangle(setup, tri, use_32bits,
+   return lp_setup_bin_triangle(setup, scene, tri, use_32bits,
                                 check_opaque(setup, v0, v1, v2),
                                 &bbox, nr_planes, viewport_index);
 }
@@ -779,6 +780,7 @@ floor_pot(uint32_t n)
 
 bool
 lp_setup_bin_triangle(struct lp_setup_context *setup,
+                      struct lp_scene *scene,
                       struct lp_rast_triangle *tri,
                       bool use_32bits,
                       bool opaque,
@@ -786,7 +788,6 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                       int nr_planes,
                       unsigned viewport_index)
 {
-   struct lp_scene *scene = setup->scene;
    unsigned cmd;
 
    /* What is the largest power-of-two boundary this triangle crosses:
@@ -966,11 +967,14 @@ lp_setup_bin_triangle(struct lp_setup_context *setup,
                   goto fail;
 
                LP_COUNT(nr_partially_covered_64);
+               scene->perf.value[LP_PERF_PARTIALLY_COVERED_64]++;
             } else {
                /* triangle covers the whole tile- shade whole tile */
                LP_COUNT(nr_fully_covered_64);
+               scene->perf.value[LP_PERF_FULLY_COVERED_64]++;
                in = true;
-               if (!lp_setup_whole_tile(setup, &tri->inputs, x, y, opaque))
+               if (!lp_setup_whole_tile(setup, scene, &tri->inputs,
+                                        x, y, opaque))
                   goto fail;
             }
 
@@ -1014,14 +1018,15 @@ retry_triangle_ccw(struct lp_setup_context *setup,
    if (lp_setup_zero_sample_mask(setup)) {
       if (0) debug_printf("zero sample mask\n");
       LP_COUNT(nr_culled_tris);
+      setup->scene->perf.value[LP_PERF_CULLED_TRIANGLES]++;
       return;
    }
 
-   if (!do_triangle_ccw(setup, position, v0, v1, v2, front)) {
+   if (!do_triangle_ccw(setup, setup->scene, position, v0, v1, v2, front)) {
       if (!lp_setup_flush_and_restart(setup))
          return;
 
-      if (!do_triangle_ccw(setup, position, v0, v1, v2, front))
+      if (!do_triangle_ccw(setup, setup->scene, position, v0, v1, v2, front))
          return;
    }
 }
@@ -1252,6 +1257,174 @@ triangle_noop(struct lp_setup_context *setup,
 }
 
 
+/**
+ * Cull and bin a triangle into a scene shard, like setup->triangle does
+ * into the scene.  A shard can't be flushed when it runs out of memory,
+ * so this fails instead.
+ */
+static bool
+shard_triangle(struct lp_setup_context *setup,
+               struct lp_scene *shard,
+               const float (*v0)[4],
+               const float (*v1)[4],
+               const float (*v2)[4])
+{
+   alignas(16) struct fixed_position position;
+
+   int8_t area_sign = calc_fixed_position(setup, &position, v0, v1, v2);
+
+   if (area_sign > 0) {
+      if (setup->triangle == triangle_cw)
+         return true;
+
+      return do_triangle_ccw(setup, shard, &position, v0, v1, v2,
+                             setup->ccw_is_frontface);
+   } else if (area_sign < 0) {
+      if (setup->triangle == triangle_ccw)
+         return true;
+
+      if (setup->flatshade_first) {
+         rotate_fixed_position_12(&position);
+         return do_triangle_ccw(setup, shard, &position, v0, v2, v1,
+                                !setup->ccw_is_frontface);
+      } else {
+         rotate_fixed_position_01(&position);
+         return do_triangle_ccw(setup, shard, &position, v1, v0, v2,
+                                !setup->ccw_is_frontface);
+      }
+   }
+
+   return true;
+}
+
+
+typedef const float (*const_float4_ptr)[4];
+
+
+static inline const_float4_ptr
+shard_vert(const struct lp_setup_bin_shard *shard, unsigned i)
+{
+   unsigned index = shard->indices ? shard->indices[i] : i;
+   return (const_float4_ptr)((const char *)shard->vertex_buffer +
+                             index * shard->stride);
+}
+
+
+static void
+bin_shard(struct lp_setup_bin_shard *shard)
+{
+   for (unsigned i = shard->start; i < shard->end; i++) {
+      if (!shard_triangle(shard->setup, shard->scene,
+                          shard_vert(shard, i * 3 + 0),
+                          shard_vert(shard, i * 3 + 1),
+                          shard_vert(shard, i * 3 + 2))) {
+         shard->failed = i;
+         return;
+      }
+   }
+}
+
+
+static void
+bin_shard_execute(void *data, void *gdata, int thread_index)
+{
+   /* Match the denorm handling draw_vbo() sets up for the draw thread */
+   util_fpstate_set_denorms_to_zero(util_fpstate_get());
+
+   bin_shard(data);
+}
+
+
+/**
+ * Bin a list of \p nr triangle vertices on several threads.  Each one bins
+ * a contiguous range of the triangles into a shard of the scene, and the
+ * shards are then appended to the scene's bins in order, so every bin
+ * still sees its triangles in API order.
+ *
+ * Returns false if the triangles should be binned one by one instead.
+ */
+bool
+lp_setup_bin_triangles(struct lp_setup_context *setup,
+                       const void *vertex_buffer,
+                       unsigned stride,
+                       const uint16_t *indices,
+                       unsigned nr)
+{
+   struct lp_scene *scene = setup->scene;
+   const unsigned num_tris = nr / 3;
+   const unsigned num_shards =
+      MIN2(setup->num_bin_shards, num_tris / LP_MIN_BIN_SHARD_TRIS);
+
+   if (num_shards < 2 ||
+       (setup->triangle != triangle_both &&
+        setup->triangle != triangle_ccw &&
+        setup->triangle != triangle_cw) ||
+       lp_setup_zero_sample_mask(setup))
+      return false;
+
+   for (unsigned i = 0; i < num_shards; i++) {
+      struct lp_setup_bin_shard *shard = &setup->bin_shards[i];
+
+      if (!shard->scene) {
+         shard->scene = lp_scene_create(setup);
+         if (!shard->scene)
+            return false;
+      }
+
+      if (!lp_scene_shard_begin(shard->scene, scene, num_shards))
+         return false;
+
+      shard->setup = setup;
+      shard->vertex_buffer = vertex_buffer;
+      shard->stride = stride;
+      shard->indices = indices;
+      shard->start = num_tris * i / num_shards;
+      shard->end = num_tris * (i + 1) / num_shards;
+      shard->failed = shard->end;
+   }
+
+   for (unsigned i = 1; i < num_shards; i++) {
+      util_queue_add_job(&setup->bin_queue, &setup->bin_shards[i],
+                         &setup->bin_shards[i].fence,
+                         bin_shard_execute, NULL, 0);
+   }
+
+   bin_shard(&setup->bin_shards[0]);
+
+   for (unsigned i = 1; i < num_shards; i++)
+      util_queue_fence_wait(&setup->bin_shards[i].fence);
+
+   /* Keep everything up to the first shard that ran out of memory.  The
+    * rest is thrown away and binned again below, flushing the scene as
+    * needed.
+    */
+   unsigned num_binned = num_tris;
+   for (unsigned i = 0; i < num_shards; i++) {
+      struct lp_setup_bin_shard *shard = &setup->bin_shards[i];
+
+      if (num_binned == num_tris && shard->failed == shard->end) {
+         lp_scene_shard_merge(scene, shard->scene);
+      } else {
+         num_binned = MIN2(num_binned, shard->start);
+         lp_scene_shard_discard(shard->scene);
+      }
+   }
+
+   struct llvmpipe_context *lp_context = llvmpipe_context(setup->pipe);
+   if (lp_context->active_statistics_queries)
+      lp_context->pipeline_statistics.c_primitives += num_binned;
+
+   for (unsigned i = num_binned; i < num_tris; i++) {
+      setup->triangle(setup,
+                      shard_vert(&setup->bin_shards[0], i * 3 + 0),
+                      shard_vert(&setup->bin_shards[0], i * 3 + 1),
+                      shard_vert(&setup->bin_shards[0], i * 3 + 2));
+   }
+
+   return true;
+}
+
+
 void
 lp_setup_choose_triangle(struct lp_setup_context *setup)
 {
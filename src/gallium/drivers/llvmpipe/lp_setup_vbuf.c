@@ -44,6 +44,7 @@
 #include "util/u_math.h"
 #include "lp_state_fs.h"
 #include "lp_perf.h"
+#include "util/os_time.h"
 
 
 /* It should be a multiple of both 6 and 4 (in other words, a multiple of 12)
@@ -169,7 +170,7 @@ rect(struct lp_setup_context *setup,
  * draw elements / indexed primitives
  */
 static void
-lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr)
+draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr)
 {
    struct lp_setup_context *setup = lp_setup_context(vbr);
    const unsigned stride = setup->vertex_info->size * sizeof(float);
@@ -223,7 +224,11 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr
       break;
 
    case MESA_PRIM_TRIANGLES:
-      if (nr % 6 == 0 && !uses_constant_interp) {
+      if ((!setup->permit_linear_rasterizer ||
+           nr % 6 != 0 || uses_constant_interp) &&
+          lp_setup_bin_triangles(setup, vertex_buffer, stride, indices, nr)) {
+         /* binned on the setup threads, if there are no rects to find */
+      } else if (nr % 6 == 0 && !uses_constant_interp) {
          for (i = 5; i < nr; i += 6) {
             rect(setup,
                  get_vert(vertex_buffer, indices[i-5], stride),
@@ -378,7 +383,7 @@ lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr
  * It's up to us to convert the vertex array into point/line/tri prims.
  */
 static void
-lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
+draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
 {
    struct lp_setup_context *setup = lp_setup_context(vbr);
    const unsigned stride = setup->vertex_info->size * sizeof(float);
@@ -431,7 +436,11 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
       break;
 
    case MESA_PRIM_TRIANGLES:
-      if (nr % 6 == 0 && !uses_constant_interp) {
+      if ((!setup->permit_linear_rasterizer ||
+           nr % 6 != 0 || uses_constant_interp) &&
+          lp_setup_bin_triangles(setup, vertex_buffer, stride, NULL, nr)) {
+         /* binned on the setup threads, if there are no rects to find */
+      } else if (nr % 6 == 0 && !uses_constant_interp) {
          for (i = 5; i < nr; i += 6) {
             rect(setup,
                  get_vert(vertex_buffer, i-5, stride),
@@ -635,6 +644,30 @@ lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
 }
 
 
+static void
+lp_setup_draw_elements(struct vbuf_render *vbr, const uint16_t *indices, uint nr)
+{
+   struct lp_setup_context *setup = lp_setup_context(vbr);
+   int64_t t0 = os_time_get_nano();
+
+   draw_elements(vbr, indices, nr);
+
+   lp_perf_add(&setup->perf, LP_PERF_BIN_TIME, os_time_get_nano() - t0);
+}
+
+
+static void
+lp_setup_draw_arrays(struct vbuf_render *vbr, uint start, uint nr)
+{
+   struct lp_setup_context *setup = lp_setup_context(vbr);
+   int64_t t0 = os_time_get_nano();
+
+   draw_arrays(vbr, start, nr);
+
+   lp_perf_add(&setup->perf, LP_PERF_BIN_TIME, os_time_get_nano() - t0);
+}
+
+
 static void
 lp_setup_vbuf_destroy(struct vbuf_render *vbr)
 {
@@ -161,12 +161,22 @@ llvmpipe_init_draw_funcs(struct llvmpipe_context *llvmpipe);
 void
 llvmpipe_init_compute_funcs(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_cs_finish_pending(struct llvmpipe_context *llvmpipe);
+
+unsigned
+llvmpipe_cs_is_resource_referenced(struct llvmpipe_context *llvmpipe,
+                                   const struct pipe_resource *resource);
+
 void
 llvmpipe_init_clip_funcs(struct llvmpipe_context *llvmpipe);
 
 void
 llvmpipe_init_fs_funcs(struct llvmpipe_context *llvmpipe);
 
+void
+llvmpipe_init_screen_fs_funcs(struct pipe_screen *screen);
+
 void
 llvmpipe_init_vs_funcs(struct llvmpipe_context *llvmpipe);
 
@@ -43,6 +43,7 @@
 #include "lp_state.h"
 #include "lp_perf.h"
 #include "lp_screen.h"
+#include "lp_texture.h"
 #include "lp_memory.h"
 #include "lp_query.h"
 #include "lp_cs_tpool.h"
@@ -1008,6 +1009,9 @@ llvmpipe_remove_cs_shader_variant(struct llvmpipe_context *lp,
                    lp->nr_cs_variants, variant->nr_instrs, lp->nr_cs_instrs);
    }
 
+   /* A running dispatch may still be using it. */
+   llvmpipe_cs_finish_pending(lp);
+
    gallivm_destroy(variant->gallivm);
 
    /* remove from shader's list */
@@ -1088,16 +1092,16 @@ make_variant_key(struct llvmpipe_context *lp,
           * used views may be included in the shader key.
           */
          if (BITSET_TEST(nir->info.textures_used, i)) {
-            lp_sampler_static_texture_state(&cs_sampler[i].texture_state,
-                                            lp->sampler_views[sh_type][i]);
+            lp_llvm_texture_static_state(&cs_sampler[i].texture_state,
+                                         lp->sampler_views[sh_type][i]);
          }
       }
    } else {
       key->nr_sampler_views = key->nr_samplers;
       for (unsigned i = 0; i < key->nr_sampler_views; ++i) {
          if (BITSET_TEST(nir->info.samplers_used, i)) {
-            lp_sampler_static_texture_state(&cs_sampler[i].texture_state,
-                                            lp->sampler_views[sh_type][i]);
+            lp_llvm_texture_static_state(&cs_sampler[i].texture_state,
+                                         lp->sampler_views[sh_type][i]);
          }
       }
    }
@@ -1111,8 +1115,8 @@ make_variant_key(struct llvmpipe_context *lp,
              key->nr_images * sizeof *lp_image);
    for (unsigned i = 0; i < key->nr_images; ++i) {
       if (BITSET_TEST(nir->info.images_used, i)) {
-         lp_sampler_static_texture_state_image(&lp_image[i].image_state,
-                                               &lp->images[sh_type][i]);
+         lp_llvm_image_static_state(&lp_image[i].image_state,
+                                    &lp->images[sh_type][i]);
       }
    }
    return key;
@@ -1387,6 +1391,8 @@ llvmpipe_update_cs_variant(struct llvmpipe_context *lp,
       variant = generate_variant(lp, shader, sh_type, key);
       t1 = os_time_get();
       dt = t1 - t0;
+      lp_perf_add_shared(&lp->perf, LP_PERF_COMPILES, 1);
+      lp_perf_add_shared(&lp->perf, LP_PERF_COMPILE_TIME, dt);
       LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
@@ -1591,6 +1597,8 @@ update_csctx_ssbo(struct llvmpipe_context *llvmpipe,
 static void
 llvmpipe_cs_update_derived(struct llvmpipe_context *llvmpipe, const void *input)
 {
+   llvmpipe_check_texture_layouts(llvmpipe);
+
    if (llvmpipe->cs_dirty & LP_CSNEW_CONSTANTS) {
       lp_csctx_set_cs_constants(llvmpipe->csctx,
                                 ARRAY_SIZE(llvmpipe->constants[PIPE_SHADER_COMPUTE]),
@@ -1724,6 +1732,166 @@ fill_grid_size(struct pipe_context *pipe,
 }
 
 
+/**
+ * A dispatch left running on the compute thread pool.  It has its own copy
+ * of the state it was launched with, and holds references to the resources
+ * it reads and writes until it completes, so the context can go on to
+ * record the next dispatch meanwhile.
+ *
+ * Dispatches only wait for each other when a resource written by one is
+ * bound for the next (see llvmpipe_flush_resource()), or at a flush, which
+ * is what memory barriers and every pipeline barrier in lavapipe come down
+ * to.  Anything else done by the context waits for all of them.
+ */
+struct lp_cs_job {
+   struct lp_cs_job_info info;
+   struct lp_cs_exec exec;
+   struct lp_cs_tpool_task *task;
+
+   unsigned num_reads;
+   unsigned num_writes;
+   struct pipe_resource *reads[LP_MAX_TGSI_CONST_BUFFERS +
+                               PIPE_MAX_SHADER_SAMPLER_VIEWS +
+                               LP_MAX_TGSI_SHADER_IMAGES];
+   struct pipe_resource *writes[LP_MAX_TGSI_SHADER_BUFFERS +
+                                LP_MAX_TGSI_SHADER_IMAGES];
+};
+
+
+static bool
+csctx_has_user_constants(const struct lp_cs_context *csctx)
+{
+   for (unsigned i = 0; i < ARRAY_SIZE(csctx->constants); i++) {
+      if (csctx->constants[i].current.user_buffer)
+         return true;
+   }
+   return false;
+}
+
+
+static void
+lp_cs_job_add_resource(struct pipe_resource **list, unsigned *num,
+                       struct pipe_resource *res)
+{
+   if (!res)
+      return;
+
+   list[*num] = NULL;
+   pipe_resource_reference(&list[(*num)++], res);
+}
+
+
+static struct lp_cs_job *
+lp_cs_job_create(struct lp_cs_context *csctx,
+                 const struct lp_cs_job_info *info)
+{
+   struct lp_cs_job *job;
+   unsigned i;
+
+   /* Display targets are unmapped as soon as they are unbound. */
+   for (i = 0; i < csctx->cs.current_tex_num; i++) {
+      if (csctx->cs.current_tex[i] &&
+          llvmpipe_resource(csctx->cs.current_tex[i])->dt)
+         return NULL;
+   }
+
+   job = MALLOC_STRUCT(lp_cs_job);
+   if (!job)
+      return NULL;
+
+   job->exec = csctx->cs.current;
+   job->info = *info;
+   job->info.current = &job->exec;
+   job->task = NULL;
+   job->num_reads = 0;
+   job->num_writes = 0;
+
+   for (i = 0; i < ARRAY_SIZE(csctx->constants); i++)
+      lp_cs_job_add_resource(job->reads, &job->num_reads,
+                             csctx->constants[i].current.buffer);
+   for (i = 0; i < csctx->cs.current_tex_num; i++)
+      lp_cs_job_add_resource(job->reads, &job->num_reads,
+                             csctx->cs.current_tex[i]);
+   for (i = 0; i < ARRAY_SIZE(csctx->ssbos); i++)
+      lp_cs_job_add_resource(job->writes, &job->num_writes,
+                             csctx->ssbos[i].current.buffer);
+   for (i = 0; i < ARRAY_SIZE(csctx->images); i++) {
+      const struct pipe_image_view *image = &csctx->images[i].current;
+
+      if (image->access & PIPE_IMAGE_ACCESS_WRITE)
+         lp_cs_job_add_resource(job->writes, &job->num_writes, image->resource);
+      else
+         lp_cs_job_add_resource(job->reads, &job->num_reads, image->resource);
+   }
+
+   return job;
+}
+
+
+static void
+lp_cs_job_destroy(struct lp_cs_job *job)
+{
+   for (unsigned i = 0; i < job->num_reads; i++)
+      pipe_resource_reference(&job->reads[i], NULL);
+   for (unsigned i = 0; i < job->num_writes; i++)
+      pipe_resource_reference(&job->writes[i], NULL);
+   FREE(job);
+}
+
+
+static void
+lp_cs_finish_oldest(struct llvmpipe_context *llvmpipe)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(llvmpipe->pipe.screen);
+   struct lp_cs_job *job = llvmpipe->cs_pending[0];
+
+   lp_cs_tpool_wait_for_task(screen->cs_tpool, &job->task);
+   lp_cs_job_destroy(job);
+
+   llvmpipe->num_cs_pending--;
+   memmove(&llvmpipe->cs_pending[0], &llvmpipe->cs_pending[1],
+           llvmpipe->num_cs_pending * sizeof(llvmpipe->cs_pending[0]));
+}
+
+
+/**
+ * Wait for all the dispatches of the context to complete.
+ */
+void
+llvmpipe_cs_finish_pending(struct llvmpipe_context *llvmpipe)
+{
+   while (llvmpipe->num_cs_pending)
+      lp_cs_finish_oldest(llvmpipe);
+}
+
+
+/**
+ * Return LP_REFERENCED_FOR_READ/WRITE flags indicating how a resource is
+ * accessed by the dispatches of the context that are still running.
+ */
+unsigned
+llvmpipe_cs_is_resource_referenced(struct llvmpipe_context *llvmpipe,
+                                   const struct pipe_resource *resource)
+{
+   unsigned referenced = 0;
+
+   for (unsigned i = 0; i < llvmpipe->num_cs_pending; i++) {
+      const struct lp_cs_job *job = llvmpipe->cs_pending[i];
+
+      for (unsigned j = 0; j < job->num_writes; j++) {
+         if (job->writes[j] == resource)
+            return LP_REFERENCED_FOR_READ | LP_REFERENCED_FOR_WRITE;
+      }
+      for (unsigned j = 0; j < job->num_reads; j++) {
+         if (job->reads[j] == resource)
+            referenced |= LP_REFERENCED_FOR_READ;
+      }
+   }
+
+   return referenced;
+}
+
+
 static void
 llvmpipe_launch_grid(struct pipe_context *pipe,
                      const struct pipe_grid_info *info)
@@ -1754,12 +1922,35 @@ llvmpipe_launch_grid(struct pipe_context *pipe,
 
    int num_tasks = job_info.grid_size[2] * job_info.grid_size[1] * job_info.grid_size[0];
    if (num_tasks) {
-      struct lp_cs_tpool_task *task;
-      mtx_lock(&screen->cs_mutex);
-      task = lp_cs_tpool_queue_task(screen->cs_tpool, cs_exec_fn, &job_info, num_tasks);
-      mtx_unlock(&screen->cs_mutex);
+      struct lp_cs_job *job = NULL;
+
+      /* Kernel inputs and user constant buffers only live for the duration
+       * of the call, such dispatches complete before returning.
+       */
+      if (!info->input && !csctx_has_user_constants(llvmpipe->csctx))
+         job = lp_cs_job_create(llvmpipe->csctx, &job_info);
+
+      if (job) {
+         if (llvmpipe->num_cs_pending == LP_MAX_CS_PENDING)
+            lp_cs_finish_oldest(llvmpipe);
+
+         mtx_lock(&screen->cs_mutex);
+         job->task = lp_cs_tpool_queue_task(screen->cs_tpool, cs_exec_fn, &job->info, num_tasks);
+         mtx_unlock(&screen->cs_mutex);
+
+         /* Without worker threads, the dispatch has run already. */
+         if (job->task)
+            llvmpipe->cs_pending[llvmpipe->num_cs_pending++] = job;
+         else
+            lp_cs_job_destroy(job);
+      } else {
+         struct lp_cs_tpool_task *task;
+         mtx_lock(&screen->cs_mutex);
+         task = lp_cs_tpool_queue_task(screen->cs_tpool, cs_exec_fn, &job_info, num_tasks);
+         mtx_unlock(&screen->cs_mutex);
 
-      lp_cs_tpool_wait_for_task(screen->cs_tpool, &task);
+         lp_cs_tpool_wait_for_task(screen->cs_tpool, &task);
+      }
    }
    if (!llvmpipe->queries_disabled)
       llvmpipe->pipeline_statistics.cs_invocations += num_tasks * info->block[0] * info->block[1] * info->block[2];
@@ -2084,6 +2275,8 @@ llvmpipe_draw_mesh_tasks(struct pipe_context *pipe,
    if (!llvmpipe_check_render_cond(lp))
       return;
 
+   llvmpipe_cs_finish_pending(lp);
+
    memset(&job_info, 0, sizeof(job_info));
    if (lp->dirty)
       llvmpipe_update_derived(lp);
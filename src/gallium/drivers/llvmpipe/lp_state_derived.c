@@ -35,6 +35,7 @@
 #include "lp_screen.h"
 #include "lp_setup.h"
 #include "lp_state.h"
+#include "lp_texture.h"
 
 #include "tgsi/tgsi_from_mesa.h"
 
@@ -282,6 +283,8 @@ llvmpipe_update_derived(struct llvmpipe_context *llvmpipe)
       llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
    }
 
+   llvmpipe_check_texture_layouts(llvmpipe);
+
    if (llvmpipe->dirty & (LP_NEW_TASK))
       llvmpipe_update_task_shader(llvmpipe);
 
@@ -68,6 +68,7 @@
 #include "util/u_dual_blend.h"
 #include "util/u_upload_mgr.h"
 #include "util/os_time.h"
+#include "util/u_atomic.h"
 #include "pipe/p_shader_tokens.h"
 #include "draw/draw_context.h"
 #include "nir/tgsi_to_nir.h"
@@ -594,6 +595,10 @@ fs_fb_fetch(const struct lp_build_fs_iface *iface,
          x = (i & 1) + ((i >> 2) << 1);
          if (!key->resource_1d)
             y = (i & 2) >> 1;
+      } else if (block_size == 16) {
+         /* the whole 4x4 block as four 2x2 quads */
+         x = (i & 1) + (((i >> 2) & 1) << 1);
+         y = key->resource_1d ? 0 : ((i & 2) >> 1) + ((i >> 3) << 1);
       }
 
       LLVMValueRef x_val;
@@ -636,6 +641,7 @@ fs_fb_fetch(const struct lp_build_fs_iface *iface,
 static void
 generate_fs_loop(struct gallivm_state *gallivm,
                  struct lp_fragment_shader *shader,
+                 struct nir_shader *nir,
                  const struct lp_fragment_shader_variant_key *key,
                  LLVMBuilderRef builder,
                  struct lp_type type,
@@ -671,7 +677,6 @@ generate_fs_loop(struct gallivm_state *gallivm,
    LLVMValueRef z_out = NULL, s_out = NULL;
    struct lp_build_for_loop_state loop_state, sample_loop_state = {0};
    struct lp_build_mask_context mask;
-   struct nir_shader *nir = shader->base.ir.nir;
    const bool dual_source_blend = key->blend.rt[0].blend_enable &&
                                   util_blend_state_is_dual(&key->blend, 0);
    const bool post_depth_coverage = nir->info.fs.post_depth_coverage;
@@ -3107,13 +3112,13 @@ generate_unswizzled_blend(struct gallivm_state *gallivm,
 static void
 generate_fragment(struct llvmpipe_context *lp,
                   struct lp_fragment_shader *shader,
+                  struct nir_shader *nir,
                   struct lp_fragment_shader_variant *variant,
                   unsigned partial_mask)
 {
    assert(partial_mask == RAST_WHOLE ||
           partial_mask == RAST_EDGE_TEST);
 
-   struct nir_shader *nir = shader->base.ir.nir;
    struct gallivm_state *gallivm = variant->gallivm;
    struct lp_fragment_shader_variant_key *key = &variant->key;
    struct lp_shader_input inputs[PIPE_MAX_SHADER_INPUTS];
@@ -3287,7 +3292,7 @@ generate_fragment(struct llvmpipe_context *lp,
 
    unsigned num_fs = 16 / fs_type.length; /* number of loops per 4x4 stamp */
    /* for 1d resources only run "upper half" of stamp */
-   if (key->resource_1d)
+   if (key->resource_1d && num_fs > 1)
       num_fs /= 2;
 
    {
@@ -3399,7 +3404,7 @@ generate_fragment(struct llvmpipe_context *lp,
       }
 
       generate_fs_loop(gallivm,
-                       shader, key,
+                       shader, nir, key,
                        builder,
                        fs_type,
                        variant->jit_context_type,
@@ -3466,6 +3471,46 @@ generate_fragment(struct llvmpipe_context *lp,
    lp_bld_llvm_sampler_soa_destroy(sampler);
    lp_bld_llvm_image_soa_destroy(image);
 
+   /*
+    * The blend and store code only deals with 4 and 8-wide vectors, so
+    * with 16-wide (AVX-512) shading hand it each 4x4 stamp as two 8-wide
+    * halves (rows 0-1 and 2-3), which is exactly how they are laid out.
+    */
+   struct lp_type blend_fs_type = fs_type;
+   unsigned blend_num_fs = num_fs;
+   unsigned blend_mask_stride = num_fs;
+   if (fs_type.length == 16) {
+      LLVMTypeRef half_vec_type;
+
+      blend_fs_type.length = 8;
+      blend_num_fs = key->resource_1d ? 1 : 2;
+      blend_mask_stride = num_fs * 2;
+      half_vec_type = lp_build_vec_type(gallivm, blend_fs_type);
+
+      for (int idx = num_fs * key->coverage_samples - 1; idx >= 0; idx--) {
+         LLVMValueRef mask = fs_mask[idx];
+         fs_mask[idx * 2] = lp_build_extract_range(gallivm, mask, 0, 8);
+         fs_mask[idx * 2 + 1] = lp_build_extract_range(gallivm, mask, 8, 8);
+      }
+
+      for (unsigned s = 0; s < key->min_samples; s++) {
+         for (unsigned cbuf = 0; cbuf < PIPE_MAX_COLOR_BUFS; cbuf++) {
+            if (cbuf >= key->nr_cbufs && !(cbuf == 1 && dual_source_blend))
+               continue;
+            for (unsigned chan = 0; chan < TGSI_NUM_CHANNELS; ++chan) {
+               LLVMValueRef ptr = fs_out_color[s][cbuf][chan][0];
+               ptr = LLVMBuildBitCast(builder, ptr,
+                                      LLVMPointerType(half_vec_type, 0), "");
+               for (unsigned h = 0; h < blend_num_fs; h++) {
+                  LLVMValueRef index = lp_build_const_int32(gallivm, h);
+                  fs_out_color[s][cbuf][chan][h] =
+                     LLVMBuildGEP2(builder, half_vec_type, ptr, &index, 1, "");
+               }
+            }
+         }
+      }
+   }
+
    /* Loop over color outputs / color buffers to do blending */
    for (unsigned cbuf = 0; cbuf < key->nr_cbufs; cbuf++) {
       if (key->cbuf_format[cbuf] != PIPE_FORMAT_NONE &&
@@ -3499,7 +3544,7 @@ generate_fragment(struct llvmpipe_context *lp,
                                                          &index, 1, ""), "");
 
          for (unsigned s = 0; s < key->cbuf_nr_samples[cbuf]; s++) {
-            unsigned mask_idx = num_fs * (key->multisample ? s : 0);
+            unsigned mask_idx = blend_mask_stride * (key->multisample ? s : 0);
             unsigned out_idx = key->min_samples == 1 ? 0 : s;
             LLVMValueRef out_ptr = color_ptr;
 
@@ -3516,7 +3561,8 @@ generate_fragment(struct llvmpipe_context *lp,
 
             generate_unswizzled_blend(gallivm, cbuf, variant,
                                       key->cbuf_format[cbuf],
-                                      num_fs, fs_type, &fs_mask[mask_idx],
+                                      blend_num_fs, blend_fs_type,
+                                      &fs_mask[mask_idx],
                                       fs_out_color[out_idx],
                                       variant->jit_context_type,
                                       context_ptr, blend_vec_type, out_ptr, stride,
@@ -3711,15 +3757,223 @@ lp_fs_get_ir_cache_key(struct lp_fragment_shader_variant *variant,
 }
 
 
+/**
+ * State handed from generate_variant() to the code generation, which may
+ * run on the screen's compile queue.
+ */
+struct lp_fs_variant_job
+{
+   struct llvmpipe_context *lp;
+   struct lp_fragment_shader_variant *variant;
+   struct nir_shader *nir;
+   bool fullcolormask;
+   bool linear_pipeline;
+   bool has_cache_key;
+   unsigned char ir_sha1_cache_key[20];
+};
+
+
+/**
+ * Stand-in for a variant whose code could not be generated in the
+ * background, at which point its draws have already been binned.
+ */
+static void
+fs_variant_no_op(const struct lp_jit_context *context,
+                 const struct lp_jit_resources *resources,
+                 uint32_t x,
+                 uint32_t y,
+                 uint32_t facing,
+                 const void *a0,
+                 const void *dadx,
+                 const void *dady,
+                 uint8_t **cbufs,
+                 uint8_t *depth,
+                 uint64_t mask,
+                 struct lp_jit_thread_data *thread_data,
+                 unsigned *strides,
+                 unsigned depth_stride,
+                 unsigned *color_sample_stride,
+                 unsigned depth_sample_stride)
+{
+}
+
+
+/**
+ * Generate and compile the code for a variant whose key-derived state
+ * has already been filled in by generate_variant().
+ */
+static bool
+compile_variant(struct lp_fs_variant_job *job)
+{
+   struct llvmpipe_context *lp = job->lp;
+   struct lp_fragment_shader_variant *variant = job->variant;
+   struct lp_fragment_shader *shader = variant->shader;
+   const struct lp_fragment_shader_variant_key *key = &variant->key;
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
+   int64_t t0 = os_time_get();
+
+   struct lp_cached_code cached = { 0 };
+   bool needs_caching = false;
+   if (job->has_cache_key) {
+      lp_disk_cache_find_shader(screen, &cached, job->ir_sha1_cache_key);
+      if (!cached.data_size)
+         needs_caching = true;
+   }
+
+   char module_name[64];
+   snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
+            shader->no, variant->no);
+   variant->gallivm = gallivm_create(module_name, &variant->context, &cached);
+   if (!variant->gallivm)
+      return false;
+
+   if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
+      lp_debug_fs_variant(variant);
+   }
+
+   llvmpipe_fs_variant_fastpath(variant);
+
+   lp_jit_init_types(variant);
+
+   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
+      generate_fragment(lp, shader, job->nir, variant, RAST_EDGE_TEST);
+
+   if (variant->jit_function[RAST_WHOLE] == NULL) {
+      if (variant->opaque) {
+         /* Specialized shader, which doesn't need to read the color buffer. */
+         generate_fragment(lp, shader, job->nir, variant, RAST_WHOLE);
+      }
+   }
+
+   if (job->linear_pipeline) {
+      /* Currently keeping both the old fastpaths and new linear path
+       * active.  The older code is still somewhat faster for the cases
+       * it covers.
+       *
+       * XXX: consider restricting this to aero-mode only.
+       */
+      if (job->fullcolormask &&
+          !key->alpha.enabled &&
+          !key->blend.alpha_to_coverage) {
+         llvmpipe_fs_variant_linear_fastpath(variant);
+      }
+
+      /* If the original fastpath doesn't cover this variant, try the new
+       * code:
+       */
+      if (variant->jit_linear == NULL) {
+         if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
+             shader->kind == LP_FS_KIND_BLIT_RGB1 ||
+             shader->kind == LP_FS_KIND_LLVM_LINEAR) {
+            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
+         }
+      }
+   } else {
+      if (LP_DEBUG & DEBUG_LINEAR) {
+         lp_debug_fs_variant(variant);
+         debug_printf("    ----> no linear path for this variant\n");
+      }
+   }
+
+   /*
+    * Compile everything
+    */
+
+#if GALLIVM_USE_ORCJIT
+/* module has been moved into ORCJIT after gallivm_compile_module */
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+
+   gallivm_compile_module(variant->gallivm);
+#else
+   gallivm_compile_module(variant->gallivm);
+
+   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
+#endif
+
+   if (variant->function[RAST_EDGE_TEST]) {
+      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
+            gallivm_jit_function(variant->gallivm,
+                                 variant->function[RAST_EDGE_TEST],
+                                 variant->function_name[RAST_EDGE_TEST]);
+   }
+
+   if (variant->function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+         gallivm_jit_function(variant->gallivm,
+                              variant->function[RAST_WHOLE],
+                              variant->function_name[RAST_WHOLE]);
+   } else if (!variant->jit_function[RAST_WHOLE]) {
+      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
+         variant->jit_function[RAST_EDGE_TEST];
+   }
+
+   if (job->linear_pipeline) {
+      if (variant->linear_function) {
+         variant->jit_linear_llvm = (lp_jit_linear_llvm_func)
+            gallivm_jit_function(variant->gallivm, variant->linear_function,
+                                 variant->linear_function_name);
+      }
+
+      /*
+       * This must be done after LLVM compilation, as it will call the JIT'ed
+       * code to determine active inputs.
+       */
+      lp_linear_check_variant(variant);
+   }
+
+   if (needs_caching) {
+      lp_disk_cache_insert_shader(screen, &cached, job->ir_sha1_cache_key);
+   }
+
+   gallivm_free_ir(variant->gallivm);
+
+   p_atomic_add(&lp->nr_fs_instrs, variant->nr_instrs);
+
+   variant->compile_time = os_time_get() - t0;
+   if (LP_DEBUG & DEBUG_FS) {
+      debug_printf("llvmpipe: compiled fs #%u var %u in %" PRId64 " us\n",
+                   shader->no, variant->no, variant->compile_time);
+   }
+
+   lp_perf_add_shared(&lp->perf, LP_PERF_COMPILES, 1);
+   lp_perf_add_shared(&lp->perf, LP_PERF_COMPILE_TIME, variant->compile_time);
+   LP_COUNT_ADD(llvm_compile_time, variant->compile_time);
+
+   return true;
+}
+
+
+static void
+compile_variant_async(void *data, void *gdata, int thread_index)
+{
+   struct lp_fs_variant_job *job = data;
+   struct lp_fragment_shader_variant *variant = job->variant;
+
+   if (!compile_variant(job)) {
+      variant->jit_function[RAST_WHOLE] = fs_variant_no_op;
+      variant->jit_function[RAST_EDGE_TEST] = fs_variant_no_op;
+   }
+
+   ralloc_free(job->nir);
+   FREE(job);
+}
+
+
 /**
  * Generate a new fragment shader variant from the shader code and
  * other state indicated by the key.
+ *
+ * If the screen has a compile queue the code is generated there, against
+ * a private copy of the NIR and a private LLVM context, and only the state
+ * setup needs for binning is filled in before returning.  The rasterizer
+ * waits for the rest with lp_fs_variant_wait().
  */
 static struct lp_fragment_shader_variant *
 generate_variant(struct llvmpipe_context *lp,
                  struct lp_fragment_shader *shader,
                  const struct lp_fragment_shader_variant_key *key)
 {
+   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
    struct nir_shader *nir = shader->base.ir.nir;
    struct lp_fragment_shader_variant *variant =
       MALLOC(sizeof *variant + shader->variant_key_size - sizeof variant->key);
@@ -3733,27 +3987,35 @@ generate_variant(struct llvmpipe_context *lp,
 
    memcpy(&variant->key, key, shader->variant_key_size);
 
-   struct llvmpipe_screen *screen = llvmpipe_screen(lp->pipe.screen);
-   struct lp_cached_code cached = { 0 };
-   unsigned char ir_sha1_cache_key[20];
-   bool needs_caching = false;
-   if (shader->base.ir.nir) {
-      lp_fs_get_ir_cache_key(variant, ir_sha1_cache_key);
+   const bool async = util_queue_is_initialized(&screen->compile_queue);
+   struct lp_fs_variant_job sync_job = { 0 };
+   struct lp_fs_variant_job *job = async ? CALLOC_STRUCT(lp_fs_variant_job)
+                                         : &sync_job;
+   if (!job) {
+      lp_fs_reference(lp, &variant->shader, NULL);
+      FREE(variant);
+      return NULL;
+   }
 
-      lp_disk_cache_find_shader(screen, &cached, ir_sha1_cache_key);
-      if (!cached.data_size)
-         needs_caching = true;
+   job->lp = lp;
+   job->variant = variant;
+
+   if (shader->base.ir.nir) {
+      lp_fs_get_ir_cache_key(variant, job->ir_sha1_cache_key);
+      job->has_cache_key = true;
    }
 
-   char module_name[64];
-   snprintf(module_name, sizeof(module_name), "fs%u_variant%u",
-            shader->no, shader->variants_created);
-   variant->gallivm = gallivm_create(module_name, &lp->context, &cached);
-   if (!variant->gallivm) {
-      FREE(variant);
-      return NULL;
+   if (async) {
+      lp_context_create(&variant->context);
+      job->nir = nir_shader_clone(NULL, nir);
+   } else {
+      variant->context = lp->context;
+      variant->context.owned = false;
+      job->nir = nir;
    }
 
+   util_queue_fence_init(&variant->ready);
+
    variant->list_item_global.base = variant;
    variant->list_item_local.base = variant;
    variant->no = shader->variants_created++;
@@ -3807,8 +4069,15 @@ generate_variant(struct llvmpipe_context *lp,
          shader->info.cbuf[0][3].file != TGSI_FILE_NULL
          ? true : false;
 
+   /* The blit and linear code paths only read linear textures. */
+   bool microtiled = false;
+   const struct lp_sampler_static_state *samplers =
+      lp_fs_variant_key_samplers(key);
+   for (unsigned i = 0; i < MAX2(key->nr_samplers, key->nr_sampler_views); i++)
+      microtiled |= samplers[i].texture_state.microtiled;
+
    /* We only care about opaque blits for now */
-   if (variant->opaque &&
+   if (variant->opaque && !microtiled &&
        (shader->kind == LP_FS_KIND_BLIT_RGBA ||
         shader->kind == LP_FS_KIND_BLIT_RGB1)) {
       const struct lp_sampler_static_state *samp0 =
@@ -3847,6 +4116,7 @@ generate_variant(struct llvmpipe_context *lp,
     * the linear path.
     */
    const bool linear_pipeline =
+         !microtiled &&
          !key->stencil[0].enabled &&
          !key->depth.enabled &&
          !nir->info.fs.uses_discard &&
@@ -3856,108 +4126,19 @@ generate_variant(struct llvmpipe_context *lp,
           key->cbuf_format[0] == PIPE_FORMAT_R8G8B8A8_UNORM ||
           key->cbuf_format[0] == PIPE_FORMAT_R8G8B8X8_UNORM);
 
-   memcpy(&variant->key, key, sizeof *key);
-
-   if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
-      lp_debug_fs_variant(variant);
-   }
-
-   llvmpipe_fs_variant_fastpath(variant);
-
-   lp_jit_init_types(variant);
-
-   if (variant->jit_function[RAST_EDGE_TEST] == NULL)
-      generate_fragment(lp, shader, variant, RAST_EDGE_TEST);
-
-   if (variant->jit_function[RAST_WHOLE] == NULL) {
-      if (variant->opaque) {
-         /* Specialized shader, which doesn't need to read the color buffer. */
-         generate_fragment(lp, shader, variant, RAST_WHOLE);
-      }
-   }
-
-   if (linear_pipeline) {
-      /* Currently keeping both the old fastpaths and new linear path
-       * active.  The older code is still somewhat faster for the cases
-       * it covers.
-       *
-       * XXX: consider restricting this to aero-mode only.
-       */
-      if (fullcolormask &&
-          !key->alpha.enabled &&
-          !key->blend.alpha_to_coverage) {
-         llvmpipe_fs_variant_linear_fastpath(variant);
-      }
-
-      /* If the original fastpath doesn't cover this variant, try the new
-       * code:
-       */
-      if (variant->jit_linear == NULL) {
-         if (shader->kind == LP_FS_KIND_BLIT_RGBA ||
-             shader->kind == LP_FS_KIND_BLIT_RGB1 ||
-             shader->kind == LP_FS_KIND_LLVM_LINEAR) {
-            llvmpipe_fs_variant_linear_llvm(lp, shader, variant);
-         }
-      }
-   } else {
-      if (LP_DEBUG & DEBUG_LINEAR) {
-         lp_debug_fs_variant(variant);
-         debug_printf("    ----> no linear path for this variant\n");
-      }
-   }
-
-   /*
-    * Compile everything
-    */
-
-#if GALLIVM_USE_ORCJIT
-/* module has been moved into ORCJIT after gallivm_compile_module */
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-
-   gallivm_compile_module(variant->gallivm);
-#else
-   gallivm_compile_module(variant->gallivm);
-
-   variant->nr_instrs += lp_build_count_ir_module(variant->gallivm->module);
-#endif
-
-   if (variant->function[RAST_EDGE_TEST]) {
-      variant->jit_function[RAST_EDGE_TEST] = (lp_jit_frag_func)
-            gallivm_jit_function(variant->gallivm,
-                                 variant->function[RAST_EDGE_TEST],
-                                 variant->function_name[RAST_EDGE_TEST]);
-   }
-
-   if (variant->function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-         gallivm_jit_function(variant->gallivm,
-                              variant->function[RAST_WHOLE],
-                              variant->function_name[RAST_WHOLE]);
-   } else if (!variant->jit_function[RAST_WHOLE]) {
-      variant->jit_function[RAST_WHOLE] = (lp_jit_frag_func)
-         variant->jit_function[RAST_EDGE_TEST];
-   }
-
-   if (linear_pipeline) {
-      if (variant->linear_function) {
-         variant->jit_linear_llvm = (lp_jit_linear_llvm_func)
-            gallivm_jit_function(variant->gallivm, variant->linear_function,
-                                 variant->linear_function_name);
-      }
+   job->fullcolormask = fullcolormask;
+   job->linear_pipeline = linear_pipeline;
 
-      /*
-       * This must be done after LLVM compilation, as it will call the JIT'ed
-       * code to determine active inputs.
-       */
-      lp_linear_check_variant(variant);
-   }
-
-   if (needs_caching) {
-      lp_disk_cache_insert_shader(screen, &cached, ir_sha1_cache_key);
+   if (async) {
+      util_queue_add_job(&screen->compile_queue, job, &variant->ready,
+                         compile_variant_async, NULL, 0);
+   } else if (!compile_variant(job)) {
+      util_queue_fence_destroy(&variant->ready);
+      lp_fs_reference(lp, &variant->shader, NULL);
+      FREE(variant);
+      return NULL;
    }
 
-   gallivm_free_ir(variant->gallivm);
-
    return variant;
 }
 
@@ -4094,11 +4275,13 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
 {
    if ((LP_DEBUG & DEBUG_FS) || (gallivm_debug & GALLIVM_DEBUG_IR)) {
       debug_printf("llvmpipe: del fs #%u var %u v created %u v cached %u "
-                   "v total cached %u inst %u total inst %u\n",
+                   "v total cached %u inst %u total inst %u "
+                   "compile %" PRId64 " us\n",
                    variant->shader->no, variant->no,
                    variant->shader->variants_created,
                    variant->shader->variants_cached,
-                   lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs);
+                   lp->nr_fs_variants, variant->nr_instrs, lp->nr_fs_instrs,
+                   variant->compile_time);
    }
 
    /* remove from shader's list */
@@ -4108,7 +4291,10 @@ llvmpipe_remove_shader_variant(struct llvmpipe_context *lp,
    /* remove from context's list */
    list_del(&variant->list_item_global.list);
    lp->nr_fs_variants--;
-   lp->nr_fs_instrs -= variant->nr_instrs;
+
+   /* its instructions are only counted once it has been compiled */
+   lp_fs_variant_wait(variant);
+   p_atomic_add(&lp->nr_fs_instrs, -(int)variant->nr_instrs);
 }
 
 
@@ -4116,7 +4302,11 @@ void
 llvmpipe_destroy_shader_variant(struct llvmpipe_context *lp,
                                 struct lp_fragment_shader_variant *variant)
 {
-   gallivm_destroy(variant->gallivm);
+   lp_fs_variant_wait(variant);
+   util_queue_fence_destroy(&variant->ready);
+   if (variant->gallivm)
+      gallivm_destroy(variant->gallivm);
+   lp_context_destroy(&variant->context);
    lp_fs_reference(lp, &variant->shader, NULL);
    if (variant->function_name[RAST_EDGE_TEST])
       FREE(variant->function_name[RAST_EDGE_TEST]);
@@ -4306,6 +4496,9 @@ llvmpipe_set_shader_images(struct pipe_context *pipe,
          bool read_only = !(image->access & PIPE_IMAGE_ACCESS_WRITE);
          llvmpipe_flush_resource(pipe, image->resource, 0, read_only, false,
                                  false, "image");
+
+         if (shader != PIPE_SHADER_FRAGMENT && shader != PIPE_SHADER_COMPUTE)
+            llvmpipe_resource_untile(pipe, image->resource);
       }
    }
 
@@ -4590,16 +4783,16 @@ make_variant_key(struct llvmpipe_context *lp,
           * used views may be included in the shader key.
           */
          if (BITSET_TEST(nir->info.textures_used, i)) {
-            lp_sampler_static_texture_state(&fs_sampler[i].texture_state,
-                                  lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            lp_llvm_texture_static_state(&fs_sampler[i].texture_state,
+                               lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    } else {
       key->nr_sampler_views = key->nr_samplers;
       for (unsigned i = 0; i < key->nr_sampler_views; ++i) {
          if (BITSET_TEST(nir->info.samplers_used, i)) {
-            lp_sampler_static_texture_state(&fs_sampler[i].texture_state,
-                                 lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
+            lp_llvm_texture_static_state(&fs_sampler[i].texture_state,
+                              lp->sampler_views[PIPE_SHADER_FRAGMENT][i]);
          }
       }
    }
@@ -4611,8 +4804,8 @@ make_variant_key(struct llvmpipe_context *lp,
              key->nr_images * sizeof *lp_image);
    for (unsigned i = 0; i < key->nr_images; ++i) {
       if (BITSET_TEST(nir->info.images_used, i)) {
-         lp_sampler_static_texture_state_image(&lp_image[i].image_state,
-                                      &lp->images[PIPE_SHADER_FRAGMENT][i]);
+         lp_llvm_image_static_state(&lp_image[i].image_state,
+                           &lp->images[PIPE_SHADER_FRAGMENT][i]);
       }
    }
 
@@ -4674,7 +4867,7 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          ? LP_MAX_SHADER_VARIANTS / 16 : 0;
 
       if (variants_to_cull ||
-          lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS) {
+          p_atomic_read(&lp->nr_fs_instrs) >= LP_MAX_SHADER_INSTRUCTIONS) {
          if (gallivm_debug & GALLIVM_DEBUG_PERF) {
             debug_printf("Evicting FS: %u fs variants,\t%u total variants,"
                          "\t%u instrs,\t%u instrs/variant\n",
@@ -4691,7 +4884,7 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
 
          for (unsigned i = 0;
               i < variants_to_cull ||
-                 lp->nr_fs_instrs >= LP_MAX_SHADER_INSTRUCTIONS;
+                 p_atomic_read(&lp->nr_fs_instrs) >= LP_MAX_SHADER_INSTRUCTIONS;
               i++) {
             struct lp_fs_variant_list_item *item;
             if (list_is_empty(&lp->fs_variants_list.list)) {
@@ -4710,11 +4903,7 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
       /*
        * Generate the new variant.
        */
-      int64_t t0 = os_time_get();
       variant = generate_variant(lp, shader, key);
-      int64_t t1 = os_time_get();
-      int64_t dt = t1 - t0;
-      LP_COUNT_ADD(llvm_compile_time, dt);
       LP_COUNT_ADD(nr_llvm_compiles, 2);  /* emit vs. omit in/out test */
 
       /* Put the new variant into the list */
@@ -4722,7 +4911,6 @@ llvmpipe_update_fs(struct llvmpipe_context *lp)
          list_add(&variant->list_item_local.list, &shader->variants.list);
          list_add(&variant->list_item_global.list, &lp->fs_variants_list.list);
          lp->nr_fs_variants++;
-         lp->nr_fs_instrs += variant->nr_instrs;
          shader->variants_cached++;
       }
    }
@@ -4742,3 +4930,47 @@ llvmpipe_init_fs_funcs(struct llvmpipe_context *llvmpipe)
    llvmpipe->pipe.set_shader_buffers = llvmpipe_set_shader_buffers;
    llvmpipe->pipe.set_shader_images = llvmpipe_set_shader_images;
 }
+
+
+static void
+llvmpipe_set_max_shader_compiler_threads(struct pipe_screen *_screen,
+                                         unsigned max_threads)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(_screen);
+
+   if (util_queue_is_initialized(&screen->compile_queue))
+      util_queue_adjust_num_threads(&screen->compile_queue, max_threads,
+                                    false);
+}
+
+
+/**
+ * Only fragment shader variants are compiled in the background.  A shader
+ * is done compiling once every variant it has so far is.
+ */
+static bool
+llvmpipe_is_parallel_shader_compilation_finished(struct pipe_screen *screen,
+                                                 void *shader,
+                                                 enum pipe_shader_type type)
+{
+   if (type != PIPE_SHADER_FRAGMENT)
+      return true;
+
+   struct lp_fragment_shader *fs = shader;
+   struct lp_fs_variant_list_item *li;
+   LIST_FOR_EACH_ENTRY(li, &fs->variants.list, list) {
+      if (!util_queue_fence_is_signalled(&li->base->ready))
+         return false;
+   }
+   return true;
+}
+
+
+void
+llvmpipe_init_screen_fs_funcs(struct pipe_screen *screen)
+{
+   screen->set_max_shader_compiler_threads =
+      llvmpipe_set_max_shader_compiler_threads;
+   screen->is_parallel_shader_compilation_finished =
+      llvmpipe_is_parallel_shader_compilation_finished;
+}
@@ -38,6 +38,8 @@
 #include "gallivm/lp_bld_tgsi.h" /* for lp_tgsi_info */
 #include "lp_bld_interp.h" /* for struct lp_shader_input */
 #include "util/u_inlines.h"
+#include "util/u_queue.h"
+#include "gallivm/lp_bld.h" /* for lp_context_ref */
 #include "lp_jit.h"
 
 struct lp_fragment_shader;
@@ -155,6 +157,19 @@ struct lp_fragment_shader_variant
 
    struct gallivm_state *gallivm;
 
+   /*
+    * LLVM context the variant was compiled in.  Variants compiled in the
+    * background own a private one, others borrow the llvmpipe context's.
+    */
+   lp_context_ref context;
+
+   /*
+    * Signalled once the code below has been generated.  Everything above
+    * is derived from the key and usable straight away, which is all setup
+    * needs for binning; the rasterizer must wait, see lp_fs_variant_wait().
+    */
+   struct util_queue_fence ready;
+
    LLVMTypeRef jit_context_type;
    LLVMTypeRef jit_context_ptr_type;
    LLVMTypeRef jit_thread_data_type;
@@ -187,6 +202,9 @@ struct lp_fragment_shader_variant
    /* Total number of LLVM instructions generated */
    unsigned nr_instrs;
 
+   /* Time spent generating the code, in microseconds */
+   int64_t compile_time;
+
    struct lp_fs_variant_list_item list_item_global, list_item_local;
    struct lp_fragment_shader *shader;
 
@@ -227,6 +245,13 @@ struct lp_fragment_shader
 void
 llvmpipe_fs_analyse_nir(struct lp_fragment_shader *shader);
 
+/** Wait for a variant which may still be compiling in the background */
+static inline void
+lp_fs_variant_wait(struct lp_fragment_shader_variant *variant)
+{
+   util_queue_fence_wait(&variant->ready);
+}
+
 void
 llvmpipe_fs_variant_fastpath(struct lp_fragment_shader_variant *variant);
 
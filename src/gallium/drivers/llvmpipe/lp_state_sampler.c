@@ -40,6 +40,7 @@
 #include "lp_debug.h"
 #include "frontend/sw_winsys.h"
 #include "lp_flush.h"
+#include "lp_texture.h"
 
 
 static void *
@@ -161,9 +162,14 @@ llvmpipe_set_sampler_views(struct pipe_context *pipe,
                       "context\n", i);
       }
 
-      if (view)
+      if (view) {
          llvmpipe_flush_resource(pipe, view->texture, 0, true, false, false, "sampler_view");
 
+         /* Only fragment and compute shaders handle micro-tiled textures. */
+         if (shader != PIPE_SHADER_FRAGMENT && shader != PIPE_SHADER_COMPUTE)
+            llvmpipe_resource_untile(pipe, view->texture);
+      }
+
       if (take_ownership) {
          pipe_sampler_view_reference(&llvmpipe->sampler_views[shader][start + i],
                                      NULL);
@@ -31,6 +31,7 @@
 #include "lp_context.h"
 #include "lp_flush.h"
 #include "lp_limits.h"
+#include "lp_screen.h"
 #include "lp_surface.h"
 #include "lp_texture.h"
 #include "lp_query.h"
@@ -83,6 +84,67 @@ lp_resource_copy_ms(struct pipe_context *pipe,
 }
 
 
+/**
+ * Copy between two micro-tiled textures a whole row of tiles at a time.
+ * Returns false if the box is not tile aligned, in which case the copy
+ * has to go through transfers.
+ */
+static bool
+lp_resource_copy_microtiled(struct pipe_resource *dst, unsigned dst_level,
+                            unsigned dstx, unsigned dsty, unsigned dstz,
+                            struct pipe_resource *src, unsigned src_level,
+                            const struct pipe_box *src_box)
+{
+   struct llvmpipe_resource *dst_tex = llvmpipe_resource(dst);
+   struct llvmpipe_resource *src_tex = llvmpipe_resource(src);
+   const unsigned mask = LP_MICROTILE_SIZE - 1;
+   const unsigned block_size = util_format_get_blocksize(src->format);
+
+   if (!dst_tex->microtiled || !src_tex->microtiled ||
+       util_format_get_blocksize(dst->format) != block_size)
+      return false;
+
+   /* Partial tiles may only be copied at the right and bottom edges of
+    * the destination, where the rest of the tile is padding.
+    */
+   if ((src_box->x | src_box->y | dstx | dsty) & mask)
+      return false;
+   if ((src_box->width & mask) &&
+       dstx + src_box->width != u_minify(dst->width0, dst_level))
+      return false;
+   if ((src_box->height & mask) &&
+       dsty + src_box->height != u_minify(dst->height0, dst_level))
+      return false;
+
+   const unsigned tile_rows = DIV_ROUND_UP(src_box->height, LP_MICROTILE_SIZE);
+   const unsigned row_size = align(src_box->width, LP_MICROTILE_SIZE) *
+                             LP_MICROTILE_SIZE * block_size;
+
+   for (int z = 0; z < src_box->depth; z++) {
+      uint8_t *dst_image =
+         llvmpipe_get_texture_image_address(dst_tex, dstz + z, dst_level);
+      const uint8_t *src_image =
+         llvmpipe_get_texture_image_address(src_tex, src_box->z + z,
+                                            src_level);
+
+      for (unsigned row = 0; row < tile_rows; row++) {
+         unsigned y = row * LP_MICROTILE_SIZE;
+         memcpy(dst_image +
+                llvmpipe_microtile_offset(dstx, dsty + y,
+                                          dst_tex->row_stride[dst_level],
+                                          block_size),
+                src_image +
+                llvmpipe_microtile_offset(src_box->x, src_box->y + y,
+                                          src_tex->row_stride[src_level],
+                                          block_size),
+                row_size);
+      }
+   }
+
+   return true;
+}
+
+
 static void
 lp_resource_copy(struct pipe_context *pipe,
                  struct pipe_resource *dst, unsigned dst_level,
@@ -111,6 +173,13 @@ lp_resource_copy(struct pipe_context *pipe,
                           src, src_level, src_box);
       return;
    }
+
+   if (lp_resource_copy_microtiled(dst, dst_level, dstx, dsty, dstz,
+                                   src, src_level, src_box)) {
+      llvmpipe_screen(pipe->screen)->timestamp++;
+      return;
+   }
+
    util_resource_copy_region(pipe, dst, dst_level, dstx, dsty, dstz,
                              src, src_level, src_box);
 }
@@ -217,6 +286,9 @@ llvmpipe_create_surface(struct pipe_context *pipe,
       }
    }
 
+   /* The rasterizer only renders to linear textures. */
+   llvmpipe_resource_untile(pipe, pt);
+
    struct pipe_surface *ps = CALLOC_STRUCT(pipe_surface);
    if (ps) {
       pipe_reference_init(&ps->reference, 1);
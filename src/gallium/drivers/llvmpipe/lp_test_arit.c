@@ -39,6 +39,7 @@
 #include "gallivm/lp_bld_debug.h"
 #include "gallivm/lp_bld_init.h"
 #include "gallivm/lp_bld_arit.h"
+#include "gallivm/lp_bld_const.h"
 
 #include "lp_test.h"
 
@@ -215,6 +216,34 @@ const float rsqrt_values[] = {
 };
 
 
+static LLVMValueRef
+build_min_half(struct lp_build_context *bld, LLVMValueRef a)
+{
+   LLVMValueRef half = lp_build_const_vec(bld->gallivm, bld->type, 0.5);
+   return lp_build_min_ext(bld, a, half, GALLIVM_NAN_RETURN_OTHER);
+}
+
+
+static float minhalff(float x)
+{
+   return fminf(x, 0.5f);
+}
+
+
+static LLVMValueRef
+build_max_half(struct lp_build_context *bld, LLVMValueRef a)
+{
+   LLVMValueRef half = lp_build_const_vec(bld->gallivm, bld->type, 0.5);
+   return lp_build_max_ext(bld, a, half, GALLIVM_NAN_RETURN_OTHER);
+}
+
+
+static float maxhalff(float x)
+{
+   return fmaxf(x, 0.5f);
+}
+
+
 const float sincos_values[] = {
    -INFINITY,
    -5*M_PI/4,
@@ -251,6 +280,34 @@ const float round_values[] = {
       -FLT_MAX
 };
 
+static LLVMValueRef
+build_iround(struct lp_build_context *bld, LLVMValueRef a)
+{
+   return lp_build_int_to_float(bld, lp_build_iround(bld, a));
+}
+
+
+/*
+ * round_values without those not representable as 32bit int, and without
+ * ties since not all iround paths round those to even.
+ */
+const float iround_values[] = {
+      -10.0, -1, 0.0, 12.0,
+      -1.49, -0.25, 1.25, 2.51,
+      -0.99, -0.01, 0.01, 0.99,
+      -1.51, -0.49, 0.51, 1.49,
+      1.401298464324817e-45f, // smallest denormal
+      -1.401298464324817e-45f,
+      1.62981451e-08f,
+      -1.62981451e-08f,
+      FLT_EPSILON,
+      -FLT_EPSILON,
+      1.0f - 0.5f*FLT_EPSILON,
+      -1.0f + FLT_EPSILON,
+      8388609.0f,
+      -8388609.0f,
+};
+
 static float fractf(float x)
 {
    x -= floorf(x);
@@ -321,14 +378,18 @@ unary_tests[] = {
    {"log", &lp_build_log_safe, &logf, log2_values, ARRAY_SIZE(log2_values), 20.0 },
    {"rcp", &lp_build_rcp, &rcpf, rcp_values, ARRAY_SIZE(rcp_values), 20.0 },
    {"rsqrt", &lp_build_rsqrt, &rsqrtf, rsqrt_values, ARRAY_SIZE(rsqrt_values), 20.0 },
+   {"fast_rsqrt", &lp_build_fast_rsqrt, &rsqrtf, rsqrt_values, ARRAY_SIZE(rsqrt_values), 10.0 },
    {"sin", &lp_build_sin, &sinf, sincos_values, ARRAY_SIZE(sincos_values), 20.0 },
    {"cos", &lp_build_cos, &cosf, sincos_values, ARRAY_SIZE(sincos_values), 20.0 },
    {"sgn", &lp_build_sgn, &sgnf, sgn_values, ARRAY_SIZE(sgn_values), 20.0 },
    {"round", &lp_build_round, &nearbyintf, round_values, ARRAY_SIZE(round_values), 24.0 },
+   {"iround", &build_iround, &nearbyintf, iround_values, ARRAY_SIZE(iround_values), 24.0 },
    {"trunc", &lp_build_trunc, &truncf, round_values, ARRAY_SIZE(round_values), 24.0 },
    {"floor", &lp_build_floor, &floorf, round_values, ARRAY_SIZE(round_values), 24.0 },
    {"ceil", &lp_build_ceil, &ceilf, round_values, ARRAY_SIZE(round_values), 24.0 },
    {"fract", &lp_build_fract_safe, &fractf, fract_values, ARRAY_SIZE(fract_values), 24.0 },
+   {"min", &build_min_half, &minhalff, sgn_values, ARRAY_SIZE(sgn_values), 24.0 },
+   {"max", &build_max_half, &maxhalff, sgn_values, ARRAY_SIZE(sgn_values), 24.0 },
 };
 
 
@@ -527,6 +588,11 @@ test_all(unsigned verbose, FILE *fp)
    for (i = 0; i < ARRAY_SIZE(unary_tests); ++i) {
       unsigned max_length = lp_native_vector_width / 32;
       unsigned length;
+
+      /* exercise the AVX-512 paths even if they aren't the native width */
+      if (util_get_cpu_caps()->has_avx512f)
+         max_length = MAX2(max_length, 16);
+
       for (length = 1; length <= max_length; length *= 2) {
          if (!test_unary(verbose, fp, &unary_tests[i], length)) {
             success = false;
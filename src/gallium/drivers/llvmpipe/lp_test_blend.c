@@ -625,6 +625,8 @@ const struct lp_type blend_types[] = {
    /* float, fixed,  sign,  norm, width, len */
    {   true, false,  true, false,    32,   4 }, /* f32 x 4 */
    {  false, false, false,  true,     8,  16 }, /* u8n x 16 */
+   {   true, false,  true, false,    32,  16 }, /* f32 x 16 (AVX-512) */
+   {  false, false, false,  true,     8,  64 }, /* u8n x 64 (AVX-512) */
 };
 
 
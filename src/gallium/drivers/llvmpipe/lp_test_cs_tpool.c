@@ -0,0 +1,138 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Compute thread pool tests.
+ *
+ * Dispatches many small grids through lp_cs_tpool, checks that every
+ * iteration of every task ran exactly once, and reports how long a
+ * dispatch takes for a range of thread counts and grid sizes.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/os_time.h"
+#include "util/u_atomic.h"
+#include "util/u_memory.h"
+#include "lp_cs_tpool.h"
+#include "lp_test.h"
+
+
+struct cs_tpool_test_data {
+   unsigned *counts;
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "threads\t"
+           "iterations\t"
+           "ns/dispatch\n");
+
+   fflush(fp);
+}
+
+
+static void
+cs_tpool_test_work(void *data, int iter_idx, struct lp_cs_local_mem *lmem)
+{
+   struct cs_tpool_test_data *test = data;
+
+   p_atomic_inc(&test->counts[iter_idx]);
+}
+
+
+static bool
+test_cs_tpool(unsigned verbose, FILE *fp, unsigned num_threads,
+              unsigned num_iters, unsigned num_dispatches)
+{
+   struct cs_tpool_test_data test;
+   struct lp_cs_tpool *pool;
+   bool success = true;
+
+   pool = lp_cs_tpool_create(num_threads, 1);
+   if (!pool)
+      return false;
+
+   test.counts = CALLOC(num_iters, sizeof(unsigned));
+
+   int64_t start = os_time_get_nano();
+   for (unsigned d = 0; d < num_dispatches; d++) {
+      struct lp_cs_tpool_task *task;
+
+      task = lp_cs_tpool_queue_task(pool, cs_tpool_test_work, &test,
+                                    num_iters);
+      lp_cs_tpool_wait_for_task(pool, &task);
+   }
+   int64_t end = os_time_get_nano();
+
+   for (unsigned i = 0; i < num_iters; i++) {
+      if (test.counts[i] != num_dispatches) {
+         success = false;
+         fprintf(stderr, "iteration %u ran %u times, expected %u\n",
+                 i, test.counts[i], num_dispatches);
+         break;
+      }
+   }
+
+   double ns = num_dispatches ? (double)(end - start) / num_dispatches : 0.0;
+
+   if (verbose >= 1) {
+      fprintf(stdout, "%s: %u threads, %u iterations, %.0f ns/dispatch\n",
+              success ? "PASS" : "FAIL", num_threads, num_iters, ns);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%u\t%u\t%.0f\n",
+              success ? "pass" : "fail", num_threads, num_iters, ns);
+      fflush(fp);
+   }
+
+   FREE(test.counts);
+   lp_cs_tpool_destroy(pool);
+
+   return success;
+}
+
+
+static const unsigned thread_counts[] = { 0, 1, 2, 4, 8, 16 };
+static const unsigned iter_counts[] = { 1, 3, 16, 61, 256, 4096 };
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   bool success = true;
+
+   for (unsigned t = 0; t < ARRAY_SIZE(thread_counts); t++) {
+      for (unsigned i = 0; i < ARRAY_SIZE(iter_counts); i++) {
+         success &= test_cs_tpool(verbose, fp, thread_counts[t],
+                                  iter_counts[i], n);
+      }
+   }
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_some(verbose, fp, 1000);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_cs_tpool(verbose, fp, 4, 64, 1000);
+}
@@ -0,0 +1,442 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Linear path interpolation and sampling kernel tests.
+ *
+ * Checks the rows produced by the linear path interpolators and bilinear
+ * samplers against a scalar reference, and reports how long they take
+ * per pixel.  The kernels are picked as llvmpipe would pick them, so the
+ * AVX2 ones are tested on CPUs which have it; run with
+ * GALLIUM_OVERRIDE_CPU_CAPS=sse4.1 to test and time the SSE2 ones there.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "util/detect.h"
+#include "util/os_time.h"
+#include "util/u_cpu_detect.h"
+#include "util/u_memory.h"
+#include "util/u_sse.h"
+#include "lp_jit.h"
+#include "lp_debug.h"
+#include "lp_state_fs.h"
+#include "lp_linear_priv.h"
+#include "lp_test.h"
+
+
+#if DETECT_ARCH_SSE
+
+#define TEX_WIDTH  128
+#define TEX_HEIGHT 96
+#define TEX_STRIDE (TEX_WIDTH * 4 + 64)
+
+#define NUM_ROWS   64
+
+
+static const unsigned test_widths[] = { 64, 61, 8, 5 };
+
+
+struct sampler_test {
+   const char *name;
+   float s0, dsdx, dsdy;        /* in texels */
+   float t0, dtdx, dtdy;        /* in texels */
+};
+
+
+static const struct sampler_test sampler_tests[] = {
+   /* stretched rows, combined vertically */
+   { "magnify",    10.3f, 0.37f,  0.0f,  7.7f, 0.0f, 0.41f },
+   /* unscaled rows, combined vertically */
+   { "blit rows",  20.0f, 1.0f,   0.0f,  3.25f, 0.0f, 0.5f },
+   /* bilinear filtering of every pixel */
+   { "rotated",    40.0f, 0.9f,  -0.3f, 10.0f, 0.3f, 0.9f },
+   /* bilinear filtering with clamping */
+   { "clamped",    -2.5f, 0.9f,  -0.3f, -1.5f, 0.3f, 0.9f },
+};
+
+
+struct interp_test {
+   const char *name;
+   float a0[4], dadx[4], dady[4];
+};
+
+
+static const struct interp_test interp_tests[] = {
+   { "gradient",
+     { 0.1f, 0.9f, 0.3f, 0.5f },
+     { 0.005f, -0.01f, 0.002f, 0.0f },
+     { 0.003f, 0.001f, -0.004f, 0.006f } },
+   { "y-invariant",
+     { 0.2f, 0.4f, 0.6f, 0.8f },
+     { 0.01f, 0.005f, -0.005f, -0.01f },
+     { 0.0f, 0.0f, 0.0f, 0.0f } },
+};
+
+
+static const char *
+kernel_isa(void)
+{
+#ifdef HAVE_LP_LINEAR_AVX2
+   if (util_get_cpu_caps()->has_avx2)
+      return "avx2";
+#endif
+   return "sse2";
+}
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "kernels\t"
+           "test\t"
+           "width\t"
+           "ns/pixel\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *test, unsigned width,
+              bool success, double ns)
+{
+   fprintf(fp, "%s\t%s\t%s\t%u\t%.3f\n",
+           success ? "pass" : "fail", kernel_isa(), test, width, ns);
+   fflush(fp);
+}
+
+
+static void
+report(unsigned verbose, FILE *fp, const char *test, unsigned width,
+       bool success, double ns)
+{
+   if (verbose >= 1 || !success) {
+      fprintf(stdout, "%s: %s %s, width %u, %.3f ns/pixel\n",
+              success ? "PASS" : "FAIL", kernel_isa(), test, width, ns);
+   }
+
+   if (fp)
+      write_tsv_row(fp, test, width, success, ns);
+}
+
+
+/* Same rounding as util_sse2_lerp_epi16(). */
+static inline uint32_t
+lerp_unorm8(uint32_t a, uint32_t b, unsigned w)
+{
+   uint32_t res = 0;
+
+   for (unsigned c = 0; c < 32; c += 8) {
+      int ac = (a >> c) & 0xff;
+      int bc = (b >> c) & 0xff;
+      uint16_t d = (uint16_t)((bc - ac) * (int)w) >> 8;
+      res |= (uint32_t)((ac + d) & 0xff) << c;
+   }
+
+   return res;
+}
+
+
+static inline uint32_t
+texel(const uint8_t *data, int x, int y)
+{
+   x = CLAMP(x, 0, TEX_WIDTH - 1);
+   y = CLAMP(y, 0, TEX_HEIGHT - 1);
+   return *(const uint32_t *)(data + y * TEX_STRIDE + x * 4);
+}
+
+
+/**
+ * Reference for one row of fetch_axis_aligned_linear_bgra(), which
+ * stretches each texture row horizontally before combining them.
+ */
+static void
+ref_axis_aligned_row(const uint8_t *data, const struct lp_linear_sampler *samp,
+                     int t, uint32_t *row)
+{
+   const int y = t >> 16;
+   const unsigned wt = (t >> 8) & 0xff;
+   int s = samp->s;
+
+   for (int i = 0; i < samp->width; i++) {
+      const int x = (uint16_t)(s >> 16);
+      const unsigned ws = (s >> 8) & 0xff;
+      uint32_t c0 = lerp_unorm8(texel(data, x, y), texel(data, x + 1, y), ws);
+      uint32_t c1 = lerp_unorm8(texel(data, x, y + 1),
+                                texel(data, x + 1, y + 1), ws);
+      row[i] = lerp_unorm8(c0, c1, wt);
+      s += samp->dsdx;
+   }
+}
+
+
+/**
+ * Reference for one row of fetch_linear_bgra() and
+ * fetch_clamp_linear_bgra(), which filter vertically first.
+ */
+static void
+ref_linear_row(const uint8_t *data, const struct lp_linear_sampler *samp,
+               int s, int t, uint32_t *row)
+{
+   for (int i = 0; i < samp->width; i++) {
+      const int x = s >> 16, y = t >> 16;
+      const unsigned ws = (s >> 8) & 0xff, wt = (t >> 8) & 0xff;
+      uint32_t c0 = lerp_unorm8(texel(data, x, y), texel(data, x, y + 1), wt);
+      uint32_t c1 = lerp_unorm8(texel(data, x + 1, y),
+                                texel(data, x + 1, y + 1), wt);
+      row[i] = lerp_unorm8(c0, c1, ws);
+      s += samp->dsdx;
+      t += samp->dtdx;
+   }
+}
+
+
+static bool
+init_sampler(struct lp_linear_sampler *samp,
+             const struct lp_jit_texture *texture,
+             const struct sampler_test *test, unsigned width)
+{
+   struct lp_tgsi_texture_info info;
+   struct lp_sampler_static_state state;
+   float a0[2][4], dadx[2][4], dady[2][4];
+
+   memset(&info, 0, sizeof info);
+   info.coord[0].file = TGSI_FILE_INPUT;
+   info.coord[0].swizzle = 0;
+   info.coord[1].file = TGSI_FILE_INPUT;
+   info.coord[1].swizzle = 1;
+   info.target = TGSI_TEXTURE_2D;
+
+   memset(&state, 0, sizeof state);
+   state.texture_state.format = PIPE_FORMAT_B8G8R8A8_UNORM;
+   state.texture_state.target = PIPE_TEXTURE_2D;
+   state.texture_state.level_zero_only = 1;
+   state.sampler_state.min_img_filter = PIPE_TEX_FILTER_LINEAR;
+   state.sampler_state.mag_img_filter = PIPE_TEX_FILTER_LINEAR;
+   state.sampler_state.wrap_s = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   state.sampler_state.wrap_t = PIPE_TEX_WRAP_CLAMP_TO_EDGE;
+   state.sampler_state.normalized_coords = 1;
+
+   /* Texel centers are at half coordinates. */
+   memset(a0, 0, sizeof a0);
+   memset(dadx, 0, sizeof dadx);
+   memset(dady, 0, sizeof dady);
+   a0[0][3] = 1.0f;
+   a0[1][0] = (test->s0 + 0.5f) / TEX_WIDTH;
+   a0[1][1] = (test->t0 + 0.5f) / TEX_HEIGHT;
+   dadx[1][0] = test->dsdx / TEX_WIDTH;
+   dadx[1][1] = test->dtdx / TEX_HEIGHT;
+   dady[1][0] = test->dsdy / TEX_WIDTH;
+   dady[1][1] = test->dtdy / TEX_HEIGHT;
+
+   return lp_linear_init_sampler(samp, &info, &state, texture,
+                                 0, 0, width, NUM_ROWS,
+                                 (const float (*)[4])a0,
+                                 (const float (*)[4])dadx,
+                                 (const float (*)[4])dady,
+                                 false);
+}
+
+
+static bool
+test_sampler(unsigned verbose, FILE *fp, const uint8_t *data,
+             const struct sampler_test *test, unsigned width,
+             unsigned repeat)
+{
+   struct lp_linear_sampler *samp = align_malloc(sizeof *samp, 32);
+   struct lp_jit_texture texture;
+   uint32_t expected[64];
+   bool success = true;
+
+   memset(&texture, 0, sizeof texture);
+   texture.base = data;
+   texture.width = TEX_WIDTH;
+   texture.height = TEX_HEIGHT;
+   texture.row_stride[0] = TEX_STRIDE;
+
+   if (!init_sampler(samp, &texture, test, width)) {
+      fprintf(stderr, "%s: not supported by the linear path\n", test->name);
+      align_free(samp);
+      return false;
+   }
+
+   for (unsigned y = 0; y < NUM_ROWS && success; y++) {
+      const int s = samp->s, t = samp->t;
+
+      if (samp->axis_aligned)
+         ref_axis_aligned_row(data, samp, t, expected);
+      else
+         ref_linear_row(data, samp, s, t, expected);
+
+      const uint32_t *row = samp->base.fetch(&samp->base);
+
+      for (unsigned x = 0; x < width; x++) {
+         if (row[x] != expected[x]) {
+            fprintf(stderr, "%s: pixel (%u, %u) is 0x%08x, expected 0x%08x\n",
+                    test->name, x, y, row[x], expected[x]);
+            success = false;
+            break;
+         }
+      }
+   }
+
+   int64_t start = os_time_get_nano();
+   for (unsigned n = 0; n < repeat; n++) {
+      init_sampler(samp, &texture, test, width);
+      for (unsigned y = 0; y < NUM_ROWS; y++)
+         samp->base.fetch(&samp->base);
+   }
+   int64_t end = os_time_get_nano();
+
+   align_free(samp);
+
+   report(verbose, fp, test->name, width, success,
+          (double)(end - start) / ((double)repeat * NUM_ROWS * width));
+
+   return success;
+}
+
+
+static bool
+test_interp(unsigned verbose, FILE *fp, const struct interp_test *test,
+            unsigned width, unsigned repeat)
+{
+   struct lp_linear_interp *interp = align_malloc(sizeof *interp, 32);
+   bool success = true;
+
+   if (!lp_linear_init_interp(interp, 0, 0, width, NUM_ROWS, 0xf, false,
+                              1.0f, test->a0, test->dadx, test->dady)) {
+      fprintf(stderr, "%s: not supported by the linear path\n", test->name);
+      align_free(interp);
+      return false;
+   }
+
+   union m128i a0, dadx, dady;
+   a0.m = interp->a0;
+   dadx.m = interp->dadx;
+   dady.m = interp->dady;
+
+   for (unsigned y = 0; y < NUM_ROWS && success; y++) {
+      const uint32_t *row = interp->base.fetch(&interp->base);
+
+      for (unsigned x = 0; x < width; x++) {
+         uint32_t expected = 0;
+
+         for (unsigned c = 0; c < 4; c++) {
+            int16_t v = a0.us[(x & 1) * 4 + c] +
+                        (x >> 1) * dadx.us[c] + y * dady.us[c];
+            expected |= (uint32_t)CLAMP(v >> 7, 0, 255) << (c * 8);
+         }
+
+         if (row[x] != expected) {
+            fprintf(stderr, "%s: pixel (%u, %u) is 0x%08x, expected 0x%08x\n",
+                    test->name, x, y, row[x], expected);
+            success = false;
+            break;
+         }
+      }
+   }
+
+   int64_t start = os_time_get_nano();
+   for (unsigned n = 0; n < repeat; n++) {
+      lp_linear_init_interp(interp, 0, 0, width, NUM_ROWS, 0xf, false,
+                            1.0f, test->a0, test->dadx, test->dady);
+      for (unsigned y = 0; y < NUM_ROWS; y++)
+         interp->base.fetch(&interp->base);
+   }
+   int64_t end = os_time_get_nano();
+
+   align_free(interp);
+
+   report(verbose, fp, test->name, width, success,
+          (double)(end - start) / ((double)repeat * NUM_ROWS * width));
+
+   return success;
+}
+
+
+static bool
+test_kernels(unsigned verbose, FILE *fp, unsigned repeat)
+{
+   uint8_t *data = align_malloc(TEX_STRIDE * TEX_HEIGHT, 64);
+   bool success = true;
+
+   for (unsigned i = 0; i < TEX_STRIDE * TEX_HEIGHT; i++)
+      data[i] = rand();
+
+   for (unsigned w = 0; w < ARRAY_SIZE(test_widths); w++) {
+      for (unsigned i = 0; i < ARRAY_SIZE(sampler_tests); i++)
+         success &= test_sampler(verbose, fp, data, &sampler_tests[i],
+                                 test_widths[w], repeat);
+
+      for (unsigned i = 0; i < ARRAY_SIZE(interp_tests); i++)
+         success &= test_interp(verbose, fp, &interp_tests[i],
+                                test_widths[w], repeat);
+   }
+
+   align_free(data);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_kernels(verbose, fp, 1000);
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_kernels(verbose, fp, MAX2(n, 1));
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_kernels(verbose, fp, 1);
+}
+
+#else  // DETECT_ARCH_SSE
+
+void
+write_tsv_header(FILE *fp)
+{
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   /* The linear path is only implemented with SSE2. */
+   return true;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return true;
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return true;
+}
+
+#endif  // DETECT_ARCH_SSE
@@ -0,0 +1,406 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * Micro-tiled texture layout tests.
+ *
+ * Checks that the offsets generated by lp_build_microtiled_sample_offset()
+ * match llvmpipe_microtile_offset(), that llvmpipe_microtile_copy() round
+ * trips, and compares how long quad footprint reads take with the linear
+ * and the micro-tiled layouts for a few sampling patterns.
+ */
+
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+
+#include "util/os_time.h"
+#include "util/u_memory.h"
+#include "util/u_pointer.h"
+#include "gallivm/lp_bld_init.h"
+#include "gallivm/lp_bld_const.h"
+#include "gallivm/lp_bld_sample.h"
+#include "lp_texture.h"
+#include "lp_test.h"
+
+
+#define TEST_VECTOR_LENGTH 4
+
+
+typedef void
+(*microtile_offset_func_t)(const uint32_t *x, const uint32_t *y,
+                           uint32_t y_stride, uint32_t *offset);
+
+
+static const enum pipe_format test_formats[] = {
+   PIPE_FORMAT_R8_UNORM,
+   PIPE_FORMAT_R8G8_UNORM,
+   PIPE_FORMAT_R8G8B8A8_UNORM,
+   PIPE_FORMAT_R32G32_FLOAT,
+   PIPE_FORMAT_R32G32B32A32_FLOAT,
+};
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "test\t"
+           "format\t"
+           "linear ns/sample\t"
+           "microtiled ns/sample\n");
+
+   fflush(fp);
+}
+
+
+static void
+write_tsv_row(FILE *fp, const char *test, enum pipe_format format,
+              bool success, double linear_ns, double microtiled_ns)
+{
+   fprintf(fp, "%s\t%s\t%s\t%.2f\t%.2f\n",
+           success ? "pass" : "fail", test,
+           util_format_short_name(format), linear_ns, microtiled_ns);
+   fflush(fp);
+}
+
+
+static LLVMValueRef
+add_offset_test(struct gallivm_state *gallivm,
+                const struct util_format_description *format_desc)
+{
+   LLVMContextRef context = gallivm->context;
+   LLVMBuilderRef builder = gallivm->builder;
+   struct lp_type type = lp_type_uint_vec(32, 32 * TEST_VECTOR_LENGTH);
+   struct lp_build_context bld;
+   LLVMTypeRef vec_type = lp_build_vec_type(gallivm, type);
+   LLVMTypeRef ptr_type = LLVMPointerType(vec_type, 0);
+   LLVMTypeRef int32_type = LLVMInt32TypeInContext(context);
+   LLVMTypeRef args[4] = { ptr_type, ptr_type, int32_type, ptr_type };
+
+   LLVMValueRef func =
+      LLVMAddFunction(gallivm->module, "test_microtile_offset",
+                      LLVMFunctionType(LLVMVoidTypeInContext(context),
+                                       args, ARRAY_SIZE(args), 0));
+   LLVMSetFunctionCallConv(func, LLVMCCallConv);
+
+   LLVMBasicBlockRef block =
+      LLVMAppendBasicBlockInContext(context, func, "entry");
+   LLVMPositionBuilderAtEnd(builder, block);
+
+   lp_build_context_init(&bld, gallivm, type);
+
+   LLVMValueRef x = LLVMBuildLoad2(builder, vec_type, LLVMGetParam(func, 0), "");
+   LLVMValueRef y = LLVMBuildLoad2(builder, vec_type, LLVMGetParam(func, 1), "");
+   LLVMValueRef y_stride = lp_build_broadcast_scalar(&bld, LLVMGetParam(func, 2));
+   LLVMValueRef offset, i, j;
+
+   lp_build_microtiled_sample_offset(&bld, format_desc, x, y, NULL,
+                                     y_stride, NULL, &offset, &i, &j);
+
+   LLVMBuildStore(builder, offset, LLVMGetParam(func, 3));
+   LLVMBuildRetVoid(builder);
+
+   gallivm_verify_function(gallivm, func);
+
+   return func;
+}
+
+
+/**
+ * Compare the generated offsets against llvmpipe_microtile_offset().
+ */
+static bool
+test_offsets(unsigned verbose, FILE *fp, enum pipe_format format)
+{
+   const struct util_format_description *format_desc =
+      util_format_description(format);
+   const unsigned block_size = format_desc->block.bits / 8;
+   const unsigned y_stride = align(37 * block_size, 64);
+   bool success = true;
+
+   lp_context_ref context;
+   lp_context_create(&context);
+
+   struct gallivm_state *gallivm =
+      gallivm_create("test_module", &context, NULL);
+   LLVMValueRef func = add_offset_test(gallivm, format_desc);
+
+   gallivm_compile_module(gallivm);
+
+   microtile_offset_func_t offset_func = (microtile_offset_func_t)
+      gallivm_jit_function(gallivm, func, "test_microtile_offset");
+
+   gallivm_free_ir(gallivm);
+
+   for (unsigned n = 0; n < 256 && success; n++) {
+      alignas(16) uint32_t x[TEST_VECTOR_LENGTH];
+      alignas(16) uint32_t y[TEST_VECTOR_LENGTH];
+      alignas(16) uint32_t offset[TEST_VECTOR_LENGTH];
+
+      for (unsigned k = 0; k < TEST_VECTOR_LENGTH; k++) {
+         x[k] = rand() % 37;
+         y[k] = rand() % 23;
+      }
+
+      offset_func(x, y, y_stride, offset);
+
+      for (unsigned k = 0; k < TEST_VECTOR_LENGTH; k++) {
+         uint64_t expected =
+            llvmpipe_microtile_offset(x[k], y[k], y_stride, block_size);
+         if (offset[k] != expected) {
+            fprintf(stderr, "%s: offset of (%u, %u) is %u, expected %u\n",
+                    util_format_short_name(format), x[k], y[k],
+                    offset[k], (unsigned)expected);
+            success = false;
+         }
+      }
+   }
+
+   gallivm_destroy(gallivm);
+   lp_context_destroy(&context);
+
+   if (verbose >= 1) {
+      fprintf(stdout, "%s: offsets %s\n",
+              success ? "PASS" : "FAIL", util_format_short_name(format));
+   }
+
+   if (fp)
+      write_tsv_row(fp, "offsets", format, success, 0.0, 0.0);
+
+   return success;
+}
+
+
+/**
+ * Tile a linear image, untile it again, and check nothing got lost,
+ * for a box which is not tile aligned.
+ */
+static bool
+test_copy(unsigned verbose, FILE *fp, enum pipe_format format)
+{
+   const unsigned block_size = util_format_get_blocksize(format);
+   const unsigned width = 29, height = 19;
+   const unsigned x = 3, y = 2, box_width = 21, box_height = 13;
+   const unsigned linear_stride = width * block_size;
+   const unsigned tiled_stride = align(align(width, LP_MICROTILE_SIZE) *
+                                       block_size, 64);
+   const unsigned tiled_size = tiled_stride * align(height, LP_MICROTILE_SIZE);
+   bool success = true;
+
+   uint8_t *linear = MALLOC(linear_stride * height);
+   uint8_t *result = CALLOC(linear_stride, height);
+   uint8_t *tiled = CALLOC(tiled_size, 1);
+
+   for (unsigned i = 0; i < linear_stride * height; i++)
+      linear[i] = rand();
+
+   uint8_t *src = linear + y * linear_stride + x * block_size;
+   uint8_t *dst = result + y * linear_stride + x * block_size;
+
+   llvmpipe_microtile_copy(tiled, tiled_stride, src, linear_stride,
+                           x, y, box_width, box_height, block_size, true);
+   llvmpipe_microtile_copy(tiled, tiled_stride, dst, linear_stride,
+                           x, y, box_width, box_height, block_size, false);
+
+   for (unsigned j = 0; j < box_height; j++) {
+      if (memcmp(src + j * linear_stride, dst + j * linear_stride,
+                 box_width * block_size)) {
+         fprintf(stderr, "%s: row %u differs after round trip\n",
+                 util_format_short_name(format), y + j);
+         success = false;
+         break;
+      }
+   }
+
+   /* Each texel must land at its own offset. */
+   for (unsigned j = 0; j < box_height && success; j++) {
+      for (unsigned i = 0; i < box_width; i++) {
+         const uint8_t *texel = tiled +
+            llvmpipe_microtile_offset(x + i, y + j, tiled_stride, block_size);
+         if (memcmp(texel, src + j * linear_stride + i * block_size,
+                    block_size)) {
+            fprintf(stderr, "%s: texel (%u, %u) misplaced\n",
+                    util_format_short_name(format), x + i, y + j);
+            success = false;
+            break;
+         }
+      }
+   }
+
+   FREE(linear);
+   FREE(result);
+   FREE(tiled);
+
+   if (verbose >= 1) {
+      fprintf(stdout, "%s: copy %s\n",
+              success ? "PASS" : "FAIL", util_format_short_name(format));
+   }
+
+   if (fp)
+      write_tsv_row(fp, "copy", format, success, 0.0, 0.0);
+
+   return success;
+}
+
+
+enum footprint_pattern {
+   PATTERN_IDENTITY,
+   PATTERN_ROTATED_90,
+   PATTERN_ROTATED_30,
+   PATTERN_MINIFIED_4X,
+};
+
+
+static const char *pattern_names[] = {
+   "identity",
+   "rotated 90",
+   "rotated 30",
+   "minified 4x",
+};
+
+
+/**
+ * Read the 2x2 bilinear footprint of every pixel of a 2x2 quad,
+ * covering the whole destination, and return ns per sample.
+ */
+static double
+time_footprints(const uint8_t *data, unsigned size, unsigned stride,
+                bool microtiled, enum footprint_pattern pattern,
+                uint32_t *checksum)
+{
+   const unsigned block_size = 4;
+   const unsigned mask = size - 1;
+   float dudx = 1.0f, dvdx = 0.0f, dudy = 0.0f, dvdy = 1.0f;
+   uint32_t sum = 0;
+
+   switch (pattern) {
+   case PATTERN_IDENTITY:
+      break;
+   case PATTERN_ROTATED_90:
+      dudx = 0.0f; dvdx = 1.0f; dudy = 1.0f; dvdy = 0.0f;
+      break;
+   case PATTERN_ROTATED_30:
+      dudx = cosf(M_PI / 6); dvdx = sinf(M_PI / 6);
+      dudy = -dvdx; dvdy = dudx;
+      break;
+   case PATTERN_MINIFIED_4X:
+      dudx = 4.0f; dvdy = 4.0f;
+      break;
+   }
+
+   int64_t start = os_time_get_nano();
+
+   for (unsigned qy = 0; qy < size; qy += 2) {
+      for (unsigned qx = 0; qx < size; qx += 2) {
+         for (unsigned p = 0; p < 4; p++) {
+            float px = qx + (p & 1), py = qy + (p >> 1);
+            unsigned u = (unsigned)(int)(px * dudx + py * dudy);
+            unsigned v = (unsigned)(int)(px * dvdx + py * dvdy);
+
+            for (unsigned t = 0; t < 4; t++) {
+               unsigned x = (u + (t & 1)) & mask;
+               unsigned y = (v + (t >> 1)) & mask;
+               uint64_t offset = microtiled ?
+                  llvmpipe_microtile_offset(x, y, stride, block_size) :
+                  (uint64_t)y * stride + x * block_size;
+               sum += *(const uint32_t *)(data + offset);
+            }
+         }
+      }
+   }
+
+   int64_t end = os_time_get_nano();
+
+   *checksum = sum;
+   return (double)(end - start) / ((double)size * size);
+}
+
+
+static bool
+test_footprints(unsigned verbose, FILE *fp, unsigned size)
+{
+   const enum pipe_format format = PIPE_FORMAT_R8G8B8A8_UNORM;
+   const unsigned block_size = 4;
+   const unsigned stride = size * block_size;
+   bool success = true;
+
+   uint8_t *linear = align_malloc((size_t)stride * size, 64);
+   uint8_t *tiled = align_malloc((size_t)stride * size, 64);
+   if (!linear || !tiled) {
+      align_free(linear);
+      align_free(tiled);
+      return false;
+   }
+
+   for (size_t i = 0; i < (size_t)stride * size; i++)
+      linear[i] = rand();
+
+   llvmpipe_microtile_copy(tiled, stride, linear, stride,
+                           0, 0, size, size, block_size, true);
+
+   for (unsigned p = 0; p < ARRAY_SIZE(pattern_names); p++) {
+      uint32_t linear_sum, tiled_sum;
+      double linear_ns = time_footprints(linear, size, stride, false, p,
+                                         &linear_sum);
+      double tiled_ns = time_footprints(tiled, size, stride, true, p,
+                                        &tiled_sum);
+      bool pass = linear_sum == tiled_sum;
+
+      if (verbose >= 1 || !pass) {
+         fprintf(stdout, "%s: %ux%u %s, %.2f ns/sample linear, "
+                 "%.2f ns/sample micro-tiled\n",
+                 pass ? "PASS" : "FAIL", size, size, pattern_names[p],
+                 linear_ns, tiled_ns);
+      }
+
+      if (fp)
+         write_tsv_row(fp, pattern_names[p], format, pass,
+                       linear_ns, tiled_ns);
+
+      success &= pass;
+   }
+
+   align_free(linear);
+   align_free(tiled);
+
+   return success;
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   bool success = true;
+
+   for (unsigned i = 0; i < ARRAY_SIZE(test_formats); i++) {
+      success &= test_offsets(verbose, fp, test_formats[i]);
+      success &= test_copy(verbose, fp, test_formats[i]);
+   }
+
+   success &= test_footprints(verbose, fp, 512);
+   success &= test_footprints(verbose, fp, 2048);
+
+   return success;
+}
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_all(verbose, fp);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   return test_offsets(verbose, fp, PIPE_FORMAT_R8G8B8A8_UNORM) &&
+          test_copy(verbose, fp, PIPE_FORMAT_R8G8B8A8_UNORM);
+}
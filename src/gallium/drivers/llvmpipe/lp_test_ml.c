@@ -0,0 +1,534 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/**
+ * @file
+ * ML subgraph tests.
+ *
+ * Builds a small quantized network out of every operation type, runs it
+ * through the context's ml_subgraph hooks and compares each tensor with a
+ * straightforward implementation of the TensorFlow Lite reference kernels,
+ * which has to match exactly.  Also reports how long an invocation takes.
+ */
+
+
+#include <math.h>
+#include <stdlib.h>
+#include <stdio.h>
+
+#include "pipe/p_context.h"
+#include "pipe/p_screen.h"
+#include "pipe/p_state.h"
+#include "util/os_time.h"
+#include "util/u_inlines.h"
+#include "util/u_math.h"
+#include "util/u_memory.h"
+#include "sw/null/null_sw_winsys.h"
+#include "lp_public.h"
+#include "lp_test.h"
+
+
+void
+write_tsv_header(FILE *fp)
+{
+   fprintf(fp,
+           "result\t"
+           "format\t"
+           "size\t"
+           "us/invoke\n");
+
+   fflush(fp);
+}
+
+
+/*
+ * Reference implementation
+ */
+
+static void
+ref_quantize_multiplier(double real, int32_t *multiplier, int *shift)
+{
+   if (real == 0.0) {
+      *multiplier = 0;
+      *shift = 0;
+      return;
+   }
+
+   int64_t q = llround(frexp(real, shift) * (double)(1ll << 31));
+   if (q == (1ll << 31)) {
+      q /= 2;
+      (*shift)++;
+   }
+   *multiplier = q;
+}
+
+static int32_t
+ref_multiply(int32_t x, int32_t multiplier, int shift)
+{
+   const int left_shift = shift > 0 ? shift : 0;
+   const int right_shift = shift > 0 ? 0 : -shift;
+   int64_t ab = (int64_t)(x * (1 << left_shift)) * multiplier;
+   int32_t nudge = ab >= 0 ? (1 << 30) : (1 - (1 << 30));
+   int32_t high = (int32_t)((ab + nudge) / (1ll << 31));
+
+   const int32_t mask = (int32_t)((1ll << right_shift) - 1);
+   const int32_t remainder = high & mask;
+   const int32_t threshold = (mask >> 1) + (high < 0);
+   return (high >> right_shift) + (remainder > threshold);
+}
+
+static int
+ref_load(const uint8_t *data, bool is_signed)
+{
+   return is_signed ? (int8_t)*data : *data;
+}
+
+static uint8_t
+ref_store(int32_t value, bool is_signed)
+{
+   if (is_signed)
+      return (uint8_t)(int8_t)CLAMP(value, -128, 127);
+   else
+      return (uint8_t)CLAMP(value, 0, 255);
+}
+
+static unsigned
+ref_padding(unsigned in, unsigned out, unsigned kernel, unsigned stride,
+            bool same)
+{
+   int total = (int)((out - 1) * stride + kernel) - (int)in;
+   return same ? MAX2(total, 0) / 2 : 0;
+}
+
+struct test_tensor {
+   struct pipe_tensor base;
+   uint8_t *data;
+   unsigned size;
+};
+
+static void
+ref_convolution(const struct pipe_ml_operation *op,
+                const struct test_tensor *in, struct test_tensor *out,
+                const uint8_t *weights, const int32_t *biases)
+{
+   const struct pipe_tensor *w = op->conv.weight_tensor;
+   const unsigned ih = in->base.dims[1], iw = in->base.dims[2];
+   const unsigned ic = in->base.dims[3];
+   const unsigned oh = out->base.dims[1], ow = out->base.dims[2];
+   const unsigned oc = out->base.dims[3];
+   const unsigned kh = w->dims[1], kw = w->dims[2];
+   const unsigned pad_y = ref_padding(ih, oh, kh, op->conv.stride_y,
+                                      op->conv.padding_same);
+   const unsigned pad_x = ref_padding(iw, ow, kw, op->conv.stride_x,
+                                      op->conv.padding_same);
+   int32_t multiplier;
+   int shift;
+
+   ref_quantize_multiplier((double)in->base.scale * w->scale / out->base.scale,
+                           &multiplier, &shift);
+
+   for (unsigned y = 0; y < oh; y++) {
+      for (unsigned x = 0; x < ow; x++) {
+         for (unsigned c = 0; c < oc; c++) {
+            int32_t acc = biases[c];
+
+            for (unsigned ky = 0; ky < kh; ky++) {
+               for (unsigned kx = 0; kx < kw; kx++) {
+                  int iy = (int)(y * op->conv.stride_y + ky) - (int)pad_y;
+                  int ix = (int)(x * op->conv.stride_x + kx) - (int)pad_x;
+                  if (iy < 0 || iy >= (int)ih || ix < 0 || ix >= (int)iw)
+                     continue;
+
+                  const uint8_t *src = &in->data[(iy * iw + ix) * ic];
+
+                  if (op->conv.depthwise) {
+                     int xv = ref_load(&src[c * ic / oc], in->base.is_signed) -
+                              in->base.zero_point;
+                     int wv = ref_load(&weights[(ky * kw + kx) * oc + c],
+                                       w->is_signed) - w->zero_point;
+                     acc += xv * wv;
+                  } else {
+                     for (unsigned i = 0; i < ic; i++) {
+                        int xv = ref_load(&src[i], in->base.is_signed) -
+                                 in->base.zero_point;
+                        int wv = ref_load(&weights[((c * kh + ky) * kw + kx) * ic + i],
+                                          w->is_signed) - w->zero_point;
+                        acc += xv * wv;
+                     }
+                  }
+               }
+            }
+
+            acc = ref_multiply(acc, multiplier, shift) + out->base.zero_point;
+            out->data[(y * ow + x) * oc + c] = ref_store(acc, out->base.is_signed);
+         }
+      }
+   }
+}
+
+static void
+ref_add(const struct test_tensor *a, const struct test_tensor *b,
+        struct test_tensor *out)
+{
+   const double twice_max = 2.0 * MAX2(a->base.scale, b->base.scale);
+   int32_t ma, mb, mo;
+   int sa, sb, so;
+
+   ref_quantize_multiplier(a->base.scale / twice_max, &ma, &sa);
+   ref_quantize_multiplier(b->base.scale / twice_max, &mb, &sb);
+   ref_quantize_multiplier(twice_max / ((1 << 20) * (double)out->base.scale),
+                           &mo, &so);
+
+   for (unsigned i = 0; i < out->size; i++) {
+      int32_t va = (ref_load(&a->data[i], a->base.is_signed) -
+                    a->base.zero_point) * (1 << 20);
+      int32_t vb = (ref_load(&b->data[i], b->base.is_signed) -
+                    b->base.zero_point) * (1 << 20);
+      int32_t sum = ref_multiply(va, ma, sa) + ref_multiply(vb, mb, sb);
+
+      sum = ref_multiply(sum, mo, so) + out->base.zero_point;
+      out->data[i] = ref_store(sum, out->base.is_signed);
+   }
+}
+
+static void
+ref_average_pool(const struct pipe_ml_operation *op,
+                 const struct test_tensor *in, struct test_tensor *out)
+{
+   const unsigned ih = in->base.dims[1], iw = in->base.dims[2];
+   const unsigned oh = out->base.dims[1], ow = out->base.dims[2];
+   const unsigned c = out->base.dims[3];
+   const unsigned kh = op->pooling.filter_height;
+   const unsigned kw = op->pooling.filter_width;
+   const unsigned pad_y = ref_padding(ih, oh, kh, op->pooling.stride_y,
+                                      op->pooling.padding_same);
+   const unsigned pad_x = ref_padding(iw, ow, kw, op->pooling.stride_x,
+                                      op->pooling.padding_same);
+
+   for (unsigned y = 0; y < oh; y++) {
+      for (unsigned x = 0; x < ow; x++) {
+         for (unsigned ch = 0; ch < c; ch++) {
+            int32_t acc = 0;
+            int count = 0;
+
+            for (unsigned ky = 0; ky < kh; ky++) {
+               for (unsigned kx = 0; kx < kw; kx++) {
+                  int iy = (int)(y * op->pooling.stride_y + ky) - (int)pad_y;
+                  int ix = (int)(x * op->pooling.stride_x + kx) - (int)pad_x;
+                  if (iy < 0 || iy >= (int)ih || ix < 0 || ix >= (int)iw)
+                     continue;
+                  acc += ref_load(&in->data[(iy * iw + ix) * c + ch],
+                                  in->base.is_signed);
+                  count++;
+               }
+            }
+
+            int32_t avg = count ? (acc + (acc > 0 ? count / 2 : -count / 2)) / count : 0;
+            out->data[(y * ow + x) * c + ch] = ref_store(avg, out->base.is_signed);
+         }
+      }
+   }
+}
+
+
+/*
+ * Test network
+ */
+
+enum {
+   T_INPUT,
+   T_CONV,        /* 3x3 convolution */
+   T_DEPTHWISE,   /* 3x3 depthwise convolution, stride 2 */
+   T_POINTWISE_A, /* 1x1 convolutions */
+   T_POINTWISE_B,
+   T_ADD,
+   T_POOL,        /* 2x2 average pool */
+   T_COUNT
+};
+
+enum {
+   W_CONV,
+   W_DEPTHWISE,
+   W_POINTWISE_A,
+   W_POINTWISE_B,
+   W_COUNT
+};
+
+struct test_network {
+   struct test_tensor tensors[T_COUNT];
+   struct pipe_tensor weights[W_COUNT];
+   struct pipe_tensor biases[W_COUNT];
+   uint8_t *weight_data[W_COUNT];
+   int32_t *bias_data[W_COUNT];
+   struct pipe_ml_operation ops[6];
+};
+
+static void
+init_tensor(struct test_tensor *t, unsigned index, unsigned h, unsigned w,
+            unsigned c, float scale, bool is_signed)
+{
+   t->base.index = index;
+   t->base.dims[0] = 1;
+   t->base.dims[1] = h;
+   t->base.dims[2] = w;
+   t->base.dims[3] = c;
+   t->base.scale = scale;
+   t->base.zero_point = is_signed ? (int)(rand() % 32) - 16 : 112 + rand() % 32;
+   t->base.is_signed = is_signed;
+   t->size = h * w * c;
+   t->data = CALLOC(t->size, 1);
+}
+
+static void
+random_bytes(uint8_t *data, unsigned size)
+{
+   for (unsigned i = 0; i < size; i++)
+      data[i] = rand();
+}
+
+static void
+init_conv(struct pipe_context *pipe, struct test_network *net, unsigned w,
+          unsigned op_idx, unsigned in, unsigned out, unsigned k,
+          unsigned stride, bool depthwise, bool is_signed)
+{
+   struct pipe_ml_operation *op = &net->ops[op_idx];
+   const unsigned oc = net->tensors[out].base.dims[3];
+   const unsigned ic = depthwise ? 1 : net->tensors[in].base.dims[3];
+   const unsigned weight_size = oc * k * k * ic;
+
+   net->weight_data[w] = MALLOC(weight_size);
+   random_bytes(net->weight_data[w], weight_size);
+   net->bias_data[w] = MALLOC(oc * sizeof(int32_t));
+   for (unsigned i = 0; i < oc; i++)
+      net->bias_data[w][i] = rand() % 20000 - 10000;
+
+   struct pipe_tensor *weights = &net->weights[w];
+   weights->index = T_COUNT + w;
+   weights->dims[0] = depthwise ? 1 : oc;
+   weights->dims[1] = k;
+   weights->dims[2] = k;
+   weights->dims[3] = depthwise ? oc : ic;
+   weights->scale = 0.02f;
+   weights->zero_point = is_signed ? 0 : 128;
+   weights->is_signed = is_signed;
+   weights->resource =
+      pipe_buffer_create_with_data(pipe, 0, PIPE_USAGE_DEFAULT, weight_size,
+                                   net->weight_data[w]);
+
+   struct pipe_tensor *biases = &net->biases[w];
+   biases->index = T_COUNT + W_COUNT + w;
+   biases->dims[0] = oc;
+   biases->resource =
+      pipe_buffer_create_with_data(pipe, 0, PIPE_USAGE_DEFAULT,
+                                   oc * sizeof(int32_t), net->bias_data[w]);
+
+   op->type = PIPE_ML_OPERATION_TYPE_CONVOLUTION;
+   op->input_tensor = &net->tensors[in].base;
+   op->output_tensor = &net->tensors[out].base;
+   op->conv.weight_tensor = weights;
+   op->conv.bias_tensor = biases;
+   op->conv.stride_x = stride;
+   op->conv.stride_y = stride;
+   op->conv.padding_same = true;
+   op->conv.pointwise = k == 1;
+   op->conv.depthwise = depthwise;
+}
+
+static void
+init_network(struct pipe_context *pipe, struct test_network *net,
+             unsigned size, bool is_signed)
+{
+   const unsigned half = DIV_ROUND_UP(size, 2);
+
+   memset(net, 0, sizeof(*net));
+
+   /* Odd sizes and channel counts to hit the tails of every loop. */
+   init_tensor(&net->tensors[T_INPUT], T_INPUT, size, size + 3, 6, 0.05f, is_signed);
+   init_tensor(&net->tensors[T_CONV], T_CONV, size, size + 3, 70, 0.3f, is_signed);
+   init_tensor(&net->tensors[T_DEPTHWISE], T_DEPTHWISE, half, DIV_ROUND_UP(size + 3, 2), 70, 0.1f, is_signed);
+   init_tensor(&net->tensors[T_POINTWISE_A], T_POINTWISE_A, half, DIV_ROUND_UP(size + 3, 2), 13, 0.4f, is_signed);
+   init_tensor(&net->tensors[T_POINTWISE_B], T_POINTWISE_B, half, DIV_ROUND_UP(size + 3, 2), 13, 0.25f, is_signed);
+   init_tensor(&net->tensors[T_ADD], T_ADD, half, DIV_ROUND_UP(size + 3, 2), 13, 0.5f, is_signed);
+   init_tensor(&net->tensors[T_POOL], T_POOL, half / 2, DIV_ROUND_UP(size + 3, 2) / 2, 13, 0.5f, is_signed);
+
+   /* Pooling doesn't requantize. */
+   net->tensors[T_POOL].base.zero_point = net->tensors[T_ADD].base.zero_point;
+
+   random_bytes(net->tensors[T_INPUT].data, net->tensors[T_INPUT].size);
+
+   init_conv(pipe, net, W_CONV, 0, T_INPUT, T_CONV, 3, 1, false, is_signed);
+   init_conv(pipe, net, W_DEPTHWISE, 1, T_CONV, T_DEPTHWISE, 3, 2, true, is_signed);
+   init_conv(pipe, net, W_POINTWISE_A, 2, T_DEPTHWISE, T_POINTWISE_A, 1, 1, false, is_signed);
+   init_conv(pipe, net, W_POINTWISE_B, 3, T_DEPTHWISE, T_POINTWISE_B, 1, 1, false, is_signed);
+
+   net->ops[4].type = PIPE_ML_OPERATION_TYPE_ADD;
+   net->ops[4].input_tensor = &net->tensors[T_POINTWISE_A].base;
+   net->ops[4].add.input_tensor = &net->tensors[T_POINTWISE_B].base;
+   net->ops[4].output_tensor = &net->tensors[T_ADD].base;
+
+   net->ops[5].type = PIPE_ML_OPERATION_TYPE_POOLING;
+   net->ops[5].input_tensor = &net->tensors[T_ADD].base;
+   net->ops[5].output_tensor = &net->tensors[T_POOL].base;
+   net->ops[5].pooling.filter_width = 2;
+   net->ops[5].pooling.filter_height = 2;
+   net->ops[5].pooling.stride_x = 2;
+   net->ops[5].pooling.stride_y = 2;
+   net->ops[5].pooling.padding_same = false;
+}
+
+static void
+run_reference(struct test_network *net)
+{
+   struct test_tensor *t = net->tensors;
+
+   for (unsigned i = 0; i < 4; i++) {
+      const struct pipe_ml_operation *op = &net->ops[i];
+      ref_convolution(op, &t[op->input_tensor->index],
+                      &t[op->output_tensor->index],
+                      net->weight_data[i], net->bias_data[i]);
+   }
+   ref_add(&t[T_POINTWISE_A], &t[T_POINTWISE_B], &t[T_ADD]);
+   ref_average_pool(&net->ops[5], &t[T_ADD], &t[T_POOL]);
+}
+
+static void
+free_network(struct test_network *net)
+{
+   for (unsigned i = 0; i < T_COUNT; i++)
+      FREE(net->tensors[i].data);
+   for (unsigned i = 0; i < W_COUNT; i++) {
+      pipe_resource_reference(&net->weights[i].resource, NULL);
+      pipe_resource_reference(&net->biases[i].resource, NULL);
+      FREE(net->weight_data[i]);
+      FREE(net->bias_data[i]);
+   }
+}
+
+
+static bool
+test_ml(struct pipe_context *pipe, unsigned verbose, FILE *fp,
+        unsigned size, bool is_signed, unsigned iterations)
+{
+   struct test_network net;
+   bool success = true;
+
+   init_network(pipe, &net, size, is_signed);
+   run_reference(&net);
+
+   struct pipe_ml_subgraph *subgraph =
+      pipe->ml_subgraph_create(pipe, net.ops, ARRAY_SIZE(net.ops));
+   if (!subgraph) {
+      free_network(&net);
+      return false;
+   }
+
+   struct test_tensor *input = &net.tensors[T_INPUT];
+   struct pipe_tensor input_tensor = input->base;
+   input_tensor.resource =
+      pipe_buffer_create_with_data(pipe, 0, PIPE_USAGE_DEFAULT, input->size,
+                                   input->data);
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++)
+      pipe->ml_subgraph_invoke(pipe, subgraph, &input_tensor);
+   int64_t end = os_time_get_nano();
+
+   /* Check every intermediate tensor, not only the last one. */
+   unsigned output_idxs[T_COUNT - 1];
+   void *outputs[T_COUNT - 1];
+   for (unsigned i = 1; i < T_COUNT; i++) {
+      output_idxs[i - 1] = i;
+      outputs[i - 1] = MALLOC(net.tensors[i].size);
+   }
+   pipe->ml_subgraph_read_output(pipe, subgraph, T_COUNT - 1, output_idxs,
+                                 outputs);
+
+   for (unsigned i = 1; i < T_COUNT; i++) {
+      const struct test_tensor *t = &net.tensors[i];
+      const uint8_t *result = outputs[i - 1];
+
+      for (unsigned j = 0; j < t->size; j++) {
+         if (result[j] != t->data[j]) {
+            success = false;
+            fprintf(stderr, "tensor %u element %u: got %u, expected %u\n",
+                    i, j, result[j], t->data[j]);
+            break;
+         }
+      }
+      FREE(outputs[i - 1]);
+   }
+
+   double us = iterations ? (double)(end - start) / (1000.0 * iterations) : 0.0;
+
+   if (verbose >= 1) {
+      fprintf(stdout, "%s: %s, %ux%u, %.1f us/invoke\n",
+              success ? "PASS" : "FAIL", is_signed ? "int8" : "uint8",
+              size, size + 3, us);
+   }
+
+   if (fp) {
+      fprintf(fp, "%s\t%s\t%u\t%.1f\n", success ? "pass" : "fail",
+              is_signed ? "int8" : "uint8", size, us);
+      fflush(fp);
+   }
+
+   pipe_resource_reference(&input_tensor.resource, NULL);
+   pipe->ml_subgraph_destroy(pipe, subgraph);
+   free_network(&net);
+
+   return success;
+}
+
+
+static bool
+test_sizes(unsigned verbose, FILE *fp, const unsigned *sizes,
+           unsigned count, unsigned iterations)
+{
+   struct pipe_screen *screen = llvmpipe_create_screen(null_sw_create());
+   if (!screen)
+      return false;
+
+   struct pipe_context *pipe = screen->context_create(screen, NULL,
+                                                      PIPE_CONTEXT_COMPUTE_ONLY);
+   bool success = pipe != NULL;
+
+   for (unsigned i = 0; success && i < count; i++) {
+      success &= test_ml(pipe, verbose, fp, sizes[i], false, iterations);
+      success &= test_ml(pipe, verbose, fp, sizes[i], true, iterations);
+   }
+
+   if (pipe)
+      pipe->destroy(pipe);
+   screen->destroy(screen);
+
+   return success;
+}
+
+
+static const unsigned sizes[] = { 3, 4, 9, 17, 32 };
+
+
+bool
+test_some(unsigned verbose, FILE *fp,
+          unsigned long n)
+{
+   return test_sizes(verbose, fp, sizes, ARRAY_SIZE(sizes), MAX2(n, 1));
+}
+
+
+bool
+test_all(unsigned verbose, FILE *fp)
+{
+   return test_some(verbose, fp, 10);
+}
+
+
+bool
+test_single(unsigned verbose, FILE *fp)
+{
+   static const unsigned size = 96;
+
+   return test_sizes(verbose, fp, &size, 1, 10);
+}
@@ -50,6 +50,7 @@
 #include "lp_jit.h"
 #include "lp_tex_sample.h"
 #include "lp_state_fs.h"
+#include "lp_texture.h"
 #include "lp_debug.h"
 
 
@@ -82,3 +83,31 @@ lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state,
 }
 
 
+/**
+ * lp_sampler_static_texture_state() plus the layout of the llvmpipe
+ * texture, for shader stages which handle micro-tiled textures.
+ */
+void
+lp_llvm_texture_static_state(struct lp_static_texture_state *state,
+                             const struct pipe_sampler_view *view)
+{
+   lp_sampler_static_texture_state(state, view);
+
+   if (view && view->texture)
+      state->microtiled = llvmpipe_resource_const(view->texture)->microtiled;
+}
+
+
+/**
+ * lp_sampler_static_texture_state_image() plus the layout of the llvmpipe
+ * texture, for shader stages which handle micro-tiled textures.
+ */
+void
+lp_llvm_image_static_state(struct lp_static_texture_state *state,
+                           const struct pipe_image_view *view)
+{
+   lp_sampler_static_texture_state_image(state, view);
+
+   if (view && view->resource)
+      state->microtiled = llvmpipe_resource_const(view->resource)->microtiled;
+}
@@ -33,6 +33,9 @@
 
 struct lp_build_sampler_soa;
 struct lp_sampler_static_state;
+struct lp_static_texture_state;
+struct pipe_sampler_view;
+struct pipe_image_view;
 /**
  * Whether texture cache is used for s3tc textures.
  */
@@ -41,4 +44,13 @@ struct lp_sampler_static_state;
 struct lp_build_sampler_soa *
 lp_llvm_sampler_soa_create(const struct lp_sampler_static_state *static_state,
                            unsigned nr_samplers);
+
+void
+lp_llvm_texture_static_state(struct lp_static_texture_state *state,
+                             const struct pipe_sampler_view *view);
+
+void
+lp_llvm_image_static_state(struct lp_static_texture_state *state,
+                           const struct pipe_image_view *view);
+
 #endif /* LP_TEX_SAMPLE_H */
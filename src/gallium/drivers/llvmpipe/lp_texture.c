@@ -37,6 +37,7 @@
 
 #include "util/detect_os.h"
 #include "util/simple_mtx.h"
+#include "util/u_atomic.h"
 #include "util/u_inlines.h"
 #include "util/u_cpu_detect.h"
 #include "util/format/u_format.h"
@@ -49,6 +50,7 @@
 #endif
 
 #include "lp_context.h"
+#include "lp_debug.h"
 #include "lp_flush.h"
 #include "lp_screen.h"
 #include "lp_texture.h"
@@ -262,6 +264,50 @@ llvmpipe_can_create_resource(struct pipe_screen *screen,
 }
 
 
+/**
+ * Whether a new texture may use the micro-tiled layout.  Only textures
+ * which nothing outside of llvmpipe can see linearly are considered, and
+ * only formats whose texels are a power of two bytes.
+ */
+static bool
+llvmpipe_texture_can_microtile(const struct pipe_resource *pt)
+{
+   if (!(LP_PERF & PERF_MICROTILE))
+      return false;
+
+   switch (pt->target) {
+   case PIPE_TEXTURE_2D:
+   case PIPE_TEXTURE_RECT:
+   case PIPE_TEXTURE_2D_ARRAY:
+   case PIPE_TEXTURE_CUBE:
+   case PIPE_TEXTURE_CUBE_ARRAY:
+      break;
+   default:
+      return false;
+   }
+
+   if (pt->nr_samples > 1 ||
+       pt->usage == PIPE_USAGE_STAGING ||
+       (pt->flags & (PIPE_RESOURCE_FLAG_SPARSE |
+                     PIPE_RESOURCE_FLAG_MAP_PERSISTENT |
+                     PIPE_RESOURCE_FLAG_MAP_COHERENT)) ||
+       (pt->bind & (PIPE_BIND_DEPTH_STENCIL |
+                    PIPE_BIND_LINEAR |
+                    PIPE_BIND_SHARED |
+                    PIPE_BIND_SCANOUT |
+                    PIPE_BIND_DISPLAY_TARGET)))
+      return false;
+
+   const struct util_format_description *desc =
+      util_format_description(pt->format);
+
+   return desc->block.width == 1 && desc->block.height == 1 &&
+          desc->block.bits >= 8 &&
+          util_is_power_of_two_nonzero(desc->block.bits) &&
+          !util_format_is_depth_or_stencil(pt->format);
+}
+
+
 static bool
 llvmpipe_displaytarget_layout(struct llvmpipe_screen *screen,
                               struct llvmpipe_resource *lpr,
@@ -321,6 +367,9 @@ llvmpipe_resource_create_all(struct pipe_screen *_screen,
          if (!llvmpipe_texture_layout(screen, lpr, alloc_backing))
             goto fail;
 
+         lpr->microtiled = alloc_backing &&
+                           llvmpipe_texture_can_microtile(&lpr->base);
+
          if (templat->flags & PIPE_RESOURCE_FLAG_SPARSE) {
 #if DETECT_OS_LINUX
             lpr->tex_data = os_mmap(NULL, lpr->size_required, PROT_READ|PROT_WRITE, MAP_ANONYMOUS|MAP_SHARED,
@@ -787,6 +836,122 @@ no_lpr:
 }
 
 
+/**
+ * Copy a box of texels between a micro-tiled image and a linear buffer,
+ * in either direction.  'tiled' points at the start of the image (mip
+ * level and layer), (x, y) is the box origin in it, 'linear' points at
+ * the box's first texel.
+ */
+void
+llvmpipe_microtile_copy(uint8_t *tiled, unsigned tiled_stride,
+                        uint8_t *linear, unsigned linear_stride,
+                        unsigned x, unsigned y,
+                        unsigned width, unsigned height,
+                        unsigned block_size, bool to_tiled)
+{
+   const unsigned mask = LP_MICROTILE_SIZE - 1;
+
+   for (unsigned j = 0; j < height; j++) {
+      uint8_t *row = linear + (uint64_t)j * linear_stride;
+
+      /* Texels within a tile row are contiguous, so copy in runs of up
+       * to LP_MICROTILE_SIZE texels.
+       */
+      for (unsigned i = 0; i < width;) {
+         unsigned n = MIN2(LP_MICROTILE_SIZE - ((x + i) & mask), width - i);
+         uint8_t *texel = tiled + llvmpipe_microtile_offset(x + i, y + j,
+                                                            tiled_stride,
+                                                            block_size);
+         if (to_tiled)
+            memcpy(texel, row + i * block_size, n * block_size);
+         else
+            memcpy(row + i * block_size, texel, n * block_size);
+         i += n;
+      }
+   }
+}
+
+
+/**
+ * Rearrange the texels of a micro-tiled texture into the linear layout.
+ * The caller must make sure nothing is using the texture.
+ */
+static void
+llvmpipe_resource_detile(struct llvmpipe_resource *lpr)
+{
+   struct llvmpipe_screen *screen = lpr->screen;
+   const struct pipe_resource *pt = &lpr->base;
+   const unsigned block_size = util_format_get_blocksize(pt->format);
+
+   assert(lpr->microtiled);
+
+   uint8_t *tmp = malloc(lpr->img_stride[0]);
+   if (!tmp)
+      return;
+
+   for (unsigned level = 0; level <= pt->last_level; level++) {
+      /* Layout pads every level to whole tiles, convert the padding too. */
+      unsigned width = align(u_minify(pt->width0, level), LP_MICROTILE_SIZE);
+      unsigned height = align(u_minify(pt->height0, level), LP_MICROTILE_SIZE);
+      unsigned stride = lpr->row_stride[level];
+
+      for (unsigned layer = 0; layer < pt->array_size; layer++) {
+         uint8_t *image = llvmpipe_get_texture_image_address(lpr, layer, level);
+
+         llvmpipe_microtile_copy(image, stride, tmp, stride,
+                                 0, 0, width, height, block_size, false);
+         memcpy(image, tmp, lpr->img_stride[level]);
+      }
+   }
+
+   free(tmp);
+
+   lpr->microtiled = false;
+   screen->timestamp++;
+   p_atomic_inc(&screen->layout_timestamp);
+}
+
+
+/**
+ * Switch a micro-tiled texture to the linear layout for good, before it
+ * is handed to code which only understands linear textures: rendering,
+ * the draw module, bindless handles and direct maps.
+ */
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource)
+{
+   struct llvmpipe_resource *lpr = llvmpipe_resource(resource);
+
+   if (!lpr->microtiled)
+      return;
+
+   /* Other contexts sharing the resource may still be using the tiled
+    * layout as well.
+    */
+   llvmpipe_finish_resource(pipe->screen, pipe, resource, __func__);
+   llvmpipe_resource_detile(lpr);
+}
+
+
+/**
+ * Invalidate shader keys if any texture changed layout since the last
+ * check, as keys describe the layout of the bound textures.
+ */
+void
+llvmpipe_check_texture_layouts(struct llvmpipe_context *llvmpipe)
+{
+   struct llvmpipe_screen *screen = llvmpipe_screen(llvmpipe->pipe.screen);
+   unsigned layout_timestamp = p_atomic_read(&screen->layout_timestamp);
+
+   if (llvmpipe->tex_layout_timestamp != layout_timestamp) {
+      llvmpipe->tex_layout_timestamp = layout_timestamp;
+      llvmpipe->dirty |= LP_NEW_SAMPLER_VIEW;
+      llvmpipe->cs_dirty |= LP_CSNEW_SAMPLER_VIEW;
+   }
+}
+
+
 static bool
 llvmpipe_resource_get_handle(struct pipe_screen *_screen,
                              struct pipe_context *ctx,
@@ -798,6 +963,12 @@ llvmpipe_resource_get_handle(struct pipe_screen *_screen,
    struct sw_winsys *winsys = screen->winsys;
    struct llvmpipe_resource *lpr = llvmpipe_resource(pt);
 
+   /* Whoever imports the handle expects a linear layout. */
+   if (lpr->microtiled) {
+      llvmpipe_finish_resource(_screen, ctx, pt, __func__);
+      llvmpipe_resource_detile(lpr);
+   }
+
 #if defined(HAVE_LIBDRM) && defined(HAVE_LINUX_UDMABUF_H)
    if (!lpr->dt && whandle->type == WINSYS_HANDLE_TYPE_FD) {
       if (!lpr->dmabuf_alloc) {
@@ -902,6 +1073,9 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
    assert(resource);
    assert(level <= resource->last_level);
 
+   if (usage & PIPE_MAP_DIRECTLY)
+      llvmpipe_resource_untile(pipe, resource);
+
    /*
     * Transfers, like other pipe operations, must happen in order, so flush
     * the context if necessary.
@@ -1016,6 +1190,39 @@ llvmpipe_transfer_map_ms(struct pipe_context *pipe,
       return lpt->map;
    }
 
+   if (lpr->microtiled) {
+      /* Hand out a linear copy of the box, written back on unmap. */
+      const unsigned block_size = util_format_get_blocksize(format);
+
+      pt->stride = box->width * block_size;
+      pt->layer_stride = (uint64_t)pt->stride * box->height;
+
+      lpt->map = malloc(MAX2(pt->layer_stride * box->depth, 1));
+      if (!lpt->map) {
+         pipe_resource_reference(&pt->resource, NULL);
+         FREE(lpt);
+         *transfer = NULL;
+         return NULL;
+      }
+      lpt->microtiled = true;
+
+      if (!(usage & (PIPE_MAP_DISCARD_RANGE |
+                     PIPE_MAP_DISCARD_WHOLE_RESOURCE))) {
+         for (unsigned z = 0; z < box->depth; z++) {
+            llvmpipe_microtile_copy(
+               llvmpipe_get_texture_image_address(lpr, box->z + z, level),
+               lpr->row_stride[level],
+               (uint8_t *)lpt->map + z * pt->layer_stride, pt->stride,
+               box->x, box->y, box->width, box->height, block_size, false);
+         }
+      }
+
+      if (usage & PIPE_MAP_WRITE)
+         screen->timestamp++;
+
+      return lpt->map;
+   }
+
    map = llvmpipe_resource_map(resource, level, box->z, tex_usage);
 
 
@@ -1135,6 +1342,31 @@ llvmpipe_transfer_unmap(struct pipe_context *pipe,
       }
    }
 
+   if (lpt->microtiled && (transfer->usage & PIPE_MAP_WRITE)) {
+      const struct pipe_box *box = &transfer->box;
+      const unsigned block_size = util_format_get_blocksize(resource->format);
+
+      for (unsigned z = 0; z < box->depth; z++) {
+         uint8_t *image =
+            llvmpipe_get_texture_image_address(lpr, box->z + z,
+                                               transfer->level);
+         uint8_t *src = (uint8_t *)lpt->map + z * transfer->layer_stride;
+
+         /* The texture may have been untiled while mapped. */
+         if (lpr->microtiled) {
+            llvmpipe_microtile_copy(image, lpr->row_stride[transfer->level],
+                                    src, transfer->stride,
+                                    box->x, box->y, box->width, box->height,
+                                    block_size, true);
+         } else {
+            util_copy_rect(image, resource->format,
+                           lpr->row_stride[transfer->level],
+                           box->x, box->y, box->width, box->height,
+                           src, transfer->stride, 0, 0);
+         }
+      }
+   }
+
    llvmpipe_resource_unmap(resource,
                            transfer->level,
                            transfer->box.z);
@@ -33,6 +33,7 @@
 #include "util/u_debug.h"
 #include "lp_limits.h"
 #include "util/bitset.h"
+#include "gallivm/lp_bld_limits.h"
 #if MESA_DEBUG
 #include "util/list.h"
 #endif
@@ -115,6 +116,13 @@ struct llvmpipe_resource
    bool backable;
    bool imported_memory;
    bool dmabuf;
+
+   /**
+    * Texels are stored in LP_MICROTILE_SIZE x LP_MICROTILE_SIZE tiles,
+    * see llvmpipe_microtile_offset().  Cleared for good once anything
+    * which needs the linear layout gets hold of the texture.
+    */
+   bool microtiled;
 #if MESA_DEBUG
    struct list_head list;
 #endif
@@ -126,6 +134,7 @@ struct llvmpipe_transfer
    struct pipe_transfer base;
    void *map;
    struct pipe_box block_box;
+   bool microtiled;  /**< map is a linear copy of a micro-tiled box */
 };
 
 struct llvmpipe_memory_allocation
@@ -244,6 +253,21 @@ llvmpipe_resource_stride(struct pipe_resource *resource,
 }
 
 
+/**
+ * Byte offset of texel (x, y) within a micro-tiled image.
+ */
+static inline uint64_t
+llvmpipe_microtile_offset(unsigned x, unsigned y,
+                          unsigned row_stride, unsigned block_size)
+{
+   const unsigned mask = LP_MICROTILE_SIZE - 1;
+   unsigned in_tile = (y & mask) * LP_MICROTILE_SIZE + (x & mask);
+
+   return (uint64_t)(y & ~mask) * row_stride +
+          ((uint64_t)(x & ~mask) * LP_MICROTILE_SIZE + in_tile) * block_size;
+}
+
+
 static inline unsigned
 llvmpipe_sample_stride(struct pipe_resource *resource)
 {
@@ -309,4 +333,18 @@ llvmpipe_get_texel_offset(struct pipe_resource *resource,
                           uint32_t level, uint32_t x,
                           uint32_t y, uint32_t z);
 
+void
+llvmpipe_microtile_copy(uint8_t *tiled, unsigned tiled_stride,
+                        uint8_t *linear, unsigned linear_stride,
+                        unsigned x, unsigned y,
+                        unsigned width, unsigned height,
+                        unsigned block_size, bool to_tiled);
+
+void
+llvmpipe_resource_untile(struct pipe_context *pipe,
+                         struct pipe_resource *resource);
+
+void
+llvmpipe_check_texture_layouts(struct llvmpipe_context *llvmpipe);
+
 #endif /* LP_TEXTURE_H */
@@ -24,6 +24,7 @@
 #include "lp_context.h"
 #include "lp_texture_handle.h"
 #include "lp_screen.h"
+#include "lp_texture.h"
 
 #include "gallivm/lp_bld_const.h"
 #include "gallivm/lp_bld_debug.h"
@@ -56,6 +57,9 @@ llvmpipe_create_texture_handle(struct pipe_context *pctx, struct pipe_sampler_vi
    struct lp_texture_handle *handle = calloc(1, sizeof(struct lp_texture_handle));
 
    if (view) {
+      /* Handles outlive any layout change, so keep them linear. */
+      llvmpipe_resource_untile(pctx, view->texture);
+
       struct lp_static_texture_state state;
       lp_sampler_static_texture_state(&state, view);
 
@@ -111,6 +115,9 @@ llvmpipe_create_image_handle(struct pipe_context *pctx, const struct pipe_image_
 
    struct lp_texture_handle *handle = calloc(1, sizeof(struct lp_texture_handle));
 
+   if (view->resource)
+      llvmpipe_resource_untile(pctx, view->resource);
+
    struct lp_static_texture_state state;
    lp_sampler_static_texture_state_image(&state, view);
 
@@ -1065,6 +1072,17 @@ llvmpipe_clear_sample_functions_cache(struct llvmpipe_context *ctx, struct pipe_
    if (!_mesa_hash_table_num_entries(acquire_latest_sample_function_cache(matrix)))
       return;
 
+   /* Handles can be shared with other contexts of the screen (lavapipe queues),
+    * whose shaders read the cache without waiting for our fence. Keep using the
+    * RCU path in that case.
+    */
+   struct llvmpipe_screen *screen = llvmpipe_screen(ctx->pipe.screen);
+   mtx_lock(&screen->ctx_mutex);
+   bool shared = !list_is_singular(&screen->ctx_list);
+   mtx_unlock(&screen->ctx_mutex);
+   if (shared)
+      return;
+
    ctx->pipe.screen->fence_finish(ctx->pipe.screen, NULL, *fence, OS_TIMEOUT_INFINITE);
 
    /* All work is finished, it's safe to move cache entries into the table. */
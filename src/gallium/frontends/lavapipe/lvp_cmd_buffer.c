@@ -23,15 +23,36 @@
 
 #include "lvp_private.h"
 #include "pipe/p_context.h"
+#include "util/u_inlines.h"
 #include "vk_util.h"
 
 #include "vk_common_entrypoints.h"
 
+void
+lvp_cmd_buffer_release_replay(struct lvp_cmd_buffer *cmd_buffer)
+{
+   util_dynarray_foreach(&cmd_buffer->replay.sets, struct lvp_descriptor_set *, set)
+      lvp_descriptor_set_destroy(cmd_buffer->device, *set);
+   util_dynarray_clear(&cmd_buffer->replay.sets);
+
+   util_dynarray_foreach(&cmd_buffer->replay.buffers, struct lvp_replay_buffer, buffer)
+      pipe_resource_reference(&buffer->pres, NULL);
+   util_dynarray_clear(&cmd_buffer->replay.buffers);
+}
+
 static void
-lvp_cmd_buffer_destroy(struct vk_command_buffer *cmd_buffer)
+lvp_cmd_buffer_destroy(struct vk_command_buffer *vk_cmd_buffer)
 {
-   vk_command_buffer_finish(cmd_buffer);
-   vk_free(&cmd_buffer->pool->alloc, cmd_buffer);
+   struct lvp_cmd_buffer *cmd_buffer =
+      container_of(vk_cmd_buffer, struct lvp_cmd_buffer, vk);
+
+   lvp_cmd_buffer_release_replay(cmd_buffer);
+   util_dynarray_fini(&cmd_buffer->replay.sets);
+   util_dynarray_fini(&cmd_buffer->replay.buffers);
+   mtx_destroy(&cmd_buffer->replay.lock);
+
+   vk_command_buffer_finish(vk_cmd_buffer);
+   vk_free(&vk_cmd_buffer->pool->alloc, cmd_buffer);
 }
 
 static VkResult
@@ -57,6 +78,11 @@ lvp_create_cmd_buffer(struct vk_command_pool *pool,
 
    cmd_buffer->device = device;
 
+   mtx_init(&cmd_buffer->replay.lock, mtx_plain);
+   cmd_buffer->replay.enabled = false;
+   util_dynarray_init(&cmd_buffer->replay.sets, NULL);
+   util_dynarray_init(&cmd_buffer->replay.buffers, NULL);
+
    *cmd_buffer_out = &cmd_buffer->vk;
 
    return VK_SUCCESS;
@@ -66,6 +92,10 @@ static void
 lvp_reset_cmd_buffer(struct vk_command_buffer *vk_cmd_buffer,
                      UNUSED VkCommandBufferResetFlags flags)
 {
+   struct lvp_cmd_buffer *cmd_buffer =
+      container_of(vk_cmd_buffer, struct lvp_cmd_buffer, vk);
+
+   lvp_cmd_buffer_release_replay(cmd_buffer);
    vk_command_buffer_reset(vk_cmd_buffer);
 }
 
@@ -83,6 +113,9 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_BeginCommandBuffer(
 
    vk_command_buffer_begin(&cmd_buffer->vk, pBeginInfo);
 
+   cmd_buffer->replay.enabled =
+      !(pBeginInfo->flags & VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
+
    return VK_SUCCESS;
 }
 
@@ -0,0 +1,172 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Copies between mapped buffers and images.
+ *
+ * Image memory is bound to the VkDeviceMemory it lives in, so a buffer to
+ * image copy is a copy between two mappings, with no staging in between.
+ * When both sides are laid out the same way it becomes a single memcpy, and
+ * large copies are split across a pool of threads shared by all the queues
+ * of the device, since one thread doesn't saturate memory bandwidth.
+ */
+
+#include "lvp_private.h"
+#include "util/format/u_format.h"
+#include "util/u_cpu_detect.h"
+
+/* Smallest amount of memory worth handing to another thread. */
+#define LVP_COPY_SPLIT_SIZE (1024 * 1024)
+
+#define LVP_MAX_COPY_THREADS 8
+
+struct lvp_copy_job {
+   uint8_t *dst;
+   const uint8_t *src;
+   unsigned dst_stride;
+   unsigned src_stride;
+   uint64_t dst_layer_stride;
+   uint64_t src_layer_stride;
+
+   /* Rows of row_size bytes, height of them per layer, or a height of 0
+    * for a contiguous copy.
+    */
+   size_t row_size;
+   unsigned height;
+
+   /* Part of the copy done by this job: rows [first, first + count) for
+    * row copies, bytes [first, first + count) for contiguous ones.
+    */
+   size_t first;
+   size_t count;
+
+   struct util_queue_fence fence;
+};
+
+static void
+copy_job_execute(void *data, void *gdata, int thread_index)
+{
+   const struct lvp_copy_job *job = data;
+
+   if (job->height == 0) {
+      memcpy(job->dst + job->first, job->src + job->first, job->count);
+      return;
+   }
+
+   for (size_t r = job->first; r < job->first + job->count; r++) {
+      const unsigned z = r / job->height;
+      const unsigned y = r % job->height;
+
+      memcpy(job->dst + z * job->dst_layer_stride + (size_t)y * job->dst_stride,
+             job->src + z * job->src_layer_stride + (size_t)y * job->src_stride,
+             job->row_size);
+   }
+}
+
+void
+lvp_device_init_copy_threads(struct lvp_device *device)
+{
+   const unsigned num_cpus = util_get_cpu_caps()->nr_cpus;
+   const unsigned num_threads = MIN2(num_cpus, LVP_MAX_COPY_THREADS) - 1;
+
+   /* The thread submitting the copy does its share of the work. */
+   if (num_threads == 0)
+      return;
+
+   if (!util_queue_init(&device->copy_queue, "lvp_copy", 2 * LVP_MAX_COPY_THREADS,
+                        num_threads, UTIL_QUEUE_INIT_RESIZE_IF_FULL, NULL))
+      memset(&device->copy_queue, 0, sizeof(device->copy_queue));
+}
+
+void
+lvp_device_finish_copy_threads(struct lvp_device *device)
+{
+   if (util_queue_is_initialized(&device->copy_queue))
+      util_queue_destroy(&device->copy_queue);
+}
+
+/**
+ * Copy a box of width x height x depth pixels between two mappings laid out
+ * with the given strides, using the device's copy threads for large ones.
+ */
+void
+lvp_copy_box(struct lvp_device *device,
+             uint8_t *dst, enum pipe_format format,
+             unsigned dst_stride, uint64_t dst_layer_stride,
+             unsigned width, unsigned height, unsigned depth,
+             const uint8_t *src,
+             unsigned src_stride, uint64_t src_layer_stride)
+{
+   struct lvp_copy_job jobs[LVP_MAX_COPY_THREADS];
+   const unsigned blocks_y = util_format_get_nblocksy(format, height);
+   const size_t row_size = util_format_get_stride(format, width);
+   const uint64_t size = (uint64_t)row_size * blocks_y * depth;
+   size_t total;
+
+   struct lvp_copy_job job = {
+      .dst = dst,
+      .src = src,
+      .dst_stride = dst_stride,
+      .src_stride = src_stride,
+      .dst_layer_stride = dst_layer_stride,
+      .src_layer_stride = src_layer_stride,
+      .row_size = row_size,
+      .height = blocks_y,
+   };
+
+   if (size == 0)
+      return;
+
+   /* Identical, gapless layouts: the whole box is one block of memory. */
+   if (row_size == dst_stride && row_size == src_stride &&
+       (depth == 1 ||
+        (dst_layer_stride == src_layer_stride &&
+         dst_layer_stride == (uint64_t)row_size * blocks_y))) {
+      job.height = 0;
+      total = size;
+   } else {
+      total = (size_t)blocks_y * depth;
+   }
+
+   unsigned num_jobs = 1;
+   if (util_queue_is_initialized(&device->copy_queue)) {
+      num_jobs = MIN2(size / LVP_COPY_SPLIT_SIZE,
+                      device->copy_queue.num_threads + 1);
+      num_jobs = CLAMP(num_jobs, 1, MIN2(total, LVP_MAX_COPY_THREADS));
+   }
+
+   if (num_jobs == 1) {
+      job.first = 0;
+      job.count = total;
+      copy_job_execute(&job, NULL, 0);
+      return;
+   }
+
+   /* Split contiguous copies on cache line boundaries. */
+   const size_t align = job.height ? 1 : 64;
+   const size_t part = align64(DIV_ROUND_UP(total, num_jobs), align);
+   size_t first = 0;
+
+   unsigned n;
+   for (n = 0; n < num_jobs && first < total; n++) {
+      jobs[n] = job;
+      jobs[n].first = first;
+      jobs[n].count = MIN2(part, total - first);
+      first += jobs[n].count;
+   }
+
+   /* Queue all but the last part, which this thread copies itself. */
+   for (unsigned i = 0; i < n - 1; i++) {
+      util_queue_fence_init(&jobs[i].fence);
+      util_queue_add_job(&device->copy_queue, &jobs[i], &jobs[i].fence,
+                         copy_job_execute, NULL, 0);
+   }
+
+   copy_job_execute(&jobs[n - 1], NULL, 0);
+
+   for (unsigned i = 0; i < n - 1; i++) {
+      util_queue_fence_wait(&jobs[i].fence);
+      util_queue_fence_destroy(&jobs[i].fence);
+   }
+}
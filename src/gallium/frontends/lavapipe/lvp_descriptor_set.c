@@ -354,10 +354,26 @@ lvp_descriptor_set_create(struct lvp_device *device,
    set->pmem = device->pscreen->allocate_memory(device->pscreen, bo_size);
 
    set->map = device->pscreen->map_memory(device->pscreen, set->pmem);
-   memset(set->map, 0, bo_size);
 
    device->pscreen->resource_bind_backing(device->pscreen, set->bo, set->pmem, 0, 0, 0);
 
+   lvp_descriptor_set_clear(set);
+
+   *out_set = set;
+
+   return VK_SUCCESS;
+}
+
+/* Puts a set back in the state it was created in: no descriptors but the
+ * immutable samplers.
+ */
+void
+lvp_descriptor_set_clear(struct lvp_descriptor_set *set)
+{
+   const struct lvp_descriptor_set_layout *layout = set->layout;
+
+   memset(set->map, 0, set->bo->width0);
+
    for (uint32_t binding_index = 0; binding_index < layout->binding_count; binding_index++) {
       const struct lvp_descriptor_set_binding_layout *bind_layout = &set->layout->binding[binding_index];
       if (!bind_layout->immutable_samplers)
@@ -375,10 +391,6 @@ lvp_descriptor_set_create(struct lvp_device *device,
          }
       }
    }
-
-   *out_set = set;
-
-   return VK_SUCCESS;
 }
 
 void
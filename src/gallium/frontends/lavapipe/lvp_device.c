@@ -1263,6 +1263,9 @@ lvp_physical_device_init(struct lvp_physical_device *device,
    for (unsigned i = 0; i < ARRAY_SIZE(device->drv_options); i++)
       device->drv_options[i] = device->pscreen->get_compiler_options(device->pscreen, PIPE_SHADER_IR_NIR, i);
 
+   /* Back the pipeline caches with llvmpipe's shader disk cache. */
+   device->vk.disk_cache = device->pscreen->get_disk_shader_cache(device->pscreen);
+
    device->sync_timeline_type = vk_sync_timeline_get_type(&lvp_pipe_sync_type);
    device->sync_types[0] = &lvp_pipe_sync_type;
    device->sync_types[1] = &device->sync_timeline_type.sync;
@@ -1482,7 +1485,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_GetPhysicalDeviceQueueFamilyProperties2(
          VK_QUEUE_TRANSFER_BIT |
          (DETECT_OS_LINUX ? VK_QUEUE_SPARSE_BINDING_BIT : 0) |
          VK_QUEUE_VIDEO_ENCODE_BIT_KHR,
-         .queueCount = 1,
+         .queueCount = LVP_MAX_QUEUES,
          .timestampValidBits = 64,
          .minImageTransferGranularity = (VkExtent3D) { 1, 1, 1 },
       };
@@ -1610,8 +1613,17 @@ destroy_pipelines(struct lvp_queue *queue)
 {
    simple_mtx_lock(&queue->lock);
    while (util_dynarray_contains(&queue->pipeline_destroys, struct lvp_pipeline*)) {
-      lvp_pipeline_destroy(queue->device, util_dynarray_pop(&queue->pipeline_destroys, struct lvp_pipeline*), true);
+      struct lvp_pipeline *pipeline = util_dynarray_pop(&queue->pipeline_destroys, struct lvp_pipeline*);
+      /* Queue 0's lock covers the CSOs the pipeline's shaders own. */
+      if (p_atomic_dec_zero(&pipeline->destroy_refs))
+         lvp_pipeline_destroy(queue->device, pipeline, queue == &queue->device->queue);
    }
+
+   simple_mtx_lock(&queue->cso_destroys_lock);
+   util_dynarray_foreach(&queue->cso_destroys, struct lvp_shader_cso, cso)
+      lvp_shader_cso_destroy(queue->ctx, cso->stage, cso->cso);
+   util_dynarray_clear(&queue->cso_destroys);
+   simple_mtx_unlock(&queue->cso_destroys_lock);
    simple_mtx_unlock(&queue->lock);
 }
 
@@ -1691,10 +1703,19 @@ lvp_queue_init(struct lvp_device *device, struct lvp_queue *queue,
    queue->cso = cso_create_context(queue->ctx, CSO_NO_VBUF);
    queue->uploader = u_upload_create(queue->ctx, 1024 * 1024, PIPE_BIND_CONSTANT_BUFFER, PIPE_USAGE_STREAM, 0);
 
+   nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_FRAGMENT, NULL, "dummy_frag");
+   struct pipe_shader_state shstate = {0};
+   shstate.type = PIPE_SHADER_IR_NIR;
+   shstate.ir.nir = b.shader;
+   queue->noop_fs = queue->ctx->create_fs_state(queue->ctx, &shstate);
+
    queue->vk.driver_submit = lvp_queue_submit;
 
    simple_mtx_init(&queue->lock, mtx_plain);
    util_dynarray_init(&queue->pipeline_destroys, NULL);
+   simple_mtx_init(&queue->cso_destroys_lock, mtx_plain);
+   util_dynarray_init(&queue->cso_destroys, NULL);
+   util_dynarray_init(&queue->cmd_stats, NULL);
 
    return VK_SUCCESS;
 }
@@ -1707,7 +1728,17 @@ lvp_queue_finish(struct lvp_queue *queue)
    destroy_pipelines(queue);
    simple_mtx_destroy(&queue->lock);
    util_dynarray_fini(&queue->pipeline_destroys);
+   simple_mtx_destroy(&queue->cso_destroys_lock);
+   util_dynarray_fini(&queue->cso_destroys);
+
+   if (queue->device->cmd_stats)
+      lvp_queue_print_cmd_stats(queue);
+   util_dynarray_fini(&queue->cmd_stats);
 
+   if (queue->last_fence)
+      queue->device->pscreen->fence_reference(queue->device->pscreen, &queue->last_fence, NULL);
+
+   queue->ctx->delete_fs_state(queue->ctx, queue->noop_fs);
    u_upload_destroy(queue->uploader);
    cso_destroy_context(queue->cso);
    queue->ctx->destroy(queue->ctx);
@@ -1725,16 +1756,24 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    assert(pCreateInfo->sType == VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO);
 
+   assert(pCreateInfo->queueCreateInfoCount == 1);
+   assert(pCreateInfo->pQueueCreateInfos[0].queueFamilyIndex == 0);
+   uint32_t queue_count = pCreateInfo->pQueueCreateInfos[0].queueCount;
+   assert(queue_count >= 1 && queue_count <= LVP_MAX_QUEUES);
+
    size_t state_size = lvp_get_rendering_state_size();
    device = vk_zalloc2(&physical_device->vk.instance->alloc, pAllocator,
-                       sizeof(*device) + state_size, 8,
+                       sizeof(*device) + state_size * queue_count, 8,
                        VK_SYSTEM_ALLOCATION_SCOPE_DEVICE);
    if (!device)
       return vk_error(instance, VK_ERROR_OUT_OF_HOST_MEMORY);
 
    device->queue.state = device + 1;
+   for (uint32_t i = 1; i < queue_count; i++)
+      device->secondary_queues[i - 1].state = (uint8_t *)(device + 1) + state_size * i;
    device->poison_mem = debug_get_bool_option("LVP_POISON_MEMORY", false);
    device->print_cmds = debug_get_bool_option("LVP_CMD_DEBUG", false);
+   device->cmd_stats = debug_get_bool_option("LVP_CMD_STATS", false);
 
    struct vk_device_dispatch_table dispatch_table;
    vk_device_dispatch_table_from_entrypoints(&dispatch_table,
@@ -1759,20 +1798,27 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    device->pscreen = physical_device->pscreen;
 
-   assert(pCreateInfo->queueCreateInfoCount == 1);
-   assert(pCreateInfo->pQueueCreateInfos[0].queueFamilyIndex == 0);
-   assert(pCreateInfo->pQueueCreateInfos[0].queueCount == 1);
+   /* Every queue gets its own context and submit thread, they share the
+    * screen's rasterizer and compute thread pools.
+    */
    result = lvp_queue_init(device, &device->queue, pCreateInfo->pQueueCreateInfos, 0);
    if (result != VK_SUCCESS) {
       vk_free(&device->vk.alloc, device);
       return result;
    }
-
-   nir_builder b = nir_builder_init_simple_shader(MESA_SHADER_FRAGMENT, NULL, "dummy_frag");
-   struct pipe_shader_state shstate = {0};
-   shstate.type = PIPE_SHADER_IR_NIR;
-   shstate.ir.nir = b.shader;
-   device->noop_fs = device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
+   device->queue_count = 1;
+
+   for (uint32_t i = 1; i < queue_count; i++) {
+      result = lvp_queue_init(device, &device->secondary_queues[i - 1], pCreateInfo->pQueueCreateInfos, i);
+      if (result != VK_SUCCESS) {
+         for (uint32_t j = 1; j < device->queue_count; j++)
+            lvp_queue_finish(&device->secondary_queues[j - 1]);
+         lvp_queue_finish(&device->queue);
+         vk_free(&device->vk.alloc, device);
+         return result;
+      }
+      device->queue_count++;
+   }
    _mesa_hash_table_init(&device->bda, NULL, _mesa_hash_pointer, _mesa_key_pointer_equal);
    simple_mtx_init(&device->bda_lock, mtx_plain);
 
@@ -1789,6 +1835,15 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateDevice(
 
    device->group_handle_alloc = 1;
 
+   lvp_device_init_copy_threads(device);
+
+   /* Used for pipelines created without a VkPipelineCache, so that those
+    * still hit the disk cache.  Weak references keep it from holding on to
+    * the NIR of every pipeline ever created.
+    */
+   struct vk_pipeline_cache_create_info pcc_info = { .weak_ref = true, };
+   device->vk.mem_cache = vk_pipeline_cache_create(&device->vk, &pcc_info, NULL);
+
    *pDevice = lvp_device_to_handle(device);
 
    return VK_SUCCESS;
@@ -1814,15 +1869,24 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyDevice(
    device->queue.ctx->delete_texture_handle(device->queue.ctx, (uint64_t)(uintptr_t)device->null_texture_handle);
    device->queue.ctx->delete_image_handle(device->queue.ctx, (uint64_t)(uintptr_t)device->null_image_handle);
 
-   device->queue.ctx->delete_fs_state(device->queue.ctx, device->noop_fs);
-
-   if (device->queue.last_fence)
-      device->pscreen->fence_reference(device->pscreen, &device->queue.last_fence, NULL);
    ralloc_free(device->bda.table);
    simple_mtx_destroy(&device->bda_lock);
    pipe_resource_reference(&device->zero_buffer, NULL);
 
+   if (device->vk.mem_cache)
+      vk_pipeline_cache_destroy(device->vk.mem_cache, NULL);
+
+   /* A pipeline deferred on several queues is destroyed by the last one to
+    * release it, which needs queue 0's context and hands the CSOs to the
+    * other queues, so release them all before any queue goes away.
+    */
+   for (uint32_t i = 0; i < device->queue_count; i++)
+      destroy_pipelines(lvp_device_queue(device, i));
+
    lvp_queue_finish(&device->queue);
+   for (uint32_t i = 1; i < device->queue_count; i++)
+      lvp_queue_finish(&device->secondary_queues[i - 1]);
+   lvp_device_finish_copy_threads(device);
    vk_device_finish(&device->vk);
    vk_free(&device->vk.alloc, device);
 }
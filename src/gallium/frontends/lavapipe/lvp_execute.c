@@ -44,6 +44,8 @@
 #include "util/u_prim_restart.h"
 #include "util/format/u_format_zs.h"
 #include "util/ptralloc.h"
+#include "util/os_time.h"
+#include <inttypes.h>
 #include "tgsi/tgsi_from_mesa.h"
 
 #include "vk_blend.h"
@@ -82,6 +84,7 @@ struct lvp_render_attachment {
 struct rendering_state {
    struct pipe_context *pctx;
    struct lvp_device *device; //for uniform inlining only
+   struct lvp_queue *queue;
    struct u_upload_mgr *uploader;
    struct cso_context *cso;
 
@@ -203,6 +206,11 @@ struct rendering_state {
    struct util_dynarray push_desc_sets;
    struct util_dynarray internal_buffers;
 
+   /* command buffer keeping the objects created during execution, if any */
+   struct lvp_cmd_buffer *replay;
+   unsigned replay_set;
+   unsigned replay_buffer;
+
    struct lvp_pipeline *exec_graph;
 
    struct {
@@ -243,6 +251,83 @@ get_buffer_resource(struct pipe_context *ctx, void *mem)
    return pres;
 }
 
+/* Wraps size bytes at mem in a buffer resource, returning a reference owned
+ * by the caller.  Reusable command buffers get the resource they created at
+ * the same point of their previous execution back.
+ */
+static struct pipe_resource *
+get_transient_buffer_resource(struct rendering_state *state, void *mem,
+                              unsigned size)
+{
+   struct lvp_cmd_buffer *replay = state->replay;
+   struct pipe_resource *pres = NULL;
+
+   if (!mem)
+      return NULL;
+
+   if (!replay) {
+      pres = get_buffer_resource(state->pctx, mem);
+      pres->width0 = size;
+      return pres;
+   }
+
+   struct lvp_replay_buffer *cached;
+   unsigned idx = state->replay_buffer++;
+   if (idx < util_dynarray_num_elements(&replay->replay.buffers, struct lvp_replay_buffer)) {
+      cached = util_dynarray_element(&replay->replay.buffers, struct lvp_replay_buffer, idx);
+      if (cached->mem == mem && cached->pres->width0 == size) {
+         pipe_resource_reference(&pres, cached->pres);
+         return pres;
+      }
+      pipe_resource_reference(&cached->pres, NULL);
+   } else {
+      cached = util_dynarray_grow(&replay->replay.buffers, struct lvp_replay_buffer, 1);
+   }
+
+   cached->mem = mem;
+   cached->pres = get_buffer_resource(state->pctx, mem);
+   cached->pres->width0 = size;
+
+   pipe_resource_reference(&pres, cached->pres);
+   return pres;
+}
+
+/* Creates a descriptor set that lives until the end of the execution, or
+ * until the command buffer is reset if it is reusable, in which case the
+ * set created at the same point of its previous execution is cleared and
+ * returned instead.
+ */
+static struct lvp_descriptor_set *
+create_transient_set(struct rendering_state *state,
+                     struct lvp_descriptor_set_layout *layout)
+{
+   struct lvp_cmd_buffer *replay = state->replay;
+   struct lvp_descriptor_set *set;
+
+   if (!replay) {
+      lvp_descriptor_set_create(state->device, layout, &set);
+      util_dynarray_append(&state->push_desc_sets, struct lvp_descriptor_set *, set);
+      return set;
+   }
+
+   unsigned idx = state->replay_set++;
+   if (idx < util_dynarray_num_elements(&replay->replay.sets, struct lvp_descriptor_set *)) {
+      struct lvp_descriptor_set **cached =
+         util_dynarray_element(&replay->replay.sets, struct lvp_descriptor_set *, idx);
+      if ((*cached)->layout == layout) {
+         lvp_descriptor_set_clear(*cached);
+         return *cached;
+      }
+      lvp_descriptor_set_destroy(state->device, *cached);
+      lvp_descriptor_set_create(state->device, layout, cached);
+      return *cached;
+   }
+
+   lvp_descriptor_set_create(state->device, layout, &set);
+   util_dynarray_append(&replay->replay.sets, struct lvp_descriptor_set *, set);
+   return set;
+}
+
 ALWAYS_INLINE static void
 assert_subresource_layers(const struct pipe_resource *pres,
                           const struct lvp_image *image,
@@ -276,6 +361,21 @@ static void finish_fence(struct rendering_state *state)
                                         &handle, NULL);
 }
 
+/* Uniform inlining compiles variants while recording state, which only queue 0
+ * does. The other queues always bind the generic shader of their context.
+ */
+static uint32_t
+shader_can_inline(const struct rendering_state *state, const struct lvp_shader *shader)
+{
+   return state->queue == &state->device->queue ? shader->inlines.can_inline : 0;
+}
+
+static void *
+shader_cso(struct rendering_state *state, struct lvp_shader *shader)
+{
+   return lvp_shader_queue_cso(state->queue, shader, false);
+}
+
 static unsigned
 get_pcbuf_size(struct rendering_state *state, enum pipe_shader_type pstage)
 {
@@ -308,7 +408,7 @@ update_inline_shader_state(struct rendering_state *state, enum pipe_shader_type
    unsigned stage = tgsi_processor_to_shader_stage(sh);
    state->inlines_dirty[sh] = false;
    struct lvp_shader *shader = state->shaders[stage];
-   if (!shader || !shader->inlines.can_inline)
+   if (!shader || !shader_can_inline(state, shader))
       return;
    struct lvp_inline_variant v;
    v.mask = shader->inlines.can_inline;
@@ -346,7 +446,8 @@ update_inline_shader_state(struct rendering_state *state, enum pipe_shader_type
          /* not enough change; don't inline further */
          shader->inlines.can_inline = 0;
          ralloc_free(nir);
-         shader->shader_cso = lvp_shader_compile(state->device, shader, nir_shader_clone(NULL, shader->pipeline_nir->nir), true);
+         if (!shader->shader_cso)
+            shader->shader_cso = lvp_shader_compile(state->device, shader, nir_shader_clone(NULL, shader->pipeline_nir->nir), true);
          _mesa_set_remove(&shader->inlines.variants, entry);
          shader_state = shader->shader_cso;
       } else {
@@ -400,10 +501,10 @@ static void emit_compute_state(struct rendering_state *state)
    }
 
    if (state->inlines_dirty[MESA_SHADER_COMPUTE] &&
-       state->shaders[MESA_SHADER_COMPUTE]->inlines.can_inline) {
+       shader_can_inline(state, state->shaders[MESA_SHADER_COMPUTE])) {
       update_inline_shader_state(state, MESA_SHADER_COMPUTE, pcbuf_dirty);
    } else if (state->compute_shader_dirty) {
-      state->pctx->bind_compute_state(state->pctx, state->shaders[MESA_SHADER_COMPUTE]->shader_cso);
+      state->pctx->bind_compute_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_COMPUTE]));
    }
 
    state->compute_shader_dirty = false;
@@ -453,10 +554,10 @@ static void update_vertex_elements_buffer_index(struct rendering_state *state)
       state->velem.velems[i].vertex_buffer_index = state->vertex_buffer_index[i] - state->start_vb;
 }
 
-static void emit_state(struct rendering_state *state)
+static void emit_state_impl(struct rendering_state *state)
 {
    if (!state->shaders[MESA_SHADER_FRAGMENT] && !state->noop_fs_bound) {
-      state->pctx->bind_fs_state(state->pctx, state->device->noop_fs);
+      state->pctx->bind_fs_state(state->pctx, state->queue->noop_fs);
       state->noop_fs_bound = true;
    }
    if (state->blend_dirty) {
@@ -603,6 +704,19 @@ static void emit_state(struct rendering_state *state)
    }
 }
 
+static void emit_state(struct rendering_state *state)
+{
+   if (!state->device->cmd_stats) {
+      emit_state_impl(state);
+      return;
+   }
+
+   const int64_t start = os_time_get_nano();
+   emit_state_impl(state);
+   state->queue->emit_stats.count++;
+   state->queue->emit_stats.time_ns += os_time_get_nano() - start;
+}
+
 static void
 handle_compute_shader(struct rendering_state *state, struct lvp_shader *shader, struct lvp_pipeline_layout *layout)
 {
@@ -617,8 +731,8 @@ handle_compute_shader(struct rendering_state *state, struct lvp_shader *shader,
    state->dispatch_info.block[0] = shader->pipeline_nir->nir->info.workgroup_size[0];
    state->dispatch_info.block[1] = shader->pipeline_nir->nir->info.workgroup_size[1];
    state->dispatch_info.block[2] = shader->pipeline_nir->nir->info.workgroup_size[2];
-   state->inlines_dirty[MESA_SHADER_COMPUTE] = shader->inlines.can_inline;
-   if (!shader->inlines.can_inline)
+   state->inlines_dirty[MESA_SHADER_COMPUTE] = shader_can_inline(state, shader);
+   if (!state->inlines_dirty[MESA_SHADER_COMPUTE])
       state->compute_shader_dirty = true;
 }
 
@@ -703,53 +817,53 @@ handle_graphics_stages(struct rendering_state *state, VkShaderStageFlagBits shad
 
       switch (vk_stage) {
       case VK_SHADER_STAGE_FRAGMENT_BIT:
-         state->inlines_dirty[MESA_SHADER_FRAGMENT] = state->shaders[MESA_SHADER_FRAGMENT]->inlines.can_inline;
-         if (!state->shaders[MESA_SHADER_FRAGMENT]->inlines.can_inline) {
-            state->pctx->bind_fs_state(state->pctx, state->shaders[MESA_SHADER_FRAGMENT]->shader_cso);
+         state->inlines_dirty[MESA_SHADER_FRAGMENT] = shader_can_inline(state, state->shaders[MESA_SHADER_FRAGMENT]);
+         if (!state->inlines_dirty[MESA_SHADER_FRAGMENT]) {
+            state->pctx->bind_fs_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_FRAGMENT]));
             state->noop_fs_bound = false;
          }
          break;
       case VK_SHADER_STAGE_VERTEX_BIT:
-         state->inlines_dirty[MESA_SHADER_VERTEX] = state->shaders[MESA_SHADER_VERTEX]->inlines.can_inline;
-         if (!state->shaders[MESA_SHADER_VERTEX]->inlines.can_inline)
-            state->pctx->bind_vs_state(state->pctx, state->shaders[MESA_SHADER_VERTEX]->shader_cso);
+         state->inlines_dirty[MESA_SHADER_VERTEX] = shader_can_inline(state, state->shaders[MESA_SHADER_VERTEX]);
+         if (!state->inlines_dirty[MESA_SHADER_VERTEX])
+            state->pctx->bind_vs_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_VERTEX]));
          break;
       case VK_SHADER_STAGE_GEOMETRY_BIT:
-         state->inlines_dirty[MESA_SHADER_GEOMETRY] = state->shaders[MESA_SHADER_GEOMETRY]->inlines.can_inline;
-         if (!state->shaders[MESA_SHADER_GEOMETRY]->inlines.can_inline)
-            state->pctx->bind_gs_state(state->pctx, state->shaders[MESA_SHADER_GEOMETRY]->shader_cso);
+         state->inlines_dirty[MESA_SHADER_GEOMETRY] = shader_can_inline(state, state->shaders[MESA_SHADER_GEOMETRY]);
+         if (!state->inlines_dirty[MESA_SHADER_GEOMETRY])
+            state->pctx->bind_gs_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_GEOMETRY]));
          state->gs_output_lines = state->shaders[MESA_SHADER_GEOMETRY]->pipeline_nir->nir->info.gs.output_primitive == MESA_PRIM_LINES ? GS_OUTPUT_LINES : GS_OUTPUT_NOT_LINES;
          break;
       case VK_SHADER_STAGE_TESSELLATION_CONTROL_BIT:
-         state->inlines_dirty[MESA_SHADER_TESS_CTRL] = state->shaders[MESA_SHADER_TESS_CTRL]->inlines.can_inline;
-         if (!state->shaders[MESA_SHADER_TESS_CTRL]->inlines.can_inline)
-            state->pctx->bind_tcs_state(state->pctx, state->shaders[MESA_SHADER_TESS_CTRL]->shader_cso);
+         state->inlines_dirty[MESA_SHADER_TESS_CTRL] = shader_can_inline(state, state->shaders[MESA_SHADER_TESS_CTRL]);
+         if (!state->inlines_dirty[MESA_SHADER_TESS_CTRL])
+            state->pctx->bind_tcs_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_TESS_CTRL]));
          break;
       case VK_SHADER_STAGE_TESSELLATION_EVALUATION_BIT:
-         state->inlines_dirty[MESA_SHADER_TESS_EVAL] = state->shaders[MESA_SHADER_TESS_EVAL]->inlines.can_inline;
+         state->inlines_dirty[MESA_SHADER_TESS_EVAL] = shader_can_inline(state, state->shaders[MESA_SHADER_TESS_EVAL]);
          state->tess_states[0] = NULL;
          state->tess_states[1] = NULL;
-         if (!state->shaders[MESA_SHADER_TESS_EVAL]->inlines.can_inline) {
+         if (!state->inlines_dirty[MESA_SHADER_TESS_EVAL]) {
             if (dynamic_tess_origin) {
-               state->tess_states[0] = state->shaders[MESA_SHADER_TESS_EVAL]->shader_cso;
-               state->tess_states[1] = state->shaders[MESA_SHADER_TESS_EVAL]->tess_ccw_cso;
+               state->tess_states[0] = shader_cso(state, state->shaders[MESA_SHADER_TESS_EVAL]);
+               state->tess_states[1] = lvp_shader_queue_cso(state->queue, state->shaders[MESA_SHADER_TESS_EVAL], true);
                state->pctx->bind_tes_state(state->pctx, state->tess_states[state->tess_ccw]);
             } else {
-               state->pctx->bind_tes_state(state->pctx, state->shaders[MESA_SHADER_TESS_EVAL]->shader_cso);
+               state->pctx->bind_tes_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_TESS_EVAL]));
             }
          }
          if (!dynamic_tess_origin)
             state->tess_ccw = false;
          break;
       case VK_SHADER_STAGE_TASK_BIT_EXT:
-         state->inlines_dirty[MESA_SHADER_TASK] = state->shaders[MESA_SHADER_TASK]->inlines.can_inline;
-         if (!state->shaders[MESA_SHADER_TASK]->inlines.can_inline)
-            state->pctx->bind_ts_state(state->pctx, state->shaders[MESA_SHADER_TASK]->shader_cso);
+         state->inlines_dirty[MESA_SHADER_TASK] = shader_can_inline(state, state->shaders[MESA_SHADER_TASK]);
+         if (!state->inlines_dirty[MESA_SHADER_TASK])
+            state->pctx->bind_ts_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_TASK]));
          break;
       case VK_SHADER_STAGE_MESH_BIT_EXT:
-         state->inlines_dirty[MESA_SHADER_MESH] = state->shaders[MESA_SHADER_MESH]->inlines.can_inline;
-         if (!state->shaders[MESA_SHADER_MESH]->inlines.can_inline)
-            state->pctx->bind_ms_state(state->pctx, state->shaders[MESA_SHADER_MESH]->shader_cso);
+         state->inlines_dirty[MESA_SHADER_MESH] = shader_can_inline(state, state->shaders[MESA_SHADER_MESH]);
+         if (!state->inlines_dirty[MESA_SHADER_MESH])
+            state->pctx->bind_ms_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_MESH]));
          break;
       default:
          assert(0);
@@ -815,7 +929,18 @@ static void handle_graphics_pipeline(struct lvp_pipeline *pipeline,
                                      struct rendering_state *state)
 {
    const struct vk_graphics_pipeline_state *ps = &pipeline->graphics_state;
-   lvp_pipeline_shaders_compile(pipeline, true);
+   /* Only the first bind compiles, don't wait for queue 0's submission
+    * once the pipeline is compiled.
+    */
+   if (!p_atomic_read(&pipeline->compiled)) {
+      if (state->queue == &state->device->queue) {
+         lvp_pipeline_shaders_compile(pipeline, true);
+      } else {
+         simple_mtx_lock(&state->device->queue.lock);
+         lvp_pipeline_shaders_compile(pipeline, true);
+         simple_mtx_unlock(&state->device->queue.lock);
+      }
+   }
    bool dynamic_tess_origin = BITSET_TEST(ps->dynamic, MESA_VK_DYNAMIC_TS_DOMAIN_ORIGIN);
    unbind_graphics_stages(state,
                           (~pipeline->graphics_state.shader_stages) &
@@ -1128,7 +1253,7 @@ static void handle_pipeline(struct vk_cmd_queue_entry *cmd,
                             struct rendering_state *state)
 {
    LVP_FROM_HANDLE(lvp_pipeline, pipeline, cmd->u.bind_pipeline.pipeline);
-   pipeline->used = true;
+   p_atomic_set(&pipeline->used[state->queue->vk.index_in_family], true);
    if (pipeline->type == LVP_PIPELINE_COMPUTE) {
       handle_compute_pipeline(cmd, state);
    } else if (pipeline->type == LVP_PIPELINE_RAY_TRACING) {
@@ -1172,8 +1297,8 @@ static void handle_vertex_buffers2(struct vk_cmd_queue_entry *cmd,
             struct pipe_transfer *xfer;
             uint8_t *mem = pipe_buffer_map(state->pctx, state->vb[idx].buffer.resource, 0, &xfer);
             state->pctx->buffer_unmap(state->pctx, xfer);
-            state->vb[idx].buffer.resource = get_buffer_resource(state->pctx, mem);
-            state->vb[idx].buffer.resource->width0 = MIN2(vcb->offsets[i] + vcb->sizes[i], state->vb[idx].buffer.resource->width0);
+            state->vb[idx].buffer.resource =
+               get_transient_buffer_resource(state, mem, MIN2(vcb->offsets[i] + vcb->sizes[i], UINT32_MAX));
             state->vb_sizes[idx] = vcb->sizes[i];
          }
       } else {
@@ -1229,10 +1354,7 @@ apply_dynamic_offsets(struct lvp_descriptor_set **out_set, const uint32_t *offse
 
    struct lvp_descriptor_set *in_set = *out_set;
 
-   struct lvp_descriptor_set *set;
-   lvp_descriptor_set_create(state->device, in_set->layout, &set);
-
-   util_dynarray_append(&state->push_desc_sets, struct lvp_descriptor_set *, set);
+   struct lvp_descriptor_set *set = create_transient_set(state, in_set->layout);
 
    memcpy(set->map, in_set->map, in_set->bo->width0);
 
@@ -2345,14 +2467,13 @@ static void handle_copy_image_to_buffer2(struct vk_cmd_queue_entry *cmd,
                         box.depth,
                         src_data, src_format, src_t->stride, src_t->layer_stride, 0, 0, 0);
       } else {
-         util_copy_box((uint8_t *)dst_data, src_format,
-                       buffer_layout.row_stride_B,
-                       buffer_layout.image_stride_B,
-                       0, 0, 0,
-                       region->imageExtent.width,
-                       region->imageExtent.height,
-                       box.depth,
-                       src_data, src_t->stride, src_t->layer_stride, 0, 0, 0);
+         lvp_copy_box(state->device, dst_data, src_format,
+                      buffer_layout.row_stride_B,
+                      buffer_layout.image_stride_B,
+                      region->imageExtent.width,
+                      region->imageExtent.height,
+                      box.depth,
+                      src_data, src_t->stride, src_t->layer_stride);
       }
       state->pctx->texture_unmap(state->pctx, src_t);
       state->pctx->buffer_unmap(state->pctx, dst_t);
@@ -2425,16 +2546,14 @@ static void handle_copy_buffer_to_image(struct vk_cmd_queue_entry *cmd,
                         buffer_layout.image_stride_B,
                         0, 0, 0);
       } else {
-         util_copy_box(dst_data, dst_format,
-                       dst_t->stride, dst_t->layer_stride,
-                       0, 0, 0,
-                       region->imageExtent.width,
-                       region->imageExtent.height,
-                       box.depth,
-                       src_data,
-                       buffer_layout.row_stride_B,
-                       buffer_layout.image_stride_B,
-                       0, 0, 0);
+         lvp_copy_box(state->device, dst_data, dst_format,
+                      dst_t->stride, dst_t->layer_stride,
+                      region->imageExtent.width,
+                      region->imageExtent.height,
+                      box.depth,
+                      src_data,
+                      buffer_layout.row_stride_B,
+                      buffer_layout.image_stride_B);
       }
       state->pctx->buffer_unmap(state->pctx, src_t);
       state->pctx->texture_unmap(state->pctx, dst_t);
@@ -2708,8 +2827,9 @@ static void handle_draw_indirect(struct vk_cmd_queue_entry *cmd,
          struct pipe_transfer *xfer;
          uint8_t *mem = pipe_buffer_map(state->pctx, state->index_buffer, 0, &xfer);
          state->pctx->buffer_unmap(state->pctx, xfer);
-         index = get_buffer_resource(state->pctx, mem + state->index_offset);
-         index->width0 = MIN2(state->index_buffer->width0 - state->index_offset, state->index_buffer_size);
+         index = get_transient_buffer_resource(state, mem + state->index_offset,
+                                               MIN2(state->index_buffer->width0 - state->index_offset,
+                                                    state->index_buffer_size));
          state->info.index.resource = index;
       }
    } else
@@ -2905,6 +3025,7 @@ static void handle_begin_query(struct vk_cmd_queue_entry *cmd,
                                                                qtype, 0);
       }
 
+      pool->ctxs[qcmd->query + idx] = state->pctx;
       state->pctx->begin_query(state->pctx, pool->queries[qcmd->query + idx]);
       if (idx)
          state->pctx->end_query(state->pctx, pool->queries[qcmd->query + idx]);
@@ -2948,6 +3069,7 @@ static void handle_begin_query_indexed_ext(struct vk_cmd_queue_entry *cmd,
                                                                       qtype, qcmd->index);
       }
 
+      pool->ctxs[qcmd->query + idx] = state->pctx;
       state->pctx->begin_query(state->pctx, pool->queries[qcmd->query + idx]);
       if (idx)
          state->pctx->end_query(state->pctx, pool->queries[qcmd->query + idx]);
@@ -2978,7 +3100,7 @@ static void handle_reset_query_pool(struct vk_cmd_queue_entry *cmd,
          continue;
       }
       if (pool->queries[i]) {
-         state->pctx->destroy_query(state->pctx, pool->queries[i]);
+         pool->ctxs[i]->destroy_query(pool->ctxs[i], pool->queries[i]);
          pool->queries[i] = NULL;
       }
    }
@@ -2999,6 +3121,7 @@ static void handle_write_timestamp2(struct vk_cmd_queue_entry *cmd,
          pool->queries[qcmd->query + idx] = state->pctx->create_query(state->pctx, PIPE_QUERY_TIMESTAMP, 0);
       }
 
+      pool->ctxs[qcmd->query + idx] = state->pctx;
       state->pctx->end_query(state->pctx, pool->queries[qcmd->query + idx]);
    }
 }
@@ -3288,8 +3411,9 @@ static void handle_draw_indirect_count(struct vk_cmd_queue_entry *cmd,
          struct pipe_transfer *xfer;
          uint8_t *mem = pipe_buffer_map(state->pctx, state->index_buffer, 0, &xfer);
          state->pctx->buffer_unmap(state->pctx, xfer);
-         index = get_buffer_resource(state->pctx, mem + state->index_offset);
-         index->width0 = MIN2(state->index_buffer->width0 - state->index_offset, state->index_buffer_size);
+         index = get_transient_buffer_resource(state, mem + state->index_offset,
+                                               MIN2(state->index_buffer->width0 - state->index_offset,
+                                                    state->index_buffer_size));
          state->info.index.resource = index;
       }
    } else
@@ -3312,10 +3436,7 @@ static void handle_push_descriptor_set(struct vk_cmd_queue_entry *cmd,
    LVP_FROM_HANDLE(lvp_pipeline_layout, layout, pds->layout);
    struct lvp_descriptor_set_layout *set_layout = (struct lvp_descriptor_set_layout *)layout->vk.set_layouts[pds->set];
 
-   struct lvp_descriptor_set *set;
-   lvp_descriptor_set_create(state->device, set_layout, &set);
-
-   util_dynarray_append(&state->push_desc_sets, struct lvp_descriptor_set *, set);
+   struct lvp_descriptor_set *set = create_transient_set(state, set_layout);
 
    uint32_t types = lvp_pipeline_types_from_shader_stages(pds->stageFlags);
    u_foreach_bit(pipeline_type, types) {
@@ -3350,10 +3471,7 @@ static void handle_push_descriptor_set_with_template(struct vk_cmd_queue_entry *
    LVP_FROM_HANDLE(lvp_pipeline_layout, layout, pds->layout);
    struct lvp_descriptor_set_layout *set_layout = (struct lvp_descriptor_set_layout *)layout->vk.set_layouts[pds->set];
 
-   struct lvp_descriptor_set *set;
-   lvp_descriptor_set_create(state->device, set_layout, &set);
-
-   util_dynarray_append(&state->push_desc_sets, struct lvp_descriptor_set *, set);
+   struct lvp_descriptor_set *set = create_transient_set(state, set_layout);
 
    struct lvp_descriptor_set *base = state->desc_sets[lvp_pipeline_type_from_bind_point(templ->bind_point)][pds->set];
    if (base)
@@ -4187,7 +4305,8 @@ handle_descriptor_buffers(struct vk_cmd_queue_entry *cmd, struct rendering_state
 {
    const struct vk_cmd_bind_descriptor_buffers_ext *bind = &cmd->u.bind_descriptor_buffers_ext;
    for (unsigned i = 0; i < bind->buffer_count; i++) {
-      struct pipe_resource *pres = get_buffer_resource(state->pctx, (void *)(uintptr_t)bind->binding_infos[i].address);
+      struct pipe_resource *pres =
+         get_transient_buffer_resource(state, (void *)(uintptr_t)bind->binding_infos[i].address, UINT32_MAX);
       state->desc_buffer_addrs[i] = (void *)(uintptr_t)bind->binding_infos[i].address;
       pipe_resource_reference(&state->desc_buffers[i], pres);
       /* leave only one ref on rendering_state */
@@ -4568,7 +4687,7 @@ static void emit_ray_tracing_state(struct rendering_state *state)
       state->constbuf_dirty[MESA_SHADER_RAYGEN] = false;
    }
 
-   state->pctx->bind_compute_state(state->pctx, state->shaders[MESA_SHADER_RAYGEN]->shader_cso);
+   state->pctx->bind_compute_state(state->pctx, shader_cso(state, state->shaders[MESA_SHADER_RAYGEN]));
 
    state->pcbuf_dirty[MESA_SHADER_COMPUTE] = true;
    state->constbuf_dirty[MESA_SHADER_COMPUTE] = true;
@@ -5138,13 +5257,70 @@ void lvp_add_enqueue_cmd_entrypoints(struct vk_device_dispatch_table *disp)
 #undef ENQUEUE_CMD
 }
 
+static void
+add_cmd_stats(struct rendering_state *state, enum vk_cmd_type type,
+              int64_t time_ns)
+{
+   struct util_dynarray *stats = &state->queue->cmd_stats;
+   const unsigned size = (type + 1) * sizeof(struct lvp_cmd_stats);
+
+   if (stats->size < size) {
+      const unsigned old_size = stats->size;
+      if (!util_dynarray_resize_bytes(stats, type + 1, sizeof(struct lvp_cmd_stats)))
+         return;
+      memset((uint8_t *)stats->data + old_size, 0, size - old_size);
+   }
+
+   struct lvp_cmd_stats *entry =
+      util_dynarray_element(stats, struct lvp_cmd_stats, type);
+   entry->count++;
+   entry->time_ns += time_ns;
+}
+
+void
+lvp_queue_print_cmd_stats(struct lvp_queue *queue)
+{
+   fprintf(stderr, "lavapipe: queue %u command replay times:\n",
+           queue->vk.index_in_family);
+
+   unsigned type = 0;
+   util_dynarray_foreach(&queue->cmd_stats, struct lvp_cmd_stats, stats) {
+      if (stats->count)
+         fprintf(stderr, "  %-40s %10" PRIu64 " %12.3f ms %10.0f ns/cmd\n",
+                 vk_cmd_queue_type_names[type], stats->count,
+                 stats->time_ns / 1e6, (double)stats->time_ns / stats->count);
+      type++;
+   }
+
+   if (queue->emit_stats.count)
+      fprintf(stderr, "  %-40s %10" PRIu64 " %12.3f ms %10.0f ns/cmd\n",
+              "(emit_state)", queue->emit_stats.count,
+              queue->emit_stats.time_ns / 1e6,
+              (double)queue->emit_stats.time_ns / queue->emit_stats.count);
+}
+
 static void lvp_execute_cmd_buffer(struct list_head *cmds,
                                    struct rendering_state *state, bool print_cmds)
 {
    struct vk_cmd_queue_entry *cmd;
    bool did_flush = false;
 
+   /* Charge the time since the previous command to it, some commands skip
+    * the end of the loop.  Times include the gallium calls they make, and
+    * secondaries for vkCmdExecuteCommands.
+    */
+   const bool stats = state->device->cmd_stats;
+   struct vk_cmd_queue_entry *prev_cmd = NULL;
+   int64_t prev_start = 0;
+
    LIST_FOR_EACH_ENTRY(cmd, cmds, cmd_link) {
+      if (stats) {
+         const int64_t now = os_time_get_nano();
+         if (prev_cmd)
+            add_cmd_stats(state, prev_cmd->type, now - prev_start);
+         prev_cmd = cmd;
+         prev_start = now;
+      }
       if (print_cmds)
          fprintf(stderr, "%s\n", vk_cmd_queue_type_names[cmd->type]);
       switch (cmd->type) {
@@ -5550,6 +5726,9 @@ static void lvp_execute_cmd_buffer(struct list_head *cmds,
       if (!cmd->cmd_link.next)
          break;
    }
+
+   if (prev_cmd)
+      add_cmd_stats(state, prev_cmd->type, os_time_get_nano() - prev_start);
 }
 
 VkResult lvp_execute_cmds(struct lvp_device *device,
@@ -5560,6 +5739,7 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    memset(state, 0, sizeof(*state));
    state->pctx = queue->ctx;
    state->device = device;
+   state->queue = queue;
    state->uploader = queue->uploader;
    state->cso = queue->cso;
    state->blend_dirty = true;
@@ -5594,12 +5774,23 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    state->index_buffer_size = sizeof(uint32_t);
    state->index_buffer = state->device->zero_buffer;
 
+   /* A command buffer with simultaneous use can be executing on another
+    * queue, in which case this execution creates its own objects.
+    */
+   if (cmd_buffer->replay.enabled &&
+       mtx_trylock(&cmd_buffer->replay.lock) == thrd_success)
+      state->replay = cmd_buffer;
+
    /* create a gallium context */
    lvp_execute_cmd_buffer(&cmd_buffer->vk.cmd_queue.cmds, state, device->print_cmds);
 
    state->start_vb = -1;
    state->num_vb = 0;
    cso_unbind_context(queue->cso);
+   for (unsigned i = 0; i < ARRAY_SIZE(state->vb); i++) {
+      if (state->vb_sizes[i] != UINT32_MAX)
+         pipe_resource_reference(&state->vb[i].buffer.resource, NULL);
+   }
    for (unsigned i = 0; i < ARRAY_SIZE(state->so_targets); i++) {
       if (state->so_targets[i]) {
          state->pctx->stream_output_target_destroy(state->pctx, state->so_targets[i]);
@@ -5621,6 +5812,9 @@ VkResult lvp_execute_cmds(struct lvp_device *device,
    for (unsigned i = 0; i < ARRAY_SIZE(state->desc_buffers); i++)
       pipe_resource_reference(&state->desc_buffers[i], NULL);
 
+   if (state->replay)
+      mtx_unlock(&cmd_buffer->replay.lock);
+
    return VK_SUCCESS;
 }
 
@@ -795,8 +795,16 @@ lvp_CopyMemoryToImageEXT(VkDevice _device, const VkCopyMemoryToImageInfoEXT *pCo
 
       unsigned stride = util_format_get_stride(image->planes[plane].bo->format, copy->memoryRowLength ? copy->memoryRowLength : box.width);
       unsigned layer_stride = util_format_get_2d_size(image->planes[plane].bo->format, stride, copy->memoryImageHeight ? copy->memoryImageHeight : box.height);
-      device->queue.ctx->texture_subdata(device->queue.ctx, image->planes[plane].bo, copy->imageSubresource.mipLevel, 0,
-                                         &box, copy->pHostPointer, stride, layer_stride);
+      struct pipe_transfer *xfer;
+      uint8_t *data = device->queue.ctx->texture_map(device->queue.ctx, image->planes[plane].bo, copy->imageSubresource.mipLevel,
+                                                     PIPE_MAP_WRITE | PIPE_MAP_UNSYNCHRONIZED | PIPE_MAP_THREAD_SAFE, &box, &xfer);
+      if (!data)
+         return VK_ERROR_MEMORY_MAP_FAILED;
+
+      /* offsets are all zero because texture_map handles the offset */
+      lvp_copy_box(device, data, image->planes[plane].bo->format, xfer->stride, xfer->layer_stride,
+                   box.width, box.height, box.depth, copy->pHostPointer, stride, layer_stride);
+      pipe_texture_unmap(device->queue.ctx, xfer);
    }
    return VK_SUCCESS;
 }
@@ -845,9 +853,9 @@ lvp_CopyImageToMemoryEXT(VkDevice _device, const VkCopyImageToMemoryInfoEXT *pCo
 
       unsigned stride = util_format_get_stride(image->planes[plane].bo->format, copy->memoryRowLength ? copy->memoryRowLength : box.width);
       unsigned layer_stride = util_format_get_2d_size(image->planes[plane].bo->format, stride, copy->memoryImageHeight ? copy->memoryImageHeight : box.height);
-      util_copy_box(copy->pHostPointer, image->planes[plane].bo->format, stride, layer_stride,
-                    /* offsets are all zero because texture_map handles the offset */
-                    0, 0, 0, box.width, box.height, box.depth, data, xfer->stride, xfer->layer_stride, 0, 0, 0);
+      /* offsets are all zero because texture_map handles the offset */
+      lvp_copy_box(device, copy->pHostPointer, image->planes[plane].bo->format, stride, layer_stride,
+                   box.width, box.height, box.depth, data, xfer->stride, xfer->layer_stride);
       pipe_texture_unmap(device->queue.ctx, xfer);
    }
    return VK_SUCCESS;
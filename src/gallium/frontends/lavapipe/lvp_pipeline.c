@@ -24,10 +24,13 @@
 #include "lvp_private.h"
 #include "vk_nir_convert_ycbcr.h"
 #include "vk_pipeline.h"
+#include "vk_pipeline_cache.h"
 #include "vk_render_pass.h"
 #include "vk_util.h"
 #include "glsl_types.h"
+#include "util/mesa-sha1.h"
 #include "util/os_time.h"
+#include "util/u_atomic.h"
 #include "spirv/nir_spirv.h"
 #include "nir/nir_builder.h"
 #include "nir/nir_serialize.h"
@@ -42,41 +45,65 @@
 
 typedef void (*cso_destroy_func)(struct pipe_context*, void*);
 
+void
+lvp_shader_cso_destroy(struct pipe_context *ctx, gl_shader_stage stage, void *cso)
+{
+   cso_destroy_func destroy[] = {
+      ctx->delete_vs_state,
+      ctx->delete_tcs_state,
+      ctx->delete_tes_state,
+      ctx->delete_gs_state,
+      ctx->delete_fs_state,
+      ctx->delete_compute_state,
+      ctx->delete_ts_state,
+      ctx->delete_ms_state,
+   };
+
+   destroy[stage](ctx, cso);
+}
+
 static void
 shader_destroy(struct lvp_device *device, struct lvp_shader *shader, bool locked)
 {
    if (!shader->pipeline_nir)
       return;
    gl_shader_stage stage = shader->pipeline_nir->nir->info.stage;
-   cso_destroy_func destroy[] = {
-      device->queue.ctx->delete_vs_state,
-      device->queue.ctx->delete_tcs_state,
-      device->queue.ctx->delete_tes_state,
-      device->queue.ctx->delete_gs_state,
-      device->queue.ctx->delete_fs_state,
-      device->queue.ctx->delete_compute_state,
-      device->queue.ctx->delete_ts_state,
-      device->queue.ctx->delete_ms_state,
-   };
+   struct pipe_context *ctx = device->queue.ctx;
 
    if (!locked)
       simple_mtx_lock(&device->queue.lock);
 
    set_foreach(&shader->inlines.variants, entry) {
       struct lvp_inline_variant *variant = (void*)entry->key;
-      destroy[stage](device->queue.ctx, variant->cso);
+      lvp_shader_cso_destroy(ctx, stage, variant->cso);
       free(variant);
    }
    ralloc_free(shader->inlines.variants.table);
 
    if (shader->shader_cso)
-      destroy[stage](device->queue.ctx, shader->shader_cso);
+      lvp_shader_cso_destroy(ctx, stage, shader->shader_cso);
    if (shader->tess_ccw_cso)
-      destroy[stage](device->queue.ctx, shader->tess_ccw_cso);
+      lvp_shader_cso_destroy(ctx, stage, shader->tess_ccw_cso);
 
    if (!locked)
       simple_mtx_unlock(&device->queue.lock);
 
+   /* The secondary queues may still have these bound, let them delete the
+    * CSOs once they are idle.
+    */
+   for (uint32_t i = 0; i < ARRAY_SIZE(shader->queue_csos); i++) {
+      struct lvp_queue *queue = &device->secondary_queues[i];
+      for (uint32_t j = 0; j < ARRAY_SIZE(shader->queue_csos[i]); j++) {
+         if (!shader->queue_csos[i][j])
+            continue;
+
+         struct lvp_shader_cso cso = { stage, shader->queue_csos[i][j] };
+         simple_mtx_lock(&queue->cso_destroys_lock);
+         util_dynarray_append(&queue->cso_destroys, struct lvp_shader_cso, cso);
+         simple_mtx_unlock(&queue->cso_destroys_lock);
+      }
+   }
+
    lvp_pipeline_nir_ref(&shader->pipeline_nir, NULL);
    lvp_pipeline_nir_ref(&shader->tess_ccw, NULL);
 }
@@ -119,12 +146,27 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyPipeline(
    if (!_pipeline)
       return;
 
-   if (pipeline->used) {
-      simple_mtx_lock(&device->queue.lock);
-      util_dynarray_append(&device->queue.pipeline_destroys, struct lvp_pipeline*, pipeline);
-      simple_mtx_unlock(&device->queue.lock);
-   } else {
+   /* Every queue that used the pipeline may still be executing it, the last
+    * one to go idle destroys it.
+    */
+   uint32_t refs = 0;
+   for (uint32_t i = 0; i < device->queue_count; i++)
+      refs += p_atomic_read(&pipeline->used[i]);
+
+   if (!refs) {
       lvp_pipeline_destroy(device, pipeline, false);
+      return;
+   }
+
+   pipeline->destroy_refs = refs;
+   for (uint32_t i = 0; i < device->queue_count; i++) {
+      if (!p_atomic_read(&pipeline->used[i]))
+         continue;
+
+      struct lvp_queue *queue = lvp_device_queue(device, i);
+      simple_mtx_lock(&queue->lock);
+      util_dynarray_append(&queue->pipeline_destroys, struct lvp_pipeline*, pipeline);
+      simple_mtx_unlock(&queue->lock);
    }
 }
 
@@ -493,14 +535,106 @@ lvp_shader_init(struct lvp_shader *shader, nir_shader *nir)
       _mesa_set_init(&shader->inlines.variants, NULL, NULL, inline_variant_equals);
 }
 
+static void
+lvp_hash_pipeline_layout(struct mesa_sha1 *ctx,
+                         const struct lvp_pipeline_layout *layout)
+{
+   if (!layout)
+      return;
+
+   _mesa_sha1_update(ctx, &layout->vk.set_count, sizeof(layout->vk.set_count));
+   _mesa_sha1_update(ctx, &layout->push_constant_size,
+                     sizeof(layout->push_constant_size));
+
+   for (unsigned s = 0; s < layout->vk.set_count; s++) {
+      if (!layout->vk.set_layouts[s])
+         continue;
+
+      const struct lvp_descriptor_set_layout *set_layout =
+         vk_to_lvp_descriptor_set_layout(layout->vk.set_layouts[s]);
+
+      _mesa_sha1_update(ctx, &s, sizeof(s));
+      _mesa_sha1_update(ctx, &set_layout->binding_count,
+                        sizeof(set_layout->binding_count));
+
+      for (unsigned b = 0; b < set_layout->binding_count; b++) {
+         const struct lvp_descriptor_set_binding_layout *binding =
+            &set_layout->binding[b];
+
+         _mesa_sha1_update(ctx, binding,
+                           offsetof(struct lvp_descriptor_set_binding_layout,
+                                    immutable_samplers));
+
+         /* only the YCbCr conversions of immutable samplers affect lowering */
+         if (!binding->immutable_samplers)
+            continue;
+         for (unsigned i = 0; i < binding->array_size; i++) {
+            const struct vk_ycbcr_conversion *conversion =
+               binding->immutable_samplers[i]->vk.ycbcr_conversion;
+            if (conversion)
+               _mesa_sha1_update(ctx, &conversion->state,
+                                 sizeof(conversion->state));
+         }
+      }
+   }
+}
+
+/* Computes the pipeline cache key of a stage's lowered NIR.  Returns false
+ * if the stage can't be cached.
+ */
+static bool
+lvp_hash_shader_stage(const struct lvp_pipeline *pipeline,
+                      const VkPipelineShaderStageCreateInfo *sinfo,
+                      unsigned char *key)
+{
+#ifdef VK_ENABLE_BETA_EXTENSIONS
+   /* execution graph nodes are lowered against the graph */
+   if (vk_find_struct_const(sinfo->pNext,
+                            PIPELINE_SHADER_STAGE_NODE_CREATE_INFO_AMDX))
+      return false;
+#endif
+
+   unsigned char stage_sha1[SHA1_DIGEST_LENGTH];
+   vk_pipeline_hash_shader_stage(pipeline->flags, sinfo, NULL, stage_sha1);
+
+   struct mesa_sha1 ctx;
+   _mesa_sha1_init(&ctx);
+   _mesa_sha1_update(&ctx, "lvp-nir", strlen("lvp-nir"));
+   _mesa_sha1_update(&ctx, stage_sha1, sizeof(stage_sha1));
+   lvp_hash_pipeline_layout(&ctx, pipeline->layout);
+   _mesa_sha1_final(&ctx, key);
+
+   return true;
+}
+
 static VkResult
 lvp_shader_compile_to_ir(struct lvp_pipeline *pipeline,
+                         struct vk_pipeline_cache *cache,
                          const VkPipelineShaderStageCreateInfo *sinfo)
 {
+   struct lvp_device *device = pipeline->device;
    gl_shader_stage stage = vk_to_mesa_shader_stage(sinfo->stage);
    assert(stage <= LVP_SHADER_STAGES && stage != MESA_SHADER_NONE);
-   nir_shader *nir;
-   VkResult result = lvp_spirv_to_nir(pipeline, sinfo, &nir);
+   unsigned char key[SHA1_DIGEST_LENGTH];
+   nir_shader *nir = NULL;
+   VkResult result = VK_SUCCESS;
+
+   if (!cache)
+      cache = device->vk.mem_cache;
+
+   bool cacheable = cache && lvp_hash_shader_stage(pipeline, sinfo, key);
+   if (cacheable) {
+      nir = vk_pipeline_cache_lookup_nir(cache, key, sizeof(key),
+                                         device->physical_device->drv_options[stage],
+                                         NULL, NULL);
+   }
+
+   if (!nir) {
+      result = lvp_spirv_to_nir(pipeline, sinfo, &nir);
+      if (result == VK_SUCCESS && cacheable)
+         vk_pipeline_cache_add_nir(cache, key, sizeof(key), nir);
+   }
+
    if (result == VK_SUCCESS) {
       struct lvp_shader *shader = &pipeline->shaders[stage];
       lvp_shader_init(shader, nir);
@@ -594,14 +728,14 @@ lvp_pipeline_xfb_init(struct lvp_pipeline *pipeline)
 }
 
 static void *
-lvp_shader_compile_stage(struct lvp_device *device, struct lvp_shader *shader, nir_shader *nir)
+lvp_shader_compile_stage(struct pipe_context *ctx, struct lvp_shader *shader, nir_shader *nir)
 {
    if (nir->info.stage == MESA_SHADER_COMPUTE) {
       struct pipe_compute_state shstate = {0};
       shstate.prog = nir;
       shstate.ir_type = PIPE_SHADER_IR_NIR;
       shstate.static_shared_mem = nir->info.shared_size;
-      return device->queue.ctx->create_compute_state(device->queue.ctx, &shstate);
+      return ctx->create_compute_state(ctx, &shstate);
    } else {
       struct pipe_shader_state shstate = {0};
       shstate.type = PIPE_SHADER_IR_NIR;
@@ -610,19 +744,19 @@ lvp_shader_compile_stage(struct lvp_device *device, struct lvp_shader *shader, n
 
       switch (nir->info.stage) {
       case MESA_SHADER_FRAGMENT:
-         return device->queue.ctx->create_fs_state(device->queue.ctx, &shstate);
+         return ctx->create_fs_state(ctx, &shstate);
       case MESA_SHADER_VERTEX:
-         return device->queue.ctx->create_vs_state(device->queue.ctx, &shstate);
+         return ctx->create_vs_state(ctx, &shstate);
       case MESA_SHADER_GEOMETRY:
-         return device->queue.ctx->create_gs_state(device->queue.ctx, &shstate);
+         return ctx->create_gs_state(ctx, &shstate);
       case MESA_SHADER_TESS_CTRL:
-         return device->queue.ctx->create_tcs_state(device->queue.ctx, &shstate);
+         return ctx->create_tcs_state(ctx, &shstate);
       case MESA_SHADER_TESS_EVAL:
-         return device->queue.ctx->create_tes_state(device->queue.ctx, &shstate);
+         return ctx->create_tes_state(ctx, &shstate);
       case MESA_SHADER_TASK:
-         return device->queue.ctx->create_ts_state(device->queue.ctx, &shstate);
+         return ctx->create_ts_state(ctx, &shstate);
       case MESA_SHADER_MESH:
-         return device->queue.ctx->create_ms_state(device->queue.ctx, &shstate);
+         return ctx->create_ms_state(ctx, &shstate);
       default:
          unreachable("illegal shader");
          break;
@@ -639,7 +773,7 @@ lvp_shader_compile(struct lvp_device *device, struct lvp_shader *shader, nir_sha
    if (!locked)
       simple_mtx_lock(&device->queue.lock);
 
-   void *state = lvp_shader_compile_stage(device, shader, nir);
+   void *state = lvp_shader_compile_stage(device->queue.ctx, shader, nir);
 
    if (!locked)
       simple_mtx_unlock(&device->queue.lock);
@@ -647,6 +781,41 @@ lvp_shader_compile(struct lvp_device *device, struct lvp_shader *shader, nir_sha
    return state;
 }
 
+/* Returns the CSO to bind on the queue's context. Called from the queue's
+ * thread with queue->lock held.
+ */
+void *
+lvp_shader_queue_cso(struct lvp_queue *queue, struct lvp_shader *shader, bool tess_ccw)
+{
+   struct lvp_device *device = queue->device;
+
+   if (queue == &device->queue)
+      return tess_ccw ? shader->tess_ccw_cso : shader->shader_cso;
+
+   void **cso = &shader->queue_csos[queue->vk.index_in_family - 1][tess_ccw];
+   if (*cso)
+      return *cso;
+
+   /* llvmpipe registers the sample and image functions a shader needs with
+    * the context that creates it, and all texture handles are created on
+    * queue 0's context, so it has to see every shader.  Only take queue
+    * 0's lock, which it holds for whole submissions, if it hasn't yet.
+    */
+   if (!p_atomic_read(&shader->shader_cso)) {
+      simple_mtx_lock(&device->queue.lock);
+      if (!shader->shader_cso)
+         p_atomic_set(&shader->shader_cso, lvp_shader_compile(device, shader, nir_shader_clone(NULL, shader->pipeline_nir->nir), true));
+      simple_mtx_unlock(&device->queue.lock);
+   }
+
+   struct lvp_pipeline_nir *pipeline_nir = tess_ccw ? shader->tess_ccw : shader->pipeline_nir;
+   nir_shader *nir = nir_shader_clone(NULL, pipeline_nir->nir);
+   device->pscreen->finalize_nir(device->pscreen, nir);
+   *cso = lvp_shader_compile_stage(queue->ctx, shader, nir);
+
+   return *cso;
+}
+
 #ifndef NDEBUG
 static bool
 layouts_equal(const struct lvp_descriptor_set_layout *a, const struct lvp_descriptor_set_layout *b)
@@ -766,7 +935,7 @@ copy_shader_sanitized(struct lvp_shader *dst, const struct lvp_shader *src)
 static VkResult
 lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
                            struct lvp_device *device,
-                           struct lvp_pipeline_cache *cache,
+                           struct vk_pipeline_cache *cache,
                            const VkGraphicsPipelineCreateInfo *pCreateInfo,
                            VkPipelineCreateFlagBits2KHR flags)
 {
@@ -860,7 +1029,7 @@ lvp_graphics_pipeline_init(struct lvp_pipeline *pipeline,
          if (!(pipeline->stages & VK_GRAPHICS_PIPELINE_LIBRARY_PRE_RASTERIZATION_SHADERS_BIT_EXT))
             continue;
       }
-      result = lvp_shader_compile_to_ir(pipeline, sinfo);
+      result = lvp_shader_compile_to_ir(pipeline, cache, sinfo);
       if (result != VK_SUCCESS)
          goto fail;
 
@@ -931,7 +1100,7 @@ fail:
 void
 lvp_pipeline_shaders_compile(struct lvp_pipeline *pipeline, bool locked)
 {
-   if (pipeline->compiled)
+   if (p_atomic_read(&pipeline->compiled))
       return;
    for (uint32_t i = 0; i < ARRAY_SIZE(pipeline->shaders); i++) {
       if (!pipeline->shaders[i].pipeline_nir)
@@ -941,14 +1110,16 @@ lvp_pipeline_shaders_compile(struct lvp_pipeline *pipeline, bool locked)
       assert(stage == pipeline->shaders[i].pipeline_nir->nir->info.stage);
 
       if (!pipeline->shaders[stage].inlines.can_inline) {
-         pipeline->shaders[stage].shader_cso = lvp_shader_compile(pipeline->device, &pipeline->shaders[stage],
-            nir_shader_clone(NULL, pipeline->shaders[stage].pipeline_nir->nir), locked);
+         p_atomic_set(&pipeline->shaders[stage].shader_cso,
+                      lvp_shader_compile(pipeline->device, &pipeline->shaders[stage],
+                                         nir_shader_clone(NULL, pipeline->shaders[stage].pipeline_nir->nir), locked));
          if (pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw)
             pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw_cso = lvp_shader_compile(pipeline->device, &pipeline->shaders[stage],
                nir_shader_clone(NULL, pipeline->shaders[MESA_SHADER_TESS_EVAL].tess_ccw->nir), locked);
       }
    }
-   pipeline->compiled = true;
+   /* Published for the unlocked check on the bind path. */
+   p_atomic_set(&pipeline->compiled, true);
 }
 
 static VkResult
@@ -961,7 +1132,7 @@ lvp_graphics_pipeline_create(
    bool group)
 {
    LVP_FROM_HANDLE(lvp_device, device, _device);
-   LVP_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   VK_FROM_HANDLE(vk_pipeline_cache, cache, _cache);
    struct lvp_pipeline *pipeline;
    VkResult result;
 
@@ -1057,7 +1228,7 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateGraphicsPipelines(
 static VkResult
 lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
                           struct lvp_device *device,
-                          struct lvp_pipeline_cache *cache,
+                          struct vk_pipeline_cache *cache,
                           const VkComputePipelineCreateInfo *pCreateInfo,
                           VkPipelineCreateFlagBits2KHR flags)
 {
@@ -1069,14 +1240,14 @@ lvp_compute_pipeline_init(struct lvp_pipeline *pipeline,
 
    pipeline->type = LVP_PIPELINE_COMPUTE;
 
-   VkResult result = lvp_shader_compile_to_ir(pipeline, &pCreateInfo->stage);
+   VkResult result = lvp_shader_compile_to_ir(pipeline, cache, &pCreateInfo->stage);
    if (result != VK_SUCCESS)
       return result;
 
    struct lvp_shader *shader = &pipeline->shaders[MESA_SHADER_COMPUTE];
    if (!shader->inlines.can_inline)
       shader->shader_cso = lvp_shader_compile(pipeline->device, shader, nir_shader_clone(NULL, shader->pipeline_nir->nir), false);
-   pipeline->compiled = true;
+   p_atomic_set(&pipeline->compiled, true);
    return VK_SUCCESS;
 }
 
@@ -1089,7 +1260,7 @@ lvp_compute_pipeline_create(
    VkPipeline *pPipeline)
 {
    LVP_FROM_HANDLE(lvp_device, device, _device);
-   LVP_FROM_HANDLE(lvp_pipeline_cache, cache, _cache);
+   VK_FROM_HANDLE(vk_pipeline_cache, cache, _cache);
    struct lvp_pipeline *pipeline;
    VkResult result;
 
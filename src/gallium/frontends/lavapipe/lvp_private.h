@@ -82,6 +82,7 @@ typedef uint32_t xcb_window_t;
 #include "vk_command_pool.h"
 #include "vk_descriptor_set_layout.h"
 #include "vk_graphics_state.h"
+#include "vk_pipeline_cache.h"
 #include "vk_pipeline_layout.h"
 #include "vk_queue.h"
 #include "vk_sampler.h"
@@ -109,6 +110,8 @@ extern "C" {
 /* Currently lavapipe does not support more than 1 image plane */
 #define LVP_MAX_PLANE_COUNT 1
 
+#define LVP_MAX_QUEUES 4
+
 #ifdef _WIN32
 #define lvp_printflike(a, b)
 #else
@@ -186,6 +189,16 @@ void lvp_finish_wsi(struct lvp_physical_device *physical_device);
 bool lvp_physical_device_extension_supported(struct lvp_physical_device *dev,
                                               const char *name);
 
+struct lvp_shader_cso {
+   gl_shader_stage stage;
+   void *cso;
+};
+
+struct lvp_cmd_stats {
+   uint64_t count;
+   uint64_t time_ns;
+};
+
 struct lvp_queue {
    struct vk_queue vk;
    struct lvp_device *                         device;
@@ -194,29 +207,43 @@ struct lvp_queue {
    struct u_upload_mgr *uploader;
    struct pipe_fence_handle *last_fence;
    void *state;
+   void *noop_fs;
    struct util_dynarray pipeline_destroys;
    simple_mtx_t lock;
-};
 
-struct lvp_pipeline_cache {
-   struct vk_object_base                        base;
-   struct lvp_device *                          device;
-   VkAllocationCallbacks                        alloc;
+   /* Shader CSOs of this queue's context whose shader has been destroyed.
+    * Other threads only append to this under cso_destroys_lock, the queue
+    * deletes them once it is idle.
+    */
+   struct util_dynarray cso_destroys;
+   simple_mtx_t cso_destroys_lock;
+
+   /* LVP_CMD_STATS: replay cost of each vk_cmd_type on this queue, and of
+    * turning the tracked state into gallium state before draws.
+    */
+   struct util_dynarray cmd_stats;
+   struct lvp_cmd_stats emit_stats;
 };
 
 struct lvp_device {
    struct vk_device vk;
 
+   /* Queue 0. Its context also owns device level objects such as texture
+    * handles and the CSOs stored in lvp_shader::shader_cso.
+    */
    struct lvp_queue queue;
+   /* Queues 1 to queue_count - 1, each with their own context. */
+   struct lvp_queue secondary_queues[LVP_MAX_QUEUES - 1];
+   uint32_t queue_count;
    struct lvp_instance *                       instance;
    struct lvp_physical_device *physical_device;
    struct pipe_screen *pscreen;
-   void *noop_fs;
    simple_mtx_t bda_lock;
    struct hash_table bda;
    struct pipe_resource *zero_buffer; /* for zeroed bda */
    bool poison_mem;
    bool print_cmds;
+   bool cmd_stats;
 
    struct lp_texture_handle *null_texture_handle;
    struct lp_texture_handle *null_image_handle;
@@ -224,10 +251,29 @@ struct lvp_device {
    struct util_dynarray bda_image_handles;
 
    uint32_t group_handle_alloc;
+
+   /* Threads splitting up large buffer/image copies, shared by all queues. */
+   struct util_queue copy_queue;
 };
 
+static inline struct lvp_queue *
+lvp_device_queue(struct lvp_device *device, uint32_t index)
+{
+   return index ? &device->secondary_queues[index - 1] : &device->queue;
+}
+
 void lvp_device_get_cache_uuid(void *uuid);
 
+void lvp_device_init_copy_threads(struct lvp_device *device);
+void lvp_device_finish_copy_threads(struct lvp_device *device);
+void
+lvp_copy_box(struct lvp_device *device,
+             uint8_t *dst, enum pipe_format format,
+             unsigned dst_stride, uint64_t dst_layer_stride,
+             unsigned width, unsigned height, unsigned depth,
+             const uint8_t *src,
+             unsigned src_stride, uint64_t src_layer_stride);
+
 enum lvp_device_memory_type {
    LVP_DEVICE_MEMORY_TYPE_DEFAULT,
    LVP_DEVICE_MEMORY_TYPE_USER_PTR,
@@ -399,6 +445,9 @@ void
 lvp_descriptor_set_destroy(struct lvp_device *device,
                            struct lvp_descriptor_set *set);
 
+void
+lvp_descriptor_set_clear(struct lvp_descriptor_set *set);
+
 void
 lvp_descriptor_set_update_with_template(VkDevice _device, VkDescriptorSet descriptorSet,
                                         VkDescriptorUpdateTemplate descriptorUpdateTemplate,
@@ -454,6 +503,10 @@ struct lvp_shader {
    struct lvp_pipeline_nir *tess_ccw;
    void *shader_cso;
    void *tess_ccw_cso;
+   /* llvmpipe shader CSOs can't be shared between contexts, so the secondary
+    * queues compile their own on first use: [queue index - 1][tess_ccw].
+    */
+   void *queue_csos[LVP_MAX_QUEUES - 1][2];
    struct {
       uint32_t uniform_offsets[PIPE_MAX_CONSTANT_BUFFERS][MAX_INLINABLE_UNIFORMS];
       uint8_t count[PIPE_MAX_CONSTANT_BUFFERS];
@@ -541,7 +594,10 @@ struct lvp_pipeline {
    bool line_rectangular;
    bool library;
    bool compiled;
-   bool used;
+   /* Indexed by queue, each queue only sets its own entry. */
+   bool used[LVP_MAX_QUEUES];
+   /* Queues that still have to release a deferred destroy. */
+   uint32_t destroy_refs;
 
    struct {
       const char *name;
@@ -627,6 +683,10 @@ struct lvp_query_pool {
    };
    enum pipe_query_type base_type;
    void *data; /* Used by queries that are not implemented by pipe_query */
+   /* Context of the queue that last used each pipe_query, which has to
+    * flush it to get the result.
+    */
+   struct pipe_context **ctxs;
    struct pipe_query *queries[0];
 };
 
@@ -651,8 +711,28 @@ struct lvp_cmd_buffer {
    struct lvp_device *                          device;
 
    uint8_t push_constants[MAX_PUSH_CONSTANTS_SIZE];
+
+   /* Descriptor sets and buffer wrappers created while executing the
+    * command buffer.  Unless it was recorded for one-time submission they
+    * are kept until it is reset, and the next submission reuses them
+    * instead of creating new ones.
+    */
+   struct {
+      mtx_t lock;
+      bool enabled;
+      struct util_dynarray sets; /* struct lvp_descriptor_set * */
+      struct util_dynarray buffers; /* struct lvp_replay_buffer */
+   } replay;
 };
 
+struct lvp_replay_buffer {
+   const void *mem;
+   struct pipe_resource *pres;
+};
+
+void
+lvp_cmd_buffer_release_replay(struct lvp_cmd_buffer *cmd_buffer);
+
 struct lvp_indirect_command_layout_nv {
    struct vk_object_base base;
    uint8_t stream_count;
@@ -706,8 +786,6 @@ VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_event, base, VkEvent, VK_OBJECT_TYPE_EVENT)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_image, vk.base, VkImage, VK_OBJECT_TYPE_IMAGE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_image_view, vk.base, VkImageView,
                                VK_OBJECT_TYPE_IMAGE_VIEW);
-VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_pipeline_cache, base, VkPipelineCache,
-                               VK_OBJECT_TYPE_PIPELINE_CACHE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_pipeline, base, VkPipeline,
                                VK_OBJECT_TYPE_PIPELINE)
 VK_DEFINE_NONDISP_HANDLE_CASTS(lvp_shader, base, VkShaderEXT,
@@ -742,6 +820,8 @@ VkResult lvp_image_bind_sparse(struct lvp_device *device,
 VkResult lvp_execute_cmds(struct lvp_device *device,
                           struct lvp_queue *queue,
                           struct lvp_cmd_buffer *cmd_buffer);
+void
+lvp_queue_print_cmd_stats(struct lvp_queue *queue);
 size_t
 lvp_get_rendering_state_size(void);
 struct lvp_image *lvp_swapchain_get_image(VkSwapchainKHR swapchain,
@@ -810,6 +890,10 @@ void
 lvp_inline_uniforms(nir_shader *nir, const struct lvp_shader *shader, const uint32_t *uniform_values, uint32_t ubo);
 void *
 lvp_shader_compile(struct lvp_device *device, struct lvp_shader *shader, nir_shader *nir, bool locked);
+void *
+lvp_shader_queue_cso(struct lvp_queue *queue, struct lvp_shader *shader, bool tess_ccw);
+void
+lvp_shader_cso_destroy(struct pipe_context *ctx, gl_shader_stage stage, void *cso);
 bool
 lvp_nir_lower_ray_queries(struct nir_shader *shader);
 bool
@@ -83,6 +83,8 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateQueryPool(
    struct lvp_query_pool *pool;
    size_t pool_size = sizeof(*pool)
       + pCreateInfo->queryCount * query_size;
+   if (pipeq < PIPE_QUERY_TYPES)
+      pool_size += pCreateInfo->queryCount * sizeof(struct pipe_context *);
 
    pool = vk_zalloc2(&device->vk.alloc, pAllocator,
                     pool_size, 8,
@@ -100,6 +102,8 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_CreateQueryPool(
    else
       pool->pipeline_stats = pCreateInfo->pipelineStatistics;
    pool->data = &pool->queries;
+   if (pipeq < PIPE_QUERY_TYPES)
+      pool->ctxs = (struct pipe_context **)&pool->queries[pool->count];
 
    *pQueryPool = lvp_query_pool_to_handle(pool);
    return VK_SUCCESS;
@@ -119,7 +123,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_DestroyQueryPool(
    if (pool->base_type < PIPE_QUERY_TYPES) {
       for (unsigned i = 0; i < pool->count; i++)
          if (pool->queries[i])
-            device->queue.ctx->destroy_query(device->queue.ctx, pool->queries[i]);
+            pool->ctxs[i]->destroy_query(pool->ctxs[i], pool->queries[i]);
    }
    vk_object_base_finish(&pool->base);
    vk_free2(&device->vk.alloc, pAllocator, pool);
@@ -181,10 +185,10 @@ VKAPI_ATTR VkResult VKAPI_CALL lvp_GetQueryPoolResults(
       }
 
       if (pool->queries[i]) {
-         ready = device->queue.ctx->get_query_result(device->queue.ctx,
-                                                     pool->queries[i],
-                                                     (flags & VK_QUERY_RESULT_WAIT_BIT),
-                                                     &result);
+         ready = pool->ctxs[i]->get_query_result(pool->ctxs[i],
+                                                 pool->queries[i],
+                                                 (flags & VK_QUERY_RESULT_WAIT_BIT),
+                                                 &result);
       } else {
          result.u64 = 0;
       }
@@ -257,7 +261,6 @@ VKAPI_ATTR void VKAPI_CALL lvp_ResetQueryPool(
    uint32_t                                    firstQuery,
    uint32_t                                    queryCount)
 {
-   LVP_FROM_HANDLE(lvp_device, device, _device);
    LVP_FROM_HANDLE(lvp_query_pool, pool, queryPool);
 
    if (pool->base_type >= PIPE_QUERY_TYPES)
@@ -267,7 +270,7 @@ VKAPI_ATTR void VKAPI_CALL lvp_ResetQueryPool(
       uint32_t idx = i + firstQuery;
 
       if (pool->queries[idx]) {
-         device->queue.ctx->destroy_query(device->queue.ctx, pool->queries[idx]);
+         pool->ctxs[idx]->destroy_query(pool->ctxs[idx], pool->queries[idx]);
          pool->queries[idx] = NULL;
       }
    }
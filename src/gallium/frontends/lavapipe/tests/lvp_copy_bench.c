@@ -0,0 +1,290 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Upload/readback bandwidth benchmark for lavapipe.
+ *
+ * Copies a host visible buffer into an RGBA8 image and back with
+ * vkCmdCopyBufferToImage/vkCmdCopyImageToBuffer, and reports the bandwidth
+ * of each direction for a few image sizes.  It talks to the driver through
+ * vk_icdGetInstanceProcAddr, without a loader.
+ *
+ * Usage: lvp_copy_bench [size...]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <vulkan/vulkan.h>
+#include <vulkan/vk_icd.h>
+
+#include "util/macros.h"
+#include "util/os_time.h"
+
+#define CHECK(x) do { \
+   VkResult _r = (x); \
+   if (_r != VK_SUCCESS) { \
+      fprintf(stderr, "%s failed: %d\n", #x, _r); \
+      exit(EXIT_FAILURE); \
+   } \
+} while (0)
+
+#define FUNCS(F) \
+   F(DestroyInstance) \
+   F(EnumeratePhysicalDevices) \
+   F(GetPhysicalDeviceMemoryProperties) \
+   F(CreateDevice) \
+   F(DestroyDevice) \
+   F(GetDeviceQueue) \
+   F(CreateBuffer) \
+   F(DestroyBuffer) \
+   F(GetBufferMemoryRequirements) \
+   F(BindBufferMemory) \
+   F(CreateImage) \
+   F(DestroyImage) \
+   F(GetImageMemoryRequirements) \
+   F(BindImageMemory) \
+   F(AllocateMemory) \
+   F(FreeMemory) \
+   F(MapMemory) \
+   F(CreateCommandPool) \
+   F(DestroyCommandPool) \
+   F(AllocateCommandBuffers) \
+   F(BeginCommandBuffer) \
+   F(EndCommandBuffer) \
+   F(CmdPipelineBarrier) \
+   F(CmdCopyBufferToImage) \
+   F(CmdCopyImageToBuffer) \
+   F(QueueSubmit) \
+   F(QueueWaitIdle)
+
+#define DECLARE(name) static PFN_vk##name name;
+FUNCS(DECLARE)
+
+struct bench {
+   VkInstance instance;
+   VkPhysicalDevice physical_device;
+   VkDevice device;
+   VkQueue queue;
+   VkCommandPool pool;
+   VkPhysicalDeviceMemoryProperties mem_props;
+};
+
+static uint32_t
+find_memory_type(struct bench *b, uint32_t type_bits, VkMemoryPropertyFlags flags)
+{
+   for (uint32_t i = 0; i < b->mem_props.memoryTypeCount; i++) {
+      if ((type_bits & (1u << i)) &&
+          (b->mem_props.memoryTypes[i].propertyFlags & flags) == flags)
+         return i;
+   }
+   fprintf(stderr, "no suitable memory type\n");
+   exit(EXIT_FAILURE);
+}
+
+static VkDeviceMemory
+allocate(struct bench *b, VkMemoryRequirements *reqs, VkMemoryPropertyFlags flags)
+{
+   VkMemoryAllocateInfo info = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO,
+      .allocationSize = reqs->size,
+      .memoryTypeIndex = find_memory_type(b, reqs->memoryTypeBits, flags),
+   };
+   VkDeviceMemory mem;
+   CHECK(AllocateMemory(b->device, &info, NULL, &mem));
+   return mem;
+}
+
+static void
+init(struct bench *b)
+{
+   PFN_vkCreateInstance CreateInstance = (PFN_vkCreateInstance)
+      vk_icdGetInstanceProcAddr(NULL, "vkCreateInstance");
+   VkApplicationInfo app = {
+      .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO,
+      .apiVersion = VK_API_VERSION_1_3,
+   };
+   VkInstanceCreateInfo instance_info = {
+      .sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
+      .pApplicationInfo = &app,
+   };
+   CHECK(CreateInstance(&instance_info, NULL, &b->instance));
+
+#define LOAD(name) \
+   name = (PFN_vk##name)vk_icdGetInstanceProcAddr(b->instance, "vk" #name);
+   FUNCS(LOAD)
+#undef LOAD
+
+   uint32_t count = 1;
+   EnumeratePhysicalDevices(b->instance, &count, &b->physical_device);
+   GetPhysicalDeviceMemoryProperties(b->physical_device, &b->mem_props);
+
+   const float priority = 1.0f;
+   VkDeviceQueueCreateInfo queue_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO,
+      .queueCount = 1,
+      .pQueuePriorities = &priority,
+   };
+   VkDeviceCreateInfo device_info = {
+      .sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
+      .queueCreateInfoCount = 1,
+      .pQueueCreateInfos = &queue_info,
+   };
+   CHECK(CreateDevice(b->physical_device, &device_info, NULL, &b->device));
+   GetDeviceQueue(b->device, 0, 0, &b->queue);
+
+   VkCommandPoolCreateInfo pool_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO,
+   };
+   CHECK(CreateCommandPool(b->device, &pool_info, NULL, &b->pool));
+}
+
+static void
+barrier(VkCommandBuffer cmd, VkImage image, VkImageLayout old_layout,
+        VkImageLayout new_layout)
+{
+   VkImageMemoryBarrier image_barrier = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER,
+      .srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
+      .dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT,
+      .oldLayout = old_layout,
+      .newLayout = new_layout,
+      .image = image,
+      .subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 1, 0, 1 },
+   };
+   CmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+                      VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, NULL, 0, NULL,
+                      1, &image_barrier);
+}
+
+/* Returns the bandwidth in GB/s of iterations copies in one direction. */
+static double
+run(struct bench *b, VkBuffer buffer, VkImage image, unsigned size,
+    unsigned iterations, bool upload)
+{
+   VkCommandBufferAllocateInfo alloc_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO,
+      .commandPool = b->pool,
+      .level = VK_COMMAND_BUFFER_LEVEL_PRIMARY,
+      .commandBufferCount = 1,
+   };
+   VkCommandBuffer cmd;
+   CHECK(AllocateCommandBuffers(b->device, &alloc_info, &cmd));
+
+   VkCommandBufferBeginInfo begin_info = {
+      .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO,
+   };
+   CHECK(BeginCommandBuffer(cmd, &begin_info));
+
+   const VkBufferImageCopy region = {
+      .imageSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, 0, 0, 1 },
+      .imageExtent = { size, size, 1 },
+   };
+   for (unsigned i = 0; i < iterations; i++) {
+      if (upload) {
+         CmdCopyBufferToImage(cmd, buffer, image, VK_IMAGE_LAYOUT_GENERAL,
+                              1, &region);
+      } else {
+         CmdCopyImageToBuffer(cmd, image, VK_IMAGE_LAYOUT_GENERAL, buffer,
+                              1, &region);
+      }
+      barrier(cmd, image, VK_IMAGE_LAYOUT_GENERAL, VK_IMAGE_LAYOUT_GENERAL);
+   }
+   CHECK(EndCommandBuffer(cmd));
+
+   VkSubmitInfo submit = {
+      .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
+      .commandBufferCount = 1,
+      .pCommandBuffers = &cmd,
+   };
+
+   /* warm up */
+   CHECK(QueueSubmit(b->queue, 1, &submit, VK_NULL_HANDLE));
+   CHECK(QueueWaitIdle(b->queue));
+
+   int64_t start = os_time_get_nano();
+   CHECK(QueueSubmit(b->queue, 1, &submit, VK_NULL_HANDLE));
+   CHECK(QueueWaitIdle(b->queue));
+   int64_t end = os_time_get_nano();
+
+   return (double)size * size * 4 * iterations / (end - start);
+}
+
+static void
+bench_size(struct bench *b, unsigned size)
+{
+   const VkDeviceSize bytes = (VkDeviceSize)size * size * 4;
+   const unsigned iterations = MAX2(1, (256u << 20) / bytes);
+
+   VkBufferCreateInfo buffer_info = {
+      .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO,
+      .size = bytes,
+      .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+   };
+   VkBuffer buffer;
+   CHECK(CreateBuffer(b->device, &buffer_info, NULL, &buffer));
+
+   VkMemoryRequirements reqs;
+   GetBufferMemoryRequirements(b->device, buffer, &reqs);
+   VkDeviceMemory buffer_mem =
+      allocate(b, &reqs, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT);
+   CHECK(BindBufferMemory(b->device, buffer, buffer_mem, 0));
+
+   void *map;
+   CHECK(MapMemory(b->device, buffer_mem, 0, bytes, 0, &map));
+   memset(map, 0x5a, bytes);
+
+   VkImageCreateInfo image_info = {
+      .sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+      .imageType = VK_IMAGE_TYPE_2D,
+      .format = VK_FORMAT_R8G8B8A8_UNORM,
+      .extent = { size, size, 1 },
+      .mipLevels = 1,
+      .arrayLayers = 1,
+      .samples = VK_SAMPLE_COUNT_1_BIT,
+      .tiling = VK_IMAGE_TILING_LINEAR,
+      .usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT,
+      .initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+   };
+   VkImage image;
+   CHECK(CreateImage(b->device, &image_info, NULL, &image));
+   GetImageMemoryRequirements(b->device, image, &reqs);
+   VkDeviceMemory image_mem = allocate(b, &reqs, 0);
+   CHECK(BindImageMemory(b->device, image, image_mem, 0));
+
+   const double upload = run(b, buffer, image, size, iterations, true);
+   const double readback = run(b, buffer, image, size, iterations, false);
+
+   printf("%5ux%-5u  upload %6.2f GB/s  readback %6.2f GB/s\n",
+          size, size, upload, readback);
+
+   DestroyImage(b->device, image, NULL);
+   FreeMemory(b->device, image_mem, NULL);
+   DestroyBuffer(b->device, buffer, NULL);
+   FreeMemory(b->device, buffer_mem, NULL);
+}
+
+int
+main(int argc, char **argv)
+{
+   static const unsigned default_sizes[] = { 256, 1024, 4096 };
+   struct bench b = { 0 };
+
+   init(&b);
+
+   if (argc > 1) {
+      for (int i = 1; i < argc; i++)
+         bench_size(&b, atoi(argv[i]));
+   } else {
+      for (unsigned i = 0; i < ARRAY_SIZE(default_sizes); i++)
+         bench_size(&b, default_sizes[i]);
+   }
+
+   DestroyCommandPool(b.device, b.pool, NULL);
+   DestroyDevice(b.device, NULL);
+   DestroyInstance(b.instance, NULL);
+
+   return EXIT_SUCCESS;
+}
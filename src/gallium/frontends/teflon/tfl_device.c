@@ -445,14 +445,23 @@ __attribute__((visibility("default"))) TfLiteDelegate *tflite_plugin_create_dele
    devs = (struct pipe_loader_device **)malloc(sizeof(*devs) * n);
    pipe_loader_probe(devs, n, false);
 
+   /* Prefer the NPU, and fall back to running the graphs on the CPU. */
+   struct pipe_loader_device *sw_dev = NULL;
    for (int i = 0; i < n; i++) {
       if (strstr("etnaviv", devs[i]->driver_name))
          delegate->dev = devs[i];
+      else if (devs[i]->type == PIPE_LOADER_DEVICE_SOFTWARE && !sw_dev)
+         sw_dev = devs[i];
       else
          pipe_loader_release(&devs[i], 1);
    }
    free(devs);
 
+   if (delegate->dev == NULL)
+      delegate->dev = sw_dev;
+   else if (sw_dev)
+      pipe_loader_release(&sw_dev, 1);
+
    if (delegate->dev == NULL) {
       fprintf(stderr, "Couldn't open kernel device\n");
       return NULL;
@@ -463,6 +472,16 @@ __attribute__((visibility("default"))) TfLiteDelegate *tflite_plugin_create_dele
    screen = pipe_loader_create_screen(delegate->dev, false);
    delegate->context = screen->context_create(screen, NULL, PIPE_CONTEXT_COMPUTE_ONLY);
 
+   if (delegate->context == NULL || delegate->context->ml_subgraph_create == NULL) {
+      fprintf(stderr, "%s driver can't run ML subgraphs\n", delegate->dev->driver_name);
+      if (delegate->context)
+         delegate->context->destroy(delegate->context);
+      screen->destroy(screen);
+      pipe_loader_release(&delegate->dev, 1);
+      free(delegate);
+      return NULL;
+   }
+
    return &delegate->base;
 }
 
@@ -620,6 +620,166 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return buf;
 }
 
+struct disk_cache_prefetch_job {
+   struct util_queue_fence fence;
+   struct disk_cache *cache;
+   unsigned num_keys;
+   cache_key keys[];
+};
+
+static void
+cache_prefetch(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache_prefetch_job *pf_job =
+      (struct disk_cache_prefetch_job *) job;
+   struct disk_cache *cache = pf_job->cache;
+
+   for (unsigned i = 0; i < pf_job->num_keys; i++) {
+      char *filename = disk_cache_get_cache_filename(cache, pf_job->keys[i]);
+      if (filename) {
+         disk_cache_readahead_item(filename);
+         free(filename);
+      }
+   }
+}
+
+static void
+destroy_prefetch_job(void *job, void *gdata, int thread_index)
+{
+   free(job);
+}
+
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+   /* Only the multi-file cache keeps one file per item. The single file and
+    * database caches read from files that are already mapped or hot, and the
+    * blob callbacks give us nothing to prefetch.
+    */
+   if (cache->type != DISK_CACHE_MULTI_FILE || cache->blob_get_cb ||
+       cache->path_init_failed || num_keys == 0)
+      return;
+
+   if (!util_queue_is_initialized(&cache->cache_queue))
+      return;
+
+   struct disk_cache_prefetch_job *pf_job =
+      malloc(sizeof(*pf_job) + num_keys * sizeof(cache_key));
+   if (!pf_job)
+      return;
+
+   pf_job->cache = cache;
+   pf_job->num_keys = num_keys;
+   memcpy(pf_job->keys, keys, num_keys * sizeof(cache_key));
+
+   util_queue_fence_init(&pf_job->fence);
+   util_queue_add_job(&cache->cache_queue, pf_job, &pf_job->fence,
+                      cache_prefetch, destroy_prefetch_job, 0);
+}
+
+struct disk_cache_get_many_batch;
+
+struct disk_cache_get_job {
+   struct util_queue_fence fence;
+   struct disk_cache_get_many_batch *batch;
+   unsigned index;
+   cache_key key;
+};
+
+struct disk_cache_get_many_batch {
+   struct disk_cache *cache;
+   disk_cache_get_many_cb cb;
+   void *cb_data;
+   struct util_queue_fence *fence;
+   unsigned remaining;
+   struct disk_cache_get_job jobs[];
+};
+
+static void
+cache_get(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache_get_job *get_job = (struct disk_cache_get_job *) job;
+   struct disk_cache_get_many_batch *batch = get_job->batch;
+   size_t size;
+
+   void *data = disk_cache_get(batch->cache, get_job->key, &size);
+   batch->cb(batch->cb_data, get_job->index, data, size);
+}
+
+static void
+destroy_get_job(void *job, void *gdata, int thread_index)
+{
+   struct disk_cache_get_job *get_job = (struct disk_cache_get_job *) job;
+   struct disk_cache_get_many_batch *batch = get_job->batch;
+
+   /* The queue signals each job's own fence before running its cleanup, so
+    * the last job out can release the whole batch.
+    */
+   if (p_atomic_dec_zero(&batch->remaining)) {
+      struct util_queue_fence *fence = batch->fence;
+      free(batch);
+      util_queue_fence_signal(fence);
+   }
+}
+
+void
+disk_cache_get_many(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys, disk_cache_get_many_cb cb,
+                    void *cb_data, struct util_queue_fence *fence)
+{
+   struct disk_cache_get_many_batch *batch = NULL;
+
+   if (num_keys == 0)
+      return;
+
+   if (util_queue_is_initialized(&cache->cache_queue)) {
+      batch = malloc(sizeof(*batch) +
+                     num_keys * sizeof(struct disk_cache_get_job));
+   }
+
+   /* No worker threads to hand the lookups to, do them here. */
+   if (!batch) {
+      for (unsigned i = 0; i < num_keys; i++) {
+         size_t size;
+         void *data = disk_cache_get(cache, keys[i], &size);
+         cb(cb_data, i, data, size);
+      }
+      return;
+   }
+
+   batch->cache = cache;
+   batch->cb = cb;
+   batch->cb_data = cb_data;
+   batch->fence = fence;
+   batch->remaining = num_keys;
+
+   util_queue_fence_reset(fence);
+
+   /* Get the reads for the whole batch going before the first lookup blocks
+    * on them.
+    */
+   if (num_keys > 1)
+      disk_cache_prefetch(cache, keys, num_keys);
+
+   for (unsigned i = 0; i < num_keys; i++) {
+      struct disk_cache_get_job *get_job = &batch->jobs[i];
+
+      get_job->batch = batch;
+      get_job->index = i;
+      memcpy(get_job->key, keys[i], sizeof(cache_key));
+      util_queue_fence_init(&get_job->fence);
+   }
+
+   /* The batch may be freed by the workers as soon as the last job is
+    * queued, so don't touch it once the loop is done.
+    */
+   for (unsigned i = 0; i < num_keys; i++) {
+      util_queue_add_job(&cache->cache_queue, &batch->jobs[i],
+                         &batch->jobs[i].fence, cache_get, destroy_get_job, 0);
+   }
+}
+
 void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -49,6 +49,8 @@ extern "C" {
 
 typedef uint8_t cache_key[CACHE_KEY_SIZE];
 
+struct util_queue_fence;
+
 /* WARNING: 3rd party applications might be reading the cache item metadata.
  * Do not change these values without making the change widely known.
  * Please contact Valve developers and make them aware of this change.
@@ -64,6 +66,18 @@ typedef signed long
 (*disk_cache_get_cb) (const void *key, signed long keySize,
                       void *value, signed long valueSize);
 
+/**
+ * Callback for disk_cache_get_many(), called once for each key.
+ *
+ * \index is the position of the key in the array passed to
+ * disk_cache_get_many(). \data is NULL if the item was not found, otherwise
+ * it is malloc'ed and owned by the callback. The callback may be invoked from
+ * any of the cache's worker threads, and concurrently for different keys.
+ */
+typedef void
+(*disk_cache_get_many_cb) (void *cb_data, unsigned index,
+                           void *data, size_t size);
+
 struct cache_item_metadata {
    /**
     * The cache item type. This could be used to identify a GLSL cache item,
@@ -229,6 +243,31 @@ disk_cache_put_nocopy(struct disk_cache *cache, const cache_key key,
 void *
 disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size);
 
+/**
+ * Retrieve several items from the cache at once.
+ *
+ * The lookups (file reads, decompression and validation) are performed on the
+ * cache's worker threads and each result is handed to \cb as soon as it is
+ * ready. \fence must have been initialized with util_queue_fence_init() and
+ * be signalled; it is reset on entry and signalled once \cb has been called
+ * for every key. The \keys array may be released as soon as this returns.
+ */
+void
+disk_cache_get_many(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys, disk_cache_get_many_cb cb,
+                    void *cb_data, struct util_queue_fence *fence);
+
+/**
+ * Hint that the items named by \keys will be retrieved soon.
+ *
+ * This asynchronously asks the OS to start reading the backing files so
+ * that a later disk_cache_get() does not block on I/O. Nothing is
+ * decompressed or returned.
+ */
+void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys);
+
 /**
  * Store the name \key within the cache, (without any associated data).
  *
@@ -304,6 +343,21 @@ disk_cache_get(struct disk_cache *cache, const cache_key key, size_t *size)
    return NULL;
 }
 
+static inline void
+disk_cache_get_many(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys, disk_cache_get_many_cb cb,
+                    void *cb_data, struct util_queue_fence *fence)
+{
+   for (unsigned i = 0; i < num_keys; i++)
+      cb(cb_data, i, NULL, 0);
+}
+
+static inline void
+disk_cache_prefetch(struct disk_cache *cache, const cache_key *keys,
+                    unsigned num_keys)
+{
+}
+
 static inline void
 disk_cache_put_key(struct disk_cache *cache, const cache_key key)
 {
@@ -667,6 +667,29 @@ disk_cache_load_item(struct disk_cache *cache, char *filename, size_t *size)
    return NULL;
 }
 
+/* Ask the kernel to start pulling the cache item 'filename' into the page
+ * cache without waiting for it, so that a later disk_cache_load_item() of
+ * the same file doesn't stall on I/O. Missing files are silently ignored.
+ */
+void
+disk_cache_readahead_item(const char *filename)
+{
+   int fd = open(filename, O_RDONLY | O_CLOEXEC);
+   if (fd == -1)
+      return;
+
+   struct stat sb;
+   if (fstat(fd, &sb) == 0 && sb.st_size > 0) {
+#if DETECT_OS_LINUX
+      readahead(fd, 0, sb.st_size);
+#elif defined(POSIX_FADV_WILLNEED)
+      posix_fadvise(fd, 0, sb.st_size, POSIX_FADV_WILLNEED);
+#endif
+   }
+
+   close(fd);
+}
+
 /* Return a filename within the cache's directory corresponding to 'key'.
  *
  * Returns NULL if out of memory.
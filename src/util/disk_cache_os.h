@@ -145,6 +145,9 @@ disk_cache_load_item_foz(struct disk_cache *cache, const cache_key key,
 void *
 disk_cache_load_item(struct disk_cache *cache, char *filename, size_t *size);
 
+void
+disk_cache_readahead_item(const char *filename);
+
 char *
 disk_cache_get_cache_filename(struct disk_cache *cache, const cache_key key);
 
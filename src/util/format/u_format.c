@@ -36,6 +36,7 @@
 #include "util/detect_arch.h"
 #include "util/format/u_format.h"
 #include "util/format/u_format_s3tc.h"
+#include "util/u_cpu_detect.h"
 #include "util/u_math.h"
 
 /**
@@ -1220,6 +1221,13 @@ static const struct util_format_unpack_description *util_format_unpack_table[PIP
 static void
 util_format_unpack_table_init(void)
 {
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && !defined(NO_FORMAT_ASM)
+   /* Not in the ISA specific files, which the compiler may use the
+    * instructions in before the check.
+    */
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+#endif
+
    for (enum pipe_format format = PIPE_FORMAT_NONE; format < PIPE_FORMAT_COUNT; format++) {
 #if (DETECT_ARCH_AARCH64 || DETECT_ARCH_ARM) && !defined(NO_FORMAT_ASM) && !defined(__SOFTFP__)
       const struct util_format_unpack_description *unpack = util_format_unpack_description_neon(format);
@@ -1229,6 +1237,22 @@ util_format_unpack_table_init(void)
       }
 #endif
 
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && !defined(NO_FORMAT_ASM)
+      const struct util_format_unpack_description *unpack = NULL;
+#if defined(HAVE_FORMAT_AVX2)
+      if (caps->has_avx2 && caps->has_f16c)
+         unpack = util_format_unpack_description_avx2(format);
+#endif
+#if defined(USE_SSE41)
+      if (!unpack && caps->has_sse4_1)
+         unpack = util_format_unpack_description_sse41(format);
+#endif
+      if (unpack) {
+         util_format_unpack_table[format] = unpack;
+         continue;
+      }
+#endif
+
       util_format_unpack_table[format] = util_format_unpack_description_generic(format);
    }
 }
@@ -1242,6 +1266,48 @@ util_format_unpack_description(enum pipe_format format)
    return util_format_unpack_table[format];
 }
 
+static const struct util_format_pack_description *util_format_pack_table[PIPE_FORMAT_COUNT];
+
+static void
+util_format_pack_table_init(void)
+{
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && !defined(NO_FORMAT_ASM)
+   /* Not in the ISA specific files, which the compiler may use the
+    * instructions in before the check.
+    */
+   const struct util_cpu_caps_t *caps = util_get_cpu_caps();
+#endif
+
+   for (enum pipe_format format = PIPE_FORMAT_NONE; format < PIPE_FORMAT_COUNT; format++) {
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && !defined(NO_FORMAT_ASM)
+      const struct util_format_pack_description *pack = NULL;
+#if defined(HAVE_FORMAT_AVX2)
+      if (caps->has_avx2 && caps->has_f16c)
+         pack = util_format_pack_description_avx2(format);
+#endif
+#if defined(USE_SSE41)
+      if (!pack && caps->has_sse4_1)
+         pack = util_format_pack_description_sse41(format);
+#endif
+      if (pack) {
+         util_format_pack_table[format] = pack;
+         continue;
+      }
+#endif
+
+      util_format_pack_table[format] = util_format_pack_description_generic(format);
+   }
+}
+
+const struct util_format_pack_description *
+util_format_pack_description(enum pipe_format format)
+{
+   static once_flag flag = ONCE_FLAG_INIT;
+   call_once(&flag, util_format_pack_table_init);
+
+   return util_format_pack_table[format];
+}
+
 enum pipe_format
 util_format_snorm_to_unorm(enum pipe_format format)
 {
@@ -0,0 +1,285 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * AVX2 pack/unpack kernels for the most common color formats.
+ *
+ * These cover the formats where 8 pixels at a time pay off over the SSE4.1
+ * kernels, plus half-float formats, which need F16C.  Like those, they
+ * produce exactly the same results as the generated code and leave the
+ * remainder of each row to it.
+ */
+
+#include "util/detect_arch.h"
+#include "util/format/u_format.h"
+
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && defined(HAVE_FORMAT_AVX2) && !defined(NO_FORMAT_ASM)
+
+#include <immintrin.h>
+#include "u_format_pack.h"
+#include "u_format_x86.h"
+
+static inline __m256i
+unpack_shuffle(int r, int g, int b, int a)
+{
+   uint8_t shuffle[16];
+   u_format_x86_unpack_shuffle(shuffle, r, g, b, a);
+   return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)shuffle));
+}
+
+static inline __m256i
+pack_shuffle(int r, int g, int b, int a)
+{
+   uint8_t shuffle[16];
+   u_format_x86_pack_shuffle(shuffle, r, g, b, a);
+   return _mm256_broadcastsi128_si256(_mm_loadu_si128((const __m128i *)shuffle));
+}
+
+/* Same as float_to_ubyte(), for the eight floats of v. */
+static inline __m256i
+float_to_ubyte_avx2(__m256 v)
+{
+   v = _mm256_min_ps(_mm256_max_ps(v, _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+   v = _mm256_add_ps(_mm256_mul_ps(v, _mm256_set1_ps(255.0f / 256.0f)),
+                     _mm256_set1_ps(32768.0f));
+   return _mm256_and_si256(_mm256_castps_si256(v), _mm256_set1_epi32(0xff));
+}
+
+static inline __m256
+ubyte_to_float_avx2(__m128i v)
+{
+   return _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu8_epi32(v)),
+                        _mm256_set1_ps(1.0f / 255.0f));
+}
+
+
+/*
+ * 8-bit RGBA formats
+ */
+
+static inline void
+unpack_rgba8_8unorm(uint8_t *restrict dst, const uint8_t *restrict src,
+                    unsigned width, int r, int g, int b, int a)
+{
+   const __m256i shuffle = unpack_shuffle(r, g, b, a);
+   const __m256i alpha = _mm256_set1_epi32(a < 0 ? 0xff000000 : 0);
+
+   for (unsigned x = 0; x < width; x += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+      v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha);
+      _mm256_storeu_si256((__m256i *)(dst + x * 4), v);
+   }
+}
+
+static inline void
+unpack_rgba8_float(float *restrict dst, const uint8_t *restrict src,
+                   unsigned width, int r, int g, int b, int a)
+{
+   const __m256i shuffle = unpack_shuffle(r, g, b, a);
+   const __m256i alpha = _mm256_set1_epi32(a < 0 ? 0xff000000 : 0);
+
+   for (unsigned x = 0; x < width; x += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+      v = _mm256_or_si256(_mm256_shuffle_epi8(v, shuffle), alpha);
+
+      const __m128i lo = _mm256_castsi256_si128(v);
+      const __m128i hi = _mm256_extracti128_si256(v, 1);
+      _mm256_storeu_ps(dst + x * 4 + 0, ubyte_to_float_avx2(lo));
+      _mm256_storeu_ps(dst + x * 4 + 8, ubyte_to_float_avx2(_mm_srli_si128(lo, 8)));
+      _mm256_storeu_ps(dst + x * 4 + 16, ubyte_to_float_avx2(hi));
+      _mm256_storeu_ps(dst + x * 4 + 24, ubyte_to_float_avx2(_mm_srli_si128(hi, 8)));
+   }
+}
+
+static inline void
+pack_rgba8_8unorm(uint8_t *restrict dst, const uint8_t *restrict src,
+                  unsigned width, int r, int g, int b, int a)
+{
+   const __m256i shuffle = pack_shuffle(r, g, b, a);
+
+   for (unsigned x = 0; x < width; x += 8) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + x * 4));
+      _mm256_storeu_si256((__m256i *)(dst + x * 4), _mm256_shuffle_epi8(v, shuffle));
+   }
+}
+
+static inline void
+pack_rgba8_float(uint8_t *restrict dst, const float *restrict src,
+                 unsigned width, int r, int g, int b, int a)
+{
+   const __m256i shuffle = pack_shuffle(r, g, b, a);
+   /* Packing works within 128-bit lanes, which leaves the even pixels in
+    * the low lane and the odd ones in the high lane.
+    */
+   const __m256i order = _mm256_setr_epi32(0, 4, 1, 5, 2, 6, 3, 7);
+
+   for (unsigned x = 0; x < width; x += 8) {
+      const float *s = src + x * 4;
+      __m256i p01 = float_to_ubyte_avx2(_mm256_loadu_ps(s + 0));
+      __m256i p23 = float_to_ubyte_avx2(_mm256_loadu_ps(s + 8));
+      __m256i p45 = float_to_ubyte_avx2(_mm256_loadu_ps(s + 16));
+      __m256i p67 = float_to_ubyte_avx2(_mm256_loadu_ps(s + 24));
+      __m256i v = _mm256_packus_epi16(_mm256_packus_epi32(p01, p23),
+                                      _mm256_packus_epi32(p45, p67));
+      v = _mm256_permutevar8x32_epi32(v, order);
+      _mm256_storeu_si256((__m256i *)(dst + x * 4), _mm256_shuffle_epi8(v, shuffle));
+   }
+}
+
+#define RGBA8_FUNCS(FORMAT, format, r, g, b, a) \
+static void \
+util_format_##format##_unpack_rgba_8unorm_avx2(uint8_t *restrict dst, \
+                                               const uint8_t *restrict src, \
+                                               unsigned width) \
+{ \
+   const unsigned n = width & ~7; \
+   unpack_rgba8_8unorm(dst, src, n, r, g, b, a); \
+   if (n < width) \
+      util_format_##format##_unpack_rgba_8unorm(dst + n * 4, src + n * 4, width - n); \
+} \
+\
+static void \
+util_format_##format##_unpack_rgba_float_avx2(void *restrict dst, \
+                                              const uint8_t *restrict src, \
+                                              unsigned width) \
+{ \
+   const unsigned n = width & ~7; \
+   unpack_rgba8_float(dst, src, n, r, g, b, a); \
+   if (n < width) \
+      util_format_##format##_unpack_rgba_float((float *)dst + n * 4, src + n * 4, width - n); \
+} \
+\
+static void \
+util_format_##format##_pack_rgba_8unorm_avx2(uint8_t *restrict dst, unsigned dst_stride, \
+                                             const uint8_t *restrict src, unsigned src_stride, \
+                                             unsigned width, unsigned height) \
+{ \
+   const unsigned n = width & ~7; \
+   for (unsigned y = 0; y < height; y++) { \
+      pack_rgba8_8unorm(dst, src, n, r, g, b, a); \
+      if (n < width) \
+         util_format_##format##_pack_rgba_8unorm(dst + n * 4, 0, src + n * 4, 0, width - n, 1); \
+      dst += dst_stride; \
+      src += src_stride; \
+   } \
+} \
+\
+static void \
+util_format_##format##_pack_rgba_float_avx2(uint8_t *restrict dst, unsigned dst_stride, \
+                                            const float *restrict src, unsigned src_stride, \
+                                            unsigned width, unsigned height) \
+{ \
+   const unsigned n = width & ~7; \
+   for (unsigned y = 0; y < height; y++) { \
+      pack_rgba8_float(dst, src, n, r, g, b, a); \
+      if (n < width) \
+         util_format_##format##_pack_rgba_float(dst + n * 4, 0, src + n * 4, 0, width - n, 1); \
+      dst += dst_stride; \
+      src += src_stride / sizeof(*src); \
+   } \
+}
+
+U_FORMAT_X86_RGBA8_FORMATS(RGBA8_FUNCS)
+
+
+/*
+ * Half-float formats
+ */
+
+static void
+util_format_r16g16b16a16_float_unpack_rgba_float_avx2(void *restrict dst_row,
+                                                      const uint8_t *restrict src,
+                                                      unsigned width)
+{
+   const unsigned n = width & ~3;
+   float *dst = dst_row;
+
+   for (unsigned x = 0; x < n; x += 4) {
+      __m256i v = _mm256_loadu_si256((const __m256i *)(src + x * 8));
+      _mm256_storeu_ps(dst + x * 4 + 0, _mm256_cvtph_ps(_mm256_castsi256_si128(v)));
+      _mm256_storeu_ps(dst + x * 4 + 8, _mm256_cvtph_ps(_mm256_extracti128_si256(v, 1)));
+   }
+
+   if (n < width)
+      util_format_r16g16b16a16_float_unpack_rgba_float(dst + n * 4, src + n * 8, width - n);
+}
+
+static void
+util_format_r16g16b16a16_float_pack_rgba_float_avx2(uint8_t *restrict dst, unsigned dst_stride,
+                                                    const float *restrict src, unsigned src_stride,
+                                                    unsigned width, unsigned height)
+{
+   const unsigned n = width & ~3;
+
+   for (unsigned y = 0; y < height; y++) {
+      for (unsigned x = 0; x < n; x += 4) {
+         /* Round towards zero, like _mesa_float_to_float16_rtz(). */
+         __m128i lo = _mm256_cvtps_ph(_mm256_loadu_ps(src + x * 4 + 0), _MM_FROUND_TO_ZERO);
+         __m128i hi = _mm256_cvtps_ph(_mm256_loadu_ps(src + x * 4 + 8), _MM_FROUND_TO_ZERO);
+         _mm256_storeu_si256((__m256i *)(dst + x * 8), _mm256_set_m128i(hi, lo));
+      }
+      if (n < width)
+         util_format_r16g16b16a16_float_pack_rgba_float(dst + n * 8, 0, src + n * 4, 0, width - n, 1);
+      dst += dst_stride;
+      src += src_stride / sizeof(*src);
+   }
+}
+
+
+#define RGBA8_UNPACK_DESC(FORMAT, format, r, g, b, a) \
+   [PIPE_FORMAT_##FORMAT] = { \
+      .unpack_rgba_8unorm = &util_format_##format##_unpack_rgba_8unorm_avx2, \
+      .unpack_rgba = &util_format_##format##_unpack_rgba_float_avx2, \
+   },
+
+static const struct util_format_unpack_description util_format_unpack_descriptions_avx2[] = {
+   U_FORMAT_X86_RGBA8_FORMATS(RGBA8_UNPACK_DESC)
+
+   [PIPE_FORMAT_R16G16B16A16_FLOAT] = {
+      .unpack_rgba_8unorm = &util_format_r16g16b16a16_float_unpack_rgba_8unorm,
+      .unpack_rgba = &util_format_r16g16b16a16_float_unpack_rgba_float_avx2,
+   },
+};
+
+#define RGBA8_PACK_DESC(FORMAT, format, r, g, b, a) \
+   [PIPE_FORMAT_##FORMAT] = { \
+      .pack_rgba_8unorm = &util_format_##format##_pack_rgba_8unorm_avx2, \
+      .pack_rgba_float = &util_format_##format##_pack_rgba_float_avx2, \
+   },
+
+static const struct util_format_pack_description util_format_pack_descriptions_avx2[] = {
+   U_FORMAT_X86_RGBA8_FORMATS(RGBA8_PACK_DESC)
+
+   [PIPE_FORMAT_R16G16B16A16_FLOAT] = {
+      .pack_rgba_8unorm = &util_format_r16g16b16a16_float_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r16g16b16a16_float_pack_rgba_float_avx2,
+   },
+};
+
+const struct util_format_unpack_description *
+util_format_unpack_description_avx2(enum pipe_format format)
+{
+   if (format >= ARRAY_SIZE(util_format_unpack_descriptions_avx2))
+      return NULL;
+
+   if (!util_format_unpack_descriptions_avx2[format].unpack_rgba)
+      return NULL;
+
+   return &util_format_unpack_descriptions_avx2[format];
+}
+
+const struct util_format_pack_description *
+util_format_pack_description_avx2(enum pipe_format format)
+{
+   if (format >= ARRAY_SIZE(util_format_pack_descriptions_avx2))
+      return NULL;
+
+   if (!util_format_pack_descriptions_avx2[format].pack_rgba_float)
+      return NULL;
+
+   return &util_format_pack_descriptions_avx2[format];
+}
+
+#endif /* (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && HAVE_FORMAT_AVX2 */
@@ -0,0 +1,380 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * SSE4.1 pack/unpack kernels for the most common color formats.
+ *
+ * These produce exactly the same results as the generated code, four pixels
+ * at a time, and leave the remainder of each row to it.
+ */
+
+#include "util/detect_arch.h"
+#include "util/format/u_format.h"
+
+#if (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && defined(USE_SSE41) && !defined(NO_FORMAT_ASM)
+
+#include <smmintrin.h>
+#include "u_format_pack.h"
+#include "u_format_x86.h"
+
+static inline __m128i
+unpack_shuffle(int r, int g, int b, int a)
+{
+   uint8_t shuffle[16];
+   u_format_x86_unpack_shuffle(shuffle, r, g, b, a);
+   return _mm_loadu_si128((const __m128i *)shuffle);
+}
+
+static inline __m128i
+pack_shuffle(int r, int g, int b, int a)
+{
+   uint8_t shuffle[16];
+   u_format_x86_pack_shuffle(shuffle, r, g, b, a);
+   return _mm_loadu_si128((const __m128i *)shuffle);
+}
+
+/* Same as float_to_ubyte(), for the four floats of v. */
+static inline __m128i
+float_to_ubyte_sse41(__m128 v)
+{
+   v = _mm_min_ps(_mm_max_ps(v, _mm_setzero_ps()), _mm_set1_ps(1.0f));
+   v = _mm_add_ps(_mm_mul_ps(v, _mm_set1_ps(255.0f / 256.0f)),
+                  _mm_set1_ps(32768.0f));
+   return _mm_and_si128(_mm_castps_si128(v), _mm_set1_epi32(0xff));
+}
+
+/* Same as _mesa_unorm_to_unorm(x, 10, 8): (x * 255 + 511) / 1023 */
+static inline __m128i
+unorm10_to_unorm8(__m128i x)
+{
+   __m128i n = _mm_add_epi32(_mm_sub_epi32(_mm_slli_epi32(x, 8), x),
+                             _mm_set1_epi32(511));
+   n = _mm_add_epi32(_mm_add_epi32(n, _mm_srli_epi32(n, 10)),
+                     _mm_set1_epi32(1));
+   return _mm_srli_epi32(n, 10);
+}
+
+
+/*
+ * 8-bit RGBA formats
+ */
+
+static inline void
+unpack_rgba8_8unorm(uint8_t *restrict dst, const uint8_t *restrict src,
+                    unsigned width, int r, int g, int b, int a)
+{
+   const __m128i shuffle = unpack_shuffle(r, g, b, a);
+   const __m128i alpha = _mm_set1_epi32(a < 0 ? 0xff000000 : 0);
+
+   for (unsigned x = 0; x < width; x += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+      _mm_storeu_si128((__m128i *)(dst + x * 4), v);
+   }
+}
+
+static inline void
+unpack_rgba8_float(float *restrict dst, const uint8_t *restrict src,
+                   unsigned width, int r, int g, int b, int a)
+{
+   const __m128i shuffle = unpack_shuffle(r, g, b, a);
+   const __m128i alpha = _mm_set1_epi32(a < 0 ? 0xff000000 : 0);
+   const __m128 scale = _mm_set1_ps(1.0f / 255.0f);
+
+   for (unsigned x = 0; x < width; x += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      v = _mm_or_si128(_mm_shuffle_epi8(v, shuffle), alpha);
+
+      _mm_storeu_ps(dst + x * 4 + 0,
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(v)), scale));
+      _mm_storeu_ps(dst + x * 4 + 4,
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 4))), scale));
+      _mm_storeu_ps(dst + x * 4 + 8,
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 8))), scale));
+      _mm_storeu_ps(dst + x * 4 + 12,
+                    _mm_mul_ps(_mm_cvtepi32_ps(_mm_cvtepu8_epi32(_mm_srli_si128(v, 12))), scale));
+   }
+}
+
+static inline void
+pack_rgba8_8unorm(uint8_t *restrict dst, const uint8_t *restrict src,
+                  unsigned width, int r, int g, int b, int a)
+{
+   const __m128i shuffle = pack_shuffle(r, g, b, a);
+
+   for (unsigned x = 0; x < width; x += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_shuffle_epi8(v, shuffle));
+   }
+}
+
+static inline void
+pack_rgba8_float(uint8_t *restrict dst, const float *restrict src,
+                 unsigned width, int r, int g, int b, int a)
+{
+   const __m128i shuffle = pack_shuffle(r, g, b, a);
+
+   for (unsigned x = 0; x < width; x += 4) {
+      const float *s = src + x * 4;
+      __m128i p0 = float_to_ubyte_sse41(_mm_loadu_ps(s + 0));
+      __m128i p1 = float_to_ubyte_sse41(_mm_loadu_ps(s + 4));
+      __m128i p2 = float_to_ubyte_sse41(_mm_loadu_ps(s + 8));
+      __m128i p3 = float_to_ubyte_sse41(_mm_loadu_ps(s + 12));
+      __m128i v = _mm_packus_epi16(_mm_packus_epi32(p0, p1),
+                                   _mm_packus_epi32(p2, p3));
+      _mm_storeu_si128((__m128i *)(dst + x * 4), _mm_shuffle_epi8(v, shuffle));
+   }
+}
+
+#define RGBA8_FUNCS(FORMAT, format, r, g, b, a) \
+static void \
+util_format_##format##_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, \
+                                                const uint8_t *restrict src, \
+                                                unsigned width) \
+{ \
+   const unsigned n = width & ~3; \
+   unpack_rgba8_8unorm(dst, src, n, r, g, b, a); \
+   if (n < width) \
+      util_format_##format##_unpack_rgba_8unorm(dst + n * 4, src + n * 4, width - n); \
+} \
+\
+static void \
+util_format_##format##_unpack_rgba_float_sse41(void *restrict dst, \
+                                               const uint8_t *restrict src, \
+                                               unsigned width) \
+{ \
+   const unsigned n = width & ~3; \
+   unpack_rgba8_float(dst, src, n, r, g, b, a); \
+   if (n < width) \
+      util_format_##format##_unpack_rgba_float((float *)dst + n * 4, src + n * 4, width - n); \
+} \
+\
+static void \
+util_format_##format##_pack_rgba_8unorm_sse41(uint8_t *restrict dst, unsigned dst_stride, \
+                                              const uint8_t *restrict src, unsigned src_stride, \
+                                              unsigned width, unsigned height) \
+{ \
+   const unsigned n = width & ~3; \
+   for (unsigned y = 0; y < height; y++) { \
+      pack_rgba8_8unorm(dst, src, n, r, g, b, a); \
+      if (n < width) \
+         util_format_##format##_pack_rgba_8unorm(dst + n * 4, 0, src + n * 4, 0, width - n, 1); \
+      dst += dst_stride; \
+      src += src_stride; \
+   } \
+} \
+\
+static void \
+util_format_##format##_pack_rgba_float_sse41(uint8_t *restrict dst, unsigned dst_stride, \
+                                             const float *restrict src, unsigned src_stride, \
+                                             unsigned width, unsigned height) \
+{ \
+   const unsigned n = width & ~3; \
+   for (unsigned y = 0; y < height; y++) { \
+      pack_rgba8_float(dst, src, n, r, g, b, a); \
+      if (n < width) \
+         util_format_##format##_pack_rgba_float(dst + n * 4, 0, src + n * 4, 0, width - n, 1); \
+      dst += dst_stride; \
+      src += src_stride / sizeof(*src); \
+   } \
+}
+
+U_FORMAT_X86_RGBA8_FORMATS(RGBA8_FUNCS)
+
+
+/*
+ * 10-bit RGBA formats, with R and B at the given shifts.
+ */
+
+static inline void
+unpack_rgb10a2_8unorm(uint8_t *restrict dst, const uint8_t *restrict src,
+                      unsigned width, int r_shift, int b_shift)
+{
+   const __m128i mask = _mm_set1_epi32(0x3ff);
+
+   for (unsigned x = 0; x < width; x += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      __m128i r = _mm_and_si128(_mm_srli_epi32(v, r_shift), mask);
+      __m128i g = _mm_and_si128(_mm_srli_epi32(v, 10), mask);
+      __m128i b = _mm_and_si128(_mm_srli_epi32(v, b_shift), mask);
+      __m128i a = _mm_srli_epi32(v, 30);
+
+      r = unorm10_to_unorm8(r);
+      g = unorm10_to_unorm8(g);
+      b = unorm10_to_unorm8(b);
+      a = _mm_mullo_epi16(a, _mm_set1_epi32(0x55));
+
+      v = _mm_or_si128(_mm_or_si128(r, _mm_slli_epi32(g, 8)),
+                       _mm_or_si128(_mm_slli_epi32(b, 16), _mm_slli_epi32(a, 24)));
+      _mm_storeu_si128((__m128i *)(dst + x * 4), v);
+   }
+}
+
+static inline void
+unpack_rgb10a2_float(float *restrict dst, const uint8_t *restrict src,
+                     unsigned width, int r_shift, int b_shift)
+{
+   const __m128i mask = _mm_set1_epi32(0x3ff);
+   const __m128 scale = _mm_set1_ps(1.0f / 0x3ff);
+
+   for (unsigned x = 0; x < width; x += 4) {
+      __m128i v = _mm_loadu_si128((const __m128i *)(src + x * 4));
+      __m128 r = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, r_shift), mask));
+      __m128 g = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, 10), mask));
+      __m128 b = _mm_cvtepi32_ps(_mm_and_si128(_mm_srli_epi32(v, b_shift), mask));
+      __m128 a = _mm_cvtepi32_ps(_mm_srli_epi32(v, 30));
+
+      r = _mm_mul_ps(r, scale);
+      g = _mm_mul_ps(g, scale);
+      b = _mm_mul_ps(b, scale);
+      a = _mm_mul_ps(a, _mm_set1_ps(1.0f / 0x3));
+
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+      _mm_storeu_ps(dst + x * 4 + 0, r);
+      _mm_storeu_ps(dst + x * 4 + 4, g);
+      _mm_storeu_ps(dst + x * 4 + 8, b);
+      _mm_storeu_ps(dst + x * 4 + 12, a);
+   }
+}
+
+static inline void
+pack_rgb10a2_float(uint8_t *restrict dst, const float *restrict src,
+                   unsigned width, int r_shift, int b_shift)
+{
+   const __m128 zero = _mm_setzero_ps();
+   const __m128 one = _mm_set1_ps(1.0f);
+
+   for (unsigned x = 0; x < width; x += 4) {
+      __m128 r = _mm_loadu_ps(src + x * 4 + 0);
+      __m128 g = _mm_loadu_ps(src + x * 4 + 4);
+      __m128 b = _mm_loadu_ps(src + x * 4 + 8);
+      __m128 a = _mm_loadu_ps(src + x * 4 + 12);
+
+      _MM_TRANSPOSE4_PS(r, g, b, a);
+
+      /* Clamping with max first turns NaN into 0, like the generic code. */
+      r = _mm_min_ps(_mm_max_ps(r, zero), one);
+      g = _mm_min_ps(_mm_max_ps(g, zero), one);
+      b = _mm_min_ps(_mm_max_ps(b, zero), one);
+      a = _mm_min_ps(_mm_max_ps(a, zero), one);
+
+      __m128i ri = _mm_cvtps_epi32(_mm_mul_ps(r, _mm_set1_ps(0x3ff)));
+      __m128i gi = _mm_cvtps_epi32(_mm_mul_ps(g, _mm_set1_ps(0x3ff)));
+      __m128i bi = _mm_cvtps_epi32(_mm_mul_ps(b, _mm_set1_ps(0x3ff)));
+      __m128i ai = _mm_cvtps_epi32(_mm_mul_ps(a, _mm_set1_ps(0x3)));
+
+      __m128i v = _mm_or_si128(_mm_or_si128(_mm_slli_epi32(ri, r_shift),
+                                            _mm_slli_epi32(gi, 10)),
+                               _mm_or_si128(_mm_slli_epi32(bi, b_shift),
+                                            _mm_slli_epi32(ai, 30)));
+      _mm_storeu_si128((__m128i *)(dst + x * 4), v);
+   }
+}
+
+#define RGB10A2_FUNCS(format, r_shift, b_shift) \
+static void \
+util_format_##format##_unpack_rgba_8unorm_sse41(uint8_t *restrict dst, \
+                                                const uint8_t *restrict src, \
+                                                unsigned width) \
+{ \
+   const unsigned n = width & ~3; \
+   unpack_rgb10a2_8unorm(dst, src, n, r_shift, b_shift); \
+   if (n < width) \
+      util_format_##format##_unpack_rgba_8unorm(dst + n * 4, src + n * 4, width - n); \
+} \
+\
+static void \
+util_format_##format##_unpack_rgba_float_sse41(void *restrict dst, \
+                                               const uint8_t *restrict src, \
+                                               unsigned width) \
+{ \
+   const unsigned n = width & ~3; \
+   unpack_rgb10a2_float(dst, src, n, r_shift, b_shift); \
+   if (n < width) \
+      util_format_##format##_unpack_rgba_float((float *)dst + n * 4, src + n * 4, width - n); \
+} \
+\
+static void \
+util_format_##format##_pack_rgba_float_sse41(uint8_t *restrict dst, unsigned dst_stride, \
+                                             const float *restrict src, unsigned src_stride, \
+                                             unsigned width, unsigned height) \
+{ \
+   const unsigned n = width & ~3; \
+   for (unsigned y = 0; y < height; y++) { \
+      pack_rgb10a2_float(dst, src, n, r_shift, b_shift); \
+      if (n < width) \
+         util_format_##format##_pack_rgba_float(dst + n * 4, 0, src + n * 4, 0, width - n, 1); \
+      dst += dst_stride; \
+      src += src_stride / sizeof(*src); \
+   } \
+}
+
+RGB10A2_FUNCS(r10g10b10a2_unorm, 0, 20)
+RGB10A2_FUNCS(b10g10r10a2_unorm, 20, 0)
+
+
+#define RGBA8_UNPACK_DESC(FORMAT, format, r, g, b, a) \
+   [PIPE_FORMAT_##FORMAT] = { \
+      .unpack_rgba_8unorm = &util_format_##format##_unpack_rgba_8unorm_sse41, \
+      .unpack_rgba = &util_format_##format##_unpack_rgba_float_sse41, \
+   },
+
+static const struct util_format_unpack_description util_format_unpack_descriptions_sse41[] = {
+   U_FORMAT_X86_RGBA8_FORMATS(RGBA8_UNPACK_DESC)
+
+   [PIPE_FORMAT_R10G10B10A2_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_r10g10b10a2_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_r10g10b10a2_unorm_unpack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B10G10R10A2_UNORM] = {
+      .unpack_rgba_8unorm = &util_format_b10g10r10a2_unorm_unpack_rgba_8unorm_sse41,
+      .unpack_rgba = &util_format_b10g10r10a2_unorm_unpack_rgba_float_sse41,
+   },
+};
+
+#define RGBA8_PACK_DESC(FORMAT, format, r, g, b, a) \
+   [PIPE_FORMAT_##FORMAT] = { \
+      .pack_rgba_8unorm = &util_format_##format##_pack_rgba_8unorm_sse41, \
+      .pack_rgba_float = &util_format_##format##_pack_rgba_float_sse41, \
+   },
+
+static const struct util_format_pack_description util_format_pack_descriptions_sse41[] = {
+   U_FORMAT_X86_RGBA8_FORMATS(RGBA8_PACK_DESC)
+
+   [PIPE_FORMAT_R10G10B10A2_UNORM] = {
+      .pack_rgba_8unorm = &util_format_r10g10b10a2_unorm_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_r10g10b10a2_unorm_pack_rgba_float_sse41,
+   },
+   [PIPE_FORMAT_B10G10R10A2_UNORM] = {
+      .pack_rgba_8unorm = &util_format_b10g10r10a2_unorm_pack_rgba_8unorm,
+      .pack_rgba_float = &util_format_b10g10r10a2_unorm_pack_rgba_float_sse41,
+   },
+};
+
+const struct util_format_unpack_description *
+util_format_unpack_description_sse41(enum pipe_format format)
+{
+   if (format >= ARRAY_SIZE(util_format_unpack_descriptions_sse41))
+      return NULL;
+
+   if (!util_format_unpack_descriptions_sse41[format].unpack_rgba)
+      return NULL;
+
+   return &util_format_unpack_descriptions_sse41[format];
+}
+
+const struct util_format_pack_description *
+util_format_pack_description_sse41(enum pipe_format format)
+{
+   if (format >= ARRAY_SIZE(util_format_pack_descriptions_sse41))
+      return NULL;
+
+   if (!util_format_pack_descriptions_sse41[format].pack_rgba_float)
+      return NULL;
+
+   return &util_format_pack_descriptions_sse41[format];
+}
+
+#endif /* (DETECT_ARCH_X86 || DETECT_ARCH_X86_64) && USE_SSE41 */
@@ -0,0 +1,65 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/*
+ * Helpers shared by the SSE4.1 and AVX2 pack/unpack kernels.
+ */
+
+#ifndef U_FORMAT_X86_H
+#define U_FORMAT_X86_H
+
+#include <stdint.h>
+
+/* The 8-bit RGBA formats with vectorized kernels, with the byte position of
+ * their R, G, B and A channels, or -1 for an X channel.
+ */
+#define U_FORMAT_X86_RGBA8_FORMATS(F) \
+   F(R8G8B8A8_UNORM, r8g8b8a8_unorm, 0, 1, 2, 3) \
+   F(R8G8B8X8_UNORM, r8g8b8x8_unorm, 0, 1, 2, -1) \
+   F(B8G8R8A8_UNORM, b8g8r8a8_unorm, 2, 1, 0, 3) \
+   F(B8G8R8X8_UNORM, b8g8r8x8_unorm, 2, 1, 0, -1) \
+   F(A8R8G8B8_UNORM, a8r8g8b8_unorm, 1, 2, 3, 0) \
+   F(X8R8G8B8_UNORM, x8r8g8b8_unorm, 1, 2, 3, -1) \
+   F(A8B8G8R8_UNORM, a8b8g8r8_unorm, 3, 2, 1, 0) \
+   F(X8B8G8R8_UNORM, x8b8g8r8_unorm, 3, 2, 1, -1)
+
+/**
+ * Byte shuffle control reordering 4 pixels of a format with the given
+ * channel positions to RGBA.  X channels read as zero, and have to be set
+ * to 0xff afterwards.
+ */
+static inline void
+u_format_x86_unpack_shuffle(uint8_t shuffle[16], int r, int g, int b, int a)
+{
+   const int pos[4] = { r, g, b, a };
+
+   for (unsigned i = 0; i < 16; i++) {
+      const int p = pos[i % 4];
+      shuffle[i] = p < 0 ? 0x80 : (i & ~3) + p;
+   }
+}
+
+/**
+ * Byte shuffle control reordering 4 RGBA pixels to a format with the given
+ * channel positions.  X channels are written as zero, like the generic
+ * code does.
+ */
+static inline void
+u_format_x86_pack_shuffle(uint8_t shuffle[16], int r, int g, int b, int a)
+{
+   const int pos[4] = { r, g, b, a };
+
+   for (unsigned i = 0; i < 16; i++)
+      shuffle[i] = 0x80;
+
+   for (unsigned px = 0; px < 16; px += 4) {
+      for (unsigned c = 0; c < 4; c++) {
+         if (pos[c] >= 0)
+            shuffle[px + pos[c]] = px + c;
+      }
+   }
+}
+
+#endif /* U_FORMAT_X86_H */
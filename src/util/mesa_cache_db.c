@@ -16,6 +16,8 @@
 #include <stdlib.h>
 #include <string.h>
 #include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include <unistd.h>
 
 #include "crc32.h"
@@ -25,12 +27,18 @@
 #include "mesa_cache_db.h"
 #include "os_time.h"
 #include "ralloc.h"
+#include "u_atomic.h"
 #include "u_debug.h"
 #include "u_qsort.h"
 
 #define MESA_CACHE_DB_VERSION          1
 #define MESA_CACHE_DB_MAGIC            "MESA_DB"
 
+#define MESA_CACHE_DB_HASH_VERSION     1
+#define MESA_CACHE_DB_HASH_MAGIC       "MESA_HT"
+#define MESA_CACHE_DB_HASH_NUM_SLOTS   (1 << 13)
+#define MESA_CACHE_DB_HASH_MAX_PROBES  32
+
 struct PACKED mesa_db_file_header {
    char magic[8];
    uint32_t version;
@@ -51,6 +59,7 @@ struct PACKED mesa_index_db_file_entry {
 };
 
 struct mesa_index_db_hash_entry {
+   uint64_t hash;
    uint64_t cache_db_file_offset;
    uint64_t index_db_file_offset;
    uint64_t last_access_time;
@@ -58,6 +67,34 @@ struct mesa_index_db_hash_entry {
    bool evicted;
 };
 
+/* Lookup table of the index shared by all processes through mmap.
+ *
+ * Writers insert every entry they append to the index file while holding
+ * the DB lock, publish it by storing the slot's hash last and then advance
+ * index_size. Readers probe the table without taking any lock and validate
+ * what they find against the cache file, falling back to the locked path
+ * whenever something doesn't add up. The file is never resized once
+ * created, so a mapping can't be truncated under a reader's feet.
+ */
+struct mesa_db_hash_header {
+   char magic[8];
+   uint32_t version;
+   uint32_t num_slots;
+   /* UUID of the DB files described by the table, zero while rebuilding */
+   uint64_t uuid;
+   /* Size of the index file covered by the table, zero if the table ran
+    * out of space and can't vouch for missing entries anymore */
+   uint64_t index_size;
+};
+
+struct mesa_db_hash_slot {
+   uint64_t hash;
+   uint64_t cache_db_file_offset;
+   uint64_t index_db_file_offset;
+   uint64_t last_access_time;
+   uint64_t size;
+};
+
 static inline bool mesa_db_seek_end(FILE *file)
 {
    return !fseek(file, 0, SEEK_END);
@@ -207,6 +244,205 @@ mesa_db_write_header(struct mesa_cache_db_file *db_file,
    return true;
 }
 
+static size_t
+mesa_db_hash_map_size(void)
+{
+   return sizeof(struct mesa_db_hash_header) +
+          MESA_CACHE_DB_HASH_NUM_SLOTS * sizeof(struct mesa_db_hash_slot);
+}
+
+static struct mesa_db_hash_slot *
+mesa_db_hash_slots(struct mesa_db_hash_header *header)
+{
+   return (struct mesa_db_hash_slot *)(header + 1);
+}
+
+static bool
+mesa_db_hash_open(struct mesa_cache_db *db, const char *cache_path)
+{
+   size_t map_size = mesa_db_hash_map_size();
+   struct stat st;
+   char *path;
+   void *map;
+   int fd;
+
+   if (asprintf(&path, "%s/%s", cache_path, "mesa_cache.hash") == -1)
+      return false;
+
+   fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+   free(path);
+   if (fd == -1)
+      return false;
+
+   /* A table of a different size belongs to another Mesa version. Don't
+    * resize it while its users may have it mapped, just go without it.
+    */
+   if (fstat(fd, &st) == -1 ||
+       (st.st_size != map_size &&
+        (st.st_size != 0 || ftruncate(fd, map_size) == -1))) {
+      close(fd);
+      return false;
+   }
+
+   map = mmap(NULL, map_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+   close(fd);
+
+   if (map == MAP_FAILED)
+      return false;
+
+   db->hash_map = map;
+
+   return true;
+}
+
+static void
+mesa_db_hash_close(struct mesa_cache_db *db)
+{
+   if (db->hash_map)
+      munmap(db->hash_map, mesa_db_hash_map_size());
+}
+
+static bool
+mesa_db_hash_valid(struct mesa_cache_db *db)
+{
+   struct mesa_db_hash_header *header = db->hash_map;
+
+   return !strncmp(header->magic, MESA_CACHE_DB_HASH_MAGIC,
+                   sizeof(header->magic)) &&
+          header->version == MESA_CACHE_DB_HASH_VERSION &&
+          header->num_slots == MESA_CACHE_DB_HASH_NUM_SLOTS &&
+          p_atomic_read(&header->uuid) == db->uuid;
+}
+
+/* Take the table offline for the lock-free readers. */
+static void
+mesa_db_hash_invalidate(struct mesa_cache_db *db)
+{
+   if (db->hash_map)
+      p_atomic_set(&db->hash_map->uuid, 0);
+}
+
+static struct mesa_db_hash_slot *
+mesa_db_hash_lookup(struct mesa_db_hash_header *header, uint64_t hash)
+{
+   struct mesa_db_hash_slot *slots = mesa_db_hash_slots(header);
+
+   for (unsigned i = 0; i < MESA_CACHE_DB_HASH_MAX_PROBES; i++) {
+      struct mesa_db_hash_slot *slot =
+         &slots[(hash + i) & (MESA_CACHE_DB_HASH_NUM_SLOTS - 1)];
+      uint64_t slot_hash = p_atomic_read(&slot->hash);
+
+      if (slot_hash == hash)
+         return slot;
+
+      if (!slot_hash)
+         break;
+   }
+
+   return NULL;
+}
+
+static void
+mesa_db_hash_insert(struct mesa_cache_db *db,
+                    struct mesa_index_db_hash_entry *hash_entry)
+{
+   struct mesa_db_hash_header *header = db->hash_map;
+   struct mesa_db_hash_slot *slots;
+
+   if (!header)
+      return;
+
+   slots = mesa_db_hash_slots(header);
+
+   for (unsigned i = 0; i < MESA_CACHE_DB_HASH_MAX_PROBES; i++) {
+      struct mesa_db_hash_slot *slot =
+         &slots[(hash_entry->hash + i) & (MESA_CACHE_DB_HASH_NUM_SLOTS - 1)];
+
+      if (slot->hash == hash_entry->hash)
+         return;
+
+      if (!slot->hash) {
+         slot->cache_db_file_offset = hash_entry->cache_db_file_offset;
+         slot->index_db_file_offset = hash_entry->index_db_file_offset;
+         slot->last_access_time = hash_entry->last_access_time;
+         slot->size = hash_entry->size;
+
+         p_atomic_set(&slot->hash, hash_entry->hash);
+         return;
+      }
+   }
+
+   /* Out of space, the table can't prove that an entry is missing anymore */
+   p_atomic_set(&header->index_size, 0);
+}
+
+/* Bring the shared table in line with the in-memory index and publish it.
+ * Must be called with the DB lock held.
+ */
+static void
+mesa_db_hash_sync(struct mesa_cache_db *db)
+{
+   struct mesa_db_hash_header *header = db->hash_map;
+
+   if (!header)
+      return;
+
+   if (!mesa_db_hash_valid(db)) {
+      mesa_db_hash_invalidate(db);
+
+      memset(mesa_db_hash_slots(header), 0,
+             MESA_CACHE_DB_HASH_NUM_SLOTS * sizeof(struct mesa_db_hash_slot));
+      memcpy(header->magic, MESA_CACHE_DB_HASH_MAGIC, sizeof(header->magic));
+      header->version = MESA_CACHE_DB_HASH_VERSION;
+      header->num_slots = MESA_CACHE_DB_HASH_NUM_SLOTS;
+      p_atomic_set(&header->index_size, sizeof(struct mesa_db_file_header));
+
+      hash_table_foreach(db->index_db->table, entry)
+         mesa_db_hash_insert(db, entry->data);
+   }
+
+   if (p_atomic_read(&header->index_size))
+      p_atomic_set(&header->index_size, db->index.offset);
+
+   p_atomic_set(&header->uuid, db->uuid);
+}
+
+/* Fold the access times recorded by the lock-free readers back into the
+ * index, so that eviction takes them into account.
+ */
+static bool
+mesa_db_hash_sync_access_times(struct mesa_cache_db *db)
+{
+   if (!db->hash_map || !mesa_db_hash_valid(db))
+      return true;
+
+   hash_table_foreach(db->index_db->table, entry) {
+      struct mesa_index_db_hash_entry *hash_entry = entry->data;
+      struct mesa_db_hash_slot *slot =
+         mesa_db_hash_lookup(db->hash_map, hash_entry->hash);
+      uint64_t last_access_time;
+
+      if (!slot)
+         continue;
+
+      last_access_time = p_atomic_read(&slot->last_access_time);
+      if (last_access_time <= hash_entry->last_access_time)
+         continue;
+
+      hash_entry->last_access_time = last_access_time;
+
+      if (!mesa_db_seek(db->index.file, hash_entry->index_db_file_offset +
+                        offsetof(struct mesa_index_db_file_entry,
+                                 last_access_time)) ||
+          !mesa_db_write(db->index.file, &last_access_time))
+         return false;
+   }
+
+   fflush(db->index.file);
+
+   return true;
+}
+
 /* Wipe out all database cache files.
  *
  * Whenever we get an unmanageable error on reading or writing to the
@@ -221,6 +457,7 @@ mesa_db_zap(struct mesa_cache_db *db)
 {
    /* Disable cache to prevent the recurring faults */
    db->alive = false;
+   mesa_db_hash_invalidate(db);
 
    /* Zap corrupted database files to start over from a clean slate */
    if (!mesa_db_truncate(db->cache.file, 0) ||
@@ -261,6 +498,10 @@ mesa_db_update_index(struct mesa_cache_db *db)
    if (!mesa_db_seek(db->index.file, db->index.offset))
       return false;
 
+   /* Keep readers away from a stale table until it has been rebuilt */
+   if (db->hash_map && !mesa_db_hash_valid(db))
+      mesa_db_hash_invalidate(db);
+
    while (db->index.offset < file_length) {
       if (!mesa_db_read(db->index.file, &index_entry))
          break;
@@ -273,12 +514,14 @@ mesa_db_update_index(struct mesa_cache_db *db)
       if (!hash_entry)
          break;
 
+      hash_entry->hash = index_entry.hash;
       hash_entry->cache_db_file_offset = index_entry.cache_db_file_offset;
       hash_entry->index_db_file_offset = db->index.offset;
       hash_entry->last_access_time = index_entry.last_access_time;
       hash_entry->size = index_entry.size;
 
       _mesa_hash_table_u64_insert(db->index_db, index_entry.hash, hash_entry);
+      mesa_db_hash_insert(db, hash_entry);
 
       db->index.offset += sizeof(index_entry);
    }
@@ -286,7 +529,12 @@ mesa_db_update_index(struct mesa_cache_db *db)
    if (!mesa_db_seek(db->index.file, db->index.offset))
       return false;
 
-   return db->index.offset == file_length;
+   if (db->index.offset != file_length)
+      return false;
+
+   mesa_db_hash_sync(db);
+
+   return true;
 }
 
 static void
@@ -302,6 +550,8 @@ mesa_db_recreate_files(struct mesa_cache_db *db)
 {
    db->uuid = mesa_db_generate_uuid();
 
+   mesa_db_hash_invalidate(db);
+
    if (!mesa_db_write_header(&db->cache, db->uuid, true) ||
        !mesa_db_write_header(&db->index, db->uuid, true))
          return false;
@@ -464,6 +714,9 @@ mesa_db_compact(struct mesa_cache_db *db, int64_t blob_size,
    if (!remove_entry && !mesa_db_reload(db))
       return false;
 
+   if (!mesa_db_hash_sync_access_times(db))
+      return false;
+
    num_entries = _mesa_hash_table_num_entries(db->index_db->table);
    entries = calloc(num_entries, sizeof(*entries));
    if (!entries)
@@ -510,6 +763,8 @@ mesa_db_compact(struct mesa_cache_db *db, int64_t blob_size,
 
    /* Mark cache file invalid by writing zero-UUID header. If compaction will
     * fail, then the file will remain to be invalid since we can't repair it. */
+   mesa_db_hash_invalidate(db);
+
    if (!mesa_db_write_header(&db->cache, 0, false) ||
        !mesa_db_write_header(&db->index, 0, false))
       goto cleanup;
@@ -610,6 +865,12 @@ mesa_cache_db_open(struct mesa_cache_db *db, const char *cache_path)
    if (!mesa_db_open_file(&db->index, cache_path, "mesa_cache.idx"))
       goto close_cache;
 
+   /* The shared lookup table is only an accelerator, go without it if it
+    * can't be set up.
+    */
+   db->hash_map = NULL;
+   mesa_db_hash_open(db, cache_path);
+
    db->mem_ctx = ralloc_context(NULL);
    if (!db->mem_ctx)
       goto close_index;
@@ -632,6 +893,7 @@ destroy_mtx:
 
    ralloc_free(db->mem_ctx);
 close_index:
+   mesa_db_hash_close(db);
    mesa_db_close_file(&db->index);
 close_cache:
    mesa_db_close_file(&db->cache);
@@ -642,15 +904,18 @@ close_cache:
 bool
 mesa_db_wipe_path(const char *cache_path)
 {
+   struct mesa_cache_db_file hash_file = {0};
    struct mesa_cache_db db = {0};
    bool success = true;
 
    if (!mesa_db_remove_file(&db.cache, cache_path, "mesa_cache.db") ||
-       !mesa_db_remove_file(&db.index, cache_path, "mesa_cache.idx"))
+       !mesa_db_remove_file(&db.index, cache_path, "mesa_cache.idx") ||
+       !mesa_db_remove_file(&hash_file, cache_path, "mesa_cache.hash"))
       success = false;
 
    free(db.cache.path);
    free(db.index.path);
+   free(hash_file.path);
 
    return success;
 }
@@ -662,6 +927,7 @@ mesa_cache_db_close(struct mesa_cache_db *db)
    simple_mtx_destroy(&db->flock_mtx);
    ralloc_free(db->mem_ctx);
 
+   mesa_db_hash_close(db);
    mesa_db_close_file(&db->index);
    mesa_db_close_file(&db->cache);
 }
@@ -679,6 +945,80 @@ mesa_cache_db_file_entry_size(void)
    return sizeof(struct mesa_cache_db_file_entry);
 }
 
+/* Look the entry up in the shared table without taking the DB lock.
+ *
+ * Returns NULL if the entry can't be served this way, in which case
+ * \missing tells whether the table proved that the entry doesn't exist.
+ */
+static void *
+mesa_db_read_entry_lockless(struct mesa_cache_db *db,
+                            const uint8_t *cache_key_160bit,
+                            size_t *size, bool *missing)
+{
+   uint64_t hash = to_mesa_cache_db_hash(cache_key_160bit);
+   struct mesa_db_hash_header *header = db->hash_map;
+   struct mesa_cache_db_file_entry cache_entry;
+   struct mesa_db_hash_slot *slot;
+   uint64_t uuid, offset;
+   int fd = fileno(db->cache.file);
+   void *data;
+
+   *missing = false;
+
+   if (!header)
+      return NULL;
+
+   uuid = p_atomic_read(&header->uuid);
+   if (!uuid)
+      return NULL;
+
+   slot = mesa_db_hash_lookup(header, hash);
+   if (!slot) {
+      /* Writers append to the index file before publishing, so the entry
+       * can only be missing if the table covers the whole index file and
+       * wasn't taken offline in the meantime.
+       */
+      uint64_t index_size = p_atomic_read(&header->index_size);
+      struct stat st;
+
+      *missing = index_size &&
+                 fstat(fileno(db->index.file), &st) == 0 &&
+                 st.st_size == index_size &&
+                 p_atomic_read(&header->uuid) == uuid;
+      return NULL;
+   }
+
+   offset = p_atomic_read(&slot->cache_db_file_offset);
+
+   if (pread(fd, &cache_entry, sizeof(cache_entry), offset) !=
+          sizeof(cache_entry) ||
+       !mesa_db_cache_entry_valid(&cache_entry) ||
+       cache_entry.size != p_atomic_read(&slot->size) ||
+       memcmp(cache_entry.key, cache_key_160bit, sizeof(cache_entry.key)))
+      return NULL;
+
+   data = malloc(cache_entry.size);
+   if (!data)
+      return NULL;
+
+   /* The entry may have been moved by a concurrent compaction, which the
+    * CRC and the UUID check catch.
+    */
+   if (pread(fd, data, cache_entry.size, offset + sizeof(cache_entry)) !=
+          cache_entry.size ||
+       util_hash_crc32(data, cache_entry.size) != cache_entry.crc ||
+       p_atomic_read(&header->uuid) != uuid) {
+      free(data);
+      return NULL;
+   }
+
+   p_atomic_set(&slot->last_access_time, os_time_get_nano());
+
+   *size = cache_entry.size;
+
+   return data;
+}
+
 void *
 mesa_cache_db_read_entry(struct mesa_cache_db *db,
                          const uint8_t *cache_key_160bit,
@@ -689,6 +1029,11 @@ mesa_cache_db_read_entry(struct mesa_cache_db *db,
    struct mesa_index_db_file_entry index_entry;
    struct mesa_index_db_hash_entry *hash_entry;
    void *data = NULL;
+   bool missing;
+
+   data = mesa_db_read_entry_lockless(db, cache_key_160bit, size, &missing);
+   if (data || missing)
+      return data;
 
    if (!mesa_db_lock(db))
       return NULL;
@@ -821,6 +1166,7 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
    if (!hash_entry)
       goto fail;
 
+   hash_entry->hash = hash;
    hash_entry->cache_db_file_offset = index_entry.cache_db_file_offset;
    hash_entry->index_db_file_offset = ftell(db->index.file);
    hash_entry->last_access_time = index_entry.last_access_time;
@@ -837,6 +1183,8 @@ mesa_cache_db_entry_write(struct mesa_cache_db *db,
    db->index.offset = ftell(db->index.file);
 
    _mesa_hash_table_u64_insert(db->index_db, hash, hash_entry);
+   mesa_db_hash_insert(db, hash_entry);
+   mesa_db_hash_sync(db);
 
    mesa_db_unlock(db);
 
@@ -953,7 +1301,7 @@ mesa_cache_db_eviction_score(struct mesa_cache_db *db)
    if (!db->alive)
       goto fail;
 
-   if (!mesa_db_reload(db))
+   if (!mesa_db_reload(db) || !mesa_db_hash_sync_access_times(db))
       goto fail_fatal;
 
    num_entries = _mesa_hash_table_num_entries(db->index_db->table);
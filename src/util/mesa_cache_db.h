@@ -28,10 +28,13 @@ struct mesa_cache_db_file {
    uint64_t uuid;
 };
 
+struct mesa_db_hash_header;
+
 struct mesa_cache_db {
    struct hash_table_u64 *index_db;
    struct mesa_cache_db_file cache;
    struct mesa_cache_db_file index;
+   struct mesa_db_hash_header *hash_map;
    uint64_t max_cache_size;
    simple_mtx_t flock_mtx;
    void *mem_ctx;
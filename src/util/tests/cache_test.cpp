@@ -43,6 +43,8 @@
 #include "util/disk_cache.h"
 #include "util/disk_cache_os.h"
 #include "util/ralloc.h"
+#include "util/u_atomic.h"
+#include "util/u_queue.h"
 
 #ifdef ENABLE_SHADER_CACHE
 
@@ -474,6 +476,90 @@ test_put_key_and_get_key(const char *driver_id)
    disk_cache_destroy(cache);
 }
 
+#define GET_MANY_NUM_ITEMS 16
+
+struct get_many_result {
+   void *data[GET_MANY_NUM_ITEMS + 1];
+   size_t size[GET_MANY_NUM_ITEMS + 1];
+   unsigned calls;
+};
+
+static void
+get_many_cb(void *cb_data, unsigned index, void *data, size_t size)
+{
+   struct get_many_result *res = (struct get_many_result *) cb_data;
+
+   res->data[index] = data;
+   res->size[index] = size;
+   p_atomic_inc(&res->calls);
+}
+
+static void
+test_get_many(const char *driver_id)
+{
+   struct disk_cache *cache;
+   char items[GET_MANY_NUM_ITEMS][32];
+   cache_key keys[GET_MANY_NUM_ITEMS + 1];
+   struct get_many_result res;
+   struct util_queue_fence fence;
+
+#ifdef SHADER_CACHE_DISABLE_BY_DEFAULT
+   setenv("MESA_SHADER_CACHE_DISABLE", "false", 1);
+#endif /* SHADER_CACHE_DISABLE_BY_DEFAULT */
+
+   cache = disk_cache_create("test", driver_id, 0);
+
+   for (unsigned i = 0; i < GET_MANY_NUM_ITEMS; i++) {
+      snprintf(items[i], sizeof(items[i]), "get_many item number %u", i);
+      disk_cache_compute_key(cache, items[i], strlen(items[i]) + 1, keys[i]);
+      disk_cache_put(cache, keys[i], items[i], strlen(items[i]) + 1, NULL);
+   }
+
+   /* The last key is never stored and must be reported as a miss. */
+   disk_cache_compute_key(cache, "not in the cache", 17,
+                          keys[GET_MANY_NUM_ITEMS]);
+
+   disk_cache_wait_for_idle(cache);
+
+   memset(&res, 0, sizeof(res));
+   util_queue_fence_init(&fence);
+   disk_cache_get_many(cache, keys, GET_MANY_NUM_ITEMS + 1, get_many_cb,
+                       &res, &fence);
+   util_queue_fence_wait(&fence);
+
+   EXPECT_EQ(res.calls, GET_MANY_NUM_ITEMS + 1) << "one callback per key";
+
+   for (unsigned i = 0; i < GET_MANY_NUM_ITEMS; i++) {
+      EXPECT_STREQ((char *) res.data[i], items[i])
+         << "disk_cache_get_many of existing item (pointer)";
+      EXPECT_EQ(res.size[i], strlen(items[i]) + 1)
+         << "disk_cache_get_many of existing item (size)";
+      free(res.data[i]);
+   }
+
+   EXPECT_EQ(res.data[GET_MANY_NUM_ITEMS], nullptr)
+      << "disk_cache_get_many with non-existent item";
+
+   /* Prefetching is only a hint, but must not disturb later lookups. */
+   disk_cache_prefetch(cache, keys, GET_MANY_NUM_ITEMS);
+   disk_cache_wait_for_idle(cache);
+
+   for (unsigned i = 0; i < GET_MANY_NUM_ITEMS; i++) {
+      size_t size;
+      char *result = (char *) disk_cache_get(cache, keys[i], &size);
+      EXPECT_STREQ(result, items[i]) << "disk_cache_get after prefetch";
+      free(result);
+   }
+
+   /* An empty batch leaves the fence signalled. */
+   disk_cache_get_many(cache, keys, 0, get_many_cb, &res, &fence);
+   EXPECT_TRUE(util_queue_fence_is_signalled(&fence))
+      << "disk_cache_get_many with no keys";
+
+   util_queue_fence_destroy(&fence);
+   disk_cache_destroy(cache);
+}
+
 /* To make sure we are not just using the inmemory cache index for the single
  * file cache we test adding and retriving cache items between two different
  * cache instances.
@@ -703,6 +789,8 @@ run_tests:
 
    test_put_key_and_get_key(driver_id);
 
+   test_get_many(driver_id);
+
    setenv("MESA_DISK_CACHE_MULTI_FILE", "false", 1);
 
    int err = rmrf_local(CACHE_TEST_TMP);
@@ -743,6 +831,8 @@ run_tests:
 
    test_put_and_get_between_instances(driver_id);
 
+   test_get_many(driver_id);
+
    setenv("MESA_DISK_CACHE_SINGLE_FILE", "false", 1);
 
    int err = rmrf_local(CACHE_TEST_TMP);
@@ -784,6 +874,8 @@ TEST_F(Cache, Database)
 
    test_put_and_get_between_instances(driver_id);
 
+   test_get_many(driver_id);
+
    test_put_and_get_between_instances_with_eviction(driver_id);
 
    unsetenv("MESA_DISK_CACHE_DATABASE_NUM_PARTS");
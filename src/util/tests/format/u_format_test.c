@@ -28,9 +28,12 @@
 
 #include <stdlib.h>
 #include <stdio.h>
+#include <string.h>
 #include <float.h>
+#include <math.h>
 
 #include "util/half_float.h"
+#include "util/os_time.h"
 #include "util/u_math.h"
 #include "util/format/u_format.h"
 #include "util/format/u_format_tests.h"
@@ -865,11 +868,268 @@ test_all(void)
 }
 
 
+/*
+ * Optimized pack/unpack functions are checked against the generated ones,
+ * which they must match bit for bit, on rows of random pixels of every
+ * length up to a few vectors.
+ */
+
+#define ROW_PIXELS 67
+
+static const float special_floats[] = {
+   0.0f, -0.0f, 1.0f, -1.0f, 0.5f, 2.0f, 1.0f / 255.0f, 254.5f / 255.0f,
+   1.0f / 1023.0f, 1e-8f, 65504.0f, 70000.0f, INFINITY, -INFINITY, NAN,
+};
+
+static void
+fill_random_bytes(uint8_t *data, unsigned size)
+{
+   for (unsigned i = 0; i < size; i++)
+      data[i] = rand();
+}
+
+static void
+fill_random_floats(float *data, unsigned count)
+{
+   for (unsigned i = 0; i < count; i++) {
+      if (rand() % 8 == 0)
+         data[i] = special_floats[rand() % ARRAY_SIZE(special_floats)];
+      else
+         data[i] = (float)rand() / RAND_MAX * 1.5f - 0.25f;
+   }
+}
+
+static bool
+compare_unpacked_float(const float *a, const float *b, unsigned count)
+{
+   for (unsigned i = 0; i < count; i++) {
+      if (isnan(a[i]) && isnan(b[i]))
+         continue;
+      if (memcmp(&a[i], &b[i], sizeof(float)))
+         return false;
+   }
+   return true;
+}
+
+static bool
+test_optimized_format(enum pipe_format format)
+{
+   const struct util_format_unpack_description *unpack =
+      util_format_unpack_description(format);
+   const struct util_format_unpack_description *unpack_generic =
+      util_format_unpack_description_generic(format);
+   const struct util_format_pack_description *pack =
+      util_format_pack_description(format);
+   const struct util_format_pack_description *pack_generic =
+      util_format_pack_description_generic(format);
+   const unsigned bpp = util_format_get_blocksize(format);
+   bool success = true;
+
+   if (unpack == unpack_generic && pack == pack_generic)
+      return true;
+
+   if (util_format_description(format)->block.width != 1)
+      return true;
+
+   printf("Testing optimized util_format_%s pack/unpack ...\n",
+          util_format_short_name(format));
+   fflush(stdout);
+
+   for (unsigned width = 1; width <= ROW_PIXELS; width++) {
+      /* Two rows, to exercise the strides of the pack functions. */
+      uint8_t packed[2 * ROW_PIXELS * UTIL_FORMAT_MAX_PACKED_BYTES];
+      uint8_t packed_ref[2 * ROW_PIXELS * UTIL_FORMAT_MAX_PACKED_BYTES];
+      float unpacked[2 * ROW_PIXELS * 4], unpacked_ref[2 * ROW_PIXELS * 4];
+      uint8_t unpacked8[2 * ROW_PIXELS * 4], unpacked8_ref[2 * ROW_PIXELS * 4];
+      const char *failed = NULL;
+
+      if (unpack->unpack_rgba && unpack->unpack_rgba != unpack_generic->unpack_rgba) {
+         fill_random_bytes(packed, width * bpp);
+         memset(unpacked, 0, sizeof(unpacked));
+         memset(unpacked_ref, 0, sizeof(unpacked_ref));
+         unpack->unpack_rgba(unpacked, packed, width);
+         unpack_generic->unpack_rgba(unpacked_ref, packed, width);
+         if (!compare_unpacked_float(unpacked, unpacked_ref, ROW_PIXELS * 4))
+            failed = "unpack_rgba";
+      }
+
+      if (unpack->unpack_rgba_8unorm &&
+          unpack->unpack_rgba_8unorm != unpack_generic->unpack_rgba_8unorm) {
+         fill_random_bytes(packed, width * bpp);
+         memset(unpacked8, 0, sizeof(unpacked8));
+         memset(unpacked8_ref, 0, sizeof(unpacked8_ref));
+         unpack->unpack_rgba_8unorm(unpacked8, packed, width);
+         unpack_generic->unpack_rgba_8unorm(unpacked8_ref, packed, width);
+         if (memcmp(unpacked8, unpacked8_ref, sizeof(unpacked8)))
+            failed = "unpack_rgba_8unorm";
+      }
+
+      if (pack->pack_rgba_float &&
+          pack->pack_rgba_float != pack_generic->pack_rgba_float) {
+         fill_random_floats(unpacked, 2 * width * 4);
+         memset(packed, 0, sizeof(packed));
+         memset(packed_ref, 0, sizeof(packed_ref));
+         pack->pack_rgba_float(packed, width * bpp, unpacked, width * 16, width, 2);
+         pack_generic->pack_rgba_float(packed_ref, width * bpp, unpacked, width * 16, width, 2);
+         if (memcmp(packed, packed_ref, sizeof(packed)))
+            failed = "pack_rgba_float";
+      }
+
+      if (pack->pack_rgba_8unorm &&
+          pack->pack_rgba_8unorm != pack_generic->pack_rgba_8unorm) {
+         fill_random_bytes(unpacked8, 2 * width * 4);
+         memset(packed, 0, sizeof(packed));
+         memset(packed_ref, 0, sizeof(packed_ref));
+         pack->pack_rgba_8unorm(packed, width * bpp, unpacked8, width * 4, width, 2);
+         pack_generic->pack_rgba_8unorm(packed_ref, width * bpp, unpacked8, width * 4, width, 2);
+         if (memcmp(packed, packed_ref, sizeof(packed)))
+            failed = "pack_rgba_8unorm";
+      }
+
+      if (failed) {
+         fprintf(stderr, "FAILED: optimized util_format_%s_%s differs for %u pixels\n",
+                 util_format_short_name(format), failed, width);
+         success = false;
+         break;
+      }
+   }
+
+   return success;
+}
+
+static bool
+test_optimized(void)
+{
+   bool success = true;
+
+   srand(0);
+
+   for (enum pipe_format format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+      if (!util_format_description(format))
+         continue;
+
+      if (!test_optimized_format(format))
+         success = false;
+   }
+
+   return success;
+}
+
+
+/*
+ * Throughput of the optimized functions against the generated ones, on
+ * 1024x1024 images.  Only run with --bench.
+ */
+
+#define BENCH_SIZE 1024
+#define BENCH_ITERATIONS 16
+
+static double
+bench_unpack(void (*func)(void *restrict, const uint8_t *restrict, unsigned),
+             void *dst, const uint8_t *src, unsigned bpp, unsigned dst_bpp)
+{
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < BENCH_ITERATIONS; i++) {
+      for (unsigned y = 0; y < BENCH_SIZE; y++)
+         func((uint8_t *)dst + y * BENCH_SIZE * dst_bpp, src + y * BENCH_SIZE * bpp, BENCH_SIZE);
+   }
+   int64_t end = os_time_get_nano();
+
+   /* Mpixels/s */
+   return (double)BENCH_SIZE * BENCH_SIZE * BENCH_ITERATIONS * 1000.0 / (end - start);
+}
+
+static double
+bench_pack(void (*func)(uint8_t *restrict, unsigned, const void *restrict,
+                        unsigned, unsigned, unsigned),
+           uint8_t *dst, const void *src, unsigned bpp, unsigned src_bpp)
+{
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < BENCH_ITERATIONS; i++) {
+      func(dst, BENCH_SIZE * bpp, src, BENCH_SIZE * src_bpp, BENCH_SIZE, BENCH_SIZE);
+   }
+   int64_t end = os_time_get_nano();
+
+   return (double)BENCH_SIZE * BENCH_SIZE * BENCH_ITERATIONS * 1000.0 / (end - start);
+}
+
+typedef void (*unpack_func)(void *restrict, const uint8_t *restrict, unsigned);
+typedef void (*pack_func)(uint8_t *restrict, unsigned, const void *restrict,
+                          unsigned, unsigned, unsigned);
+
+static void
+bench_optimized(void)
+{
+   const unsigned pixels = BENCH_SIZE * BENCH_SIZE;
+   uint8_t *packed = malloc(pixels * UTIL_FORMAT_MAX_PACKED_BYTES);
+   float *unpacked = malloc(pixels * 4 * sizeof(float));
+   uint8_t *unpacked8 = malloc(pixels * 4);
+
+   fill_random_bytes(unpacked8, pixels * 4);
+   fill_random_floats(unpacked, pixels * 4);
+
+   printf("%-28s %-20s %12s %12s\n", "format", "function", "generic", "optimized");
+
+   for (enum pipe_format format = 1; format < PIPE_FORMAT_COUNT; ++format) {
+      if (!util_format_description(format))
+         continue;
+
+      const struct util_format_unpack_description *unpack =
+         util_format_unpack_description(format);
+      const struct util_format_unpack_description *unpack_generic =
+         util_format_unpack_description_generic(format);
+      const struct util_format_pack_description *pack =
+         util_format_pack_description(format);
+      const struct util_format_pack_description *pack_generic =
+         util_format_pack_description_generic(format);
+      const unsigned bpp = util_format_get_blocksize(format);
+      const char *name = util_format_short_name(format);
+
+      if (unpack == unpack_generic && pack == pack_generic)
+         continue;
+
+      fill_random_bytes(packed, pixels * bpp);
+
+#define BENCH_UNPACK(func, dst, dst_bpp) \
+      if (unpack->func && unpack->func != unpack_generic->func) { \
+         printf("%-28s %-20s %7.0f MP/s %7.0f MP/s\n", name, #func, \
+                bench_unpack((unpack_func)unpack_generic->func, dst, packed, bpp, dst_bpp), \
+                bench_unpack((unpack_func)unpack->func, dst, packed, bpp, dst_bpp)); \
+      }
+
+#define BENCH_PACK(func, src, src_bpp) \
+      if (pack->func && pack->func != pack_generic->func) { \
+         printf("%-28s %-20s %7.0f MP/s %7.0f MP/s\n", name, #func, \
+                bench_pack((pack_func)pack_generic->func, packed, src, bpp, src_bpp), \
+                bench_pack((pack_func)pack->func, packed, src, bpp, src_bpp)); \
+      }
+
+      BENCH_UNPACK(unpack_rgba_8unorm, unpacked8, 4);
+      BENCH_UNPACK(unpack_rgba, unpacked, 16);
+      BENCH_PACK(pack_rgba_8unorm, unpacked8, 4);
+      BENCH_PACK(pack_rgba_float, unpacked, 16);
+
+#undef BENCH_UNPACK
+#undef BENCH_PACK
+   }
+
+   free(packed);
+   free(unpacked);
+   free(unpacked8);
+}
+
+
 int main(int argc, char **argv)
 {
    bool success;
 
+   if (argc > 1 && !strcmp(argv[1], "--bench")) {
+      bench_optimized();
+      return 0;
+   }
+
    success = test_all();
+   success &= test_optimized();
 
    return success ? 0 : 1;
 }
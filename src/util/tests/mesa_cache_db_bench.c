@@ -0,0 +1,184 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Multi-process lookup benchmark for mesa_cache_db.
+ *
+ * Fills a database with a set of entries and then forks an increasing
+ * number of reader processes, each with its own handle on the database,
+ * that look up random entries for a fixed amount of time. This mimics many
+ * applications starting at once against the same shader cache.
+ *
+ * Usage: mesa_cache_db_bench [max_readers] [seconds_per_run]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "util/mesa_cache_db.h"
+#include "util/mesa-sha1.h"
+#include "util/os_time.h"
+#include "util/rand_xor.h"
+
+#define NUM_ENTRIES  1024
+#define ENTRY_SIZE   4096
+
+static void
+entry_key(unsigned i, uint8_t key[20])
+{
+   _mesa_sha1_compute(&i, sizeof(i), key);
+}
+
+static bool
+fill_db(const char *path)
+{
+   struct mesa_cache_db db;
+   uint8_t blob[ENTRY_SIZE];
+   uint8_t key[20];
+
+   if (!mesa_cache_db_open(&db, path))
+      return false;
+
+   mesa_cache_db_set_size_limit(&db, 64 * 1024 * 1024);
+
+   for (unsigned i = 0; i < NUM_ENTRIES; i++) {
+      memset(blob, i, sizeof(blob));
+      entry_key(i, key);
+      mesa_cache_db_entry_write(&db, key, blob, sizeof(blob));
+   }
+
+   mesa_cache_db_close(&db);
+
+   return true;
+}
+
+static void
+run_reader(const char *path, int fd, unsigned seed, double seconds)
+{
+   uint64_t state[2];
+   struct mesa_cache_db db;
+   uint64_t lookups = 0;
+   uint8_t key[20];
+
+   if (!mesa_cache_db_open(&db, path))
+      _exit(1);
+
+   s_rand_xorshift128plus(state, false);
+   state[0] ^= seed;
+
+   int64_t end = os_time_get_nano() + (int64_t)(seconds * 1e9);
+
+   while (os_time_get_nano() < end) {
+      /* Check the clock only every so often */
+      for (unsigned i = 0; i < 64; i++) {
+         size_t size;
+         void *data;
+
+         entry_key(rand_xorshift128plus(state) % NUM_ENTRIES, key);
+         data = mesa_cache_db_read_entry(&db, key, &size);
+         if (!data || size != ENTRY_SIZE)
+            _exit(1);
+
+         free(data);
+         lookups++;
+      }
+   }
+
+   mesa_cache_db_close(&db);
+
+   if (write(fd, &lookups, sizeof(lookups)) != sizeof(lookups))
+      _exit(1);
+
+   _exit(0);
+}
+
+static bool
+run_readers(const char *path, unsigned num_readers, double seconds,
+            uint64_t *total)
+{
+   int fds[2];
+   bool success = true;
+
+   if (pipe(fds) == -1)
+      return false;
+
+   for (unsigned i = 0; i < num_readers; i++) {
+      pid_t pid = fork();
+
+      if (pid == -1) {
+         success = false;
+         num_readers = i;
+         break;
+      }
+
+      if (pid == 0) {
+         close(fds[0]);
+         run_reader(path, fds[1], i + 1, seconds);
+      }
+   }
+
+   close(fds[1]);
+
+   *total = 0;
+
+   for (unsigned i = 0; i < num_readers; i++) {
+      uint64_t lookups;
+      int status;
+
+      if (read(fds[0], &lookups, sizeof(lookups)) == sizeof(lookups))
+         *total += lookups;
+
+      if (wait(&status) == -1 || !WIFEXITED(status) || WEXITSTATUS(status))
+         success = false;
+   }
+
+   close(fds[0]);
+
+   return success;
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned max_readers = argc > 1 ? atoi(argv[1]) : sysconf(_SC_NPROCESSORS_ONLN);
+   double seconds = argc > 2 ? atof(argv[2]) : 1.0;
+   char path[] = "/tmp/mesa_cache_db_bench_XXXXXX";
+
+   if (!mkdtemp(path)) {
+      fprintf(stderr, "failed to create a temporary directory\n");
+      return 1;
+   }
+
+   if (!fill_db(path)) {
+      fprintf(stderr, "failed to create the database\n");
+      return 1;
+   }
+
+   printf("%8s %16s %16s\n", "readers", "lookups/s", "per reader");
+
+   for (unsigned n = 1; n <= max_readers; n *= 2) {
+      uint64_t total;
+
+      if (!run_readers(path, n, seconds, &total)) {
+         fprintf(stderr, "reader failed\n");
+         mesa_db_wipe_path(path);
+         rmdir(path);
+         return 1;
+      }
+
+      printf("%8u %16.0f %16.0f\n", n, total / seconds, total / seconds / n);
+
+      if (n < max_readers && n * 2 > max_readers)
+         n = max_readers / 2;
+   }
+
+   mesa_db_wipe_path(path);
+   rmdir(path);
+
+   return 0;
+}
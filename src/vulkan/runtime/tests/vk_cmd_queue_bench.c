@@ -0,0 +1,104 @@
+/*
+ * Copyright 2024 Mesa contributors
+ * SPDX-License-Identifier: MIT
+ */
+
+/* Record/reset benchmark for vk_cmd_queue.
+ *
+ * Records a command buffer's worth of draws (vertex buffer binds, push
+ * constants, barriers and indexed draws) into a vk_cmd_queue and resets it,
+ * the way lavapipe records every command buffer, and reports the time per
+ * recorded command.  It runs once with the chunks returned to a pool-like
+ * free list on reset and once with them freed, to show what the recycling
+ * is worth.
+ *
+ * Usage: vk_cmd_queue_bench [draws_per_buffer] [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "vk_alloc.h"
+#include "vk_cmd_queue.h"
+
+#include "util/os_time.h"
+
+#define CMDS_PER_DRAW 4
+
+static void
+record(struct vk_cmd_queue *queue, unsigned draws)
+{
+   const VkBuffer buffers[2] = { (VkBuffer)(uintptr_t)0x1000,
+                                 (VkBuffer)(uintptr_t)0x2000 };
+   const VkDeviceSize offsets[2] = { 0, 256 };
+   const VkDeviceSize strides[2] = { 32, 16 };
+   const float constants[16] = { 0 };
+   const VkMemoryBarrier2 barrier = {
+      .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+      .srcStageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT,
+      .srcAccessMask = VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT,
+      .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT,
+      .dstAccessMask = VK_ACCESS_2_SHADER_READ_BIT,
+   };
+   const VkDependencyInfo dep = {
+      .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+      .memoryBarrierCount = 1,
+      .pMemoryBarriers = &barrier,
+   };
+
+   for (unsigned i = 0; i < draws; i++) {
+      vk_enqueue_cmd_bind_vertex_buffers2(queue, 0, 2, buffers, offsets,
+                                          NULL, strides);
+      vk_enqueue_cmd_push_constants(queue, VK_NULL_HANDLE,
+                                    VK_SHADER_STAGE_VERTEX_BIT, 0,
+                                    sizeof(constants), constants);
+      vk_enqueue_cmd_pipeline_barrier2(queue, &dep);
+      vk_enqueue_cmd_draw_indexed(queue, 36, 1, i * 36, 0, 0);
+   }
+}
+
+static double
+run(unsigned draws, unsigned iterations, bool recycle)
+{
+   VkAllocationCallbacks alloc = *vk_default_allocator();
+   struct list_head free_chunks;
+   struct vk_cmd_queue queue;
+
+   list_inithead(&free_chunks);
+   vk_cmd_queue_init(&queue, &alloc, recycle ? &free_chunks : NULL);
+
+   /* warm up */
+   record(&queue, draws);
+   vk_cmd_queue_reset(&queue);
+
+   int64_t start = os_time_get_nano();
+   for (unsigned i = 0; i < iterations; i++) {
+      record(&queue, draws);
+      vk_cmd_queue_reset(&queue);
+   }
+   int64_t end = os_time_get_nano();
+
+   vk_cmd_queue_finish(&queue);
+   vk_cmd_queue_free_chunks(&alloc, &free_chunks);
+
+   return (double)(end - start) / ((double)iterations * draws * CMDS_PER_DRAW);
+}
+
+int
+main(int argc, char **argv)
+{
+   unsigned draws = argc > 1 ? atoi(argv[1]) : 100000;
+   unsigned iterations = argc > 2 ? atoi(argv[2]) : 20;
+
+   if (draws == 0 || iterations == 0)
+      return EXIT_FAILURE;
+
+   printf("%u commands per buffer, %u iterations\n",
+          draws * CMDS_PER_DRAW, iterations);
+   printf("  chunks recycled: %.1f ns/command\n",
+          run(draws, iterations, true));
+   printf("  chunks freed:    %.1f ns/command\n",
+          run(draws, iterations, false));
+
+   return EXIT_SUCCESS;
+}
@@ -55,6 +55,11 @@ struct vk_command_pool {
 
    /** List of freed command buffers for trimming. */
    struct list_head free_command_buffers;
+
+   /** List of vk_cmd_queue_chunk released by command buffer resets, reused
+    * by the next command buffer recorded from this pool.
+    */
+   struct list_head free_cmd_queue_chunks;
 };
 
 VK_DEFINE_NONDISP_HANDLE_CASTS(vk_command_pool, base, VkCommandPool,
@@ -77,6 +77,9 @@ TEMPLATE_H = Template(COPYRIGHT + """\
 #pragma once
 
 #include "util/list.h"
+#include "util/macros.h"
+
+#include <string.h>
 
 #define VK_PROTOTYPES
 #include <vulkan/vulkan_core.h>
@@ -90,9 +93,29 @@ extern "C" {
 
 struct vk_device_dispatch_table;
 
+/** Size of the chunks commands are bump-allocated from */
+#define VK_CMD_QUEUE_CHUNK_SIZE (16 * 1024)
+
+struct vk_cmd_queue_chunk {
+   struct list_head link;
+   size_t size;
+   /* followed by size bytes of command data */
+};
+
 struct vk_cmd_queue {
    const VkAllocationCallbacks *alloc;
    struct list_head cmds;
+
+   /** Chunks holding the commands and everything they point to */
+   struct list_head chunks;
+
+   /** Free space left in the current chunk */
+   uint8_t *chunk_next, *chunk_end;
+
+   /** Where to return chunks on reset, usually the command pool's list of
+    * free chunks.  If NULL, chunks are freed.
+    */
+   struct list_head *free_chunks;
 };
 
 enum vk_cmd_type {
@@ -181,11 +204,38 @@ struct vk_cmd_queue_entry {
 
 void vk_free_queue(struct vk_cmd_queue *queue);
 
+void *vk_cmd_queue_zalloc_chunk(struct vk_cmd_queue *queue, size_t size);
+
+/* Allocates zeroed memory that lives until the queue is reset.  All of a
+ * command's memory comes from here, so nothing but driver_data needs to be
+ * freed per command.
+ */
+static inline void *
+vk_cmd_queue_zalloc(struct vk_cmd_queue *queue, size_t size)
+{
+   size = (size + 7) & ~(size_t)7;
+   if (unlikely(size >= (size_t)(queue->chunk_end - queue->chunk_next)))
+      return vk_cmd_queue_zalloc_chunk(queue, size);
+
+   void *ptr = queue->chunk_next;
+   queue->chunk_next += size;
+   memset(ptr, 0, size);
+   return ptr;
+}
+
+/* Frees a list of chunks that were returned to a command pool */
+void vk_cmd_queue_free_chunks(const VkAllocationCallbacks *alloc,
+                              struct list_head *chunks);
+
 static inline void
-vk_cmd_queue_init(struct vk_cmd_queue *queue, VkAllocationCallbacks *alloc)
+vk_cmd_queue_init(struct vk_cmd_queue *queue, VkAllocationCallbacks *alloc,
+                  struct list_head *free_chunks)
 {
    queue->alloc = alloc;
    list_inithead(&queue->cmds);
+   list_inithead(&queue->chunks);
+   queue->chunk_next = queue->chunk_end = NULL;
+   queue->free_chunks = free_chunks;
 }
 
 static inline void
@@ -259,25 +309,6 @@ size_t vk_cmd_queue_type_sizes[] = {
 % if c.guard is not None:
 #ifdef ${c.guard}
 % endif
-static void
-vk_free_${to_underscore(c.name)}(struct vk_cmd_queue *queue,
-${' ' * len('vk_free_' + to_underscore(c.name) + '(')}\\
-struct vk_cmd_queue_entry *cmd)
-{
-   if (cmd->driver_free_cb)
-      cmd->driver_free_cb(queue, cmd);
-   else
-      vk_free(queue->alloc, cmd->driver_data);
-% for p in c.params[1:]:
-% if p.len:
-   vk_free(queue->alloc, (${remove_suffix(p.decl.replace("const", ""), p.name)})cmd->u.${to_struct_field_name(c.name)}.${to_field_name(p.name)});
-% elif '*' in p.decl:
-${get_command_struct_free(c, p, types)}
-% endif
-% endfor
-   vk_free(queue->alloc, cmd);
-}
-
 % if c.name not in manual_commands and c.name not in no_enqueue_commands:
 VkResult vk_enqueue_${to_underscore(c.name)}(struct vk_cmd_queue *queue
 % for p in c.params[1:]:
@@ -285,27 +316,23 @@ VkResult vk_enqueue_${to_underscore(c.name)}(struct vk_cmd_queue *queue
 % endfor
 )
 {
-   struct vk_cmd_queue_entry *cmd = vk_zalloc(queue->alloc, vk_cmd_queue_type_sizes[${to_enum_name(c.name)}], 8,
-                                              VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+   struct vk_cmd_queue_entry *cmd =
+      vk_cmd_queue_zalloc(queue, vk_cmd_queue_type_sizes[${to_enum_name(c.name)}]);
    if (!cmd) return VK_ERROR_OUT_OF_HOST_MEMORY;
 
    cmd->type = ${to_enum_name(c.name)};
-   \
-   <% need_error_handling = False %>
 % for p in c.params[1:]:
 % if p.len:
    if (${p.name}) {
       ${get_array_copy(c, p)}
-   }\
-   <% need_error_handling = True %>
+   }
 % elif '[' in p.decl:
    memcpy(cmd->u.${to_struct_field_name(c.name)}.${to_field_name(p.name)}, ${p.name},
           sizeof(*${p.name}) * ${get_array_len(p)});
 % elif p.type == "void":
    cmd->u.${to_struct_field_name(c.name)}.${to_field_name(p.name)} = (${remove_suffix(p.decl.replace("const", ""), p.name)}) ${p.name};
 % elif '*' in p.decl:
-${get_struct_copy("cmd->u.%s.%s" % (to_struct_field_name(c.name), to_field_name(p.name)), p.name, p.type, 'sizeof(%s)' % p.type, types)}\
-   <% need_error_handling = True %>
+${get_struct_copy("cmd->u.%s.%s" % (to_struct_field_name(c.name), to_field_name(p.name)), p.name, p.type, 'sizeof(%s)' % p.type, types)}
 % else:
    cmd->u.${to_struct_field_name(c.name)}.${to_field_name(p.name)} = ${p.name};
 % endif
@@ -313,13 +340,6 @@ ${get_struct_copy("cmd->u.%s.%s" % (to_struct_field_name(c.name), to_field_name(
 
    list_addtail(&cmd->cmd_link, &queue->cmds);
    return VK_SUCCESS;
-
-% if need_error_handling:
-err:
-   if (cmd)
-      vk_free_${to_underscore(c.name)}(queue, cmd);
-   return VK_ERROR_OUT_OF_HOST_MEMORY;
-% endif
 }
 % endif
 % if c.guard is not None:
@@ -328,25 +348,76 @@ err:
 
 % endfor
 
+void *
+vk_cmd_queue_zalloc_chunk(struct vk_cmd_queue *queue, size_t size)
+{
+   struct vk_cmd_queue_chunk *chunk;
+
+   /* Anything that would waste much of a chunk gets a chunk of its own, and
+    * the current chunk stays in use.
+    */
+   if (size > VK_CMD_QUEUE_CHUNK_SIZE / 4) {
+      chunk = vk_alloc(queue->alloc, sizeof(*chunk) + size, 8,
+                       VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      if (chunk == NULL)
+         return NULL;
+
+      chunk->size = size;
+      list_add(&chunk->link, &queue->chunks);
+      return memset(chunk + 1, 0, size);
+   }
+
+   if (queue->free_chunks && !list_is_empty(queue->free_chunks)) {
+      chunk = list_first_entry(queue->free_chunks,
+                               struct vk_cmd_queue_chunk, link);
+      list_del(&chunk->link);
+   } else {
+      chunk = vk_alloc(queue->alloc,
+                       sizeof(*chunk) + VK_CMD_QUEUE_CHUNK_SIZE, 8,
+                       VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);
+      if (chunk == NULL)
+         return NULL;
+
+      chunk->size = VK_CMD_QUEUE_CHUNK_SIZE;
+   }
+
+   list_addtail(&chunk->link, &queue->chunks);
+   queue->chunk_next = (uint8_t *)(chunk + 1) + size;
+   queue->chunk_end = (uint8_t *)(chunk + 1) + VK_CMD_QUEUE_CHUNK_SIZE;
+
+   return memset(chunk + 1, 0, size);
+}
+
+void
+vk_cmd_queue_free_chunks(const VkAllocationCallbacks *alloc,
+                         struct list_head *chunks)
+{
+   list_for_each_entry_safe(struct vk_cmd_queue_chunk, chunk, chunks, link)
+      vk_free(alloc, chunk);
+   list_inithead(chunks);
+}
+
 void
 vk_free_queue(struct vk_cmd_queue *queue)
 {
-   struct vk_cmd_queue_entry *tmp, *cmd;
-   LIST_FOR_EACH_ENTRY_SAFE(cmd, tmp, &queue->cmds, cmd_link) {
-      switch(cmd->type) {
-% for c in commands:
-% if c.guard is not None:
-#ifdef ${c.guard}
-% endif
-      case ${to_enum_name(c.name)}:
-         vk_free_${to_underscore(c.name)}(queue, cmd);
-         break;
-% if c.guard is not None:
-#endif // ${c.guard}
-% endif
-% endfor
-      }
+   list_for_each_entry(struct vk_cmd_queue_entry, cmd, &queue->cmds, cmd_link) {
+      if (cmd->driver_free_cb)
+         cmd->driver_free_cb(queue, cmd);
+      else
+         vk_free(queue->alloc, cmd->driver_data);
+   }
+
+   /* The commands themselves are freed in bulk along with their chunks */
+   list_for_each_entry_safe(struct vk_cmd_queue_chunk, chunk,
+                            &queue->chunks, link) {
+      if (queue->free_chunks && chunk->size == VK_CMD_QUEUE_CHUNK_SIZE)
+         list_add(&chunk->link, queue->free_chunks);
+      else
+         vk_free(queue->alloc, chunk);
    }
+
+   list_inithead(&queue->chunks);
+   queue->chunk_next = queue->chunk_end = NULL;
 }
 
 void
@@ -470,7 +541,7 @@ def get_array_copy(command, param):
         field_size = "1"
     else:
         field_size = "sizeof(*%s)" % field_name
-    allocation = "%s = vk_zalloc(queue->alloc, %s * (%s), 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n      if (%s == NULL) goto err;\n" % (field_name, field_size, param.len, field_name)
+    allocation = "%s = vk_cmd_queue_zalloc(queue, %s * (%s));\n      if (%s == NULL) return VK_ERROR_OUT_OF_HOST_MEMORY;\n" % (field_name, field_size, param.len, field_name)
     copy = "memcpy((void*)%s, %s, %s * (%s));" % (field_name, param.name, field_size, param.len)
     return "%s\n      %s" % (allocation, copy)
 
@@ -481,7 +552,7 @@ def get_array_member_copy(struct, src_name, member, types, level, indent_level):
         field_size = "sizeof(*%s)" % (field_name)
     else:
         field_size = "sizeof(*%s) * %s->%s" % (field_name, struct, member.len)
-    allocation = "%s   %s = vk_zalloc(queue->alloc, %s, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n%s   if (%s == NULL) goto err;\n" % (indent, field_name, field_size, indent, field_name)
+    allocation = "%s   %s = vk_cmd_queue_zalloc(queue, %s);\n%s   if (%s == NULL) return VK_ERROR_OUT_OF_HOST_MEMORY;\n" % (indent, field_name, field_size, indent, field_name)
     copy = "%s   memcpy((void*)%s, %s->%s, %s);" % (indent, field_name, src_name, member.name, field_size)
 
     member_copies = ""
@@ -547,7 +618,7 @@ def get_struct_copy(dst, src_name, src_type, size, types, level=0, indent_level=
     global tmp_src_idx
 
     indent = "   " * indent_level
-    allocation = "%s   %s = vk_zalloc(queue->alloc, %s, 8, VK_SYSTEM_ALLOCATION_SCOPE_OBJECT);\n%s   if (%s == NULL) goto err;\n" % (indent, dst, size, indent, dst)
+    allocation = "%s   %s = vk_cmd_queue_zalloc(queue, %s);\n%s   if (%s == NULL) return VK_ERROR_OUT_OF_HOST_MEMORY;\n" % (indent, dst, size, indent, dst)
     copy = "%s   memcpy((void*)%s, %s, %s);" % (indent, dst, src_name, size)
 
     level += 1
@@ -569,89 +640,6 @@ def get_struct_copy(dst, src_name, src_type, size, types, level=0, indent_level=
          allocation, copy, tmp_dst, tmp_src, member_copies,
          indent, null_assignment, indent)
 
-def get_array_member_free(struct, member, types, level, indent_level):
-    field_name = "%s->%s" % (struct, member.name)
-    member_frees = ""
-    indent = "   " * indent_level
-    if member.type in types:
-        for sub_member in types[member.type].members:
-            if sub_member.len and sub_member.len != 'null-terminated':
-                if member.len == "struct-ptr":
-                    member_frees += get_array_member_free(field_name, sub_member, types, level, indent_level + 1)
-                else:
-                    counter_name = "i%s" % level
-                    member_frees += "%s   for (uint32_t %s = 0; %s < %s->%s; ++%s) {\n%s%s   }\n" % \
-                        (indent, counter_name, counter_name, struct, member.len, counter_name,
-                        get_array_member_free("(%s + %s)" % (field_name, counter_name),
-                                              sub_member, types, level + 1, indent_level + 2),
-                        indent)
-            elif member.name == 'pNext':
-                raise NotImplementedError("pNext in array not supported")
-    
-    const_cast = remove_suffix(member.decl.replace("const", ""), member.name)
-    array_free = "vk_free(queue->alloc, (%s)%s);" % (const_cast, field_name)
-    if_stmt = ""
-    endif_stmt = ""
-    if len(member_frees) > 0:
-        if_stmt = "%sif (%s) {\n" % (indent, field_name)
-        endif_stmt = "%s}\n" % indent
-        indent = "   " * (indent_level + 1)
-    return "%s%s%s%s\n%s" % (if_stmt, member_frees, indent, array_free, endif_stmt)
-
-def get_pnext_member_free(struct, type, member, types, level, indent_level):
-    if not types[type].extended_by:
-        return ""
-    field_name = "%s->%s" % (struct, member.name)
-    pnext_decl = "const VkBaseInStructure *pnext = %s;" % field_name
-    case_stmts = ""
-    indent = "   " * (indent_level + 2)
-    for ext_type in types[type].extended_by:
-        guard_pre_stmt = ""
-        guard_post_stmt = ""
-        if ext_type.guard is not None:
-            guard_pre_stmt = "#ifdef %s\n" % ext_type.guard
-            guard_post_stmt = "#endif\n"
-        case_stmts += """%s%scase %s:
-%s
-%sbreak;
-%s
-""" % (guard_pre_stmt,
-             indent, ext_type.enum,
-             get_struct_free("((%s*)pthis)" % ext_type.name, ext_type.name, "", types, level, indent_level + 3),
-             indent,
-             guard_post_stmt)
-        
-    indent = "   " * indent_level
-    return """
-%s%s
-%swhile (pnext) {
-%s   const VkBaseInStructure *pthis = pnext;
-%s   pnext = pnext->pNext;
-%s   switch ((int32_t)pthis->sType) {
-%s%s   }
-%s}
-""" % (indent, pnext_decl,
-          indent, indent, indent, indent,
-          case_stmts, indent,
-          indent)
-
-def get_command_struct_free(command, param, types):
-    field_name = "cmd->u.%s.%s" % (to_struct_field_name(command.name), to_field_name(param.name))
-    const_cast = remove_suffix(param.decl.replace("const", ""), param.name)
-    return get_struct_free(field_name, param.type, "(%s)" % const_cast, types)
-
-def get_struct_free(field_name, type, cast, types, level=1, indent_level=1):
-    struct_free = "vk_free(queue->alloc, %s%s);" % (cast, field_name)
-    member_frees = ""
-    if (type in types):
-        for member in types[type].members:
-            if member.len and member.len != 'null-terminated':
-                member_frees += get_array_member_free(field_name, member, types, level, indent_level + 1)
-            elif member.name == 'pNext':
-                member_frees += get_pnext_member_free(field_name, type, member, types, level, indent_level + 1)
-    indent = "   " * indent_level
-    return "%sif (!cmd->driver_free_cb) {\n%s%s}\n%s%s" % (indent, member_frees, indent, indent, struct_free)
-
 EntrypointType = namedtuple('EntrypointType', 'name enum members extended_by guard')
 
 def get_types_defines(doc):
@@ -770,7 +758,6 @@ def main():
         'to_struct_name': to_struct_name,
         'get_array_copy': get_array_copy,
         'get_struct_copy': get_struct_copy,
-        'get_command_struct_free': get_command_struct_free,
         'types': types,
         'manual_commands': MANUAL_COMMANDS,
         'no_enqueue_commands': NO_ENQUEUE_COMMANDS,